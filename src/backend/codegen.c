@@ -1,9 +1,9 @@
 #include "codegen.h"
 
-static int CODEGEN_get_var_pos(var_array* vars, const char* name) 
+static int CODEGEN_get_var_pos(var_array* vars, atom_t name) 
 {
   da_foreach(var_pair_t, it, vars) {
-    if (strcmp(it->name, name) == 0)
+    if (it->name == name)
       return it->place;
   }
 
@@ -53,17 +53,16 @@ int CODEGEN_write_function(
     case IR_LOAD_VAR:
       {
         // since this append after semantic analyze this can't fail
-        int place = CODEGEN_get_var_pos(&vars, (*it)->var.name);
+        int place = CODEGEN_get_var_pos(&vars, (*it)->var.atom);
         target->emit_mov_from_stack(sb, 
             CODEGEN_get_reg(target, (*it)->dest, false), place);
       }
       break;
     case IR_STORE_VAR:
-      int place = CODEGEN_get_var_pos(&vars, (*it)->var.name);
+      int place = CODEGEN_get_var_pos(&vars, (*it)->var.atom);
       if (place == -1) {
-        char* name = strdup((*it)->var.name);  
         place = actual_place++ * 8;
-        var_pair_t pair = {name, place};
+        var_pair_t pair = {(*it)->var.atom, place};
         da_append(&vars, pair); 
       }
       // TODO: handle uninitialized var
@@ -197,17 +196,22 @@ int CODEGEN_write_function(
       }
     case IR_ASM: {
       size_t arg_idx = 0;
+      string_builder_t line = {0};
       for (size_t i = 0; i < (*it)->asm_data.string_count; i++) {
         const char* s = (*it)->asm_data.strings[i];
         const char* pct = strchr(s, '%');
+        line.count = 0;
         if (pct && arg_idx < (*it)->asm_data.arg_count) {
           const char* reg = 
             CODEGEN_get_reg(target, (*it)->asm_data.args[arg_idx++], true);
-          sb_append_fmt(sb, "    %.*s%s\n", (int)(pct - s), s, reg);
+          sb_append_strn(&line, s, (size_t)(pct - s));
+          sb_append_str(&line, reg);
         } else {
-          sb_append_fmt(sb, "    %s\n", s);
+          sb_append_str(&line, s);
         }
+        target->emit_raw(sb, line.items);
       }
+      da_free(&line);
     }
       break;
     default:
@@ -217,9 +221,6 @@ int CODEGEN_write_function(
     } 
   }
 
-  da_foreach(var_pair_t, it, &vars)
-    free(it->name); 
-
   da_free(&vars);
 
   return 0;
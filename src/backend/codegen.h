@@ -10,7 +10,7 @@
 #include "../thirdparty/error.h"
 
 typedef struct {
-  char* name;
+  atom_t name;
   int place;
 } var_pair_t;
 
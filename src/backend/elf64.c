@@ -0,0 +1,244 @@
+#include "elf64.h"
+#include "../thirdparty/error.h"
+
+#include <elf.h>
+
+enum {
+  SECTION_NULL = 0,
+  SECTION_TEXT,
+  SECTION_RELA_TEXT,
+  SECTION_SYMTAB,
+  SECTION_STRTAB,
+  SECTION_SHSTRTAB,
+  SECTION_COUNT,
+};
+
+typedef struct {
+  Elf64_Sym* items;
+  size_t count;
+  size_t capacity;
+} elf64_sym_array;
+
+static void elf64_append(string_builder_t* sb, const void* data, size_t size)
+{
+  da_reserve(sb, sb->count + size);
+  memcpy(sb->items + sb->count, data, size);
+  sb->count += size;
+}
+
+static void elf64_align(string_builder_t* sb, size_t align)
+{
+  while (sb->count % align != 0)
+    da_append(sb, '\0');
+}
+
+static Elf64_Word elf64_add_string(string_builder_t* strtab, const char* s)
+{
+  Elf64_Word offset = (Elf64_Word) strtab->count;
+  elf64_append(strtab, s, strlen(s) + 1);
+  return offset;
+}
+
+static size_t elf64_find_symbol(
+    const elf64_sym_array* syms,
+    const string_builder_t* strtab,
+    size_t first,
+    const char* name)
+{
+  for (size_t i = first; i < syms->count; ++i) {
+    if (strcmp(strtab->items + syms->items[i].st_name, name) == 0)
+      return i;
+  }
+  return 0;
+}
+
+bool elf64_serialize_object(const object_file_t* obj, string_builder_t* out)
+{
+  elf64_sym_array syms = {0};
+  string_builder_t strtab = {0};
+  da_append(&strtab, '\0');
+
+  Elf64_Sym null_sym = {0};
+  da_append(&syms, null_sym);
+
+  Elf64_Sym text_sym = {0};
+  text_sym.st_info = ELF64_ST_INFO(STB_LOCAL, STT_SECTION);
+  text_sym.st_shndx = SECTION_TEXT;
+  da_append(&syms, text_sym);
+
+  // local symbols must come before every global one
+  da_foreach(object_label_t, it, &obj->labels) {
+    if (object_is_global(obj, it->name)) continue;
+    Elf64_Sym sym = {0};
+    sym.st_name = elf64_add_string(&strtab, it->name);
+    sym.st_info = ELF64_ST_INFO(STB_LOCAL, STT_NOTYPE);
+    sym.st_shndx = SECTION_TEXT;
+    sym.st_value = it->offset;
+    da_append(&syms, sym);
+  }
+
+  size_t first_global = syms.count;
+
+  da_foreach(char*, it, &obj->globals) {
+    size_t offset = 0;
+    bool defined = object_find_label(obj, *it, &offset);
+    Elf64_Sym sym = {0};
+    sym.st_name = elf64_add_string(&strtab, *it);
+    sym.st_info = ELF64_ST_INFO(STB_GLOBAL, STT_NOTYPE);
+    sym.st_shndx = defined ? SECTION_TEXT : SHN_UNDEF;
+    sym.st_value = defined ? offset : 0;
+    da_append(&syms, sym);
+  }
+
+  da_foreach(char*, it, &obj->externs) {
+    if (object_find_label(obj, *it, NULL)) continue;
+    if (elf64_find_symbol(&syms, &strtab, first_global, *it)) continue;
+    Elf64_Sym sym = {0};
+    sym.st_name = elf64_add_string(&strtab, *it);
+    sym.st_info = ELF64_ST_INFO(STB_GLOBAL, STT_NOTYPE);
+    sym.st_shndx = SHN_UNDEF;
+    da_append(&syms, sym);
+  }
+
+  string_builder_t rela = {0};
+  bool ok = true;
+  da_foreach(object_ref_t, it, &obj->relocs) {
+    size_t index = elf64_find_symbol(&syms, &strtab, first_global, it->name);
+    if (index == 0) {
+      // referenced without global/extern, NASM would reject it too
+      error_report_general(ERROR_SEVERITY_ERROR,
+          "symbol '%s' is neither defined nor declared extern", it->name);
+      ok = false;
+      continue;
+    }
+
+    Elf64_Rela r = {0};
+    r.r_offset = it->offset;
+    r.r_info = ELF64_R_INFO(index,
+        it->kind == OBJECT_REF_CALL ? R_X86_64_PLT32 : R_X86_64_PC32);
+    r.r_addend = -4;
+    elf64_append(&rela, &r, sizeof(r));
+  }
+
+  if (!ok) {
+    da_free(&syms);
+    da_free(&strtab);
+    da_free(&rela);
+    return false;
+  }
+
+  string_builder_t shstrtab = {0};
+  da_append(&shstrtab, '\0');
+  Elf64_Word text_name = elf64_add_string(&shstrtab, ".text");
+  Elf64_Word rela_name = elf64_add_string(&shstrtab, ".rela.text");
+  Elf64_Word symtab_name = elf64_add_string(&shstrtab, ".symtab");
+  Elf64_Word strtab_name = elf64_add_string(&shstrtab, ".strtab");
+  Elf64_Word shstrtab_name = elf64_add_string(&shstrtab, ".shstrtab");
+
+  Elf64_Shdr sh[SECTION_COUNT] = {0};
+  out->count = 0;
+
+  Elf64_Ehdr eh = {0};
+  elf64_append(out, &eh, sizeof(eh)); // patched once offsets are known
+
+  elf64_align(out, 16);
+  sh[SECTION_TEXT].sh_name = text_name;
+  sh[SECTION_TEXT].sh_type = SHT_PROGBITS;
+  sh[SECTION_TEXT].sh_flags = SHF_ALLOC | SHF_EXECINSTR;
+  sh[SECTION_TEXT].sh_offset = out->count;
+  sh[SECTION_TEXT].sh_size = obj->text.count;
+  sh[SECTION_TEXT].sh_addralign = 16;
+  if (obj->text.count > 0)
+    elf64_append(out, obj->text.items, obj->text.count);
+
+  elf64_align(out, 8);
+  sh[SECTION_RELA_TEXT].sh_name = rela_name;
+  sh[SECTION_RELA_TEXT].sh_type = SHT_RELA;
+  sh[SECTION_RELA_TEXT].sh_flags = SHF_INFO_LINK;
+  sh[SECTION_RELA_TEXT].sh_offset = out->count;
+  sh[SECTION_RELA_TEXT].sh_size = rela.count;
+  sh[SECTION_RELA_TEXT].sh_link = SECTION_SYMTAB;
+  sh[SECTION_RELA_TEXT].sh_info = SECTION_TEXT;
+  sh[SECTION_RELA_TEXT].sh_addralign = 8;
+  sh[SECTION_RELA_TEXT].sh_entsize = sizeof(Elf64_Rela);
+  if (rela.count > 0)
+    elf64_append(out, rela.items, rela.count);
+
+  elf64_align(out, 8);
+  sh[SECTION_SYMTAB].sh_name = symtab_name;
+  sh[SECTION_SYMTAB].sh_type = SHT_SYMTAB;
+  sh[SECTION_SYMTAB].sh_offset = out->count;
+  sh[SECTION_SYMTAB].sh_size = syms.count * sizeof(Elf64_Sym);
+  sh[SECTION_SYMTAB].sh_link = SECTION_STRTAB;
+  sh[SECTION_SYMTAB].sh_info = (Elf64_Word) first_global;
+  sh[SECTION_SYMTAB].sh_addralign = 8;
+  sh[SECTION_SYMTAB].sh_entsize = sizeof(Elf64_Sym);
+  elf64_append(out, syms.items, syms.count * sizeof(Elf64_Sym));
+
+  sh[SECTION_STRTAB].sh_name = strtab_name;
+  sh[SECTION_STRTAB].sh_type = SHT_STRTAB;
+  sh[SECTION_STRTAB].sh_offset = out->count;
+  sh[SECTION_STRTAB].sh_size = strtab.count;
+  sh[SECTION_STRTAB].sh_addralign = 1;
+  elf64_append(out, strtab.items, strtab.count);
+
+  sh[SECTION_SHSTRTAB].sh_name = shstrtab_name;
+  sh[SECTION_SHSTRTAB].sh_type = SHT_STRTAB;
+  sh[SECTION_SHSTRTAB].sh_offset = out->count;
+  sh[SECTION_SHSTRTAB].sh_size = shstrtab.count;
+  sh[SECTION_SHSTRTAB].sh_addralign = 1;
+  elf64_append(out, shstrtab.items, shstrtab.count);
+
+  elf64_align(out, 8);
+  size_t shoff = out->count;
+  elf64_append(out, sh, sizeof(sh));
+
+  memcpy(eh.e_ident, ELFMAG, SELFMAG);
+  eh.e_ident[EI_CLASS] = ELFCLASS64;
+  eh.e_ident[EI_DATA] = ELFDATA2LSB;
+  eh.e_ident[EI_VERSION] = EV_CURRENT;
+  eh.e_ident[EI_OSABI] = ELFOSABI_SYSV;
+  eh.e_type = ET_REL;
+  eh.e_machine = EM_X86_64;
+  eh.e_version = EV_CURRENT;
+  eh.e_shoff = shoff;
+  eh.e_ehsize = sizeof(Elf64_Ehdr);
+  eh.e_shentsize = sizeof(Elf64_Shdr);
+  eh.e_shnum = SECTION_COUNT;
+  eh.e_shstrndx = SECTION_SHSTRTAB;
+  memcpy(out->items, &eh, sizeof(eh));
+
+  da_free(&syms);
+  da_free(&strtab);
+  da_free(&rela);
+  da_free(&shstrtab);
+  return true;
+}
+
+bool elf64_write_image(const string_builder_t* image, const char* path)
+{
+  FILE* f = fopen(path, "wb");
+  if (!f) {
+    error_report_general(
+        ERROR_SEVERITY_ERROR, "cannot write object file '%s'", path);
+    return false;
+  }
+
+  bool ok = fwrite(image->items, 1, image->count, f) == image->count;
+  if (fclose(f) != 0) ok = false;
+  if (!ok)
+    error_report_general(
+        ERROR_SEVERITY_ERROR, "cannot write object file '%s'", path);
+
+  return ok;
+}
+
+bool elf64_write_object(const object_file_t* obj, const char* path)
+{
+  string_builder_t image = {0};
+  if (!elf64_serialize_object(obj, &image)) return false;
+
+  bool ok = elf64_write_image(&image, path);
+  da_free(&image);
+  return ok;
+}
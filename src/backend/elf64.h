@@ -0,0 +1,19 @@
+#ifndef ELF64_H
+#define ELF64_H
+
+#include <stdbool.h>
+
+#include "object.h"
+
+// Serializes a finalized object as an ELF64 x86-64 relocatable file
+// (what `nasm -f elf64` produces): .text, its relocations, the symbol
+// table and the string tables.
+bool elf64_serialize_object(const object_file_t* obj, string_builder_t* out);
+
+// Same as elf64_serialize_object, written to `path`
+bool elf64_write_object(const object_file_t* obj, const char* path);
+
+// Writes an already serialized ELF image to `path`
+bool elf64_write_image(const string_builder_t* image, const char* path);
+
+#endif // ELF64_H
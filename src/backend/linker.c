@@ -0,0 +1,640 @@
+#include "linker.h"
+#include "../thirdparty/error.h"
+#include "../thirdparty/hashmap.h"
+#include "../thirdparty/string_builder.h"
+
+#include <elf.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <sys/stat.h>
+
+#define LINKER_PAGE_SIZE 0x1000
+
+// output sections, every input section is merged into one of them
+typedef enum {
+  OUT_TEXT,
+  OUT_DATA,
+  OUT_BSS,
+  OUT_COUNT,
+  OUT_NONE = OUT_COUNT,
+} out_section_t;
+
+typedef struct {
+  string_builder_t bytes; // empty for .bss
+  size_t           size;
+  size_t           align;
+  uint64_t         addr;
+  uint64_t         offset; // in the file
+} out_bucket_t;
+
+typedef struct {
+  const char*  path;
+  char*        owned; // file contents when read from disk
+  const char*  data;
+  size_t       size;
+
+  const Elf64_Ehdr* eh;
+  const Elf64_Shdr* sh;
+  const Elf64_Sym*  syms;
+  size_t            sym_count;
+  const char*       strtab;
+
+  out_section_t* placement; // per input section
+  size_t*        offset;    // per input section, inside its bucket
+} link_object_t;
+
+typedef struct {
+  char*         name;
+  uint64_t      addr;
+  out_section_t section;
+  bool          weak;
+  const char*   path; // defining object
+} link_symbol_t;
+
+typedef struct {
+  link_symbol_t* items;
+  size_t count;
+  size_t capacity;
+} link_symbol_array;
+
+typedef struct {
+  link_object_t*    objects;
+  size_t            object_count;
+  out_bucket_t      out[OUT_COUNT];
+  link_symbol_array symbols;
+  hashmap_t         symbol_index; // name -> index + 1 in `symbols`
+} linker_t;
+
+static const char* out_names[OUT_COUNT] = {
+  [OUT_TEXT] = ".text",
+  [OUT_DATA] = ".data",
+  [OUT_BSS]  = ".bss",
+};
+
+static uint64_t align_up(uint64_t v, uint64_t align)
+{
+  if (align <= 1) return v;
+  return (v + align - 1) / align * align;
+}
+
+static bool read_whole_file(const char* path, char** out, size_t* size)
+{
+  FILE* f = fopen(path, "rb");
+  if (!f) return false;
+
+  struct stat st;
+  if (fstat(fileno(f), &st) != 0 || st.st_size < 0) {
+    fclose(f);
+    return false;
+  }
+
+  char* data = malloc((size_t) st.st_size + 1);
+  if (!data) {
+    fclose(f);
+    return false;
+  }
+
+  size_t n = fread(data, 1, (size_t) st.st_size, f);
+  fclose(f);
+  if (n != (size_t) st.st_size) {
+    free(data);
+    return false;
+  }
+
+  *out = data;
+  *size = n;
+  return true;
+}
+
+static bool in_bounds(const link_object_t* o, uint64_t offset, uint64_t size)
+{
+  return offset <= o->size && size <= o->size - offset;
+}
+
+// Validates the headers of an input and locates its symbol table.
+// Returns LINK_UNSUPPORTED for anything but an x86-64 ELF64 relocatable
+// made of plain PROGBITS / NOBITS sections with RELA relocations.
+static link_status_t linker_open(link_object_t* o)
+{
+  if (o->size < sizeof(Elf64_Ehdr)) return LINK_UNSUPPORTED;
+  o->eh = (const Elf64_Ehdr*) o->data;
+
+  if (memcmp(o->eh->e_ident, ELFMAG, SELFMAG) != 0 ||
+      o->eh->e_ident[EI_CLASS] != ELFCLASS64 ||
+      o->eh->e_ident[EI_DATA] != ELFDATA2LSB ||
+      o->eh->e_type != ET_REL ||
+      o->eh->e_machine != EM_X86_64 ||
+      o->eh->e_shentsize != sizeof(Elf64_Shdr) ||
+      !in_bounds(o, o->eh->e_shoff,
+        (uint64_t) o->eh->e_shnum * sizeof(Elf64_Shdr)))
+    return LINK_UNSUPPORTED;
+
+  o->sh = (const Elf64_Shdr*) (o->data + o->eh->e_shoff);
+  o->placement = calloc(o->eh->e_shnum, sizeof(out_section_t));
+  o->offset = calloc(o->eh->e_shnum, sizeof(size_t));
+  if (o->eh->e_shnum && (!o->placement || !o->offset)) return LINK_ERROR;
+
+  for (size_t i = 0; i < o->eh->e_shnum; ++i) {
+    const Elf64_Shdr* s = &o->sh[i];
+    o->placement[i] = OUT_NONE;
+
+    if (s->sh_type != SHT_NOBITS && !in_bounds(o, s->sh_offset, s->sh_size))
+      return LINK_UNSUPPORTED;
+
+    switch (s->sh_type) {
+    case SHT_NULL:
+    case SHT_STRTAB:
+    case SHT_RELA:
+    case SHT_NOTE:
+      if (s->sh_type == SHT_NOTE && (s->sh_flags & SHF_ALLOC))
+        return LINK_UNSUPPORTED;
+      break;
+    case SHT_SYMTAB:
+      if (o->syms || s->sh_entsize != sizeof(Elf64_Sym) ||
+          s->sh_link >= o->eh->e_shnum)
+        return LINK_UNSUPPORTED;
+      o->syms = (const Elf64_Sym*) (o->data + s->sh_offset);
+      o->sym_count = s->sh_size / sizeof(Elf64_Sym);
+      o->strtab = o->data + o->sh[s->sh_link].sh_offset;
+      break;
+    case SHT_PROGBITS:
+    case SHT_NOBITS:
+      if (!(s->sh_flags & SHF_ALLOC)) break; // .comment, debug info
+      if (s->sh_flags & (SHF_TLS | SHF_GROUP)) return LINK_UNSUPPORTED;
+      if (s->sh_type == SHT_NOBITS)            o->placement[i] = OUT_BSS;
+      else if (s->sh_flags & SHF_EXECINSTR)    o->placement[i] = OUT_TEXT;
+      else                                     o->placement[i] = OUT_DATA;
+      break;
+    default:
+      // groups, init arrays, SHT_REL, ... would need a real linker
+      return LINK_UNSUPPORTED;
+    }
+  }
+
+  return LINK_OK;
+}
+
+static void linker_place_sections(linker_t* l)
+{
+  for (size_t i = 0; i < l->object_count; ++i) {
+    link_object_t* o = &l->objects[i];
+    for (size_t s = 0; s < o->eh->e_shnum; ++s) {
+      if (o->placement[s] == OUT_NONE) continue;
+
+      out_bucket_t* b = &l->out[o->placement[s]];
+      uint64_t align = o->sh[s].sh_addralign ? o->sh[s].sh_addralign : 1;
+      if (align > b->align) b->align = align;
+
+      b->size = align_up(b->size, align);
+      o->offset[s] = b->size;
+      b->size += o->sh[s].sh_size;
+    }
+  }
+
+  // text padding is filled with int3 so stray jumps trap
+  for (out_section_t k = OUT_TEXT; k < OUT_BSS; ++k) {
+    out_bucket_t* b = &l->out[k];
+    if (b->size == 0) continue;
+    da_reserve(&b->bytes, b->size);
+    memset(b->bytes.items, k == OUT_TEXT ? 0xCC : 0x00, b->size);
+    b->bytes.count = b->size;
+  }
+
+  for (size_t i = 0; i < l->object_count; ++i) {
+    link_object_t* o = &l->objects[i];
+    for (size_t s = 0; s < o->eh->e_shnum; ++s) {
+      out_section_t k = o->placement[s];
+      if (k == OUT_NONE || k == OUT_BSS) continue;
+      memcpy(l->out[k].bytes.items + o->offset[s],
+          o->data + o->sh[s].sh_offset, o->sh[s].sh_size);
+    }
+  }
+}
+
+// Text right after the headers, data and bss on the next pages so that
+// each gets its own protection
+static void linker_layout(linker_t* l, size_t header_size)
+{
+  out_bucket_t* text = &l->out[OUT_TEXT];
+  out_bucket_t* data = &l->out[OUT_DATA];
+  out_bucket_t* bss  = &l->out[OUT_BSS];
+
+  text->offset = align_up(header_size, text->align ? text->align : 1);
+  text->addr = LINKER_BASE_ADDRESS + text->offset;
+
+  uint64_t file_end = text->offset + text->size;
+  uint64_t mem_end = text->addr + text->size;
+
+  data->offset = align_up(file_end, data->align ? data->align : 1);
+  data->addr = align_up(mem_end, LINKER_PAGE_SIZE) +
+    (data->offset % LINKER_PAGE_SIZE);
+  if (data->size) file_end = data->offset + data->size;
+
+  bss->addr = align_up(data->addr + data->size, bss->align ? bss->align : 1);
+  bss->offset = file_end;
+}
+
+static uint64_t section_addr(
+    const linker_t* l, const link_object_t* o, size_t shndx)
+{
+  return l->out[o->placement[shndx]].addr + o->offset[shndx];
+}
+
+static link_symbol_t* linker_find(linker_t* l, const char* name)
+{
+  uintptr_t index = (uintptr_t) hashmap_get(&l->symbol_index, name);
+  return index ? &l->symbols.items[index - 1] : NULL;
+}
+
+static link_status_t linker_collect_symbols(linker_t* l)
+{
+  link_status_t status = LINK_OK;
+
+  for (size_t i = 0; i < l->object_count; ++i) {
+    link_object_t* o = &l->objects[i];
+    for (size_t j = 1; j < o->sym_count; ++j) {
+      const Elf64_Sym* sym = &o->syms[j];
+      int bind = ELF64_ST_BIND(sym->st_info);
+      if (bind != STB_GLOBAL && bind != STB_WEAK) continue;
+      if (sym->st_shndx == SHN_UNDEF) continue;
+      if (sym->st_shndx == SHN_COMMON) return LINK_UNSUPPORTED;
+
+      link_symbol_t def = {0};
+      def.weak = bind == STB_WEAK;
+      def.path = o->path;
+      if (sym->st_shndx == SHN_ABS) {
+        def.addr = sym->st_value;
+        def.section = OUT_NONE;
+      } else if (sym->st_shndx < o->eh->e_shnum &&
+          o->placement[sym->st_shndx] != OUT_NONE) {
+        def.addr = section_addr(l, o, sym->st_shndx) + sym->st_value;
+        def.section = o->placement[sym->st_shndx];
+      } else {
+        return LINK_UNSUPPORTED;
+      }
+
+      const char* name = o->strtab + sym->st_name;
+      link_symbol_t* prev = linker_find(l, name);
+      if (prev) {
+        if (def.weak) continue;
+        if (!prev->weak) {
+          error_report_general(ERROR_SEVERITY_ERROR,
+              "multiple definition of `%s' in '%s', first defined in '%s'",
+              name, o->path, prev->path);
+          status = LINK_ERROR;
+          continue;
+        }
+        def.name = prev->name;
+        *prev = def;
+        continue;
+      }
+
+      def.name = strdup(name);
+      da_append(&l->symbols, def);
+      hashmap_put(&l->symbol_index, name,
+          (void*) (uintptr_t) l->symbols.count);
+    }
+  }
+
+  return status;
+}
+
+static link_status_t linker_relocate(linker_t* l)
+{
+  link_status_t status = LINK_OK;
+
+  for (size_t i = 0; i < l->object_count; ++i) {
+    link_object_t* o = &l->objects[i];
+    for (size_t s = 0; s < o->eh->e_shnum; ++s) {
+      const Elf64_Shdr* rs = &o->sh[s];
+      if (rs->sh_type != SHT_RELA) continue;
+      if (rs->sh_info >= o->eh->e_shnum) return LINK_UNSUPPORTED;
+
+      size_t target = rs->sh_info;
+      if (o->placement[target] == OUT_NONE) continue; // debug sections
+      if (o->placement[target] == OUT_BSS || !o->syms)
+        return LINK_UNSUPPORTED;
+
+      const Elf64_Rela* rela = (const Elf64_Rela*) (o->data + rs->sh_offset);
+      size_t count = rs->sh_size / sizeof(Elf64_Rela);
+      char* section_bytes =
+        l->out[o->placement[target]].bytes.items + o->offset[target];
+
+      for (size_t r = 0; r < count; ++r) {
+        uint32_t type = ELF64_R_TYPE(rela[r].r_info);
+        size_t sym_index = ELF64_R_SYM(rela[r].r_info);
+        if (type == R_X86_64_NONE) continue;
+        if (sym_index >= o->sym_count) return LINK_UNSUPPORTED;
+
+        const Elf64_Sym* sym = &o->syms[sym_index];
+        const char* name = o->strtab + sym->st_name;
+        uint64_t S = 0;
+
+        if (ELF64_ST_BIND(sym->st_info) == STB_LOCAL) {
+          if (sym->st_shndx == SHN_ABS) {
+            S = sym->st_value;
+          } else if (sym->st_shndx < o->eh->e_shnum &&
+              o->placement[sym->st_shndx] != OUT_NONE) {
+            S = section_addr(l, o, sym->st_shndx) + sym->st_value;
+          } else {
+            return LINK_UNSUPPORTED;
+          }
+        } else {
+          link_symbol_t* def = linker_find(l, name);
+          if (!def) {
+            error_report_general(ERROR_SEVERITY_ERROR,
+                "undefined reference to `%s' in '%s'", name, o->path);
+            status = LINK_ERROR;
+            continue;
+          }
+          S = def->addr;
+        }
+
+        int64_t A = rela[r].r_addend;
+        uint64_t P = section_addr(l, o, target) + rela[r].r_offset;
+        size_t width = type == R_X86_64_64 ? 8 : 4;
+        if (rela[r].r_offset > o->sh[target].sh_size ||
+            width > o->sh[target].sh_size - rela[r].r_offset)
+          return LINK_UNSUPPORTED;
+
+        int64_t value;
+        switch (type) {
+        case R_X86_64_PC32:
+        case R_X86_64_PLT32:
+          value = (int64_t) (S + A - P);
+          if (value < INT32_MIN || value > INT32_MAX) return LINK_UNSUPPORTED;
+          break;
+        case R_X86_64_32:
+          value = (int64_t) (S + A);
+          if (value < 0 || value > (int64_t) UINT32_MAX)
+            return LINK_UNSUPPORTED;
+          break;
+        case R_X86_64_32S:
+          value = (int64_t) (S + A);
+          if (value < INT32_MIN || value > INT32_MAX) return LINK_UNSUPPORTED;
+          break;
+        case R_X86_64_64:
+          value = (int64_t) (S + A);
+          break;
+        default:
+          return LINK_UNSUPPORTED;
+        }
+
+        char* at = section_bytes + rela[r].r_offset;
+        for (size_t b = 0; b < width; ++b)
+          at[b] = (char) ((uint64_t) value >> (b * 8));
+      }
+    }
+  }
+
+  return status;
+}
+
+static void sb_append_bytes(string_builder_t* sb, const void* data, size_t size)
+{
+  da_reserve(sb, sb->count + size);
+  memcpy(sb->items + sb->count, data, size);
+  sb->count += size;
+}
+
+static void sb_pad_to(string_builder_t* sb, size_t offset)
+{
+  while (sb->count < offset) da_append(sb, '\0');
+}
+
+static Elf64_Word add_string(string_builder_t* strtab, const char* s)
+{
+  Elf64_Word offset = (Elf64_Word) strtab->count;
+  sb_append_bytes(strtab, s, strlen(s) + 1);
+  return offset;
+}
+
+static bool linker_write(
+    linker_t* l, uint64_t entry, size_t phnum, const char* output_path)
+{
+  out_bucket_t* text = &l->out[OUT_TEXT];
+  out_bucket_t* data = &l->out[OUT_DATA];
+  out_bucket_t* bss  = &l->out[OUT_BSS];
+
+  string_builder_t image = {0};
+  Elf64_Ehdr eh = {0};
+  sb_append_bytes(&image, &eh, sizeof(eh)); // patched at the end
+
+  Elf64_Phdr ph[2] = {0};
+  ph[0].p_type = PT_LOAD;
+  ph[0].p_flags = PF_R | PF_X;
+  ph[0].p_offset = 0;
+  ph[0].p_vaddr = ph[0].p_paddr = LINKER_BASE_ADDRESS;
+  ph[0].p_filesz = ph[0].p_memsz = text->offset + text->size;
+  ph[0].p_align = LINKER_PAGE_SIZE;
+
+  ph[1].p_type = PT_LOAD;
+  ph[1].p_flags = PF_R | PF_W;
+  ph[1].p_offset = data->offset;
+  ph[1].p_vaddr = ph[1].p_paddr = data->addr;
+  ph[1].p_filesz = data->size;
+  ph[1].p_memsz = bss->size ? bss->addr + bss->size - data->addr : data->size;
+  ph[1].p_align = LINKER_PAGE_SIZE;
+  sb_append_bytes(&image, ph, phnum * sizeof(Elf64_Phdr));
+
+  sb_pad_to(&image, text->offset);
+  if (text->size) sb_append_bytes(&image, text->bytes.items, text->size);
+  if (data->size) {
+    sb_pad_to(&image, data->offset);
+    sb_append_bytes(&image, data->bytes.items, data->size);
+  }
+
+  // section headers and a symbol table of the globals, only there so
+  // that objdump / gdb make sense of the output
+  string_builder_t shstrtab = {0};
+  string_builder_t strtab = {0};
+  da_append(&shstrtab, '\0');
+  da_append(&strtab, '\0');
+
+  Elf64_Shdr sh[OUT_COUNT + 4] = {0};
+  Elf64_Half out_index[OUT_COUNT] = {0};
+  size_t shnum = 1;
+
+  for (out_section_t k = OUT_TEXT; k < OUT_COUNT; ++k) {
+    out_bucket_t* b = &l->out[k];
+    if (b->size == 0) continue;
+    out_index[k] = (Elf64_Half) shnum;
+    Elf64_Shdr* s = &sh[shnum++];
+    s->sh_name = add_string(&shstrtab, out_names[k]);
+    s->sh_type = k == OUT_BSS ? SHT_NOBITS : SHT_PROGBITS;
+    s->sh_flags = SHF_ALLOC | (k == OUT_TEXT ? SHF_EXECINSTR : SHF_WRITE);
+    s->sh_addr = b->addr;
+    s->sh_offset = b->offset;
+    s->sh_size = b->size;
+    s->sh_addralign = b->align ? b->align : 1;
+  }
+
+  string_builder_t syms = {0};
+  Elf64_Sym null_sym = {0};
+  sb_append_bytes(&syms, &null_sym, sizeof(null_sym));
+  da_foreach(link_symbol_t, it, &l->symbols) {
+    Elf64_Sym sym = {0};
+    sym.st_name = add_string(&strtab, it->name);
+    sym.st_info = ELF64_ST_INFO(it->weak ? STB_WEAK : STB_GLOBAL, STT_NOTYPE);
+    sym.st_shndx = it->section == OUT_NONE ? SHN_ABS : out_index[it->section];
+    sym.st_value = it->addr;
+    sb_append_bytes(&syms, &sym, sizeof(sym));
+  }
+
+  size_t symtab_index = shnum;
+  sb_pad_to(&image, align_up(image.count, 8));
+  sh[shnum].sh_name = add_string(&shstrtab, ".symtab");
+  sh[shnum].sh_type = SHT_SYMTAB;
+  sh[shnum].sh_offset = image.count;
+  sh[shnum].sh_size = syms.count;
+  sh[shnum].sh_link = (Elf64_Word) (symtab_index + 1);
+  sh[shnum].sh_info = 1; // every symbol but the null one is global
+  sh[shnum].sh_addralign = 8;
+  sh[shnum].sh_entsize = sizeof(Elf64_Sym);
+  sb_append_bytes(&image, syms.items, syms.count);
+  shnum++;
+
+  sh[shnum].sh_name = add_string(&shstrtab, ".strtab");
+  sh[shnum].sh_type = SHT_STRTAB;
+  sh[shnum].sh_offset = image.count;
+  sh[shnum].sh_size = strtab.count;
+  sh[shnum].sh_addralign = 1;
+  sb_append_bytes(&image, strtab.items, strtab.count);
+  shnum++;
+
+  size_t shstrtab_index = shnum;
+  sh[shnum].sh_name = add_string(&shstrtab, ".shstrtab");
+  sh[shnum].sh_type = SHT_STRTAB;
+  sh[shnum].sh_offset = image.count;
+  sh[shnum].sh_size = shstrtab.count;
+  sh[shnum].sh_addralign = 1;
+  sb_append_bytes(&image, shstrtab.items, shstrtab.count);
+  shnum++;
+
+  sb_pad_to(&image, align_up(image.count, 8));
+  size_t shoff = image.count;
+  sb_append_bytes(&image, sh, shnum * sizeof(Elf64_Shdr));
+
+  memcpy(eh.e_ident, ELFMAG, SELFMAG);
+  eh.e_ident[EI_CLASS] = ELFCLASS64;
+  eh.e_ident[EI_DATA] = ELFDATA2LSB;
+  eh.e_ident[EI_VERSION] = EV_CURRENT;
+  eh.e_ident[EI_OSABI] = ELFOSABI_SYSV;
+  eh.e_type = ET_EXEC;
+  eh.e_machine = EM_X86_64;
+  eh.e_version = EV_CURRENT;
+  eh.e_entry = entry;
+  eh.e_phoff = sizeof(Elf64_Ehdr);
+  eh.e_shoff = shoff;
+  eh.e_ehsize = sizeof(Elf64_Ehdr);
+  eh.e_phentsize = sizeof(Elf64_Phdr);
+  eh.e_phnum = (Elf64_Half) phnum;
+  eh.e_shentsize = sizeof(Elf64_Shdr);
+  eh.e_shnum = (Elf64_Half) shnum;
+  eh.e_shstrndx = (Elf64_Half) shstrtab_index;
+  memcpy(image.items, &eh, sizeof(eh));
+
+  da_free(&syms);
+  da_free(&strtab);
+  da_free(&shstrtab);
+
+  // written aside then renamed, the previous executable may be running
+  char tmp_path[1024];
+  snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", output_path);
+
+  bool ok = false;
+  FILE* f = fopen(tmp_path, "wb");
+  if (f) {
+    ok = fwrite(image.items, 1, image.count, f) == image.count;
+    ok = fchmod(fileno(f), 0755) == 0 && ok;
+    ok = fclose(f) == 0 && ok;
+    ok = ok && rename(tmp_path, output_path) == 0;
+    if (!ok) remove(tmp_path);
+  }
+  if (!ok)
+    error_report_general(
+        ERROR_SEVERITY_ERROR, "cannot write executable '%s'", output_path);
+
+  da_free(&image);
+  return ok;
+}
+
+static void linker_free(linker_t* l)
+{
+  for (size_t i = 0; i < l->object_count; ++i) {
+    free(l->objects[i].owned);
+    free(l->objects[i].placement);
+    free(l->objects[i].offset);
+  }
+  free(l->objects);
+
+  for (out_section_t k = OUT_TEXT; k < OUT_COUNT; ++k)
+    da_free(&l->out[k].bytes);
+
+  da_foreach(link_symbol_t, it, &l->symbols) free(it->name);
+  da_free(&l->symbols);
+  hashmap_free(&l->symbol_index, 0);
+}
+
+link_status_t link_executable(
+    const link_input_array* inputs,
+    const char* entry,
+    const char* output_path)
+{
+  linker_t l = {0};
+  link_status_t status = LINK_OK;
+
+  l.objects = calloc(inputs->count ? inputs->count : 1, sizeof(link_object_t));
+  if (!l.objects) {
+    error_report_general(ERROR_SEVERITY_ERROR, "out of memory");
+    return LINK_ERROR;
+  }
+  l.object_count = inputs->count;
+
+  for (size_t i = 0; i < inputs->count && status == LINK_OK; ++i) {
+    link_object_t* o = &l.objects[i];
+    o->path = inputs->items[i].path;
+    o->data = inputs->items[i].image;
+    o->size = inputs->items[i].size;
+
+    if (!o->data) {
+      if (!read_whole_file(o->path, &o->owned, &o->size)) {
+        error_report_general(
+            ERROR_SEVERITY_ERROR, "cannot read object file '%s'", o->path);
+        status = LINK_ERROR;
+        break;
+      }
+      o->data = o->owned;
+    }
+
+    status = linker_open(o);
+  }
+
+  size_t phnum = 1;
+  if (status == LINK_OK) {
+    linker_place_sections(&l);
+    if (l.out[OUT_DATA].size || l.out[OUT_BSS].size) phnum = 2;
+    linker_layout(&l, sizeof(Elf64_Ehdr) + phnum * sizeof(Elf64_Phdr));
+    status = linker_collect_symbols(&l);
+  }
+
+  if (status == LINK_OK)
+    status = linker_relocate(&l);
+
+  link_symbol_t* start = NULL;
+  if (status == LINK_OK) {
+    start = linker_find(&l, entry);
+    if (!start) {
+      error_report_general(ERROR_SEVERITY_ERROR,
+          "undefined entry symbol `%s'", entry);
+      status = LINK_ERROR;
+    }
+  }
+
+  if (status == LINK_OK &&
+      !linker_write(&l, start->addr, phnum, output_path))
+    status = LINK_ERROR;
+
+  linker_free(&l);
+  return status;
+}
@@ -0,0 +1,37 @@
+#ifndef LINKER_H
+#define LINKER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// Load address of the executable, same default as GNU ld
+#define LINKER_BASE_ADDRESS 0x400000
+
+typedef struct {
+  const char* path;  // used in diagnostics, read from disk if `image` is NULL
+  const char* image; // ELF64 relocatable already in memory, not owned
+  size_t      size;
+} link_input_t;
+
+typedef struct {
+  link_input_t* items;
+  size_t count;
+  size_t capacity;
+} link_input_array;
+
+typedef enum {
+  LINK_OK,
+  LINK_ERROR,       // diagnostics were reported (undefined symbol, ...)
+  LINK_UNSUPPORTED, // an input needs a feature we do not handle, use ld
+} link_status_t;
+
+// Static linker for the libc-free executables cleaf produces: merges the
+// allocated sections of every input, resolves global symbols, applies
+// x86-64 relocations and writes an ELF64 executable starting at `entry`.
+// Nothing is written and no diagnostic is reported on LINK_UNSUPPORTED.
+link_status_t link_executable(
+    const link_input_array* inputs,
+    const char* entry,
+    const char* output_path);
+
+#endif // LINKER_H
@@ -0,0 +1,164 @@
+#include "object.h"
+#include "../thirdparty/error.h"
+
+void object_emit_byte(object_file_t* obj, uint8_t byte)
+{
+  da_append(&obj->text, (char) byte);
+}
+
+void object_emit_u32(object_file_t* obj, uint32_t value)
+{
+  for (int i = 0; i < 4; ++i)
+    object_emit_byte(obj, (uint8_t) (value >> (i * 8)));
+}
+
+void object_emit_u64(object_file_t* obj, uint64_t value)
+{
+  for (int i = 0; i < 8; ++i)
+    object_emit_byte(obj, (uint8_t) (value >> (i * 8)));
+}
+
+// NASM rules: `.x` belongs to the last label that does not start with `.`
+static char* object_scoped_name(const object_file_t* obj, const char* name)
+{
+  if (name[0] != '.' || !obj->scope)
+    return strdup(name);
+
+  size_t scope_len = strlen(obj->scope);
+  size_t name_len = strlen(name);
+  char* out = malloc(scope_len + name_len + 1);
+  if (!out) return NULL;
+  memcpy(out, obj->scope, scope_len);
+  memcpy(out + scope_len, name, name_len + 1);
+  return out;
+}
+
+bool object_find_label(
+    const object_file_t* obj, const char* name, size_t* offset)
+{
+  uintptr_t index =
+    (uintptr_t) hashmap_get(&obj->label_index, name);
+  if (index == 0) return false;
+  if (offset) *offset = obj->labels.items[index - 1].offset;
+  return true;
+}
+
+bool object_define_label(object_file_t* obj, const char* name)
+{
+  char* full = object_scoped_name(obj, name);
+  if (!full) {
+    error_report_general(ERROR_SEVERITY_ERROR, "out of memory");
+    obj->failed = true;
+    return false;
+  }
+
+  if (object_find_label(obj, full, NULL)) {
+    error_report_general(ERROR_SEVERITY_ERROR,
+        "label '%s' redefined", full);
+    free(full);
+    obj->failed = true;
+    return false;
+  }
+
+  object_label_t label = { full, obj->text.count };
+  da_append(&obj->labels, label);
+  hashmap_put(&obj->label_index, full, (void*) (uintptr_t) obj->labels.count);
+
+  if (name[0] != '.') {
+    free(obj->scope);
+    obj->scope = strdup(name);
+  }
+  return true;
+}
+
+static bool object_name_listed(const object_name_array* names, const char* name)
+{
+  da_foreach(char*, it, names) {
+    if (strcmp(*it, name) == 0) return true;
+  }
+  return false;
+}
+
+bool object_is_global(const object_file_t* obj, const char* name)
+{
+  return object_name_listed(&obj->globals, name);
+}
+
+void object_add_global(object_file_t* obj, const char* name)
+{
+  if (object_name_listed(&obj->globals, name)) return;
+  da_append(&obj->globals, strdup(name));
+}
+
+void object_add_extern(object_file_t* obj, const char* name)
+{
+  if (object_name_listed(&obj->externs, name)) return;
+  da_append(&obj->externs, strdup(name));
+}
+
+void object_emit_ref(
+    object_file_t* obj, const char* name, object_ref_kind_t kind)
+{
+  object_ref_t ref = {0};
+  ref.name = object_scoped_name(obj, name);
+  ref.offset = obj->text.count;
+  ref.kind = kind;
+  if (!ref.name) {
+    error_report_general(ERROR_SEVERITY_ERROR, "out of memory");
+    obj->failed = true;
+    return;
+  }
+  da_append(&obj->refs, ref);
+  object_emit_u32(obj, 0);
+}
+
+bool object_finalize(object_file_t* obj)
+{
+  bool ok = !obj->failed;
+
+  da_foreach(object_ref_t, it, &obj->refs) {
+    size_t target = 0;
+    if (object_find_label(obj, it->name, &target)) {
+      int64_t rel = (int64_t) target - (int64_t) (it->offset + 4);
+      uint32_t value = (uint32_t) (int32_t) rel;
+      for (int i = 0; i < 4; ++i)
+        obj->text.items[it->offset + i] = (char) (value >> (i * 8));
+      free(it->name);
+      continue;
+    }
+
+    if (it->name[0] == '.' || strchr(it->name, '.')) {
+      error_report_general(ERROR_SEVERITY_ERROR,
+          "undefined label '%s'", it->name);
+      free(it->name);
+      ok = false;
+      continue;
+    }
+
+    // the relocation takes ownership of the name
+    da_append(&obj->relocs, *it);
+  }
+  obj->refs.count = 0;
+
+  if (!ok) obj->failed = true;
+  return ok;
+}
+
+void object_file_free(object_file_t* obj)
+{
+  da_foreach(object_label_t, it, &obj->labels) free(it->name);
+  da_foreach(char*, it, &obj->globals) free(*it);
+  da_foreach(char*, it, &obj->externs) free(*it);
+  da_foreach(object_ref_t, it, &obj->refs) free(it->name);
+  da_foreach(object_ref_t, it, &obj->relocs) free(it->name);
+
+  da_free(&obj->text);
+  da_free(&obj->labels);
+  da_free(&obj->globals);
+  da_free(&obj->externs);
+  da_free(&obj->refs);
+  da_free(&obj->relocs);
+  hashmap_free(&obj->label_index, 0);
+  free(obj->scope);
+  obj->scope = NULL;
+}
@@ -0,0 +1,89 @@
+#ifndef OBJECT_H
+#define OBJECT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "../thirdparty/string_builder.h"
+#include "../thirdparty/hashmap.h"
+
+typedef enum {
+  OBJECT_REF_JUMP, // rel32 of a jmp / jcc
+  OBJECT_REF_CALL, // rel32 of a call
+} object_ref_kind_t;
+
+typedef struct {
+  char*  name;   // fully scoped, `.x` labels are stored as `<scope>.x`
+  size_t offset; // in .text
+} object_label_t;
+
+typedef struct {
+  object_label_t* items;
+  size_t count;
+  size_t capacity;
+} object_label_array;
+
+// rel32 field waiting for its target label to be known
+typedef struct {
+  char*             name;
+  size_t            offset; // of the rel32 field in .text
+  object_ref_kind_t kind;
+} object_ref_t;
+
+typedef struct {
+  object_ref_t* items;
+  size_t count;
+  size_t capacity;
+} object_ref_array;
+
+typedef struct {
+  char** items;
+  size_t count;
+  size_t capacity;
+} object_name_array;
+
+// Relocatable object built in memory by the object target.
+// `text` MUST stay the first member: target callbacks only receive a
+// string_builder_t* and cast it back to the object that owns it.
+typedef struct {
+  string_builder_t   text;
+  object_label_array labels;
+  hashmap_t          label_index; // name -> index + 1 in `labels`
+  object_name_array  globals;
+  object_name_array  externs;
+  object_ref_array   refs;        // unresolved until object_finalize
+  object_ref_array   relocs;      // refs to symbols defined elsewhere
+  char*              scope;       // last non local label, owned
+  bool               failed;      // an instruction could not be encoded
+} object_file_t;
+
+#define OBJECT_FROM_SB(sb) ((object_file_t*) (sb))
+
+void object_emit_byte(object_file_t* obj, uint8_t byte);
+void object_emit_u32(object_file_t* obj, uint32_t value);
+void object_emit_u64(object_file_t* obj, uint64_t value);
+
+// Defines `name` at the current end of .text, names starting with `.`
+// are local to the last label that does not
+bool object_define_label(object_file_t* obj, const char* name);
+
+void object_add_global(object_file_t* obj, const char* name);
+void object_add_extern(object_file_t* obj, const char* name);
+
+// Emits a rel32 placeholder pointing at `name`
+void object_emit_ref(
+    object_file_t* obj, const char* name, object_ref_kind_t kind);
+
+// Looks a label up, `*offset` is only written when it is defined
+bool object_find_label(
+    const object_file_t* obj, const char* name, size_t* offset);
+
+bool object_is_global(const object_file_t* obj, const char* name);
+
+// Patches every ref to a label of this object and turns the others into
+// relocations. Fails if a local label was never defined.
+bool object_finalize(object_file_t* obj);
+
+void object_file_free(object_file_t* obj);
+
+#endif // OBJECT_H
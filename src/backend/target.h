@@ -167,6 +167,11 @@ typedef struct {
     void
       (*emit_extern)
       (string_builder_t*, const char* name);
+
+    // one line of user written assembly (inline `asm`), NASM syntax
+    void
+      (*emit_raw)
+      (string_builder_t*, const char* line);
 } target_t;
 
 #endif // TARGET_H
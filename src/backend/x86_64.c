@@ -1,4 +1,5 @@
 #include "x86_64_definition.h"
+#include "x86_64_encoder.h"
 
 typedef enum {
   X86_RAX = 0,
@@ -59,11 +60,76 @@ static const char* x86_reserved_regs[] = {
   [X86_R10] = "r10",
 };
 
+// Text is appended piece by piece: a literal, a register name or an
+// integer costs a copy, not a pass of vsnprintf over the format
+
+// "    <ins> <a>\n", `ins` given with its indent and trailing space
+static void x86_ins1(string_builder_t* sb, const char* ins, const char* a)
+{
+  sb_append_str(sb, ins);
+  sb_append_str(sb, a);
+  sb_append_char(sb, '\n');
+}
+
+static void x86_ins2(
+    string_builder_t* sb,
+    const char* ins,
+    const char* a,
+    const char* b)
+{
+  sb_append_str(sb, ins);
+  sb_append_str(sb, a);
+  sb_append_str(sb, ", ");
+  sb_append_str(sb, b);
+  sb_append_char(sb, '\n');
+}
+
+static void x86_ins2_imm(
+    string_builder_t* sb,
+    const char* ins,
+    const char* a,
+    long long value)
+{
+  sb_append_str(sb, ins);
+  sb_append_str(sb, a);
+  sb_append_str(sb, ", ");
+  sb_append_int(sb, value);
+  sb_append_char(sb, '\n');
+}
+
+// "[base + index]"
+static void x86_mem(string_builder_t* sb, const char* base, const char* index)
+{
+  sb_append_char(sb, '[');
+  sb_append_str(sb, base);
+  sb_append_str(sb, " + ");
+  sb_append_str(sb, index);
+  sb_append_char(sb, ']');
+}
+
+// "[base + offset]"
+static void x86_mem_offset(string_builder_t* sb, const char* base, size_t offset)
+{
+  sb_append_char(sb, '[');
+  sb_append_str(sb, base);
+  sb_append_str(sb, " + ");
+  sb_append_uint(sb, offset);
+  sb_append_char(sb, ']');
+}
+
+// "[rbp - place]"
+static void x86_mem_stack(string_builder_t* sb, int place)
+{
+  sb_append_str(sb, "[rbp - ");
+  sb_append_int(sb, place);
+  sb_append_char(sb, ']');
+}
+
 static void x86_emit_mov(
     string_builder_t* sb, 
     const char* dst, 
     const char* src) {
-  sb_append_fmt(sb, "    mov %s, %s\n", dst, src);
+  x86_ins2(sb, "    mov ", dst, src);
 }
 
 static void x86_emit_mov_direct(
@@ -71,11 +137,11 @@ static void x86_emit_mov_direct(
     const char* dst,
     int value)
 {
-  sb_append_fmt(sb, "    mov %s, %d\n", dst, value);
+  x86_ins2_imm(sb, "    mov ", dst, value);
 }
 
 static void x86_emit_ret(string_builder_t* sb) {
-  sb_append_fmt(sb, "    ret\n");
+  sb_append_str(sb, "    ret\n");
 }
 
 static void x86_emit_sub(
@@ -83,7 +149,7 @@ static void x86_emit_sub(
     const char* dst,
     const char* src)
 {
-  sb_append_fmt(sb, "    sub %s, %s\n", dst, src);
+  x86_ins2(sb, "    sub ", dst, src);
 }
 
 static void x86_emit_mul(
@@ -91,7 +157,7 @@ static void x86_emit_mul(
     const char* dst,
     const char* src)
 {
-  sb_append_fmt(sb, "    imul %s, %s\n", dst, src);
+  x86_ins2(sb, "    imul ", dst, src);
 }
 
 static void x86_emit_mul_direct(
@@ -99,48 +165,51 @@ static void x86_emit_mul_direct(
     const char* dst,
     int value)
 {
-  sb_append_fmt(sb, "    imul %s, %d\n", dst, value);
+  x86_ins2_imm(sb, "    imul ", dst, value);
 }
 
 static void x86_emit_sub_direct(
     string_builder_t* sb, 
     const char* dst, 
     int value) {
-  sb_append_fmt(sb, "    sub %s, %d\n", dst, value);
+  x86_ins2_imm(sb, "    sub ", dst, value);
 }
 
 static void x86_emit_push(
     string_builder_t* sb,
     const char* dst)
 {
-  sb_append_fmt(sb, "    push %s\n", dst);
+  x86_ins1(sb, "    push ", dst);
 }
 
 static void x86_emit_pop(
     string_builder_t* sb,
     const char* dst)
 {
-  sb_append_fmt(sb, "    pop %s\n", dst);
+  x86_ins1(sb, "    pop ", dst);
 }
 
 static void x86_setup(
     string_builder_t* sb)
 {
-  sb_append_fmt(sb, "section .text\n");
+  sb_append_str(sb, "section .text\n");
 }
 
 static void x86_func_write(
     string_builder_t* sb,
     const char* name)
 {
-  sb_append_fmt(sb, "_%s:\n", name);
+  sb_append_char(sb, '_');
+  sb_append_str(sb, name);
+  sb_append_str(sb, ":\n");
 }
 
 static void x86_chunk_write(
     string_builder_t* sb,
     const char* name) 
 {
-  sb_append_fmt(sb, "%s:\n", name);
+  sb_append_str(sb, name);
+  sb_append_str(sb, ":\n");
 }
 
 static void x86_emit_mov_at_stack(
@@ -148,7 +217,11 @@ static void x86_emit_mov_at_stack(
     int place,
     const char* src) 
 {
-  sb_append_fmt(sb, "    mov [rbp - %d], %s\n", place, src);
+  sb_append_str(sb, "    mov ");
+  x86_mem_stack(sb, place);
+  sb_append_str(sb, ", ");
+  sb_append_str(sb, src);
+  sb_append_char(sb, '\n');
 }
 
 static void x86_emit_mov_from_stack(
@@ -156,7 +229,11 @@ static void x86_emit_mov_from_stack(
     const char* dst,
     int place)
 {
-  sb_append_fmt(sb, "    mov %s, [rbp - %d]\n", dst, place);
+  sb_append_str(sb, "    mov ");
+  sb_append_str(sb, dst);
+  sb_append_str(sb, ", ");
+  x86_mem_stack(sb, place);
+  sb_append_char(sb, '\n');
 }
 
 static void x86_emit_add(
@@ -164,61 +241,61 @@ static void x86_emit_add(
     const char* dst,
     const char* src)
 {
-  sb_append_fmt(sb, "    add %s, %s\n", dst, src);
+  x86_ins2(sb, "    add ", dst, src);
 }
 
 static void x86_emit_jmp(
     string_builder_t* sb,
     const char* chunk)
 {
-  sb_append_fmt(sb, "    jmp %s\n", chunk);
+  x86_ins1(sb, "    jmp ", chunk);
 }
 
 static void x86_emit_je(
     string_builder_t* sb,
     const char* chunk)
 {
-  sb_append_fmt(sb, "    je %s\n", chunk);
+  x86_ins1(sb, "    je ", chunk);
 }
 
 static void x86_emit_jne(
     string_builder_t* sb,
     const char* chunk)
 {
-  sb_append_fmt(sb, "    jne %s\n", chunk);
+  x86_ins1(sb, "    jne ", chunk);
 }
 
 static void x86_emit_jl(
     string_builder_t* sb,
     const char* chunk)
 {
-  sb_append_fmt(sb, "    jl %s\n", chunk);
+  x86_ins1(sb, "    jl ", chunk);
 }
 
 static void x86_emit_jle(
     string_builder_t* sb,
     const char* chunk)
 {
-  sb_append_fmt(sb, "    jle %s\n", chunk);
+  x86_ins1(sb, "    jle ", chunk);
 }
 
 static void x86_emit_jg(
     string_builder_t* sb,
     const char* chunk)
 {
-  sb_append_fmt(sb, "    jg %s\n", chunk);
+  x86_ins1(sb, "    jg ", chunk);
 }
 
 static void x86_emit_jge(
     string_builder_t* sb,
     const char* chunk)
 {
-  sb_append_fmt(sb, "    jge %s\n", chunk);
+  x86_ins1(sb, "    jge ", chunk);
 }
 
 static void x86_emit_syscall(string_builder_t* sb)
 {
-  sb_append_fmt(sb, "    syscall\n");
+  sb_append_str(sb, "    syscall\n");
 }
 
 static void x86_emit_cmp(
@@ -226,45 +303,45 @@ static void x86_emit_cmp(
     const char* a,
     const char* b)
 {
-  sb_append_fmt(sb, "    cmp %s, %s\n", a, b);
+  x86_ins2(sb, "    cmp ", a, b);
 }
 
 static void x86_emit_call(
     string_builder_t* sb,
     const char* name)
 {
-  sb_append_fmt(sb, "    call _%s\n", name);
+  x86_ins1(sb, "    call _", name);
 }
 
 static void x86_emit_inc(string_builder_t* sb, const char* reg)
 {
-  sb_append_fmt(sb, "    inc %s\n", reg);
+  x86_ins1(sb, "    inc ", reg);
 }
 
 static void x86_emit_dec(string_builder_t* sb, const char* reg)
 {
-  sb_append_fmt(sb, "    dec %s\n", reg);
+  x86_ins1(sb, "    dec ", reg);
 }
 
 static void x86_emit_stack_setup(string_builder_t* sb, int size)
 {
-  sb_append_fmt(sb, "    push rbp\n");
-  sb_append_fmt(sb, "    mov rbp, rsp\n");
-  sb_append_fmt(sb, "    sub rsp, %d\n", size);
+  sb_append_str(sb, "    push rbp\n");
+  sb_append_str(sb, "    mov rbp, rsp\n");
+  x86_ins2_imm(sb, "    sub ", "rsp", size);
 }
 
 static void x86_emit_stack_restore(string_builder_t* sb, int size)
 {
-  sb_append_fmt(sb, "    add rsp, %d\n", size);
-  sb_append_fmt(sb, "    pop rbp\n");
+  x86_ins2_imm(sb, "    add ", "rsp", size);
+  sb_append_str(sb, "    pop rbp\n");
 }
 
 static void x86_emit_process_exit(
     string_builder_t* sb, const char* exit_code_reg)
 {
-  sb_append_fmt(sb, "    mov rax, 60\n");
-  sb_append_fmt(sb, "    mov rdi, %s\n", exit_code_reg);
-  sb_append_fmt(sb, "    syscall\n");
+  sb_append_str(sb, "    mov rax, 60\n");
+  x86_ins2(sb, "    mov ", "rdi", exit_code_reg);
+  sb_append_str(sb, "    syscall\n");
 }
 
 static void x86_emit_load_elem(
@@ -273,7 +350,11 @@ static void x86_emit_load_elem(
     const char* base,
     const char* index)
 {
-  sb_append_fmt(sb, "    mov %s, [%s + %s]\n", dst, base, index);
+  sb_append_str(sb, "    mov ");
+  sb_append_str(sb, dst);
+  sb_append_str(sb, ", ");
+  x86_mem(sb, base, index);
+  sb_append_char(sb, '\n');
 }
 
 static void x86_emit_store_elem(
@@ -282,50 +363,73 @@ static void x86_emit_store_elem(
     const char* index,
     const char* src)
 {
-  sb_append_fmt(sb, "    mov [%s + %s], %s\n", base, index, src);
+  sb_append_str(sb, "    mov ");
+  x86_mem(sb, base, index);
+  sb_append_str(sb, ", ");
+  sb_append_str(sb, src);
+  sb_append_char(sb, '\n');
 }
 
 static void x86_alloc_memory(string_builder_t* sb, int size) 
 {
-  sb_append_fmt(sb, "    mov rax, 9\n");
-  sb_append_fmt(sb, "    mov rdi, 0\n");
-  sb_append_fmt(sb, "    mov rsi, %d\n", size);
-  sb_append_fmt(sb, "    mov rdx, 0x01 | 0x02\n");
-  sb_append_fmt(sb, "    mov r10, 0x22\n");
-  sb_append_fmt(sb, "    mov r8, -1\n");
-  sb_append_fmt(sb, "    mov r9, 0\n");
-  sb_append_fmt(sb, "    syscall\n");
+  sb_append_str(sb, "    mov rax, 9\n");
+  sb_append_str(sb, "    mov rdi, 0\n");
+  x86_ins2_imm(sb, "    mov ", "rsi", size);
+  sb_append_str(sb, "    mov rdx, 0x01 | 0x02\n");
+  sb_append_str(sb, "    mov r10, 0x22\n");
+  sb_append_str(sb, "    mov r8, -1\n");
+  sb_append_str(sb, "    mov r9, 0\n");
+  sb_append_str(sb, "    syscall\n");
 }
 
 static void x86_dealloc_memory(
     string_builder_t* sb, const char* src, size_t size)
 {
-  sb_append_fmt(sb, "    mov rax, 11\n");
-  sb_append_fmt(sb, "    mov rdi, %s\n", src);
-  sb_append_fmt(sb, "    mov rsi, %zu\n", size);
-  sb_append_fmt(sb, "    syscall\n");
+  sb_append_str(sb, "    mov rax, 11\n");
+  x86_ins2(sb, "    mov ", "rdi", src);
+  sb_append_str(sb, "    mov rsi, ");
+  sb_append_uint(sb, size);
+  sb_append_char(sb, '\n');
+  sb_append_str(sb, "    syscall\n");
 }
 
 static void x86_emit_mov_offset_pre(string_builder_t* sb,
     const char* dst, size_t size, const char* src)
 {
-  sb_append_fmt(sb, "    mov [%s + %zu], %s\n", dst, size, src);
+  sb_append_str(sb, "    mov ");
+  x86_mem_offset(sb, dst, size);
+  sb_append_str(sb, ", ");
+  sb_append_str(sb, src);
+  sb_append_char(sb, '\n');
 }
 
 static void x86_emit_mov_offset_post(string_builder_t* sb,
     const char* dst, size_t size, const char* src)
 {
-  sb_append_fmt(sb, "    mov %s, [%s + %zu]\n", dst, src, size);
+  sb_append_str(sb, "    mov ");
+  sb_append_str(sb, dst);
+  sb_append_str(sb, ", ");
+  x86_mem_offset(sb, src, size);
+  sb_append_char(sb, '\n');
 }
 
 static void x86_emit_global(string_builder_t* sb, const char* name)
 {
-  sb_append_fmt(sb, "global _%s\n", name);
+  sb_append_str(sb, "global _");
+  sb_append_str(sb, name);
+  sb_append_char(sb, '\n');
 }
 
 static void x86_emit_extern(string_builder_t* sb, const char* name)
 {
-  sb_append_fmt(sb, "extern _%s\n", name);
+  sb_append_str(sb, "extern _");
+  sb_append_str(sb, name);
+  sb_append_char(sb, '\n');
+}
+
+static void x86_emit_raw(string_builder_t* sb, const char* line)
+{
+  x86_ins1(sb, "    ", line);
 }
 
 const target_t x86_64_target = {
@@ -373,4 +477,349 @@ const target_t x86_64_target = {
   .emit_store_elem = x86_emit_store_elem,
   .emit_global = x86_emit_global,
   .emit_extern = x86_emit_extern,
+  .emit_raw = x86_emit_raw,
+};
+
+// ----------------- Object target ------------------
+// Same instructions as above, encoded straight into an object_file_t
+
+static void x86_obj_encode0(string_builder_t* sb, x86_mnemonic_t m)
+{
+  x86_encode(OBJECT_FROM_SB(sb), m, NULL, 0);
+}
+
+static void x86_obj_encode1(
+    string_builder_t* sb, x86_mnemonic_t m, x86_operand_t a)
+{
+  x86_encode(OBJECT_FROM_SB(sb), m, &a, 1);
+}
+
+static void x86_obj_encode2(
+    string_builder_t* sb, x86_mnemonic_t m, x86_operand_t a, x86_operand_t b)
+{
+  x86_operand_t ops[2] = { a, b };
+  x86_encode(OBJECT_FROM_SB(sb), m, ops, 2);
+}
+
+// functions are emitted as `_name` by the text target, keep the same
+// symbols so that NASM and built-in objects can be linked together
+static char* x86_obj_symbol(const char* name)
+{
+  size_t len = strlen(name);
+  char* out = malloc(len + 2);
+  if (!out) return NULL;
+  out[0] = '_';
+  memcpy(out + 1, name, len + 1);
+  return out;
+}
+
+static void x86_obj_setup(string_builder_t* sb)
+{
+  (void) sb; // a single .text section, nothing to declare
+}
+
+static void x86_obj_emit_mov(
+    string_builder_t* sb, const char* dst, const char* src)
+{
+  x86_obj_encode2(sb, X86_MOV, x86_op_reg(dst), x86_op_reg(src));
+}
+
+static void x86_obj_emit_mov_direct(
+    string_builder_t* sb, const char* dst, int value)
+{
+  x86_obj_encode2(sb, X86_MOV, x86_op_reg(dst), x86_op_imm(value));
+}
+
+static void x86_obj_emit_ret(string_builder_t* sb)
+{
+  x86_obj_encode0(sb, X86_RET);
+}
+
+static void x86_obj_emit_sub(
+    string_builder_t* sb, const char* dst, const char* src)
+{
+  x86_obj_encode2(sb, X86_SUB, x86_op_reg(dst), x86_op_reg(src));
+}
+
+static void x86_obj_emit_mul(
+    string_builder_t* sb, const char* dst, const char* src)
+{
+  x86_obj_encode2(sb, X86_IMUL, x86_op_reg(dst), x86_op_reg(src));
+}
+
+static void x86_obj_emit_mul_direct(
+    string_builder_t* sb, const char* dst, int value)
+{
+  x86_obj_encode2(sb, X86_IMUL, x86_op_reg(dst), x86_op_imm(value));
+}
+
+static void x86_obj_emit_sub_direct(
+    string_builder_t* sb, const char* dst, int value)
+{
+  x86_obj_encode2(sb, X86_SUB, x86_op_reg(dst), x86_op_imm(value));
+}
+
+static void x86_obj_emit_push(string_builder_t* sb, const char* dst)
+{
+  x86_obj_encode1(sb, X86_PUSH, x86_op_reg(dst));
+}
+
+static void x86_obj_emit_pop(string_builder_t* sb, const char* dst)
+{
+  x86_obj_encode1(sb, X86_POP, x86_op_reg(dst));
+}
+
+static void x86_obj_func_write(string_builder_t* sb, const char* name)
+{
+  object_file_t* obj = OBJECT_FROM_SB(sb);
+  char* symbol = x86_obj_symbol(name);
+  if (!symbol) {
+    obj->failed = true;
+    return;
+  }
+  object_define_label(obj, symbol);
+  free(symbol);
+}
+
+static void x86_obj_chunk_write(string_builder_t* sb, const char* name)
+{
+  object_define_label(OBJECT_FROM_SB(sb), name);
+}
+
+static void x86_obj_emit_mov_at_stack(
+    string_builder_t* sb, int place, const char* src)
+{
+  x86_obj_encode2(sb, X86_MOV,
+      x86_op_mem("rbp", NULL, -place, 0), x86_op_reg(src));
+}
+
+static void x86_obj_emit_mov_from_stack(
+    string_builder_t* sb, const char* dst, int place)
+{
+  x86_obj_encode2(sb, X86_MOV,
+      x86_op_reg(dst), x86_op_mem("rbp", NULL, -place, 0));
+}
+
+static void x86_obj_emit_add(
+    string_builder_t* sb, const char* dst, const char* src)
+{
+  x86_obj_encode2(sb, X86_ADD, x86_op_reg(dst), x86_op_reg(src));
+}
+
+static void x86_obj_emit_jmp(string_builder_t* sb, const char* chunk)
+{
+  x86_obj_encode1(sb, X86_JMP, x86_op_label(chunk));
+}
+
+static void x86_obj_emit_je(string_builder_t* sb, const char* chunk)
+{
+  x86_obj_encode1(sb, X86_JE, x86_op_label(chunk));
+}
+
+static void x86_obj_emit_jne(string_builder_t* sb, const char* chunk)
+{
+  x86_obj_encode1(sb, X86_JNE, x86_op_label(chunk));
+}
+
+static void x86_obj_emit_jl(string_builder_t* sb, const char* chunk)
+{
+  x86_obj_encode1(sb, X86_JL, x86_op_label(chunk));
+}
+
+static void x86_obj_emit_jle(string_builder_t* sb, const char* chunk)
+{
+  x86_obj_encode1(sb, X86_JLE, x86_op_label(chunk));
+}
+
+static void x86_obj_emit_jg(string_builder_t* sb, const char* chunk)
+{
+  x86_obj_encode1(sb, X86_JG, x86_op_label(chunk));
+}
+
+static void x86_obj_emit_jge(string_builder_t* sb, const char* chunk)
+{
+  x86_obj_encode1(sb, X86_JGE, x86_op_label(chunk));
+}
+
+static void x86_obj_emit_syscall(string_builder_t* sb)
+{
+  x86_obj_encode0(sb, X86_SYSCALL);
+}
+
+static void x86_obj_emit_cmp(
+    string_builder_t* sb, const char* a, const char* b)
+{
+  x86_obj_encode2(sb, X86_CMP, x86_op_reg(a), x86_op_reg(b));
+}
+
+static void x86_obj_emit_call(string_builder_t* sb, const char* name)
+{
+  char* symbol = x86_obj_symbol(name);
+  if (!symbol) {
+    OBJECT_FROM_SB(sb)->failed = true;
+    return;
+  }
+  x86_obj_encode1(sb, X86_CALL, x86_op_label(symbol));
+  free(symbol);
+}
+
+static void x86_obj_emit_inc(string_builder_t* sb, const char* reg)
+{
+  x86_obj_encode1(sb, X86_INC, x86_op_reg(reg));
+}
+
+static void x86_obj_emit_dec(string_builder_t* sb, const char* reg)
+{
+  x86_obj_encode1(sb, X86_DEC, x86_op_reg(reg));
+}
+
+static void x86_obj_emit_stack_setup(string_builder_t* sb, int size)
+{
+  x86_obj_encode1(sb, X86_PUSH, x86_op_reg("rbp"));
+  x86_obj_encode2(sb, X86_MOV, x86_op_reg("rbp"), x86_op_reg("rsp"));
+  x86_obj_encode2(sb, X86_SUB, x86_op_reg("rsp"), x86_op_imm(size));
+}
+
+static void x86_obj_emit_stack_restore(string_builder_t* sb, int size)
+{
+  x86_obj_encode2(sb, X86_ADD, x86_op_reg("rsp"), x86_op_imm(size));
+  x86_obj_encode1(sb, X86_POP, x86_op_reg("rbp"));
+}
+
+static void x86_obj_emit_process_exit(
+    string_builder_t* sb, const char* exit_code_reg)
+{
+  x86_obj_encode2(sb, X86_MOV, x86_op_reg("rax"), x86_op_imm(60));
+  x86_obj_encode2(sb, X86_MOV, x86_op_reg("rdi"), x86_op_reg(exit_code_reg));
+  x86_obj_encode0(sb, X86_SYSCALL);
+}
+
+static void x86_obj_emit_load_elem(
+    string_builder_t* sb,
+    const char* dst,
+    const char* base,
+    const char* index)
+{
+  x86_obj_encode2(sb, X86_MOV,
+      x86_op_reg(dst), x86_op_mem(base, index, 0, 0));
+}
+
+static void x86_obj_emit_store_elem(
+    string_builder_t* sb,
+    const char* base,
+    const char* index,
+    const char* src)
+{
+  x86_obj_encode2(sb, X86_MOV,
+      x86_op_mem(base, index, 0, 0), x86_op_reg(src));
+}
+
+static void x86_obj_alloc_memory(string_builder_t* sb, int size)
+{
+  x86_obj_encode2(sb, X86_MOV, x86_op_reg("rax"), x86_op_imm(9));
+  x86_obj_encode2(sb, X86_MOV, x86_op_reg("rdi"), x86_op_imm(0));
+  x86_obj_encode2(sb, X86_MOV, x86_op_reg("rsi"), x86_op_imm(size));
+  x86_obj_encode2(sb, X86_MOV, x86_op_reg("rdx"), x86_op_imm(0x01 | 0x02));
+  x86_obj_encode2(sb, X86_MOV, x86_op_reg("r10"), x86_op_imm(0x22));
+  x86_obj_encode2(sb, X86_MOV, x86_op_reg("r8"), x86_op_imm(-1));
+  x86_obj_encode2(sb, X86_MOV, x86_op_reg("r9"), x86_op_imm(0));
+  x86_obj_encode0(sb, X86_SYSCALL);
+}
+
+static void x86_obj_dealloc_memory(
+    string_builder_t* sb, const char* src, size_t size)
+{
+  x86_obj_encode2(sb, X86_MOV, x86_op_reg("rax"), x86_op_imm(11));
+  x86_obj_encode2(sb, X86_MOV, x86_op_reg("rdi"), x86_op_reg(src));
+  x86_obj_encode2(sb, X86_MOV, x86_op_reg("rsi"), x86_op_imm((int64_t) size));
+  x86_obj_encode0(sb, X86_SYSCALL);
+}
+
+static void x86_obj_emit_mov_offset_pre(string_builder_t* sb,
+    const char* dst, size_t size, const char* src)
+{
+  x86_obj_encode2(sb, X86_MOV,
+      x86_op_mem(dst, NULL, (int64_t) size, 0), x86_op_reg(src));
+}
+
+static void x86_obj_emit_mov_offset_post(string_builder_t* sb,
+    const char* dst, size_t size, const char* src)
+{
+  x86_obj_encode2(sb, X86_MOV,
+      x86_op_reg(dst), x86_op_mem(src, NULL, (int64_t) size, 0));
+}
+
+static void x86_obj_emit_global(string_builder_t* sb, const char* name)
+{
+  char* symbol = x86_obj_symbol(name);
+  if (!symbol) {
+    OBJECT_FROM_SB(sb)->failed = true;
+    return;
+  }
+  object_add_global(OBJECT_FROM_SB(sb), symbol);
+  free(symbol);
+}
+
+static void x86_obj_emit_extern(string_builder_t* sb, const char* name)
+{
+  char* symbol = x86_obj_symbol(name);
+  if (!symbol) {
+    OBJECT_FROM_SB(sb)->failed = true;
+    return;
+  }
+  object_add_extern(OBJECT_FROM_SB(sb), symbol);
+  free(symbol);
+}
+
+static void x86_obj_emit_raw(string_builder_t* sb, const char* line)
+{
+  x86_assemble_line(OBJECT_FROM_SB(sb), line);
+}
+
+const target_t x86_64_object_target = {
+  .setup = x86_obj_setup,
+  .regs_8 = x86_regs_8,
+  .reg_8_count = X86_REG_8_COUNT,
+  .regs_4 = x86_regs_4,
+  .reg_4_count = X86_REG_4_COUNT,
+  .reserved_regs = x86_reserved_regs,
+  .reserved_reg_count = X86_RESERVED_COUNT,
+  .emit_mov = x86_obj_emit_mov,
+  .emit_ret = x86_obj_emit_ret,
+  .emit_sub_direct = x86_obj_emit_sub_direct,
+  .emit_push = x86_obj_emit_push,
+  .emit_pop = x86_obj_emit_pop,
+  .func_write = x86_obj_func_write,
+  .chunk_write = x86_obj_chunk_write,
+  .emit_mov_at_stack = x86_obj_emit_mov_at_stack,
+  .emit_add = x86_obj_emit_add,
+  .emit_mov_direct = x86_obj_emit_mov_direct,
+  .emit_syscall = x86_obj_emit_syscall,
+  .emit_cmp = x86_obj_emit_cmp,
+  .emit_jmp = x86_obj_emit_jmp,
+  .emit_jmp_equal = x86_obj_emit_je,
+  .emit_jmp_not_equal = x86_obj_emit_jne,
+  .emit_jmp_greater_than = x86_obj_emit_jg,
+  .emit_jmp_greater_than_equal = x86_obj_emit_jge,
+  .emit_jmp_lower_than = x86_obj_emit_jl,
+  .emit_jmp_lower_than_equal = x86_obj_emit_jle,
+  .emit_call = x86_obj_emit_call,
+  .emit_inc = x86_obj_emit_inc,
+  .emit_dec = x86_obj_emit_dec,
+  .emit_stack_setup = x86_obj_emit_stack_setup,
+  .emit_stack_restore = x86_obj_emit_stack_restore,
+  .emit_process_exit = x86_obj_emit_process_exit,
+  .emit_mov_from_stack = x86_obj_emit_mov_from_stack,
+  .emit_sub = x86_obj_emit_sub,
+  .emit_mul = x86_obj_emit_mul,
+  .emit_mul_direct = x86_obj_emit_mul_direct,
+  .alloc_memory = x86_obj_alloc_memory,
+  .emit_mov_offset_pre = x86_obj_emit_mov_offset_pre,
+  .emit_mov_offset_post = x86_obj_emit_mov_offset_post,
+  .dealloc_memory = x86_obj_dealloc_memory,
+  .emit_load_elem = x86_obj_emit_load_elem,
+  .emit_store_elem = x86_obj_emit_store_elem,
+  .emit_global = x86_obj_emit_global,
+  .emit_extern = x86_obj_emit_extern,
+  .emit_raw = x86_obj_emit_raw,
 };
@@ -3,7 +3,12 @@
 
 #include "target.h"
 #include "../thirdparty/string_builder.h"
+#include "object.h"
 
 extern const target_t x86_64_target;
 
+// Encodes machine code directly, the string_builder_t* given to its
+// callbacks must be the `text` member of an object_file_t
+extern const target_t x86_64_object_target;
+
 #endif // X86_64_DEFINITION_H
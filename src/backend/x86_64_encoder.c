@@ -0,0 +1,931 @@
+#include "x86_64_encoder.h"
+#include "../thirdparty/error.h"
+
+#include <ctype.h>
+#include <strings.h>
+
+static const char* x86_mnemonic_names[] = {
+  [X86_ADD] = "add", [X86_OR] = "or", [X86_AND] = "and",
+  [X86_SUB] = "sub", [X86_XOR] = "xor", [X86_CMP] = "cmp",
+  [X86_MOV] = "mov", [X86_LEA] = "lea", [X86_TEST] = "test",
+  [X86_IMUL] = "imul",
+  [X86_INC] = "inc", [X86_DEC] = "dec", [X86_NEG] = "neg",
+  [X86_NOT] = "not", [X86_MUL] = "mul", [X86_DIV] = "div",
+  [X86_IDIV] = "idiv",
+  [X86_SHL] = "shl", [X86_SHR] = "shr", [X86_SAR] = "sar",
+  [X86_PUSH] = "push", [X86_POP] = "pop",
+  [X86_RET] = "ret", [X86_SYSCALL] = "syscall", [X86_NOP] = "nop",
+  [X86_LEAVE] = "leave", [X86_CQO] = "cqo", [X86_CDQ] = "cdq",
+  [X86_JMP] = "jmp", [X86_CALL] = "call",
+  [X86_JO] = "jo", [X86_JNO] = "jno", [X86_JB] = "jb", [X86_JAE] = "jae",
+  [X86_JE] = "je", [X86_JNE] = "jne", [X86_JBE] = "jbe", [X86_JA] = "ja",
+  [X86_JS] = "js", [X86_JNS] = "jns", [X86_JP] = "jp", [X86_JNP] = "jnp",
+  [X86_JL] = "jl", [X86_JGE] = "jge", [X86_JLE] = "jle", [X86_JG] = "jg",
+};
+
+// NASM accepts several spellings for most condition codes
+static const struct {
+  const char*    name;
+  x86_mnemonic_t mnemonic;
+} x86_mnemonic_aliases[] = {
+  { "jc",  X86_JB  }, { "jnae", X86_JB  },
+  { "jnb", X86_JAE }, { "jnc",  X86_JAE },
+  { "jz",  X86_JE  }, { "jnz",  X86_JNE },
+  { "jna", X86_JBE }, { "jnbe", X86_JA  },
+  { "jpe", X86_JP  }, { "jpo",  X86_JNP },
+  { "jnge", X86_JL }, { "jnl",  X86_JGE },
+  { "jng", X86_JLE }, { "jnle", X86_JG  },
+  { "sal", X86_SHL },
+};
+
+static const char* x86_regs_64[] = {
+  "rax", "rcx", "rdx", "rbx", "rsp", "rbp", "rsi", "rdi",
+  "r8", "r9", "r10", "r11", "r12", "r13", "r14", "r15",
+};
+
+static const char* x86_regs_32[] = {
+  "eax", "ecx", "edx", "ebx", "esp", "ebp", "esi", "edi",
+  "r8d", "r9d", "r10d", "r11d", "r12d", "r13d", "r14d", "r15d",
+};
+
+#define X86_REG_RSP 4
+#define X86_REG_RBP 5
+
+int x86_register_lookup(const char* name, int* size)
+{
+  for (int i = 0; i < 16; ++i) {
+    if (strcasecmp(name, x86_regs_64[i]) == 0) {
+      if (size) *size = 8;
+      return i;
+    }
+    if (strcasecmp(name, x86_regs_32[i]) == 0) {
+      if (size) *size = 4;
+      return i;
+    }
+  }
+  return -1;
+}
+
+x86_operand_t x86_op_reg(const char* name)
+{
+  x86_operand_t op = {0};
+  op.kind = X86_OPERAND_REG;
+  op.reg = x86_register_lookup(name, &op.size);
+  return op;
+}
+
+x86_operand_t x86_op_imm(int64_t value)
+{
+  x86_operand_t op = {0};
+  op.kind = X86_OPERAND_IMM;
+  op.value = value;
+  return op;
+}
+
+x86_operand_t x86_op_label(const char* name)
+{
+  x86_operand_t op = {0};
+  op.kind = X86_OPERAND_LABEL;
+  op.label = name;
+  return op;
+}
+
+x86_operand_t x86_op_mem(
+    const char* base, const char* index, int64_t disp, int size)
+{
+  x86_operand_t op = {0};
+  op.kind = X86_OPERAND_MEM;
+  op.size = size;
+  op.base = x86_register_lookup(base, &op.addr_size);
+  op.index = -1;
+  op.scale = 1;
+  op.value = disp;
+
+  if (index) {
+    int index_size = 0;
+    op.index = x86_register_lookup(index, &index_size);
+    if (index_size != op.addr_size) op.base = -1; // rejected by x86_encode
+  }
+  return op;
+}
+
+// ----------------- Encoding ------------------
+
+static bool fits_i8(int64_t v)  { return v >= INT8_MIN && v <= INT8_MAX; }
+static bool fits_i32(int64_t v) { return v >= INT32_MIN && v <= INT32_MAX; }
+
+static bool x86_fail(object_file_t* obj, x86_mnemonic_t mnemonic)
+{
+  error_report_general(ERROR_SEVERITY_ERROR,
+      "built-in assembler cannot encode '%s' with these operands "
+      "(use --nasm to assemble with NASM)",
+      x86_mnemonic_names[mnemonic]);
+  obj->failed = true;
+  return false;
+}
+
+static bool x86_operand_valid(const x86_operand_t* op)
+{
+  switch (op->kind) {
+  case X86_OPERAND_REG:
+    return op->reg >= 0;
+  case X86_OPERAND_MEM:
+    if (op->base < 0) return false;
+    if (op->index == X86_REG_RSP && op->base == X86_REG_RSP) return false;
+    if (op->index == X86_REG_RSP && op->scale != 1) return false;
+    return op->addr_size == 8 || op->addr_size == 4;
+  case X86_OPERAND_IMM:
+    return true;
+  case X86_OPERAND_LABEL:
+    return op->label != NULL;
+  }
+  return false;
+}
+
+static bool is_rm(const x86_operand_t* op)
+{
+  return op->kind == X86_OPERAND_REG || op->kind == X86_OPERAND_MEM;
+}
+
+// Emits [0x67] [REX] opcode ModRM [SIB] [disp] for a `reg` field and
+// an r/m operand. `size` selects REX.W.
+static void x86_emit_rm(
+    object_file_t* obj,
+    const uint8_t* opcode,
+    size_t opcode_len,
+    int size,
+    int reg,
+    const x86_operand_t* rm)
+{
+  int base = rm->kind == X86_OPERAND_REG ? rm->reg : rm->base;
+  int index = rm->kind == X86_OPERAND_MEM ? rm->index : -1;
+
+  // rsp cannot be an index, it is free to swap with the base at scale 1
+  if (index == X86_REG_RSP) {
+    index = base;
+    base = X86_REG_RSP;
+  }
+
+  if (rm->kind == X86_OPERAND_MEM && rm->addr_size == 4)
+    object_emit_byte(obj, 0x67);
+
+  uint8_t rex = 0x40;
+  if (size == 8)   rex |= 0x08;
+  if (reg & 8)     rex |= 0x04;
+  if (index >= 0 && (index & 8)) rex |= 0x02;
+  if (base & 8)    rex |= 0x01;
+  if (rex != 0x40) object_emit_byte(obj, rex);
+
+  for (size_t i = 0; i < opcode_len; ++i)
+    object_emit_byte(obj, opcode[i]);
+
+  if (rm->kind == X86_OPERAND_REG) {
+    object_emit_byte(obj, (uint8_t) (0xC0 | ((reg & 7) << 3) | (base & 7)));
+    return;
+  }
+
+  int64_t disp = rm->value;
+  int mod;
+  if (disp == 0 && (base & 7) != X86_REG_RBP) mod = 0;
+  else if (fits_i8(disp))                     mod = 1;
+  else                                        mod = 2;
+
+  bool need_sib = index >= 0 || (base & 7) == X86_REG_RSP;
+  object_emit_byte(obj, (uint8_t) ((mod << 6) | ((reg & 7) << 3) |
+        (need_sib ? 4 : (base & 7))));
+
+  if (need_sib) {
+    int scale_bits = rm->scale == 8 ? 3 : rm->scale == 4 ? 2 :
+                     rm->scale == 2 ? 1 : 0;
+    int index_bits = index >= 0 ? (index & 7) : 4; // 4 = no index
+    object_emit_byte(obj, (uint8_t) ((scale_bits << 6) | (index_bits << 3) |
+          (base & 7)));
+  }
+
+  if (mod == 1)      object_emit_byte(obj, (uint8_t) (int8_t) disp);
+  else if (mod == 2) object_emit_u32(obj, (uint32_t) (int32_t) disp);
+}
+
+static void x86_emit_rm1(
+    object_file_t* obj, uint8_t opcode, int size, int reg,
+    const x86_operand_t* rm)
+{
+  x86_emit_rm(obj, &opcode, 1, size, reg, rm);
+}
+
+// Emits an immediate of `imm_size` bytes (1 or 4), always succeeds so that
+// encoders can tail call it
+static bool x86_emit_imm(object_file_t* obj, int64_t value, int imm_size)
+{
+  if (imm_size == 1) {
+    object_emit_byte(obj, (uint8_t) (int8_t) value);
+    return true;
+  }
+  object_emit_u32(obj, (uint32_t) value);
+  return true;
+}
+
+// Whether an immediate fits an operand of `size` bytes, NASM accepts
+// 0xFFFFFFFF for a dword as well as -1
+static bool x86_imm_fits(int64_t value, int size)
+{
+  if (size == 4) return value >= INT32_MIN && value <= (int64_t) UINT32_MAX;
+  return fits_i32(value);
+}
+
+static int x86_rm_size(const x86_operand_t* a, const x86_operand_t* b)
+{
+  if (a->kind == X86_OPERAND_REG) return a->size;
+  if (b && b->kind == X86_OPERAND_REG) return b->size;
+  return a->size;
+}
+
+static bool x86_encode_alu(
+    object_file_t* obj, x86_mnemonic_t m,
+    const x86_operand_t* d, const x86_operand_t* s)
+{
+  // ALU opcodes are laid out as add, or, adc, sbb, and, sub, xor, cmp
+  static const int ext[] = {
+    [X86_ADD] = 0, [X86_OR] = 1, [X86_AND] = 4,
+    [X86_SUB] = 5, [X86_XOR] = 6, [X86_CMP] = 7,
+  };
+  int n = ext[m];
+
+  if (is_rm(d) && s->kind == X86_OPERAND_REG) {
+    if (d->kind == X86_OPERAND_REG && d->size != s->size)
+      return x86_fail(obj, m);
+    x86_emit_rm1(obj, (uint8_t) (n * 8 + 1), s->size, s->reg, d);
+    return true;
+  }
+
+  if (d->kind == X86_OPERAND_REG && s->kind == X86_OPERAND_MEM) {
+    if (s->size && s->size != d->size) return x86_fail(obj, m);
+    x86_emit_rm1(obj, (uint8_t) (n * 8 + 3), d->size, d->reg, s);
+    return true;
+  }
+
+  if (is_rm(d) && s->kind == X86_OPERAND_IMM) {
+    int size = x86_rm_size(d, NULL);
+    if (!size || !x86_imm_fits(s->value, size)) return x86_fail(obj, m);
+    int64_t value = size == 4 ? (int32_t) (uint32_t) s->value : s->value;
+    if (fits_i8(value)) {
+      x86_emit_rm1(obj, 0x83, size, n, d);
+      return x86_emit_imm(obj, value, 1);
+    }
+    x86_emit_rm1(obj, 0x81, size, n, d);
+    return x86_emit_imm(obj, value, 4);
+  }
+
+  return x86_fail(obj, m);
+}
+
+static bool x86_encode_mov(
+    object_file_t* obj, const x86_operand_t* d, const x86_operand_t* s)
+{
+  if (is_rm(d) && s->kind == X86_OPERAND_REG) {
+    if (d->kind == X86_OPERAND_REG && d->size != s->size)
+      return x86_fail(obj, X86_MOV);
+    if (d->kind == X86_OPERAND_MEM && d->size && d->size != s->size)
+      return x86_fail(obj, X86_MOV);
+    x86_emit_rm1(obj, 0x89, s->size, s->reg, d);
+    return true;
+  }
+
+  if (d->kind == X86_OPERAND_REG && s->kind == X86_OPERAND_MEM) {
+    if (s->size && s->size != d->size) return x86_fail(obj, X86_MOV);
+    x86_emit_rm1(obj, 0x8B, d->size, d->reg, s);
+    return true;
+  }
+
+  if (d->kind == X86_OPERAND_REG && s->kind == X86_OPERAND_IMM) {
+    int64_t v = s->value;
+
+    if (d->size == 4 || (v >= 0 && v <= (int64_t) UINT32_MAX)) {
+      // writing the 32 bit register zero extends, like NASM does
+      if (d->size == 4 && !x86_imm_fits(v, 4)) return x86_fail(obj, X86_MOV);
+      if (d->reg & 8) object_emit_byte(obj, 0x41);
+      object_emit_byte(obj, (uint8_t) (0xB8 + (d->reg & 7)));
+      object_emit_u32(obj, (uint32_t) v);
+      return true;
+    }
+
+    if (fits_i32(v)) {
+      x86_emit_rm1(obj, 0xC7, 8, 0, d);
+      return x86_emit_imm(obj, v, 4);
+    }
+
+    object_emit_byte(obj, (uint8_t) (0x48 | ((d->reg & 8) ? 1 : 0)));
+    object_emit_byte(obj, (uint8_t) (0xB8 + (d->reg & 7)));
+    object_emit_u64(obj, (uint64_t) v);
+    return true;
+  }
+
+  if (d->kind == X86_OPERAND_MEM && s->kind == X86_OPERAND_IMM) {
+    if (!d->size || !x86_imm_fits(s->value, d->size))
+      return x86_fail(obj, X86_MOV);
+    x86_emit_rm1(obj, 0xC7, d->size, 0, d);
+    return x86_emit_imm(obj, s->value, 4);
+  }
+
+  return x86_fail(obj, X86_MOV);
+}
+
+static bool x86_encode_imul(
+    object_file_t* obj, const x86_operand_t* ops, size_t count)
+{
+  static const uint8_t imul_rm[] = { 0x0F, 0xAF };
+
+  const x86_operand_t* d = &ops[0];
+  if (d->kind != X86_OPERAND_REG) return x86_fail(obj, X86_IMUL);
+
+  const x86_operand_t* src = d;
+  const x86_operand_t* imm = NULL;
+
+  if (count == 2 && ops[1].kind == X86_OPERAND_IMM) {
+    imm = &ops[1];
+  } else if (count == 2 && is_rm(&ops[1])) {
+    src = &ops[1];
+  } else if (count == 3 && is_rm(&ops[1]) &&
+      ops[2].kind == X86_OPERAND_IMM) {
+    src = &ops[1];
+    imm = &ops[2];
+  } else {
+    return x86_fail(obj, X86_IMUL);
+  }
+
+  if (src->kind == X86_OPERAND_REG && src->size != d->size)
+    return x86_fail(obj, X86_IMUL);
+
+  if (!imm) {
+    x86_emit_rm(obj, imul_rm, 2, d->size, d->reg, src);
+    return true;
+  }
+
+  if (!x86_imm_fits(imm->value, d->size)) return x86_fail(obj, X86_IMUL);
+  if (fits_i8(imm->value)) {
+    x86_emit_rm1(obj, 0x6B, d->size, d->reg, src);
+    return x86_emit_imm(obj, imm->value, 1);
+  }
+  x86_emit_rm1(obj, 0x69, d->size, d->reg, src);
+  return x86_emit_imm(obj, imm->value, 4);
+}
+
+// inc, dec, neg, not, mul, imul, div, idiv: one r/m operand and an opcode
+// extension in the reg field
+static bool x86_encode_unary(
+    object_file_t* obj, x86_mnemonic_t m, const x86_operand_t* d)
+{
+  uint8_t opcode = 0xF7;
+  int n = 0;
+  switch (m) {
+  case X86_INC:  opcode = 0xFF; n = 0; break;
+  case X86_DEC:  opcode = 0xFF; n = 1; break;
+  case X86_NOT:  n = 2; break;
+  case X86_NEG:  n = 3; break;
+  case X86_MUL:  n = 4; break;
+  case X86_IMUL: n = 5; break;
+  case X86_DIV:  n = 6; break;
+  case X86_IDIV: n = 7; break;
+  default: return x86_fail(obj, m);
+  }
+
+  if (!is_rm(d) || !d->size) return x86_fail(obj, m);
+  x86_emit_rm1(obj, opcode, d->size, n, d);
+  return true;
+}
+
+static bool x86_encode_shift(
+    object_file_t* obj, x86_mnemonic_t m,
+    const x86_operand_t* d, const x86_operand_t* s)
+{
+  int n = m == X86_SHL ? 4 : m == X86_SHR ? 5 : 7;
+  if (!is_rm(d) || !d->size || s->kind != X86_OPERAND_IMM ||
+      s->value < 0 || s->value > 63)
+    return x86_fail(obj, m);
+
+  if (s->value == 1) {
+    x86_emit_rm1(obj, 0xD1, d->size, n, d);
+    return true;
+  }
+  x86_emit_rm1(obj, 0xC1, d->size, n, d);
+  return x86_emit_imm(obj, s->value, 1);
+}
+
+static bool x86_encode_stack(
+    object_file_t* obj, x86_mnemonic_t m, const x86_operand_t* d)
+{
+  bool push = m == X86_PUSH;
+
+  if (d->kind == X86_OPERAND_REG) {
+    if (d->size != 8) return x86_fail(obj, m);
+    if (d->reg & 8) object_emit_byte(obj, 0x41);
+    object_emit_byte(obj, (uint8_t) ((push ? 0x50 : 0x58) + (d->reg & 7)));
+    return true;
+  }
+
+  if (d->kind == X86_OPERAND_MEM) {
+    // default operand size is 64 bit, no REX.W needed
+    x86_emit_rm1(obj, push ? 0xFF : 0x8F, 0, push ? 6 : 0, d);
+    return true;
+  }
+
+  if (push && d->kind == X86_OPERAND_IMM && fits_i32(d->value)) {
+    if (fits_i8(d->value)) {
+      object_emit_byte(obj, 0x6A);
+      return x86_emit_imm(obj, d->value, 1);
+    }
+    object_emit_byte(obj, 0x68);
+    return x86_emit_imm(obj, d->value, 4);
+  }
+
+  return x86_fail(obj, m);
+}
+
+static bool x86_encode_branch(
+    object_file_t* obj, x86_mnemonic_t m, const x86_operand_t* d)
+{
+  if (d->kind == X86_OPERAND_REG || d->kind == X86_OPERAND_MEM) {
+    if (m != X86_JMP && m != X86_CALL) return x86_fail(obj, m);
+    if (d->kind == X86_OPERAND_REG && d->size != 8) return x86_fail(obj, m);
+    x86_emit_rm1(obj, 0xFF, 0, m == X86_JMP ? 4 : 2, d);
+    return true;
+  }
+
+  if (d->kind != X86_OPERAND_LABEL) return x86_fail(obj, m);
+
+  // always rel32, the rel8 forms would need a relaxation pass
+  if (m == X86_CALL) {
+    object_emit_byte(obj, 0xE8);
+    object_emit_ref(obj, d->label, OBJECT_REF_CALL);
+  } else if (m == X86_JMP) {
+    object_emit_byte(obj, 0xE9);
+    object_emit_ref(obj, d->label, OBJECT_REF_JUMP);
+  } else {
+    object_emit_byte(obj, 0x0F);
+    object_emit_byte(obj, (uint8_t) (0x80 + (m - X86_JO)));
+    object_emit_ref(obj, d->label, OBJECT_REF_JUMP);
+  }
+  return true;
+}
+
+bool x86_encode(
+    object_file_t* obj,
+    x86_mnemonic_t mnemonic,
+    const x86_operand_t* ops,
+    size_t count)
+{
+  for (size_t i = 0; i < count; ++i) {
+    if (!x86_operand_valid(&ops[i])) return x86_fail(obj, mnemonic);
+  }
+
+  switch (mnemonic) {
+  case X86_ADD: case X86_OR: case X86_AND:
+  case X86_SUB: case X86_XOR: case X86_CMP:
+    if (count != 2) return x86_fail(obj, mnemonic);
+    return x86_encode_alu(obj, mnemonic, &ops[0], &ops[1]);
+
+  case X86_MOV:
+    if (count != 2) return x86_fail(obj, mnemonic);
+    return x86_encode_mov(obj, &ops[0], &ops[1]);
+
+  case X86_LEA:
+    if (count != 2 || ops[0].kind != X86_OPERAND_REG ||
+        ops[1].kind != X86_OPERAND_MEM)
+      return x86_fail(obj, mnemonic);
+    x86_emit_rm1(obj, 0x8D, ops[0].size, ops[0].reg, &ops[1]);
+    return true;
+
+  case X86_TEST:
+    if (count != 2 || !is_rm(&ops[0])) return x86_fail(obj, mnemonic);
+    if (ops[1].kind == X86_OPERAND_REG) {
+      if (ops[0].kind == X86_OPERAND_REG && ops[0].size != ops[1].size)
+        return x86_fail(obj, mnemonic);
+      x86_emit_rm1(obj, 0x85, ops[1].size, ops[1].reg, &ops[0]);
+      return true;
+    }
+    if (ops[1].kind == X86_OPERAND_IMM && ops[0].size &&
+        x86_imm_fits(ops[1].value, ops[0].size)) {
+      x86_emit_rm1(obj, 0xF7, ops[0].size, 0, &ops[0]);
+      return x86_emit_imm(obj, ops[1].value, 4);
+    }
+    return x86_fail(obj, mnemonic);
+
+  case X86_IMUL:
+    if (count == 1) return x86_encode_unary(obj, mnemonic, &ops[0]);
+    if (count < 2 || count > 3) return x86_fail(obj, mnemonic);
+    return x86_encode_imul(obj, ops, count);
+
+  case X86_INC: case X86_DEC: case X86_NEG: case X86_NOT:
+  case X86_MUL: case X86_DIV: case X86_IDIV:
+    if (count != 1) return x86_fail(obj, mnemonic);
+    return x86_encode_unary(obj, mnemonic, &ops[0]);
+
+  case X86_SHL: case X86_SHR: case X86_SAR:
+    if (count != 2) return x86_fail(obj, mnemonic);
+    return x86_encode_shift(obj, mnemonic, &ops[0], &ops[1]);
+
+  case X86_PUSH: case X86_POP:
+    if (count != 1) return x86_fail(obj, mnemonic);
+    return x86_encode_stack(obj, mnemonic, &ops[0]);
+
+  case X86_RET:
+    if (count != 0) return x86_fail(obj, mnemonic);
+    object_emit_byte(obj, 0xC3);
+    return true;
+  case X86_SYSCALL:
+    if (count != 0) return x86_fail(obj, mnemonic);
+    object_emit_byte(obj, 0x0F);
+    object_emit_byte(obj, 0x05);
+    return true;
+  case X86_NOP:
+    if (count != 0) return x86_fail(obj, mnemonic);
+    object_emit_byte(obj, 0x90);
+    return true;
+  case X86_LEAVE:
+    if (count != 0) return x86_fail(obj, mnemonic);
+    object_emit_byte(obj, 0xC9);
+    return true;
+  case X86_CQO:
+    if (count != 0) return x86_fail(obj, mnemonic);
+    object_emit_byte(obj, 0x48);
+    object_emit_byte(obj, 0x99);
+    return true;
+  case X86_CDQ:
+    if (count != 0) return x86_fail(obj, mnemonic);
+    object_emit_byte(obj, 0x99);
+    return true;
+
+  case X86_JMP: case X86_CALL:
+  case X86_JO: case X86_JNO: case X86_JB: case X86_JAE:
+  case X86_JE: case X86_JNE: case X86_JBE: case X86_JA:
+  case X86_JS: case X86_JNS: case X86_JP: case X86_JNP:
+  case X86_JL: case X86_JGE: case X86_JLE: case X86_JG:
+    if (count != 1) return x86_fail(obj, mnemonic);
+    return x86_encode_branch(obj, mnemonic, &ops[0]);
+
+  case X86_MNEMONIC_COUNT:
+    break;
+  }
+
+  return x86_fail(obj, mnemonic);
+}
+
+// ----------------- Text assembler ------------------
+
+#define X86_LINE_MAX_OPERANDS 3
+
+typedef struct {
+  const char* p;
+  bool        ok;
+} x86_expr_t;
+
+static void x86_skip_spaces(x86_expr_t* e)
+{
+  while (*e->p == ' ' || *e->p == '\t') e->p++;
+}
+
+static int64_t x86_expr_or(x86_expr_t* e);
+
+static int64_t x86_expr_primary(x86_expr_t* e)
+{
+  x86_skip_spaces(e);
+
+  if (*e->p == '-') { e->p++; return -x86_expr_primary(e); }
+  if (*e->p == '+') { e->p++; return x86_expr_primary(e); }
+  if (*e->p == '~') { e->p++; return ~x86_expr_primary(e); }
+
+  if (*e->p == '(') {
+    e->p++;
+    int64_t v = x86_expr_or(e);
+    x86_skip_spaces(e);
+    if (*e->p != ')') e->ok = false;
+    else e->p++;
+    return v;
+  }
+
+  if (!isdigit((unsigned char) *e->p)) {
+    e->ok = false;
+    return 0;
+  }
+
+  char* end = NULL;
+  uint64_t v;
+  if (e->p[0] == '0' && (e->p[1] == 'b' || e->p[1] == 'B'))
+    v = strtoull(e->p + 2, &end, 2);
+  else
+    v = strtoull(e->p, &end, 0); // handles 0x prefixes
+  e->p = end;
+  return (int64_t) v;
+}
+
+static int64_t x86_expr_mul(x86_expr_t* e)
+{
+  int64_t v = x86_expr_primary(e);
+  for (;;) {
+    x86_skip_spaces(e);
+    if (*e->p != '*') return v;
+    e->p++;
+    v *= x86_expr_primary(e);
+  }
+}
+
+static int64_t x86_expr_add(x86_expr_t* e)
+{
+  int64_t v = x86_expr_mul(e);
+  for (;;) {
+    x86_skip_spaces(e);
+    if (*e->p == '+')      { e->p++; v += x86_expr_mul(e); }
+    else if (*e->p == '-') { e->p++; v -= x86_expr_mul(e); }
+    else return v;
+  }
+}
+
+static int64_t x86_expr_and(x86_expr_t* e)
+{
+  int64_t v = x86_expr_add(e);
+  for (;;) {
+    x86_skip_spaces(e);
+    if (*e->p != '&') return v;
+    e->p++;
+    v &= x86_expr_add(e);
+  }
+}
+
+static int64_t x86_expr_xor(x86_expr_t* e)
+{
+  int64_t v = x86_expr_and(e);
+  for (;;) {
+    x86_skip_spaces(e);
+    if (*e->p != '^') return v;
+    e->p++;
+    v ^= x86_expr_and(e);
+  }
+}
+
+static int64_t x86_expr_or(x86_expr_t* e)
+{
+  int64_t v = x86_expr_xor(e);
+  for (;;) {
+    x86_skip_spaces(e);
+    if (*e->p != '|') return v;
+    e->p++;
+    v |= x86_expr_xor(e);
+  }
+}
+
+static bool x86_parse_expr(const char* text, int64_t* out)
+{
+  x86_expr_t e = { text, true };
+  *out = x86_expr_or(&e);
+  x86_skip_spaces(&e);
+  return e.ok && *e.p == '\0';
+}
+
+static char* x86_trim(char* s)
+{
+  while (isspace((unsigned char) *s)) s++;
+  char* end = s + strlen(s);
+  while (end > s && isspace((unsigned char) end[-1])) *--end = '\0';
+  return s;
+}
+
+static bool x86_is_ident_char(char c)
+{
+  return isalnum((unsigned char) c) || c == '_' || c == '.' ||
+    c == '$' || c == '@';
+}
+
+// Parses `reg`, `reg*n` or `n*reg` inside a memory operand
+static bool x86_parse_mem_reg(char* term, int* reg, int* size, int* scale)
+{
+  *scale = 1;
+  char* star = strchr(term, '*');
+  if (!star) {
+    *reg = x86_register_lookup(x86_trim(term), size);
+    return *reg >= 0;
+  }
+
+  *star = '\0';
+  char* left = x86_trim(term);
+  char* right = x86_trim(star + 1);
+  int64_t n = 0;
+  *reg = x86_register_lookup(left, size);
+  if (*reg < 0) {
+    *reg = x86_register_lookup(right, size);
+    if (*reg < 0 || !x86_parse_expr(left, &n)) return false;
+  } else if (!x86_parse_expr(right, &n)) {
+    return false;
+  }
+
+  if (n != 1 && n != 2 && n != 4 && n != 8) return false;
+  *scale = (int) n;
+  return true;
+}
+
+static bool x86_parse_mem(char* text, x86_operand_t* op)
+{
+  op->kind = X86_OPERAND_MEM;
+  op->base = -1;
+  op->index = -1;
+  op->scale = 1;
+  op->value = 0;
+
+  char* p = text;
+  bool negative = false;
+  while (*p) {
+    p = x86_trim(p);
+    if (*p == '+') { negative = false; p++; continue; }
+    if (*p == '-') { negative = true; p++; continue; }
+
+    // a term ends on the next top level + or -
+    char* end = p;
+    int depth = 0;
+    while (*end && (depth > 0 || (*end != '+' && *end != '-'))) {
+      if (*end == '(') depth++;
+      if (*end == ')') depth--;
+      end++;
+    }
+    char saved = *end;
+    *end = '\0';
+
+    int reg = -1, size = 0, scale = 1;
+    char term[128];
+    snprintf(term, sizeof(term), "%s", p);
+
+    if (!negative && x86_parse_mem_reg(term, &reg, &size, &scale)) {
+      if (op->addr_size && op->addr_size != size) return false;
+      op->addr_size = size;
+      if (op->base < 0 && scale == 1) {
+        op->base = reg;
+      } else if (op->index < 0) {
+        op->index = reg;
+        op->scale = scale;
+      } else {
+        return false;
+      }
+    } else {
+      int64_t v = 0;
+      if (!x86_parse_expr(p, &v)) return false;
+      op->value += negative ? -v : v;
+    }
+
+    *end = saved;
+    p = end;
+    negative = false;
+  }
+
+  // [reg*2] alone: NASM turns it into [reg + reg]
+  if (op->base < 0 && op->index >= 0 && op->scale == 2) {
+    op->base = op->index;
+    op->scale = 1;
+  }
+
+  return op->base >= 0;
+}
+
+static bool x86_parse_operand(char* text, x86_operand_t* op)
+{
+  *op = (x86_operand_t) {0};
+  text = x86_trim(text);
+
+  int size = 0;
+  if (strncmp(text, "qword", 5) == 0 && !x86_is_ident_char(text[5])) {
+    size = 8;
+    text = x86_trim(text + 5);
+  } else if (strncmp(text, "dword", 5) == 0 && !x86_is_ident_char(text[5])) {
+    size = 4;
+    text = x86_trim(text + 5);
+  }
+  if (size && strncmp(text, "ptr", 3) == 0 && !x86_is_ident_char(text[3]))
+    text = x86_trim(text + 3);
+
+  if (*text == '[') {
+    char* close = strrchr(text, ']');
+    if (!close || close[1] != '\0') return false;
+    *close = '\0';
+    if (!x86_parse_mem(text + 1, op)) return false;
+    op->size = size;
+    return true;
+  }
+
+  int reg_size = 0;
+  int reg = x86_register_lookup(text, &reg_size);
+  if (reg >= 0) {
+    op->kind = X86_OPERAND_REG;
+    op->reg = reg;
+    op->size = reg_size;
+    return !size || size == reg_size;
+  }
+
+  int64_t v = 0;
+  if (x86_parse_expr(text, &v)) {
+    op->kind = X86_OPERAND_IMM;
+    op->value = v;
+    return true;
+  }
+
+  if (*text == '\0' || isdigit((unsigned char) *text)) return false;
+  for (char* c = text; *c; ++c) {
+    if (!x86_is_ident_char(*c)) return false;
+  }
+  op->kind = X86_OPERAND_LABEL;
+  op->label = text;
+  return true;
+}
+
+static bool x86_lookup_mnemonic(const char* name, x86_mnemonic_t* out)
+{
+  for (int i = 0; i < X86_MNEMONIC_COUNT; ++i) {
+    if (strcmp(name, x86_mnemonic_names[i]) == 0) {
+      *out = (x86_mnemonic_t) i;
+      return true;
+    }
+  }
+  for (size_t i = 0;
+      i < sizeof(x86_mnemonic_aliases) / sizeof(x86_mnemonic_aliases[0]);
+      ++i) {
+    if (strcmp(name, x86_mnemonic_aliases[i].name) == 0) {
+      *out = x86_mnemonic_aliases[i].mnemonic;
+      return true;
+    }
+  }
+  return false;
+}
+
+static bool x86_line_error(object_file_t* obj, const char* line)
+{
+  error_report_general(ERROR_SEVERITY_ERROR,
+      "built-in assembler cannot parse '%s' "
+      "(use --nasm to assemble with NASM)", line);
+  obj->failed = true;
+  return false;
+}
+
+bool x86_assemble_line(object_file_t* obj, const char* line)
+{
+  char buffer[512];
+  if (strlen(line) >= sizeof(buffer)) return x86_line_error(obj, line);
+  snprintf(buffer, sizeof(buffer), "%s", line);
+
+  char* comment = strchr(buffer, ';');
+  if (comment) *comment = '\0';
+
+  char* text = x86_trim(buffer);
+  if (*text == '\0') return true;
+
+  // NASM is case insensitive for mnemonics and registers, not for labels
+  char* word_end = text;
+  while (*word_end && !isspace((unsigned char) *word_end)) word_end++;
+
+  size_t len = strlen(text);
+  if (text[len - 1] == ':' && word_end == text + len) {
+    text[len - 1] = '\0';
+    return object_define_label(obj, text);
+  }
+
+  char saved = *word_end;
+  *word_end = '\0';
+  char word[32];
+  snprintf(word, sizeof(word), "%s", text);
+  for (char* c = word; *c; ++c) *c = (char) tolower((unsigned char) *c);
+  *word_end = saved;
+  char* rest = x86_trim(word_end);
+
+  if (strcmp(word, "global") == 0) {
+    object_add_global(obj, rest);
+    return true;
+  }
+  if (strcmp(word, "extern") == 0) {
+    object_add_extern(obj, rest);
+    return true;
+  }
+  if (strcmp(word, "section") == 0) {
+    if (strcmp(rest, ".text") != 0) return x86_line_error(obj, line);
+    return true;
+  }
+
+  x86_mnemonic_t mnemonic;
+  if (!x86_lookup_mnemonic(word, &mnemonic)) return x86_line_error(obj, line);
+
+  x86_operand_t ops[X86_LINE_MAX_OPERANDS];
+  size_t count = 0;
+  char* p = rest;
+  while (*p) {
+    if (count == X86_LINE_MAX_OPERANDS) return x86_line_error(obj, line);
+
+    char* end = p;
+    int depth = 0;
+    while (*end && (depth > 0 || *end != ',')) {
+      if (*end == '[' || *end == '(') depth++;
+      if (*end == ']' || *end == ')') depth--;
+      end++;
+    }
+    char saved_end = *end;
+    *end = '\0';
+    if (!x86_parse_operand(p, &ops[count++])) return x86_line_error(obj, line);
+    if (saved_end == '\0') break;
+    p = end + 1;
+  }
+
+  return x86_encode(obj, mnemonic, ops, count);
+}
@@ -0,0 +1,67 @@
+#ifndef X86_64_ENCODER_H
+#define X86_64_ENCODER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "object.h"
+
+// Mnemonics understood by the built-in assembler. Covers everything the
+// x86_64 target emits plus the usual suspects found in inline `asm`.
+typedef enum {
+  X86_ADD, X86_OR, X86_AND, X86_SUB, X86_XOR, X86_CMP,
+  X86_MOV, X86_LEA, X86_TEST, X86_IMUL,
+  X86_INC, X86_DEC, X86_NEG, X86_NOT, X86_MUL, X86_DIV, X86_IDIV,
+  X86_SHL, X86_SHR, X86_SAR,
+  X86_PUSH, X86_POP,
+  X86_RET, X86_SYSCALL, X86_NOP, X86_LEAVE, X86_CQO, X86_CDQ,
+  X86_JMP, X86_CALL,
+  X86_JO, X86_JNO, X86_JB, X86_JAE, X86_JE, X86_JNE, X86_JBE, X86_JA,
+  X86_JS, X86_JNS, X86_JP, X86_JNP, X86_JL, X86_JGE, X86_JLE, X86_JG,
+  X86_MNEMONIC_COUNT,
+} x86_mnemonic_t;
+
+typedef enum {
+  X86_OPERAND_REG,
+  X86_OPERAND_MEM,
+  X86_OPERAND_IMM,
+  X86_OPERAND_LABEL,
+} x86_operand_kind_t;
+
+typedef struct {
+  x86_operand_kind_t kind;
+  int                size;  // 8 or 4 bytes, 0 when not known (imm, mem)
+  int                reg;   // REG, -1 if the name was not a register
+  int                base;  // MEM, -1 when absent
+  int                index; // MEM, -1 when absent
+  int                scale; // MEM, 1, 2, 4 or 8
+  int                addr_size; // MEM, size of base/index registers
+  int64_t            value; // IMM value or MEM displacement
+  const char*        label; // LABEL, not owned
+} x86_operand_t;
+
+// Returns the register number (0-15) of `name` or -1, `size` gets 8 or 4
+int x86_register_lookup(const char* name, int* size);
+
+x86_operand_t x86_op_reg(const char* name);
+x86_operand_t x86_op_imm(int64_t value);
+x86_operand_t x86_op_label(const char* name);
+// `index` may be NULL, `size` is 0 when the other operand gives it
+x86_operand_t x86_op_mem(
+    const char* base, const char* index, int64_t disp, int size);
+
+// Appends the machine code of one instruction to `obj`.
+// Reports an error and marks `obj` as failed when the combination of
+// operands cannot be encoded.
+bool x86_encode(
+    object_file_t* obj,
+    x86_mnemonic_t mnemonic,
+    const x86_operand_t* ops,
+    size_t count);
+
+// Assembles one line of NASM syntax as written by the x86_64 target:
+// an instruction, a `label:`, or a `global` / `extern` / `section`
+// directive. Used for inline `asm` blocks.
+bool x86_assemble_line(object_file_t* obj, const char* line);
+
+#endif // X86_64_ENCODER_H
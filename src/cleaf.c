@@ -10,6 +10,7 @@
 
 #include "frontend/ast_definition.h"
 #include "frontend/ast.h"
+#include "frontend/ast_parallel.h"
 #include "frontend/ast_printer.h"
 #include "thirdparty/error.h"
 #include "frontend/semantic.h"
@@ -17,12 +18,29 @@
 #include "thirdparty/rand.h"
 #include "backend/codegen.h"
 #include "backend/x86_64_definition.h"
+#include "backend/object.h"
+#include "backend/elf64.h"
+#include "backend/linker.h"
 #include "compiler/definition/compiler_definition.h"
 #include "compiler/setup/compiler_setup.h"
 #include "compiler/build/registry.h"
 #include "compiler/build/dep_graph.h"
 #include "compiler/build/export_table.h"
 #include "compiler/build/import_resolver.h"
+#include "compiler/build/scheduler.h"
+#include "compiler/build/build_cache.h"
+#include "compiler/build/process_pool.h"
+#include "compiler/build/server.h"
+#include "compiler/build/session.h"
+#include "compiler/build/watcher.h"
+#include "compiler/stats/stats.h"
+#include "compiler/stats/trace.h"
+
+#include <errno.h>
+#include <signal.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
 
 static char* build_object_basename(module_unit_t* unit)
 {
@@ -56,399 +74,1058 @@ static char* build_object_basename(module_unit_t* unit)
   return out;
 }
 
-int main(int argc, char** argv) 
+// Links with the built-in linker, `ld` is only spawned when an object
+// uses something it does not handle (e.g. hand written NASM sections)
+static bool link_objects(
+    compiled_files_array* object_files, const char* output_path)
 {
-  compiler_resources_t* res = NULL;
+  log_phase("link", "%zu object file(s) -> '%s'",
+      object_files->count, output_path);
 
-  if (argc > 1 && strcmp(argv[1], "build") == 0) {
-    res = build_setup();  
-  } else {
-    res = single_file_setup(argc, argv);  
+  link_input_array inputs = {0};
+  da_foreach(char*, oit, object_files) {
+    link_input_t input = { .path = *oit };
+    da_append(&inputs, input);
   }
 
-  if (!res) return 1;
+  stats_span_t span = stats_begin(NULL, STATS_LINK);
+  link_status_t status = link_executable(&inputs, "_start", output_path);
+  stats_end(&span);
+  da_free(&inputs);
 
-  int is_build_mode = (argc > 1 && strcmp(argv[1], "build") == 0);
+  if (status == LINK_OK) return true;
+  if (status == LINK_ERROR) {
+    error_report_general(ERROR_SEVERITY_ERROR, "linking failed");
+    return false;
+  }
 
-  log_phase("compiling", "%zu file(s)", res->files.count);
+  log_phase("link", "unsupported object layout, falling back to ld");
+
+  struct {
+    const char** items;
+    size_t count;
+    size_t capacity;
+  } argv = {0};
+  da_append(&argv, "ld");
+  da_foreach(char*, oit, object_files) da_append(&argv, *oit);
+  da_append(&argv, "-o");
+  da_append(&argv, output_path);
+  da_append(&argv, NULL);
+
+  span = stats_begin(NULL, STATS_LINK);
+  bool ok = process_run(argv.items) == 0;
+  stats_end(&span);
+  if (!ok)
+    error_report_general(ERROR_SEVERITY_ERROR, "linking failed");
+
+  da_free(&argv);
+  return ok;
+}
 
-  build_context_t build_ctx = {0};
-  if (is_build_mode) {
-    build_ctx.registry = calloc(1, sizeof(hashmap_t));
-    if (!build_ctx.registry) {
-      error_report_general(ERROR_SEVERITY_ERROR, "out of memory"); 
-      compiler_resources_free(res);
-      return 1;
+typedef struct {
+  build_context_t*   build_ctx;
+  const target_t*    target;
+  IR_function_array* module_hir;   // one per topo index
+  char**             object_paths; // one per topo index, NULL on failure
+  bool*              cache_hits;   // one per topo index
+  bool*              store_keys;   // one per topo index, once NASM succeeded
+  uint64_t*          cache_keys;   // one per topo index
+  bool               use_nasm;     // text assembly + NASM instead of built-in
+  uint64_t           compiler_id;  // see build_cache_compiler_id
+  process_pool_t*    assemblers;   // NASM runs, reaped after scheduling
+  const bool*        reuse;        // one per topo index, NULL to check
+                                   // every module against the cache
+} module_pipeline_t;
+
+static void emit_module_symbols(
+    string_builder_t* sb,
+    const target_t* target,
+    module_unit_t* unit,
+    IR_function_array* hir,
+    int* had_errors)
+{
+  target->setup(sb);
+
+  da_foreach(declaration_t*, dit, &unit->program) {
+    declaration_t* decl = *dit;
+    if (decl->type != DECLARATION_FUNC) continue;
+
+    char* mangled =
+      IR_mangle_function_name(unit->module_name, decl->func.name);
+    if (!mangled) {
+      error_report_general(ERROR_SEVERITY_ERROR, "out of memory");
+      *had_errors = 1;
+      continue;
     }
+
+    if (!decl->func.is_internal || strcmp(mangled, "start") == 0)
+      target->emit_global(sb, mangled);
+
+    free(mangled);
   }
 
-  da_foreach(char*, it, &res->files) {
-    char* filename = *it;
+  compiled_files_array externs_emitted = {0};
+  da_foreach(IR_function_t*, fit, hir) {
+    da_foreach(IR_instruction_t*, cit, (*fit)->code) {
+      if ((*cit)->kind != IR_CALL) continue;
+      const char* callee = (*cit)->func_name;
+
+      bool is_local = false;
+      da_foreach(IR_function_t*, lit, hir) {
+        if (strcmp((*lit)->name, callee) == 0) {
+          is_local = true;
+          break;
+        }
+      }
+      if (is_local) continue;
 
-    FILE* f = fopen(filename, "rb");
-    if (!f) {
-      error_report_general(
-          ERROR_SEVERITY_ERROR, "cannot open file '%s'", filename);
-      compiler_resources_free(res);
-      build_context_free(&build_ctx);
-      return 1;
+      bool already_emitted = false;
+      da_foreach(char*, eit, &externs_emitted) {
+        if (strcmp(*eit, callee) == 0) {
+          already_emitted = true;
+          break;
+        }
+      }
+      if (already_emitted) continue;
+
+      target->emit_extern(sb, callee);
+      da_append(&externs_emitted, strdup(callee));
     }
+  }
+  da_foreach(char*, eit, &externs_emitted) free(*eit);
+  da_free(&externs_emitted);
+}
 
-    module_unit_t* unit = calloc(1, sizeof(module_unit_t));
-    if (!unit) {
-      fclose(f);
-      compiler_resources_free(res);
-      build_context_free(&build_ctx);
-      return 1;
+// Debug path: closes the assembly file codegen streamed into and starts
+// NASM on it. The next modules are lowered while it runs, its status is
+// checked by finish_nasm_jobs.
+static bool assemble_with_nasm(
+    process_pool_t* assemblers,
+    size_t index,
+    FILE* asm_f,
+    const char* asm_path,
+    const char* obj_path)
+{
+  bool written = !ferror(asm_f);
+  if (fclose(asm_f) != 0 || !written) {
+    remove(asm_path);
+    error_report_general(
+        ERROR_SEVERITY_ERROR, "cannot write asm file '%s'", asm_path);
+    return false;
+  }
+
+  log_phase("assemble", "'%s' -> '%s'", asm_path, obj_path);
+
+  const char* argv[] = { "nasm", "-f", "elf64", asm_path, "-o", obj_path, NULL };
+  return process_pool_submit(assemblers, argv, index);
+}
+
+// Reports the NASM runs in module order: a failed one drops the object of
+// its module, a successful one records the module cache key
+static void finish_nasm_jobs(module_pipeline_t* pipeline, int* had_errors)
+{
+  process_pool_wait(pipeline->assemblers);
+
+  da_foreach(process_job_t*, it, pipeline->assemblers) {
+    process_job_t* job = *it;
+    size_t index = job->index;
+    process_job_replay(job);
+    stats_add(stats_module(pipeline->build_ctx->items[index]->file_path),
+        STATS_ASSEMBLE, job->start_ms, job->wall_ms, job->cpu_ms, job->pid);
+
+    if (job->exit_status != 0) {
+      error_report_general(ERROR_SEVERITY_ERROR,
+          "nasm failed to assemble '%s'", job->argv[3]);
+      free(pipeline->object_paths[index]);
+      pipeline->object_paths[index] = NULL;
+      *had_errors = 1;
+      continue;
     }
 
-    unit->file_path = filename;
-    unit->source = malloc(1 << 20);
-    unit->source_len = (int) fread(unit->source, 1, 1 << 20, f);
-    fclose(f);
+    if (!pipeline->store_keys[index]) continue;
+    char* base = build_object_basename(pipeline->build_ctx->items[index]);
+    if (!base || !build_cache_store(base, pipeline->cache_keys[index]))
+      log_phase("cache", "cannot record key of '%s'", job->argv[5]);
+    free(base);
+  }
+}
+
+// Token source of the parser, lexing a batch at a time
+typedef struct {
+  lexer_t lex;
+  bool    failed;
+  double  lex_ms; // time spent lexing, interleaved with parsing
+} lexer_source_t;
 
-    error_init(&unit->error_ctx, filename, unit->source, unit->source_len);
-    unit->parser.error_ctx = &unit->error_ctx;
+static size_t lexer_source_next(void* user, token_t* out, size_t max)
+{
+  lexer_source_t* source = (lexer_source_t*) user;
+  double start_ms = trace_now_ms();
+
+  size_t produced = 0;
+  while (produced < max && !source->failed && lexer_get_token(&source->lex)) {
+    if (source->lex.token == LEXER_token_parse_error) {
+      error_report_general(ERROR_SEVERITY_ERROR, "lexer parse error");
+      source->failed = true;
+      break;
+    }
+    out[produced++] = lexer_copy_token(&source->lex);
+  }
+
+  source->lex_ms += trace_now_ms() - start_ms;
+  return produced;
+}
 
-    lexer_t lex;
+// Parses the body `d` skipped when its module was loaded, if any
+static bool parse_deferred_body(module_unit_t* unit, declaration_t* d)
+{
+  char storage[4096];
+  lexer_source_t source = {0};
+  if (d->type == DECLARATION_FUNC && d->func.body_start)
     lexer_init_lexer(
-        &lex, unit->source, unit->source + unit->source_len,
-        malloc(4096), 4096);
+        &source.lex, d->func.body_start, d->func.body_end,
+        storage, sizeof(storage));
+  return ast_parse_function_body(
+      &unit->parser, d, lexer_source_next, &source);
+}
 
-    while (lexer_get_token(&lex)) {
-      if (lex.token == LEXER_token_parse_error) {
-        error_report_general(ERROR_SEVERITY_ERROR, "lexer parse error");
-        free(lex.string_storage);
-        module_unit_free(unit);
-        compiler_resources_free(res);
-        build_context_free(&build_ctx);
-        return 1;
-      }
-      token_t t = lexer_copy_token(&lex);
-      da_append(&unit->parser, t);
+// Semantic analysis, HIR lowering, codegen and assembly of a single
+// module. Only touches state owned by `unit` and the `index` slots of the
+// pipeline, so several of them can run at the same time.
+static module_job_status_t compile_module_job(
+    module_unit_t* unit, size_t index, void* user)
+{
+  module_pipeline_t* pipeline = (module_pipeline_t*) user;
+  const target_t* target = pipeline->target;
+  IR_function_array* hir = &pipeline->module_hir[index];
+  stats_module_t* stats = stats_module(unit->file_path);
+  stats_module_set_name(stats, unit->module_name);
+  int had_errors = 0;
+
+  char* base = build_object_basename(unit);
+  if (!base) {
+    error_report_general(ERROR_SEVERITY_ERROR, "out of memory");
+    return MODULE_JOB_ERROR;
+  }
+
+  char asm_path[512];
+  snprintf(asm_path, sizeof(asm_path), "build/%s.asm", base);
+  char* obj_path = malloc(strlen("build/") + strlen(base) + strlen(".o") + 1);
+  if (!obj_path) {
+    error_report_general(ERROR_SEVERITY_ERROR, "out of memory");
+    free(base);
+    return MODULE_JOB_ERROR;
+  }
+  sprintf(obj_path, "build/%s.o", base);
+
+  // watch mode: neither this module nor anything it imports changed since
+  // a build that succeeded, its object is still the one on disk
+  if (pipeline->reuse && pipeline->reuse[index] && access(obj_path, R_OK) == 0) {
+    log_phase("watch", "'%s' (module '%s'): unchanged",
+        unit->file_path, unit->module_name ? unit->module_name : "-");
+    pipeline->cache_hits[index] = true;
+    pipeline->object_paths[index] = obj_path;
+    free(base);
+    return MODULE_JOB_OK;
+  }
+
+  uint64_t cache_key =
+    build_cache_key(unit, pipeline->use_nasm ? "nasm" : "built-in",
+        pipeline->compiler_id);
+  if (build_cache_lookup(base, cache_key)) {
+    log_phase("cache", "'%s' (module '%s'): hit",
+        unit->file_path, unit->module_name ? unit->module_name : "-");
+    pipeline->cache_hits[index] = true;
+    pipeline->object_paths[index] = obj_path;
+    free(base);
+    return MODULE_JOB_OK;
+  }
+
+  log_phase("cache", "'%s' (module '%s'): miss",
+      unit->file_path, unit->module_name ? unit->module_name : "-");
+  build_cache_invalidate(base);
+
+  stats_span_t span = stats_begin(stats, STATS_PARSE);
+  da_foreach(declaration_t*, dit, &unit->program) {
+    bool deferred = (*dit)->type == DECLARATION_FUNC && (*dit)->func.body_start;
+    if (!parse_deferred_body(unit, *dit)) {
+      stats_end(&span);
+      error_report_general(
+          ERROR_SEVERITY_ERROR, 
+          "ast parse error in '%s'", unit->file_path);
+      free(obj_path);
+      free(base);
+      return MODULE_JOB_ERROR;
     }
-    free(lex.string_storage);
+    // the declaration itself was counted when the module was loaded
+    if (deferred && stats) stats->ast_nodes += ast_count_nodes(*dit) - 1;
+  }
+  stats_end(&span);
+
+  if (log_is_dump() && unit->parser.defer_bodies) {
+    log_section_begin("AST");
+    ast_print_program(&unit->program);
+    log_section_end();
+  }
 
-    log_phase("lexing", "'%s': %zu tokens", filename, unit->parser.count);
+  semantic_analyzer_t analyzer = {0};
+  analyzer.error_ctx = &unit->error_ctx;
+  analyzer.ast = &unit->program;
+  analyzer.types = unit->parser.types;
 
-    unit->parser.types = calloc(1, sizeof(known_type_array));
-    if (!unit->parser.types) {
+  span = stats_begin(stats, STATS_SEMANTIC);
+  if (!semantic_resolve_imports(pipeline->build_ctx, unit, &analyzer)) {
+    stats_end(&span);
+    semantic_free_program_definition(&analyzer);
+    free(obj_path);
+    free(base);
+    return MODULE_JOB_FATAL;
+  }
+
+  log_phase("semantic", "'%s' (module '%s')",
+      unit->file_path, unit->module_name ? unit->module_name : "-");
+  semantic_analyze(&analyzer);
+  stats_end(&span);
+
+  if (analyzer.error_count > 0) {
+    semantic_free_program_definition(&analyzer);
+    free(obj_path);
+    free(base);
+    return MODULE_JOB_ERROR;
+  }
+
+  rand_t chunk_rng;
+  rand_init(&chunk_rng);
+
+  HIR_parser_t hir_parser = {0};
+  hir_parser.error_ctx = &unit->error_ctx;
+  hir_parser.hir_program = hir;
+  hir_parser.struct_symbols = analyzer.struct_symbols;
+  hir_parser.flat = &analyzer.flat;
+  hir_parser.current_module = unit->module_name;
+  HIR_PARSER_USE_RNG(hir_parser, &chunk_rng);
+
+  span = stats_begin(stats, STATS_HIR);
+  da_foreach(declaration_t*, dit, &unit->program) {
+    if (IR_lower_function(&hir_parser, *dit) != 0) {
+      error_report_general(
+          ERROR_SEVERITY_ERROR, "hir lowering error in '%s'", unit->file_path);
+      had_errors = 1;
+      break;
+    }
+  }
+  stats_end(&span);
+  if (stats) {
+    da_foreach(IR_function_t*, fit, hir)
+      stats->hir_instructions += (*fit)->code ? (*fit)->code->count : 0;
+  }
+
+  log_phase("hir", "'%s' (module '%s'): %zu function(s)",
+      unit->file_path, unit->module_name ? unit->module_name : "-",
+      hir->count);
+
+  if (log_is_dump()) {
+    log_section_begin("HIR");
+    da_foreach(IR_function_t*, fit, hir) {
+      char* hir_text = IR_generate_string_program(*fit);
+      fprintf(log_get_output(), "%s", hir_text);
+      free(hir_text);
+    }
+    log_section_end();
+  }
+
+  // the object target encodes into `module_obj.text`, the NASM one
+  // formats assembly into `module_sb`, written to `asm_path` by chunks
+  string_builder_t module_sb = {0};
+  object_file_t module_obj = {0};
+  string_builder_t* code = pipeline->use_nasm ? &module_sb : &module_obj.text;
+
+  FILE* asm_f = NULL;
+  if (pipeline->use_nasm) {
+    asm_f = fopen(asm_path, "wb");
+    if (!asm_f) {
+      error_report_general(
+          ERROR_SEVERITY_ERROR, "cannot write asm file '%s'", asm_path);
+      free(obj_path);
+      free(base);
+      semantic_free_program_definition(&analyzer);
+      return MODULE_JOB_ERROR;
+    }
+    sb_set_sink(&module_sb, asm_f);
+  }
+
+  span = stats_begin(stats, STATS_CODEGEN);
+  if (unit->module_name)
+    emit_module_symbols(code, target, unit, hir, &had_errors);
+
+  int codegen_error = 0;
+  da_foreach(IR_function_t*, fit, hir) {
+    if (CODEGEN_write_function(code, *fit, target) != 0) {
+      codegen_error = 1;
+      break;
+    }
+  }
+  if (!pipeline->use_nasm && !object_finalize(&module_obj))
+    codegen_error = 1;
+  sb_flush(code);
+  stats_end(&span);
+  if (stats) stats->code_bytes = sb_length(code);
+
+  log_phase("codegen", "'%s' (module '%s'): %zu byte(s) of %s",
+      unit->file_path, unit->module_name ? unit->module_name : "-",
+      sb_length(code), pipeline->use_nasm ? "assembly" : "machine code");
+
+  bool assembled = false;
+  if (codegen_error) {
+    error_report_general(
+        ERROR_SEVERITY_ERROR, "codegen error in '%s'", unit->file_path);
+    // no partial assembly is left behind
+    if (asm_f) {
+      fclose(asm_f);
+      remove(asm_path);
+    }
+  } else if (pipeline->use_nasm) {
+    // the NASM process itself is accounted for by finish_nasm_jobs
+    assembled = assemble_with_nasm(
+        pipeline->assemblers, index, asm_f, asm_path, obj_path);
+  } else {
+    log_phase("assemble", "built-in -> '%s'", obj_path);
+    span = stats_begin(stats, STATS_ASSEMBLE);
+    assembled = elf64_write_object(&module_obj, obj_path);
+    stats_end(&span);
+  }
+
+  da_free(&module_sb);
+  object_file_free(&module_obj);
+
+  if (!assembled) {
+    free(obj_path);
+    free(base);
+    semantic_free_program_definition(&analyzer);
+    return MODULE_JOB_ERROR;
+  }
+
+  // a module with errors is rebuilt next time even if its object exists,
+  // NASM ones are recorded once the assembler succeeded
+  if (pipeline->use_nasm) {
+    pipeline->store_keys[index] = !had_errors;
+    pipeline->cache_keys[index] = cache_key;
+  } else if (!had_errors && !build_cache_store(base, cache_key)) {
+    log_phase("cache", "cannot record key of '%s'", obj_path);
+  }
+  free(base);
+
+  pipeline->object_paths[index] = obj_path;
+
+  semantic_free_program_definition(&analyzer);
+  return had_errors ? MODULE_JOB_ERROR : MODULE_JOB_OK;
+}
+
+// Threads a single module may be parsed on, the -j of the build
+static int parse_jobs = 1;
+// `cleaf build` skips function bodies when loading a module, they are
+// parsed by the module's compile job, never for a module reused as is
+static bool defer_bodies = false;
+// Units kept between builds (serve, watch) own a copy of their source
+// rather than a mapping of a file that may be rewritten under them
+static bool owned_sources = false;
+
+// Lexes the whole module into the parser's token array, for
+// ast_parse_program. A lexer error is not reported here: the tokens are
+// dropped and the module is lexed again as it is parsed, so the error
+// comes after the diagnostics of the declarations before it.
+static bool lex_module_tokens(module_unit_t* unit, lexer_source_t* source)
+{
+  double start_ms = trace_now_ms();
+  lexer_t lex = source->lex; // `source` still starts at the beginning
+
+  bool failed = false;
+  while (lexer_get_token(&lex)) {
+    if (lex.token == LEXER_token_parse_error) {
+      failed = true;
+      break;
+    }
+    token_t t = lexer_copy_token(&lex);
+    da_append(&unit->parser, t);
+  }
+
+  source->lex_ms += trace_now_ms() - start_ms;
+  if (failed)
+    parser_free_tokens(&unit->parser);
+  return !failed;
+}
+
+// Lexes and parses `filename` into a new unit, which borrows it as its
+// file path. Tokens are lexed as the parser asks for them and freed after
+// each top-level declaration, or with -j all lexed first and parsed on
+// parse_jobs threads. Returns NULL after reporting an error.
+static module_unit_t* load_module_unit(char* filename)
+{
+  module_unit_t* unit = calloc(1, sizeof(module_unit_t));
+  if (!unit) {
+    error_report_general(ERROR_SEVERITY_ERROR, "out of memory");
+    return NULL;
+  }
+
+  if (!module_unit_load_source(unit, filename, owned_sources)) {
+    error_report_general(
+        ERROR_SEVERITY_ERROR, "cannot open file '%s'", filename);
+    module_unit_free(unit);
+    return NULL;
+  }
+  unit->file_path = filename;
+
+  error_init(&unit->error_ctx, filename, unit->source, unit->source_len);
+  unit->parser.error_ctx = &unit->error_ctx;
+  unit->parser.defer_bodies = defer_bodies;
+
+  unit->parser.types = calloc(1, sizeof(type_registry_t));
+  char* string_storage = malloc(4096);
+  if (!unit->parser.types || !string_storage) {
+    error_report_general(ERROR_SEVERITY_ERROR, "out of memory");
+    free(string_storage);
+    module_unit_free(unit);
+    return NULL;
+  }
+  populate_parser_known_type(unit->parser.types);
+
+  lexer_source_t source = {0};
+  lexer_init_lexer(
+      &source.lex, unit->source, unit->source + unit->source_len,
+      string_storage, 4096);
+
+  stats_module_t* stats = stats_module(filename);
+  stats_span_t span = stats_begin(stats, STATS_PARSE);
+
+  if (parse_jobs > 1 && lex_module_tokens(unit, &source)) {
+    if (!ast_parse_program(&unit->parser, &unit->program, parse_jobs)) {
+      error_report_general(
+          ERROR_SEVERITY_ERROR, 
+          "ast parse error in '%s'", filename);
+      free(string_storage);
       module_unit_free(unit);
-      compiler_resources_free(res);
-      build_context_free(&build_ctx);
-      return 1;
+      return NULL;
     }
-    populate_parser_known_type(unit->parser.types);
+  } else {
+    parser_init_stream(&unit->parser, lexer_source_next, &source);
 
-    while ((size_t) unit->parser.pos < unit->parser.count) {
+    while (peek(&unit->parser)) {
       declaration_t* decl = parse_declaration(&unit->parser);
-      if (!decl) {
-        error_report_general(
-            ERROR_SEVERITY_ERROR, 
-            "ast parse error in '%s'", filename);
+      if (!decl || source.failed) {
+        // the lexer already reported why the parser ran out of tokens
+        if (!source.failed)
+          error_report_general(
+              ERROR_SEVERITY_ERROR, 
+              "ast parse error in '%s'", filename);
+        free(string_storage);
         module_unit_free(unit);
-        compiler_resources_free(res);
-        build_context_free(&build_ctx);
-        return 1;
+        return NULL;
       }
       da_append(&unit->program, decl);
+      parser_release_consumed(&unit->parser);
     }
+  }
+  if (stats) {
+    da_foreach(declaration_t*, it, &unit->program)
+      stats->ast_nodes += ast_count_nodes(*it);
+  }
+  stats_split(&span, STATS_LEX, source.lex_ms);
+  stats_end(&span);
+  free(string_storage);
 
-    log_phase("parsing", "'%s': %zu declaration(s)", filename, unit->program.count);
+  if (source.failed) {
+    module_unit_free(unit);
+    return NULL;
+  }
 
-    if (log_is_dump()) {
-      log_section_begin("AST");
-      ast_print_program(&unit->program);
-      log_section_end();
-    }
+  size_t token_count = parser_token_count(&unit->parser);
+  if (stats) stats->tokens = token_count;
+  parser_free_tokens(&unit->parser);
 
-    da_append(&res->units, unit);
+  log_phase("lexing", "'%s': %zu tokens", filename, token_count);
+  log_phase("parsing", "'%s': %zu declaration(s)", filename, unit->program.count);
+
+  // with deferred bodies the compile job dumps the AST once it parsed them
+  if (log_is_dump() && !unit->parser.defer_bodies) {
+    log_section_begin("AST");
+    ast_print_program(&unit->program);
+    log_section_end();
   }
 
-  if (is_build_mode) {
-    da_foreach(module_unit_t*, it, &res->units) {
-      if (!populate_module_registry(&build_ctx, *it)) {
+  return unit;
+}
+
+// Fills `build_ctx` with the compilation order of `units`: the module
+// registry and dependency order in build mode, the given order otherwise.
+// Units may come from an earlier build, only missing export tables are
+// built.
+static bool prepare_build(
+    build_context_t* build_ctx, module_unit_array* units, bool is_build_mode)
+{
+  if (!is_build_mode) {
+    da_foreach(module_unit_t*, it, units) {
+      da_append(build_ctx, *it);
+    }
+  } else {
+    build_ctx->registry = calloc(1, sizeof(atom_map_t));
+    if (!build_ctx->registry) {
+      error_report_general(ERROR_SEVERITY_ERROR, "out of memory"); 
+      return false;
+    }
+
+    da_foreach(module_unit_t*, it, units) {
+      (*it)->deps.count = 0;
+      if (!populate_module_registry(build_ctx, *it)) {
         error_report_general(
             ERROR_SEVERITY_ERROR, 
             "error while building module registry");
-        compiler_resources_free(res);
-        build_context_free(&build_ctx);
-        return 1;
+        return false;
       }
     }
 
     module_unit_array* main_units =
-      (module_unit_array*) hashmap_get(build_ctx.registry, "main");
+      (module_unit_array*) atom_map_get(
+          build_ctx->registry, intern_cstr("main"));
 
     if (!main_units || main_units->count == 0) {
-      build_context_free(&build_ctx);
       error_report_general(ERROR_SEVERITY_ERROR,
          "no `main` module found");
-      compiler_resources_free(res);
-      return 1;
+      return false;
     }
-  }
 
-  if (is_build_mode) {
-    if (!build_dep_graph(&build_ctx)) {
-      build_context_free(&build_ctx);
-      compiler_resources_free(res);
-      return 1;
-    }
+    stats_span_t span = stats_begin(NULL, STATS_DEP_GRAPH);
+    bool graph_built = build_dep_graph(build_ctx);
+    stats_end(&span);
+    if (!graph_built) return false;
 
-    log_phase("topo order", "%zu module(s)", build_ctx.count);
-    for (size_t i = 0; i < build_ctx.count; ++i)
-      log_phase("  -->", "%s", build_ctx.items[i]->module_name);
-  } else {
-    da_foreach(module_unit_t*, it, &res->units) {
-      da_append(&build_ctx, *it);
-    }
+    log_phase("topo order", "%zu module(s)", build_ctx->count);
+    for (size_t i = 0; i < build_ctx->count; ++i)
+      log_phase("  -->", "%s", build_ctx->items[i]->module_name);
   }
 
-  da_foreach(module_unit_t*, it, &build_ctx) {
-    if (!semantic_build_export_table(*it)) {
-      build_context_free(&build_ctx);
-      compiler_resources_free(res);
-      return 1;
-    }
+  stats_span_t exports_span = stats_begin(NULL, STATS_EXPORTS);
+  da_foreach(module_unit_t*, it, build_ctx) {
+    if (!(*it)->export_funcs && !semantic_build_export_table(*it))
+      return false;
   }
+  stats_end(&exports_span);
 
+  return true;
+}
+
+// Everything after the front end: the module pipeline in topo order, then
+// the link. Reports what `--stats` and `--trace` collected and returns the
+// exit status of the build. `reuse` is forwarded to the pipeline.
+static int compile_and_link(
+    compiler_resources_t* res, build_context_t* build_ctx, const bool* reuse)
+{
   res->hir_program = calloc(1, sizeof(IR_function_array));
   if (!res->hir_program) {
     error_report_general(ERROR_SEVERITY_ERROR, "out of memory");
-    build_context_free(&build_ctx);
-    compiler_resources_free(res);
     return 1;
   }
 
-  rand_t chunk_rng;
-  rand_init(&chunk_rng);
-
-  const target_t* target = &x86_64_target;
+  const target_t* target =
+    res->use_nasm ? &x86_64_target : &x86_64_object_target;
   compiled_files_array object_files = {0};
 
-  if (system("mkdir -p build") != 0) {
+  if (mkdir("build", 0755) != 0 && errno != EEXIST) {
     error_report_general(ERROR_SEVERITY_ERROR, "cannot create 'build' directory");
-    build_context_free(&build_ctx);
-    compiler_resources_free(res);
     return 1;
   }
 
-  int had_errors = 0;
-  da_foreach(module_unit_t*, it, &build_ctx) {
-    module_unit_t* unit = *it;
+  // NASM runs overlap with the lowering of the next modules, at most
+  // `-j` of them at once
+  process_pool_t assemblers;
+  process_pool_init(&assemblers, res->jobs);
+
+  module_pipeline_t pipeline = {0};
+  pipeline.build_ctx = build_ctx;
+  pipeline.assemblers = &assemblers;
+  pipeline.target = target;
+  pipeline.use_nasm = res->use_nasm;
+  pipeline.compiler_id = build_cache_compiler_id();
+  pipeline.reuse = reuse;
+  pipeline.module_hir = calloc(build_ctx->count, sizeof(IR_function_array));
+  pipeline.object_paths = calloc(build_ctx->count, sizeof(char*));
+  pipeline.cache_hits = calloc(build_ctx->count, sizeof(bool));
+  pipeline.store_keys = calloc(build_ctx->count, sizeof(bool));
+  pipeline.cache_keys = calloc(build_ctx->count, sizeof(uint64_t));
+  if (build_ctx->count > 0 &&
+      (!pipeline.module_hir || !pipeline.object_paths || !pipeline.cache_hits ||
+       !pipeline.store_keys || !pipeline.cache_keys)) {
+    error_report_general(ERROR_SEVERITY_ERROR, "out of memory");
+    free(pipeline.module_hir);
+    free(pipeline.object_paths);
+    free(pipeline.cache_hits);
+    free(pipeline.store_keys);
+    free(pipeline.cache_keys);
+    process_pool_free(&assemblers);
+    return 1;
+  }
 
-    semantic_analyzer_t analyzer = {0};
-    analyzer.error_ctx = &unit->error_ctx;
-    analyzer.ast = &unit->program;
+  if (res->jobs > 1)
+    log_phase("jobs", "%d worker(s)", res->jobs);
 
-    if (!semantic_resolve_imports(&build_ctx, unit, &analyzer)) {
-      semantic_free_program_definition(&analyzer);
-      build_context_free(&build_ctx);
-      compiler_resources_free(res);
-      return 1;
-    }
+  int had_errors = 0;
+  bool scheduled = schedule_modules(
+      build_ctx, res->jobs, compile_module_job, &pipeline, &had_errors);
+  finish_nasm_jobs(&pipeline, &had_errors);
+  process_pool_free(&assemblers);
+
+  size_t cache_hit_count = 0;
+  for (size_t i = 0; i < build_ctx->count; ++i)
+    if (pipeline.cache_hits[i]) cache_hit_count++;
+  log_phase("cache", "%zu hit(s), %zu miss(es)",
+      cache_hit_count, build_ctx->count - cache_hit_count);
+
+  // hand every lowered function and object over in topo order so the link
+  // line does not depend on which worker finished first
+  for (size_t i = 0; i < build_ctx->count; ++i) {
+    da_foreach(IR_function_t*, fit, &pipeline.module_hir[i])
+      da_append(res->hir_program, *fit);
+    da_free(&pipeline.module_hir[i]);
+
+    if (pipeline.object_paths[i])
+      da_append(&object_files, pipeline.object_paths[i]);
+  }
+  free(pipeline.module_hir);
+  free(pipeline.object_paths);
+  free(pipeline.cache_hits);
+  free(pipeline.store_keys);
+  free(pipeline.cache_keys);
 
-    log_phase("semantic", "'%s' (module '%s')",
-        unit->file_path, unit->module_name ? unit->module_name : "-");
-    semantic_analyze(&analyzer);
+  if (!scheduled) had_errors = 1;
+
+  if (!had_errors && object_files.count > 0) {
+    const char* requested = res->output ? res->output : "a.out";
+    char output_path[512];
+    if (strchr(requested, '/') != NULL)
+      snprintf(output_path, sizeof(output_path), "%s", requested);
+    else
+      snprintf(
+          output_path, sizeof(output_path), "build/%s", requested);
 
-    if (analyzer.error_count > 0) {
+    if (!link_objects(&object_files, output_path))
       had_errors = 1;
-      semantic_free_program_definition(&analyzer);
-      continue;
-    }
+  }
 
-    HIR_parser_t hir_parser = {0};
-    hir_parser.error_ctx = &unit->error_ctx;
-    hir_parser.hir_program = res->hir_program;
-    hir_parser.struct_symbols = analyzer.struct_symbols;
-    hir_parser.current_module = unit->module_name;
-    HIR_PARSER_USE_RNG(hir_parser, &chunk_rng);
+  da_foreach(char*, oit, &object_files) free(*oit);
+  da_free(&object_files);
 
-    size_t hir_before = res->hir_program->count;
-    da_foreach(declaration_t*, dit, &unit->program) {
-      if (IR_lower_function(&hir_parser, *dit) != 0) {
-        error_report_general(
-            ERROR_SEVERITY_ERROR, "hir lowering error in '%s'", unit->file_path);
-        had_errors = 1;
-        break;
-      }
-    }
+  stats_report(stderr);
+  stats_free();
+  if (!trace_close()) had_errors = 1;
 
-    log_phase("hir", "'%s' (module '%s'): %zu function(s)",
-        unit->file_path, unit->module_name ? unit->module_name : "-",
-        res->hir_program->count - hir_before);
+  return had_errors ? 1 : 0;
+}
 
-    if (log_is_dump()) {
-      log_section_begin("HIR");
-      for (size_t i = hir_before; i < res->hir_program->count; ++i) {
-        char* hir_text = IR_generate_string_program(res->hir_program->items[i]);
-        fprintf(stderr, "%s", hir_text);
-        free(hir_text);
-      }
-      log_section_end();
-    }
+static bool start_reporting(compiler_resources_t* res)
+{
+  if (res->stats) stats_enable();
+  if (res->trace_path && !trace_open(res->trace_path)) {
+    error_report_general(ERROR_SEVERITY_ERROR, "out of memory");
+    return false;
+  }
+  return true;
+}
 
-    string_builder_t module_sb = {0};
-    if (unit->module_name) {
-      target->setup(&module_sb);
+static volatile sig_atomic_t _stop_requested = 0;
 
-      da_foreach(declaration_t*, dit2, &unit->program) {
-        declaration_t* decl = *dit2;
-        if (decl->type != DECLARATION_FUNC) continue;
+static void request_stop(int sig)
+{
+  (void) sig;
+  _stop_requested = 1;
+}
 
-        char* mangled =
-          IR_mangle_function_name(unit->module_name, decl->func.name);
-        if (!mangled) {
-          error_report_general(ERROR_SEVERITY_ERROR, "out of memory");
-          had_errors = 1;
-          continue;
-        }
+// Lets `serve` and `watch` clean up on SIGINT and SIGTERM. Without
+// SA_RESTART, the signal also interrupts whatever they are waiting on.
+static void catch_stop_signals(void)
+{
+  struct sigaction sa = {0};
+  sa.sa_handler = request_stop;
+  sigaction(SIGINT, &sa, NULL);
+  sigaction(SIGTERM, &sa, NULL);
+}
 
-        if (!decl->func.is_internal || strcmp(mangled, "start") == 0)
-          target->emit_global(&module_sb, mangled);
+// Runs compile_and_link in a child process and returns its status. The
+// analysis annotates the ASTs of `build_ctx`: units kept across builds
+// must come out of a build as they went in.
+static int build_in_child(
+    compiler_resources_t* res, build_context_t* build_ctx, const bool* reuse)
+{
+  fflush(NULL);
+  pid_t pid = fork();
+  if (pid == 0) {
+    int status = start_reporting(res)
+      ? compile_and_link(res, build_ctx, reuse) : 1;
+    fflush(NULL);
+    _exit(status);
+  }
 
-        free(mangled);
-      }
+  if (pid < 0) {
+    error_report_general(ERROR_SEVERITY_ERROR, "cannot fork the build");
+    return 1;
+  }
 
-      compiled_files_array externs_emitted = {0};
-      for (size_t i = hir_before; i < res->hir_program->count; ++i) {
-        IR_function_t* f = res->hir_program->items[i];
-        da_foreach(IR_instruction_t*, cit, f->code) {
-          if ((*cit)->kind != IR_CALL) continue;
-          const char* callee = (*cit)->func_name;
-
-          bool is_local = false;
-          for (size_t k = hir_before; k < res->hir_program->count; ++k) {
-            if (strcmp(res->hir_program->items[k]->name, callee) == 0) {
-              is_local = true;
-              break;
-            }
-          }
-          if (is_local) continue;
-
-          bool already_emitted = false;
-          da_foreach(char*, eit, &externs_emitted) {
-            if (strcmp(*eit, callee) == 0) {
-              already_emitted = true;
-              break;
-            }
-          }
-          if (already_emitted) continue;
-
-          target->emit_extern(&module_sb, callee);
-          da_append(&externs_emitted, strdup(callee));
-        }
-      }
-      da_foreach(char*, eit, &externs_emitted) free(*eit);
-      da_free(&externs_emitted);
-    }
+  int wstatus = 0;
+  while (waitpid(pid, &wstatus, 0) < 0) {
+    if (errno != EINTR) return 1;
+  }
+  return WIFEXITED(wstatus) ? WEXITSTATUS(wstatus) : 1;
+}
 
-    int codegen_error = 0;
-    for (size_t i = hir_before; i < res->hir_program->count; ++i) {
-      if (CODEGEN_write_function(&module_sb, res->hir_program->items[i], target) != 0) {
-        codegen_error = 1;
-        break;
-      }
-    }
+// One forwarded `cleaf build`, everything it prints goes to the client.
+// The tree is scanned again and the changed files reparsed here, so the
+// session keeps them warm for the next request.
+static int serve_build(build_session_t* session, server_request_t* req)
+{
+  fflush(NULL);
+  int saved_out = dup(STDOUT_FILENO);
+  int saved_err = dup(STDERR_FILENO);
+  dup2(req->fd, STDOUT_FILENO);
+  dup2(req->fd, STDERR_FILENO);
+
+  int status = 1;
+  compiler_resources_t* res = build_setup(req->argc, req->argv);
+  if (res) {
+    parse_jobs = res->jobs;
+    defer_bodies = true;
+    owned_sources = true;
+    long changed =
+      build_session_refresh(session, &res->files, load_module_unit);
+    if (changed >= 0)
+      log_phase("server", "%zu file(s), %ld reparsed or dropped",
+          session->count, changed);
+
+    build_context_t build_ctx = {0};
+    module_unit_array units = {0};
+    build_session_units(session, &units);
+
+    if (changed >= 0 && prepare_build(&build_ctx, &units, true))
+      status = build_in_child(res, &build_ctx, NULL);
+
+    da_free(&units);
+    build_context_free(&build_ctx);
+    compiler_resources_free(res);
+  }
 
-    log_phase("codegen", "'%s' (module '%s'): %zu byte(s) of assembly",
-        unit->file_path, unit->module_name ? unit->module_name : "-",
-        module_sb.count);
+  fflush(NULL);
+  dup2(saved_out, STDOUT_FILENO);
+  dup2(saved_err, STDERR_FILENO);
+  close(saved_out);
+  close(saved_err);
+  return status;
+}
 
-    if (codegen_error) {
+// `cleaf serve`: keeps the parsed modules of the tree between the builds
+// forwarded by `cleaf build --server`, until SIGINT or SIGTERM
+static int serve(int argc, char** argv)
+{
+  log_verbosity_t verbosity = LOG_SILENT;
+  for (int i = 2; i < argc; i++) {
+    if (strcmp(argv[i], "-v") == 0)
+      verbosity = LOG_VERBOSE;
+    else {
       error_report_general(
-          ERROR_SEVERITY_ERROR, "codegen error in '%s'", unit->file_path);
-      had_errors = 1;
-      da_free(&module_sb);
-      semantic_free_program_definition(&analyzer);
-      continue;
+          ERROR_SEVERITY_ERROR, "unknown flag '%s'", argv[i]);
+      fprintf(stderr, "usage: %s serve [-v]\n", argv[0]);
+      return 1;
     }
+  }
+  log_set_verbosity(verbosity);
 
-    char* base = build_object_basename(unit);
-    if (!base) {
-      error_report_general(ERROR_SEVERITY_ERROR, "out of memory");
-      had_errors = 1;
-      da_free(&module_sb);
-      semantic_free_program_definition(&analyzer);
-      continue;
-    }
+  int listen_fd = server_listen(SERVER_SOCKET_PATH);
+  if (listen_fd < 0) return 1;
 
-    char asm_path[512];
-    snprintf(asm_path, sizeof(asm_path), "build/%s.asm", base);
-    char* obj_path = malloc(strlen("build/") + strlen(base) + strlen(".o") + 1);
-    sprintf(obj_path, "build/%s.o", base);
-    free(base);
+  catch_stop_signals();
+  signal(SIGPIPE, SIG_IGN);
 
-    FILE* asm_f = fopen(asm_path, "wb");
-    if (!asm_f) {
-      error_report_general(
-          ERROR_SEVERITY_ERROR, "cannot write asm file '%s'", asm_path);
-      had_errors = 1;
-      free(obj_path);
-      da_free(&module_sb);
-      semantic_free_program_definition(&analyzer);
-      continue;
-    }
-    fwrite(module_sb.items, 1, module_sb.count, asm_f);
-    fclose(asm_f);
-    da_free(&module_sb);
+  log_phase("serve", "listening on '%s'", SERVER_SOCKET_PATH);
 
-    char nasm_cmd[1200];
-    snprintf(nasm_cmd, sizeof(nasm_cmd),
-        "nasm -f elf64 %s -o %s", asm_path, obj_path);
+  build_session_t session = {0};
+  while (!_stop_requested) {
+    server_request_t req;
+    if (!server_accept(listen_fd, &req)) continue;
 
-    log_phase("assemble", "'%s' -> '%s'", asm_path, obj_path);
+    double start_ms = trace_now_ms();
+    int status = serve_build(&session, &req);
+    log_set_verbosity(verbosity);
+    log_phase("served", "build %s in %.1f ms",
+        status == 0 ? "succeeded" : "failed", trace_now_ms() - start_ms);
 
-    if (system(nasm_cmd) != 0) {
-      error_report_general(
-          ERROR_SEVERITY_ERROR, 
-          "nasm failed to assemble '%s'", asm_path);
-      had_errors = 1;
-      free(obj_path);
-      semantic_free_program_definition(&analyzer);
-      continue;
-    }
+    server_finish(&req, status);
+  }
 
-    da_append(&object_files, obj_path);
+  close(listen_fd);
+  unlink(SERVER_SOCKET_PATH);
+  build_session_free(&session);
+  return 0;
+}
 
-    semantic_free_program_definition(&analyzer);
+// Topo indexes whose object can be reused as is: everything but the
+// modules reparsed by the last refresh and their dependents
+static bool* reusable_modules(
+    build_session_t* session, build_context_t* build_ctx)
+{
+  bool* dirty = calloc(build_ctx->count ? build_ctx->count : 1, sizeof(bool));
+  if (!dirty) return NULL;
+
+  da_foreach(session_entry_t, it, session) {
+    if (!it->reloaded) continue;
+    for (size_t i = 0; i < build_ctx->count; ++i)
+      if (build_ctx->items[i] == it->unit) dirty[i] = true;
   }
+  dep_graph_mark_dependents(build_ctx, dirty);
 
-  if (!had_errors && object_files.count > 0) {
-    string_builder_t link_cmd = {0};
-    sb_append_fmt(&link_cmd, "ld");
-    da_foreach(char*, oit, &object_files) {
-      sb_append_fmt(&link_cmd, " %s", *oit);
+  size_t rebuilt = 0;
+  for (size_t i = 0; i < build_ctx->count; ++i) {
+    if (dirty[i]) rebuilt++;
+    dirty[i] = !dirty[i];
+  }
+  log_phase("watch", "%zu of %zu module(s) affected",
+      rebuilt, build_ctx->count);
+  return dirty;
+}
+
+// `cleaf build --watch`: builds, then waits for the sources to change and
+// builds again, until SIGINT or SIGTERM. Parsed modules are kept between
+// builds like `cleaf serve` does.
+static int watch(compiler_resources_t* res)
+{
+  watcher_t watcher;
+  if (!watcher_init(&watcher)) return 1;
+  catch_stop_signals();
+  owned_sources = true;
+
+  build_session_t session = {0};
+  bool rescan = true;
+  bool first = true;
+  bool last_ok = false;
+  int status = 0;
+
+  for (;;) {
+    if (rescan) {
+      // also picks up the directories created since the last scan
+      compiled_files_array dirs = {0};
+      da_foreach(char*, it, &res->files) free(*it);
+      da_free(&res->files);
+      res->files = find_source_files(&dirs);
+      bool watched = watcher_add_dirs(&watcher, &dirs);
+      da_foreach(char*, it, &dirs) free(*it);
+      da_free(&dirs);
+      if (!watched) {
+        status = 1;
+        break;
+      }
     }
 
-    const char* requested = res->output ? res->output : "a.out";
-    char output_path[512];
-    if (strchr(requested, '/') != NULL)
-      snprintf(output_path, sizeof(output_path), "%s", requested);
-    else
-      snprintf(
-          output_path, sizeof(output_path), "build/%s", requested);
+    long changed =
+      build_session_refresh(&session, &res->files, load_module_unit);
+
+    if (changed != 0 || first) {
+      first = false;
+      status = 1;
+      if (changed >= 0) {
+        build_context_t build_ctx = {0};
+        module_unit_array units = {0};
+        build_session_units(&session, &units);
+
+        if (prepare_build(&build_ctx, &units, true)) {
+          // a vanished file may have held part of a module, everything is
+          // checked against the cache then
+          size_t reloaded = 0;
+          da_foreach(session_entry_t, it, &session)
+            if (it->reloaded) reloaded++;
+          bool* reuse = last_ok && (long) reloaded == changed
+            ? reusable_modules(&session, &build_ctx) : NULL;
+
+          status = build_in_child(res, &build_ctx, reuse);
+          free(reuse);
+        }
 
-    sb_append_fmt(&link_cmd, " -o %s", output_path);
+        da_free(&units);
+        build_context_free(&build_ctx);
+      }
+      last_ok = status == 0;
+      error_report_general(ERROR_SEVERITY_NOTE,
+          "build %s, watching for changes", last_ok ? "succeeded" : "failed");
+    }
 
-    log_phase("link", "%zu object file(s) -> '%s'",
-        object_files.count, output_path);
+    watch_event_t event = watcher_wait(&watcher, WATCH_DEBOUNCE_MS);
+    if (event == WATCH_STOPPED || _stop_requested) break;
+    rescan = event == WATCH_TREE_CHANGED;
+  }
 
-    if (system(link_cmd.items) != 0) {
-      error_report_general(ERROR_SEVERITY_ERROR, "linking failed");
-      had_errors = 1;
+  watcher_free(&watcher);
+  build_session_free(&session);
+  return status;
+}
+
+int main(int argc, char** argv) 
+{
+  if (argc > 1 && strcmp(argv[1], "serve") == 0)
+    return serve(argc, argv);
+
+  int is_build_mode = (argc > 1 && strcmp(argv[1], "build") == 0);
+
+  if (is_build_mode) {
+    // hand the build to `cleaf serve` when one runs for this tree, the
+    // flag itself is ignored by build_setup on a local build
+    char** forwarded = calloc(argc + 1, sizeof(char*));
+    int forwarded_count = 0;
+    bool use_server = false;
+    for (int i = 0; forwarded && i < argc; i++) {
+      if (strcmp(argv[i], "--server") == 0) use_server = true;
+      else forwarded[forwarded_count++] = argv[i];
     }
 
-    da_free(&link_cmd);
+    int status = -1;
+    if (use_server && forwarded)
+      status = server_forward(SERVER_SOCKET_PATH, forwarded_count, forwarded);
+    free(forwarded);
+    if (status >= 0) return status;
+    if (use_server)
+      error_report_general(ERROR_SEVERITY_NOTE,
+          "no compile server on '%s', building locally", SERVER_SOCKET_PATH);
   }
 
-  da_foreach(char*, oit, &object_files) free(*oit);
-  da_free(&object_files);
+  compiler_resources_t* res = NULL;
+  if (is_build_mode) {
+    res = build_setup(argc, argv);
+  } else {
+    res = single_file_setup(argc, argv);  
+  }
+
+  if (!res) return 1;
+  parse_jobs = res->jobs;
+  defer_bodies = is_build_mode;
+  if (res->watch) {
+    int status = watch(res);
+    compiler_resources_free(res);
+    return status;
+  }
+  if (!start_reporting(res)) {
+    compiler_resources_free(res);
+    return 1;
+  }
+
+  log_phase("compiling", "%zu file(s)", res->files.count);
+
+  da_foreach(char*, it, &res->files) {
+    module_unit_t* unit = load_module_unit(*it);
+    if (!unit) {
+      compiler_resources_free(res);
+      return 1;
+    }
+    da_append(&res->units, unit);
+  }
+
+  build_context_t build_ctx = {0};
+  int status = prepare_build(&build_ctx, &res->units, is_build_mode)
+    ? compile_and_link(res, &build_ctx, NULL) : 1;
 
   build_context_free(&build_ctx);
   compiler_resources_free(res);
-  return had_errors ? 1 : 0;
+  return status;
 }
-
@@ -0,0 +1,171 @@
+#include "compiler/build/build_cache.h"
+#include "frontend/symbols.h"
+
+#include <errno.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <sys/stat.h>
+
+#define FNV_OFFSET 0xcbf29ce484222325ULL
+#define FNV_PRIME  0x100000001b3ULL
+
+static uint64_t hash_bytes(uint64_t h, const void* data, size_t len)
+{
+  const unsigned char* p = (const unsigned char*) data;
+  for (size_t i = 0; i < len; ++i) {
+    h ^= p[i];
+    h *= FNV_PRIME;
+  }
+  return h;
+}
+
+// strings are hashed with their terminator so that ("ab", "c") and
+// ("a", "bc") do not collide
+static uint64_t hash_string(uint64_t h, const char* s)
+{
+  if (!s) return hash_bytes(h, "", 1);
+  return hash_bytes(h, s, strlen(s) + 1);
+}
+
+static uint64_t hash_u64(uint64_t h, uint64_t v)
+{
+  return hash_bytes(h, &v, sizeof(v));
+}
+
+static uint64_t hash_type(uint64_t h, const known_type_t* t)
+{
+  h = hash_u64(h, (uint64_t) t->kind);
+  h = hash_u64(h, t->size);
+  h = hash_u64(h, t->element_size);
+  h = hash_u64(h, t->array_len);
+  return hash_string(h, t->kind == TYPE_CUSTOM ? t->name : NULL);
+}
+
+// walks the declarations rather than the hashmap buckets so that the
+// result only depends on what the module exports, in source order
+static uint64_t hash_exports(uint64_t h, module_unit_t* dep)
+{
+  h = hash_string(h, dep->module_name);
+
+  da_foreach(declaration_t*, it, &dep->program) {
+    declaration_t* decl = *it;
+    if (decl->type != DECLARATION_FUNC) continue;
+
+    function_symbol_t* fs =
+      (function_symbol_t*) hashmap_get(dep->export_funcs, decl->func.name);
+    if (!fs) continue;
+
+    h = hash_string(h, decl->func.name);
+    h = hash_type(h, &fs->return_type);
+    h = hash_u64(h, fs->params_count);
+    for (size_t i = 0; i < fs->params_count; ++i) {
+      h = hash_string(h, atom_str(fs->params_atom[i]));
+      h = hash_type(h, &fs->params_type[i].type);
+      h = hash_u64(h, fs->params_type[i].is_constant);
+    }
+  }
+
+  return h;
+}
+
+static uint64_t hash_file(uint64_t h, FILE* f)
+{
+  unsigned char buf[65536];
+  size_t n;
+  while ((n = fread(buf, 1, sizeof(buf), f)) > 0)
+    h = hash_bytes(h, buf, n);
+  return h;
+}
+
+uint64_t build_cache_compiler_id(void)
+{
+  static bool computed = false;
+  static uint64_t id;
+  if (computed) return id;
+
+  id = hash_string(FNV_OFFSET, CLEAF_VERSION);
+  bool read = false;
+  FILE* exe = fopen("/proc/self/exe", "rb");
+  if (exe) {
+    uint64_t h = hash_file(id, exe);
+    read = !ferror(exe);
+    if (read) id = h;
+    fclose(exe);
+  }
+  if (!read)
+    id = hash_string(id, __DATE__ " " __TIME__);
+
+  computed = true;
+  return id;
+}
+
+uint64_t build_cache_key(module_unit_t* unit, const char* backend,
+    uint64_t compiler_id)
+{
+  uint64_t h = FNV_OFFSET;
+
+  h = hash_u64(h, compiler_id);
+  h = hash_string(h, backend);
+  h = hash_string(h, unit->module_name);
+  h = hash_u64(h, (uint64_t) unit->source_len);
+  h = hash_bytes(h, unit->source, unit->source_len);
+
+  h = hash_u64(h, unit->deps.count);
+  da_foreach(module_unit_t*, it, &unit->deps)
+    h = hash_exports(h, *it);
+
+  return h;
+}
+
+static void key_path(char* out, size_t size, const char* base)
+{
+  snprintf(out, size, BUILD_CACHE_DIR "/%s.key", base);
+}
+
+bool build_cache_lookup(const char* base, uint64_t key)
+{
+  char path[512];
+  snprintf(path, sizeof(path), "build/%s.o", base);
+
+  struct stat st;
+  if (stat(path, &st) != 0) return false;
+
+  key_path(path, sizeof(path), base);
+  FILE* f = fopen(path, "rb");
+  if (!f) return false;
+
+  uint64_t stored = 0;
+  int read = fscanf(f, "%" SCNx64, &stored);
+  fclose(f);
+
+  return read == 1 && stored == key;
+}
+
+bool build_cache_store(const char* base, uint64_t key)
+{
+  if (mkdir(BUILD_CACHE_DIR, 0755) != 0 && errno != EEXIST)
+    return false;
+
+  char path[512];
+  char tmp_path[520];
+  key_path(path, sizeof(path), base);
+  snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path);
+
+  FILE* f = fopen(tmp_path, "wb");
+  if (!f) return false;
+  fprintf(f, "%016" PRIx64 "\n", key);
+  if (fclose(f) != 0) {
+    remove(tmp_path);
+    return false;
+  }
+
+  // rename keeps the entry valid or absent, never half written
+  return rename(tmp_path, path) == 0;
+}
+
+void build_cache_invalidate(const char* base)
+{
+  char path[512];
+  key_path(path, sizeof(path), base);
+  remove(path);
+}
@@ -0,0 +1,37 @@
+#ifndef BUILD_CACHE_H
+#define BUILD_CACHE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "compiler/definition/compiler_definition.h"
+
+// Bump whenever the generated code changes for the same input
+#define CLEAF_VERSION "0.1.0"
+
+#define BUILD_CACHE_DIR "build/.cache"
+
+// Identity of the running compiler: a hash of its executable, so that
+// any rebuild of cleaf misses the objects of the previous one. Falls back
+// to CLEAF_VERSION and the build date when the executable can't be read.
+// Computed by the first call, which must happen before any worker thread
+// starts.
+uint64_t build_cache_compiler_id(void);
+
+// Key of the object produced for `unit`: its source bytes, the export
+// signatures of every module it imports, the `compiler_id` and the
+// `backend` that produces the object.
+// Export tables of the unit dependencies must be built beforehand.
+uint64_t build_cache_key(module_unit_t* unit, const char* backend,
+    uint64_t compiler_id);
+
+// True when `build/<base>.o` exists and was produced for `key`
+bool build_cache_lookup(const char* base, uint64_t key);
+
+// Records that `build/<base>.o` now matches `key`
+bool build_cache_store(const char* base, uint64_t key);
+
+// Forgets the key of `build/<base>.o`, called before it is rebuilt so that
+// a failed build never leaves a stale entry behind
+void build_cache_invalidate(const char* base);
+
+#endif // BUILD_CACHE_H
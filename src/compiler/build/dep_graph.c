@@ -6,10 +6,18 @@ static void dep_graph_free(dep_graph_t* graph)
     da_free(it);
   }
   da_free(graph);
-  if (graph->index) {
-    hashmap_free(graph->index, 0);
-    free(graph->index);
-    graph->index = NULL;
+  atom_map_free(&graph->index, 0);
+}
+
+static void add_unit_deps(module_unit_t* unit, module_unit_array* imported)
+{
+  da_foreach(module_unit_t*, it, imported) {
+    bool known = false;
+    da_foreach(module_unit_t*, dit, &unit->deps) {
+      if (*dit == *it) { known = true; break; }
+    }
+    if (!known && *it != unit)
+      da_append(&unit->deps, *it);
   }
 }
 
@@ -32,7 +40,7 @@ static void topo_visit(build_context_t* ctx, dep_node_t* node, bool* had_cycle)
   }
 
   node->color = BLACK;
-  module_unit_array* arr = hashmap_get(ctx->registry, node->module_name);
+  module_unit_array* arr = atom_map_get(ctx->registry, node->module_atom);
   if (arr) {
     da_foreach(module_unit_t*, it, arr) {
       da_append(ctx, (*it));
@@ -44,84 +52,91 @@ bool build_dep_graph(build_context_t* ctx)
 {
   dep_graph_t graph = {0};
 
-  graph.index = calloc(1, sizeof(hashmap_t));
-  if (!graph.index) {
-    error_report_general(ERROR_SEVERITY_ERROR, "out of memory");
-    return false;
+  atom_map_foreach(e, ctx->registry) {
+    dep_node_t node = {0};
+    node.module_name = atom_str(e->key);
+    node.module_atom = e->key;
+    node.color = WHITE;
+
+    da_append(&graph, node);
   }
 
-  for (size_t i = 0; i < HASH_SIZE; ++i) {
-    hashmap_entry_t* e = ctx->registry->buckets[i]; 
+  da_foreach(dep_node_t, it, &graph) {
+    if (!atom_map_put(&graph.index, it->module_atom, it)) {
+      error_report_general(ERROR_SEVERITY_ERROR, "out of memory");
+      dep_graph_free(&graph);
+      return false;
+    }
+  }
 
-    while (e) {
-      dep_node_t node = {0};
-      node.module_name = e->key;
-      node.color = WHITE;
+  atom_map_foreach(e, ctx->registry) {
+    module_unit_array* mod = (module_unit_array*) e->value;
 
-      da_append(&graph, node);
+    da_foreach(module_unit_t*, it, mod) {
+      module_unit_t* unit = (*it);
+      
+      da_foreach(declaration_t*, it, &unit->program) {
+        declaration_t* decl = (*it);
 
-      e = e->next;
-    } 
-  }
+        if (decl->type != DECLARATION_IMPORT)
+          continue;
 
-  da_foreach(dep_node_t, it, &graph) {
-    hashmap_put(graph.index, it->module_name, it); 
-  }
+        char* import_name = calloc(255, sizeof(char));
+        if (!import_name) { dep_graph_free(&graph); return false; }
 
-  for (size_t i = 0; i < HASH_SIZE; ++i) {
-    hashmap_entry_t* e = ctx->registry->buckets[i];
-    while (e) {
-      module_unit_array* mod = (module_unit_array*) e->value;
-
-      da_foreach(module_unit_t*, it, mod) {
-        module_unit_t* unit = (*it);
-        
-        da_foreach(declaration_t*, it, &unit->program) {
-          declaration_t* decl = (*it);
-
-          if (decl->type != DECLARATION_IMPORT)
-            continue;
-
-          char* import_name = calloc(255, sizeof(char));
-          if (!import_name) { dep_graph_free(&graph); return false; }
-
-          for (size_t j = 0; j < decl->import.path.count - 1; ++j) {
-            if (import_name[0] == '\0') {
-              strcpy(import_name, decl->import.path.items[j]);
-            }
-            else {
-              strcat(strcat(import_name, "::"), decl->import.path.items[j]);
-            }
+        for (size_t j = 0; j < decl->import.path.count - 1; ++j) {
+          if (import_name[0] == '\0') {
+            strcpy(import_name, decl->import.path.items[j]);
           }
-
-          dep_node_t* src_node =
-            hashmap_get(graph.index, unit->module_name);
-          dep_node_t* dst_node  = 
-            hashmap_get(graph.index, import_name);
-
-          if (!dst_node) {
-            error_report_general(ERROR_SEVERITY_ERROR, 
-               "unkown imported module %s\n", import_name); 
-            free(import_name);
-            dep_graph_free(&graph);
-            return false;
+          else {
+            strcat(strcat(import_name, "::"), decl->import.path.items[j]);
           }
+        }
 
-          da_append(src_node, dst_node);
+        atom_t import_atom = intern_cstr(import_name);
+        dep_node_t* src_node =
+          atom_map_get(&graph.index, unit->module_atom);
+        dep_node_t* dst_node  = 
+          atom_map_get(&graph.index, import_atom);
+
+        if (!dst_node) {
+          error_report_general(ERROR_SEVERITY_ERROR, 
+             "unkown imported module %s\n", import_name); 
           free(import_name);
+          dep_graph_free(&graph);
+          return false;
         }
+
+        da_append(src_node, dst_node);
+        add_unit_deps(unit, atom_map_get(ctx->registry, import_atom));
+        free(import_name);
       }
-       
-      e = e->next;
     }
   }
 
   bool had_cycle = false;
+  atom_t main_atom = intern_cstr("main");
   da_foreach(dep_node_t, it, &graph) {
-    if (strcmp(it->module_name, "main") == 0) 
+    if (it->module_atom == main_atom)
       topo_visit(ctx, it, &had_cycle);
   }
 
   dep_graph_free(&graph);
   return !had_cycle;
 }
+
+void dep_graph_mark_dependents(build_context_t* ctx, bool* dirty)
+{
+  // the topo order puts every module after the ones it imports, a single
+  // pass also reaches the dependents of dependents
+  hashmap_t marked = {0};
+  for (size_t i = 0; i < ctx->count; ++i) {
+    module_unit_t* unit = ctx->items[i];
+    da_foreach(module_unit_t*, it, &unit->deps) {
+      if (dirty[i]) break;
+      if (hashmap_get(&marked, (*it)->file_path)) dirty[i] = true;
+    }
+    if (dirty[i]) hashmap_put(&marked, unit->file_path, unit);
+  }
+  hashmap_free(&marked, 0);
+}
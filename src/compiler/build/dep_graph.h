@@ -14,7 +14,8 @@ typedef enum {
 } visit_color_t;
 
 typedef struct dep_node_t {
-  char*                  module_name; // not owned
+  const char*            module_name; // interned
+  atom_t                 module_atom;
   visit_color_t          color;
   struct dep_node_t**    items;    // act as 'arcs'
   size_t                 count;    // we use items, count, capacity
@@ -25,9 +26,13 @@ typedef struct {
   dep_node_t* items;
   size_t      count;
   size_t      capacity;
-  hashmap_t*  index;
+  atom_map_t  index; // node per module atom
 } dep_graph_t;
 
 bool build_dep_graph(build_context_t* ctx);
 
+// `dirty` holds one flag per topo index of `ctx`: every module importing,
+// directly or not, a module already flagged gets flagged too
+void dep_graph_mark_dependents(build_context_t* ctx, bool* dirty);
+
 #endif // DEP_GRAPH_H
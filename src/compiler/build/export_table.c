@@ -25,26 +25,37 @@ bool semantic_build_export_table(module_unit_t* unit)
     fs->params_count = decl->func.params.count;
 
     if (fs->params_count > 0) {
-      fs->params_name = calloc(fs->params_count, sizeof(char*));
+      fs->params_atom = calloc(fs->params_count, sizeof(atom_t));
       fs->params_type = 
         calloc(fs->params_count, sizeof(variable_symbol_t));
 
-      if (!fs->params_name || !fs->params_type) {
+      if (!fs->params_atom || !fs->params_type) {
         error_report_general(ERROR_SEVERITY_ERROR, "out of memory");
-        free(fs->params_name);
+        free(fs->params_atom);
         free(fs->params_type);
         free(fs);
         return false;
       }
       for (size_t i = 0; i < fs->params_count; ++i) {
-        fs->params_name[i] = decl->func.params.items[i].ident_name;
+        fs->params_atom[i] = decl->func.params.items[i].atom;
         fs->params_type[i].type = decl->func.params.items[i].type;
         fs->params_type[i].is_constant = 
           decl->func.params.items[i].is_constant;
       }
     }
 
-    hashmap_put(unit->export_funcs, decl->func.name, fs);
+    // a function defined twice keeps its first definition, the semantic
+    // pass of this module reports the second one
+    int put = hashmap_put_new(unit->export_funcs, decl->func.name, fs);
+    if (put != 1) {
+      free(fs->params_atom);
+      free(fs->params_type);
+      free(fs);
+      if (put == 0) {
+        error_report_general(ERROR_SEVERITY_ERROR, "out of memory");
+        return false;
+      }
+    }
   }
 
   return true;
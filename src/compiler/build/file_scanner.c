@@ -1,7 +1,7 @@
 #include "compiler/build/file_scanner.h"
 
 bool read_files_in_dir(
-    compiled_files_array* files, char* path)
+    compiled_files_array* files, compiled_files_array* dirs, char* path)
 {
   DIR* dir;
   struct dirent* entry;
@@ -10,6 +10,8 @@ bool read_files_in_dir(
     return false; 
   }
 
+  if (dirs) da_append(dirs, strdup(path));
+
   while((entry = readdir(dir)) != NULL) {
     if (entry->d_type == 8) {
       char* extension = strrchr(entry->d_name, '.');
@@ -44,7 +46,7 @@ bool read_files_in_dir(
             strlen(path) + strlen(entry->d_name) + 2, sizeof(char)); 
 
       read_files_in_dir(
-          files, 
+          files, dirs,
           strcat(strcat(strcpy(new, path), "/"), entry->d_name));
     }
   }
@@ -54,13 +56,13 @@ bool read_files_in_dir(
   return true;
 }
 
-compiled_files_array find_source_files()
+compiled_files_array find_source_files(compiled_files_array* dirs)
 {
   compiled_files_array files = {0};
 
   char* path = calloc(2, sizeof(char));
   path = strcpy(path, ".");
-  if(!read_files_in_dir(&files, path)) {
+  if(!read_files_in_dir(&files, dirs, path)) {
     return files; 
   }
 
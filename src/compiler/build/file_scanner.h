@@ -6,8 +6,10 @@
 
 #include "compiler/definition/compiler_definition.h"
 
-compiled_files_array find_source_files();
+// Every .clf file under the current directory. When `dirs` is not NULL,
+// the directories that were traversed are appended to it (owned strings).
+compiled_files_array find_source_files(compiled_files_array* dirs);
 bool read_files_in_dir(
-    compiled_files_array* files, char* path);
+    compiled_files_array* files, compiled_files_array* dirs, char* path);
 
 #endif // BUILD_SCANNER_H
@@ -88,7 +88,8 @@ bool semantic_resolve_imports(
     }
 
     module_unit_array* target_units =
-      (module_unit_array*) hashmap_get(ctx->registry, module_name);
+      (module_unit_array*) atom_map_get(
+          ctx->registry, intern_cstr(module_name));
 
     if (!target_units || target_units->count == 0) {
       semantic_error_register(analyzer, decl->source_pos - 1,
@@ -124,17 +125,35 @@ bool semantic_resolve_imports(
     const char* local_name =
       decl->import.alias ? decl->import.alias : symbol_name;
 
-    hashmap_put(analyzer->imported_functions, local_name, isym);
+    da_append(&analyzer->imported_owned, isym);
+
+    int put =
+      hashmap_put_new(analyzer->imported_functions, local_name, isym);
+    if (put == 0) {
+      error_report_general(ERROR_SEVERITY_ERROR, "out of memory");
+      return false;
+    }
+    if (put == 2) {
+      semantic_error_register(analyzer, decl->source_pos - 1,
+          "imported name already used by another import");
+      continue;
+    }
 
+    // the same `qualifier::symbol` imported twice under different aliases
+    // resolves to the first import
     size_t qk_len = strlen(qualifier) + 2 + strlen(symbol_name) + 1;
     char* qualified_key = malloc(qk_len);
-    if (qualified_key) {
-      snprintf(qualified_key, qk_len, "%s::%s", qualifier, symbol_name);
-      hashmap_put(analyzer->imported_functions, qualified_key, isym);
-      free(qualified_key);
+    if (!qualified_key) {
+      error_report_general(ERROR_SEVERITY_ERROR, "out of memory");
+      return false;
+    }
+    snprintf(qualified_key, qk_len, "%s::%s", qualifier, symbol_name);
+    put = hashmap_put_new(analyzer->imported_functions, qualified_key, isym);
+    free(qualified_key);
+    if (put == 0) {
+      error_report_general(ERROR_SEVERITY_ERROR, "out of memory");
+      return false;
     }
-
-    da_append(&analyzer->imported_owned, isym);
   }
 
   return true;
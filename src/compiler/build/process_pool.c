@@ -0,0 +1,219 @@
+#include "compiler/build/process_pool.h"
+#define DA_LIB_IMPLEMENTATION
+#include "thirdparty/da.h"
+#include "thirdparty/error.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <spawn.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+extern char** environ;
+
+void process_pool_init(process_pool_t* pool, int limit)
+{
+  memset(pool, 0, sizeof(*pool));
+  pool->limit = limit < 1 ? 1 : limit;
+  pthread_mutex_init(&pool->lock, NULL);
+}
+
+static double monotonic_ms(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double) ts.tv_sec * 1e3 + (double) ts.tv_nsec / 1e6;
+}
+
+static char** copy_argv(const char* const* argv)
+{
+  size_t count = 0;
+  while (argv[count]) count++;
+
+  char** copy = calloc(count + 1, sizeof(char*));
+  if (!copy) return NULL;
+  for (size_t i = 0; i < count; ++i) {
+    copy[i] = strdup(argv[i]);
+    if (!copy[i]) {
+      for (size_t j = 0; j < i; ++j) free(copy[j]);
+      free(copy);
+      return NULL;
+    }
+  }
+  return copy;
+}
+
+static void job_collect_stderr(process_job_t* job)
+{
+  if (!job->err_file) return;
+
+  FILE* f = job->err_file;
+  job->err_file = NULL;
+  fflush(f);
+  rewind(f);
+
+  char buf[4096];
+  size_t n;
+  while ((n = fread(buf, 1, sizeof(buf), f)) > 0) {
+    char* grown = realloc(job->err, job->err_len + n);
+    if (!grown) break;
+    memcpy(grown + job->err_len, buf, n);
+    job->err = grown;
+    job->err_len += n;
+  }
+  fclose(f);
+}
+
+// Reaps one child, must be called with the lock held.
+// Returns false when there was nothing to reap (WNOHANG).
+static bool pool_reap(process_pool_t* pool, int options)
+{
+  int status = 0;
+  struct rusage usage = {0};
+  pid_t pid;
+  do {
+    pid = wait4(-1, &status, options, &usage);
+  } while (pid < 0 && errno == EINTR);
+
+  if (pid == 0) return false;
+
+  if (pid < 0) {
+    // our children were reaped behind our back, do not wait forever
+    da_foreach(process_job_t*, it, pool) {
+      if ((*it)->done) continue;
+      (*it)->done = true;
+      job_collect_stderr(*it);
+    }
+    pool->running = 0;
+    return false;
+  }
+
+  da_foreach(process_job_t*, it, pool) {
+    process_job_t* job = *it;
+    if (job->done || job->pid != pid) continue;
+    job->done = true;
+    job->exit_status = WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+    job->wall_ms = monotonic_ms() - job->start_ms;
+    job->cpu_ms =
+      (usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1e3 +
+      (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e3;
+    job_collect_stderr(job);
+    pool->running--;
+    break;
+  }
+  return true;
+}
+
+static bool job_spawn(process_job_t* job)
+{
+  job->err_file = tmpfile();
+  if (job->err_file)
+    fcntl(fileno(job->err_file), F_SETFD, FD_CLOEXEC);
+
+  posix_spawn_file_actions_t actions;
+  posix_spawn_file_actions_init(&actions);
+  if (job->err_file)
+    posix_spawn_file_actions_adddup2(
+        &actions, fileno(job->err_file), STDERR_FILENO);
+
+  int rc = posix_spawnp(
+      &job->pid, job->argv[0], &actions, NULL, job->argv, environ);
+  posix_spawn_file_actions_destroy(&actions);
+  job->start_ms = monotonic_ms();
+
+  if (rc != 0) {
+    error_report_general(ERROR_SEVERITY_ERROR,
+        "cannot run '%s': %s", job->argv[0], strerror(rc));
+    job->done = true;
+    if (job->err_file) fclose(job->err_file);
+    job->err_file = NULL;
+    return false;
+  }
+  return true;
+}
+
+bool process_pool_submit(
+    process_pool_t* pool, const char* const* argv, size_t index)
+{
+  process_job_t* job = calloc(1, sizeof(process_job_t));
+  char** copy = job ? copy_argv(argv) : NULL;
+  if (!copy) {
+    free(job);
+    error_report_general(ERROR_SEVERITY_ERROR, "out of memory");
+    return false;
+  }
+  job->argv = copy;
+  job->index = index;
+  job->exit_status = -1;
+
+  pthread_mutex_lock(&pool->lock);
+  while (pool_reap(pool, WNOHANG)) {}
+  while (pool->running >= (size_t) pool->limit)
+    pool_reap(pool, 0);
+
+  da_append(pool, job);
+  bool spawned = job_spawn(job);
+  if (spawned) pool->running++;
+  pthread_mutex_unlock(&pool->lock);
+
+  return spawned;
+}
+
+static int compare_jobs(const void* a, const void* b)
+{
+  const process_job_t* ja = *(process_job_t* const*) a;
+  const process_job_t* jb = *(process_job_t* const*) b;
+  return (ja->index > jb->index) - (ja->index < jb->index);
+}
+
+void process_pool_wait(process_pool_t* pool)
+{
+  pthread_mutex_lock(&pool->lock);
+  while (pool->running > 0)
+    pool_reap(pool, 0);
+  if (pool->count > 1)
+    qsort(pool->items, pool->count, sizeof(process_job_t*), compare_jobs);
+  pthread_mutex_unlock(&pool->lock);
+}
+
+void process_job_replay(const process_job_t* job)
+{
+  if (job->err_len == 0) return;
+  fwrite(job->err, 1, job->err_len, stderr);
+  fflush(stderr);
+}
+
+void process_pool_free(process_pool_t* pool)
+{
+  da_foreach(process_job_t*, it, pool) {
+    process_job_t* job = *it;
+    for (char** arg = job->argv; *arg; ++arg) free(*arg);
+    free(job->argv);
+    if (job->err_file) fclose(job->err_file);
+    free(job->err);
+    free(job);
+  }
+  da_free(pool);
+  pthread_mutex_destroy(&pool->lock);
+}
+
+int process_run(const char* const* argv)
+{
+  process_pool_t pool;
+  process_pool_init(&pool, 1);
+
+  int status = -1;
+  if (process_pool_submit(&pool, argv, 0)) {
+    process_pool_wait(&pool);
+    process_job_replay(pool.items[0]);
+    status = pool.items[0]->exit_status;
+  }
+
+  process_pool_free(&pool);
+  return status;
+}
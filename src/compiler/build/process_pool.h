@@ -0,0 +1,58 @@
+#ifndef PROCESS_POOL_H
+#define PROCESS_POOL_H
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <sys/types.h>
+
+// An external tool run (nasm, ld, ...) spawned without a shell
+typedef struct {
+  char**  argv;        // owned, NULL terminated
+  size_t  index;       // reporting order, the topo index for module jobs
+  pid_t   pid;
+  int     exit_status; // -1 when it could not be spawned or was killed
+  bool    done;
+  double  start_ms;    // CLOCK_MONOTONIC when spawned
+  double  wall_ms;     // spawn to reap, reaping may lag behind the exit
+  double  cpu_ms;      // user + system time of the process
+
+  // stderr of the process, buffered so it is replayed in `index` order
+  FILE*   err_file;
+  char*   err;
+  size_t  err_len;
+} process_job_t;
+
+typedef struct {
+  process_job_t** items;
+  size_t          count;
+  size_t          capacity;
+
+  int             limit;   // max number of processes alive at once
+  size_t          running;
+  pthread_mutex_t lock;
+} process_pool_t;
+
+void process_pool_init(process_pool_t* pool, int limit);
+
+// Spawns `argv[0]` (looked up in PATH) with the given arguments, blocking
+// while `limit` processes are already running. Safe to call from several
+// threads. Returns false when the process could not be spawned, the job is
+// still recorded with an exit status of -1.
+bool process_pool_submit(
+    process_pool_t* pool, const char* const* argv, size_t index);
+
+// Waits for every submitted process, then sorts the jobs by `index`
+void process_pool_wait(process_pool_t* pool);
+
+// Writes the buffered stderr of `job` to stderr
+void process_job_replay(const process_job_t* job);
+
+void process_pool_free(process_pool_t* pool);
+
+// Runs a single process to completion and replays its stderr.
+// Returns its exit status, -1 when it could not be spawned.
+int process_run(const char* const* argv);
+
+#endif // PROCESS_POOL_H
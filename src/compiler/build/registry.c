@@ -30,18 +30,23 @@ bool populate_module_registry(
     char* key = build_module_key(d);
     if (!key) return false;
 
-    unit->module_name = strdup(key);
-    if (!unit->module_name) { free(key); return false; }
+    // a unit kept from an earlier build is registered again
+    free(unit->module_name);
+    unit->module_name = key;
+    unit->module_atom = intern_cstr(key);
+    if (unit->module_atom == ATOM_NONE) return false;
 
-    module_unit_array* arr = hashmap_get(ctx->registry, key);
+    module_unit_array* arr = atom_map_get(ctx->registry, unit->module_atom);
     if (!arr) {
       arr = calloc(1, sizeof(module_unit_array));
-      if (!arr) { free(key); return false; }
-      hashmap_put(ctx->registry, key, arr);
+      if (!arr) return false;
+      if (!atom_map_put(ctx->registry, unit->module_atom, arr)) {
+        free(arr);
+        return false;
+      }
     }
 
     da_append(arr, unit);
-    free(key);
     return true;
   }
 
@@ -0,0 +1,235 @@
+#include "compiler/build/scheduler.h"
+#include "thirdparty/log.h"
+
+#include <pthread.h>
+
+typedef enum {
+  SLOT_PENDING,
+  SLOT_RUNNING,
+  SLOT_DONE,
+} slot_state_t;
+
+typedef struct {
+  size_t* items; // indices of the units waiting on this one
+  size_t  count;
+  size_t  capacity;
+} dependents_t;
+
+typedef struct {
+  slot_state_t        state;
+  module_job_status_t status;
+  size_t              pending_deps;
+  dependents_t        dependents;
+
+  // buffered diagnostics, replayed in topo order
+  char*               output;
+  size_t              output_len;
+} job_slot_t;
+
+typedef struct {
+  build_context_t* ctx;
+  module_job_fn    fn;
+  void*            user;
+
+  job_slot_t*      slots;
+  size_t           running;
+  size_t           next_flush;
+  bool             fatal;
+
+  pthread_mutex_t  lock;
+  pthread_cond_t   cond;
+} scheduler_t;
+
+static long find_unit_index(build_context_t* ctx, module_unit_t* unit)
+{
+  for (size_t i = 0; i < ctx->count; ++i)
+    if (ctx->items[i] == unit) return (long) i;
+  return -1;
+}
+
+static void scheduler_link_deps(scheduler_t* s)
+{
+  for (size_t i = 0; i < s->ctx->count; ++i) {
+    da_foreach(module_unit_t*, it, &s->ctx->items[i]->deps) {
+      long d = find_unit_index(s->ctx, *it);
+      if (d < 0) continue;
+      da_append(&s->slots[d].dependents, i);
+      s->slots[i].pending_deps++;
+    }
+  }
+}
+
+// lowest topo index first so that `-j 1` and `-j N` agree on priorities
+static long scheduler_pick(scheduler_t* s)
+{
+  for (size_t i = 0; i < s->ctx->count; ++i) {
+    if (s->slots[i].state == SLOT_PENDING &&
+        s->slots[i].pending_deps == 0)
+      return (long) i;
+  }
+  return -1;
+}
+
+static bool scheduler_has_pending(scheduler_t* s)
+{
+  for (size_t i = 0; i < s->ctx->count; ++i)
+    if (s->slots[i].state == SLOT_PENDING) return true;
+  return false;
+}
+
+// must be called with the lock held
+static void scheduler_flush(scheduler_t* s)
+{
+  while (s->next_flush < s->ctx->count &&
+         s->slots[s->next_flush].state == SLOT_DONE) {
+    job_slot_t* slot = &s->slots[s->next_flush++];
+    if (slot->output) {
+      fwrite(slot->output, 1, slot->output_len, stderr);
+      free(slot->output);
+      slot->output = NULL;
+    }
+  }
+  fflush(stderr);
+}
+
+static module_job_status_t scheduler_run_captured(
+    scheduler_t* s, size_t index, job_slot_t* slot)
+{
+  FILE* out = open_memstream(&slot->output, &slot->output_len);
+  if (out) {
+    error_set_output(out);
+    log_set_output(out);
+  }
+
+  module_job_status_t status = s->fn(s->ctx->items[index], index, s->user);
+
+  if (out) {
+    error_set_output(NULL);
+    log_set_output(NULL);
+    fclose(out);
+  }
+
+  return status;
+}
+
+static void* scheduler_worker(void* arg)
+{
+  scheduler_t* s = (scheduler_t*) arg;
+
+  pthread_mutex_lock(&s->lock);
+  for (;;) {
+    long index = -1;
+    while (!s->fatal && (index = scheduler_pick(s)) < 0) {
+      if (!scheduler_has_pending(s)) break;
+      if (s->running == 0) {
+        // nothing can unblock the remaining units, should never happen
+        // since the topo order already rejected cycles
+        error_report_general(ERROR_SEVERITY_ERROR,
+            "module scheduler stalled on unresolved dependencies");
+        s->fatal = true;
+        break;
+      }
+      pthread_cond_wait(&s->cond, &s->lock);
+    }
+
+    if (s->fatal || index < 0) break;
+
+    job_slot_t* slot = &s->slots[index];
+    slot->state = SLOT_RUNNING;
+    s->running++;
+    pthread_mutex_unlock(&s->lock);
+
+    module_job_status_t status = scheduler_run_captured(s, index, slot);
+
+    pthread_mutex_lock(&s->lock);
+    slot->status = status;
+    slot->state = SLOT_DONE;
+    s->running--;
+    if (status == MODULE_JOB_FATAL) s->fatal = true;
+
+    da_foreach(size_t, it, &slot->dependents)
+      s->slots[*it].pending_deps--;
+
+    scheduler_flush(s);
+    pthread_cond_broadcast(&s->cond);
+  }
+  pthread_cond_broadcast(&s->cond);
+  pthread_mutex_unlock(&s->lock);
+
+  return NULL;
+}
+
+static bool schedule_serial(
+    build_context_t* ctx, module_job_fn fn, void* user, int* had_errors)
+{
+  for (size_t i = 0; i < ctx->count; ++i) {
+    module_job_status_t status = fn(ctx->items[i], i, user);
+    if (status != MODULE_JOB_OK) *had_errors = 1;
+    if (status == MODULE_JOB_FATAL) return false;
+  }
+  return true;
+}
+
+bool schedule_modules(
+    build_context_t* ctx,
+    int jobs,
+    module_job_fn fn,
+    void* user,
+    int* had_errors)
+{
+  if (jobs <= 1 || ctx->count <= 1)
+    return schedule_serial(ctx, fn, user, had_errors);
+
+  scheduler_t s = {0};
+  s.ctx = ctx;
+  s.fn = fn;
+  s.user = user;
+  s.slots = calloc(ctx->count, sizeof(job_slot_t));
+  if (!s.slots) {
+    error_report_general(ERROR_SEVERITY_ERROR, "out of memory");
+    return false;
+  }
+
+  scheduler_link_deps(&s);
+  pthread_mutex_init(&s.lock, NULL);
+  pthread_cond_init(&s.cond, NULL);
+
+  size_t worker_count = (size_t) jobs < ctx->count ? (size_t) jobs : ctx->count;
+  pthread_t* workers = calloc(worker_count, sizeof(pthread_t));
+  size_t started = 0;
+  if (workers) {
+    for (; started < worker_count; ++started) {
+      if (pthread_create(&workers[started], NULL, scheduler_worker, &s) != 0)
+        break;
+    }
+  }
+
+  if (started == 0) {
+    // no thread could be spawned, the current one does all the work
+    scheduler_worker(&s);
+  }
+
+  for (size_t i = 0; i < started; ++i)
+    pthread_join(workers[i], NULL);
+  free(workers);
+
+  // units skipped after a fatal error never reach SLOT_DONE, flush what
+  // is left so that no diagnostic is lost
+  for (size_t i = 0; i < ctx->count; ++i) {
+    job_slot_t* slot = &s.slots[i];
+    if (slot->output) {
+      fwrite(slot->output, 1, slot->output_len, stderr);
+      free(slot->output);
+    }
+    if (slot->state == SLOT_DONE && slot->status != MODULE_JOB_OK)
+      *had_errors = 1;
+    da_free(&slot->dependents);
+  }
+
+  bool fatal = s.fatal;
+  pthread_cond_destroy(&s.cond);
+  pthread_mutex_destroy(&s.lock);
+  free(s.slots);
+
+  return !fatal;
+}
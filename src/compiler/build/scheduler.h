@@ -0,0 +1,32 @@
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <stdbool.h>
+#include "compiler/definition/compiler_definition.h"
+
+// Outcome of a single module job
+typedef enum {
+  MODULE_JOB_OK    = 0,
+  MODULE_JOB_ERROR = 1, // diagnostics were reported, keep building others
+  MODULE_JOB_FATAL = 2, // stop scheduling new modules (out of memory, ...)
+} module_job_status_t;
+
+// `index` is the position of `unit` in the topo order of the build context
+typedef module_job_status_t (*module_job_fn)(
+    module_unit_t* unit, size_t index, void* user);
+
+// Runs `fn` once for every unit of `ctx`, in topo order.
+// With `jobs` > 1 units are dispatched on a pool of worker threads as soon
+// as every unit listed in their `deps` has finished. Diagnostics and log
+// lines produced by a job are buffered and flushed in topo order so the
+// output is identical whatever the number of workers.
+// Returns false if a job reported MODULE_JOB_FATAL, `had_errors` is set
+// when at least one job did not return MODULE_JOB_OK.
+bool schedule_modules(
+    build_context_t* ctx,
+    int jobs,
+    module_job_fn fn,
+    void* user,
+    int* had_errors);
+
+#endif // SCHEDULER_H
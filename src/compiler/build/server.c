@@ -0,0 +1,217 @@
+#include "compiler/build/server.h"
+#include "thirdparty/error.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+// Request: u32 argc, then every argument as u32 length + bytes.
+// Reply: the diagnostics as they are written, a NUL byte, the exit status
+// as one byte. Diagnostics never contain a NUL byte.
+#define SERVER_MAX_ARGS    256
+#define SERVER_MAX_ARG_LEN 4096
+
+static bool write_all(int fd, const void* data, size_t len)
+{
+  const char* p = (const char*) data;
+  while (len > 0) {
+    ssize_t n = write(fd, p, len);
+    if (n < 0 && errno == EINTR) continue;
+    if (n <= 0) return false;
+    p += n;
+    len -= (size_t) n;
+  }
+  return true;
+}
+
+static bool read_all(int fd, void* data, size_t len)
+{
+  char* p = (char*) data;
+  while (len > 0) {
+    ssize_t n = read(fd, p, len);
+    if (n < 0 && errno == EINTR) continue;
+    if (n <= 0) return false;
+    p += n;
+    len -= (size_t) n;
+  }
+  return true;
+}
+
+static bool socket_address(const char* path, struct sockaddr_un* addr)
+{
+  memset(addr, 0, sizeof(*addr));
+  addr->sun_family = AF_UNIX;
+  if (strlen(path) >= sizeof(addr->sun_path)) return false;
+  strcpy(addr->sun_path, path);
+  return true;
+}
+
+static int connect_to(const char* path)
+{
+  struct sockaddr_un addr;
+  if (!socket_address(path, &addr)) return -1;
+
+  int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (fd < 0) return -1;
+  if (connect(fd, (struct sockaddr*) &addr, sizeof(addr)) != 0) {
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+int server_listen(const char* path)
+{
+  struct sockaddr_un addr;
+  if (!socket_address(path, &addr)) {
+    error_report_general(
+        ERROR_SEVERITY_ERROR, "socket path '%s' is too long", path);
+    return -1;
+  }
+
+  int live = connect_to(path);
+  if (live >= 0) {
+    close(live);
+    error_report_general(ERROR_SEVERITY_ERROR,
+        "a compile server is already listening on '%s'", path);
+    return -1;
+  }
+  // left behind by a server that did not shut down cleanly
+  unlink(path);
+
+  if (mkdir("build", 0755) != 0 && errno != EEXIST) {
+    error_report_general(
+        ERROR_SEVERITY_ERROR, "cannot create 'build' directory");
+    return -1;
+  }
+
+  int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (fd < 0 ||
+      bind(fd, (struct sockaddr*) &addr, sizeof(addr)) != 0 ||
+      listen(fd, 16) != 0) {
+    error_report_general(ERROR_SEVERITY_ERROR,
+        "cannot listen on '%s': %s", path, strerror(errno));
+    if (fd >= 0) close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+static void request_free(server_request_t* req)
+{
+  if (req->argv) {
+    for (int i = 0; i < req->argc; ++i) free(req->argv[i]);
+    free(req->argv);
+  }
+  req->argv = NULL;
+  req->argc = 0;
+}
+
+static bool read_request(server_request_t* req)
+{
+  uint32_t argc = 0;
+  if (!read_all(req->fd, &argc, sizeof(argc)) ||
+      argc < 2 || argc > SERVER_MAX_ARGS)
+    return false;
+
+  req->argv = calloc(argc + 1, sizeof(char*));
+  if (!req->argv) return false;
+
+  for (uint32_t i = 0; i < argc; ++i) {
+    uint32_t len = 0;
+    if (!read_all(req->fd, &len, sizeof(len)) || len > SERVER_MAX_ARG_LEN)
+      return false;
+
+    char* arg = malloc(len + 1);
+    if (!arg) return false;
+    req->argv[i] = arg;
+    req->argc = (int) i + 1;
+    if (!read_all(req->fd, arg, len)) return false;
+    arg[len] = '\0';
+  }
+
+  return strcmp(req->argv[1], "build") == 0;
+}
+
+bool server_accept(int listen_fd, server_request_t* req)
+{
+  memset(req, 0, sizeof(*req));
+
+  req->fd = accept(listen_fd, NULL, NULL);
+  if (req->fd < 0) return false;
+  // assembler and linker runs of the build must not hold the client
+  fcntl(req->fd, F_SETFD, FD_CLOEXEC);
+
+  if (!read_request(req)) {
+    request_free(req);
+    close(req->fd);
+    req->fd = -1;
+    return false;
+  }
+  return true;
+}
+
+void server_finish(server_request_t* req, int status)
+{
+  unsigned char trailer[2] = { 0, (unsigned char) status };
+  // the client may be gone already, nothing to report to then
+  write_all(req->fd, trailer, sizeof(trailer));
+  close(req->fd);
+  req->fd = -1;
+  request_free(req);
+}
+
+int server_forward(const char* path, int argc, char** argv)
+{
+  int fd = connect_to(path);
+  if (fd < 0) return -1;
+
+  uint32_t count = (uint32_t) argc;
+  bool sent = write_all(fd, &count, sizeof(count));
+  for (int i = 0; sent && i < argc; ++i) {
+    uint32_t len = (uint32_t) strlen(argv[i]);
+    sent = write_all(fd, &len, sizeof(len)) && write_all(fd, argv[i], len);
+  }
+  if (!sent) {
+    close(fd);
+    error_report_general(
+        ERROR_SEVERITY_ERROR, "cannot send the build to the compile server");
+    return 1;
+  }
+
+  // copy everything up to the NUL byte, the status follows it
+  char buf[4096];
+  bool in_trailer = false;
+  int status = -1;
+  while (status < 0) {
+    ssize_t n = read(fd, buf, sizeof(buf));
+    if (n < 0 && errno == EINTR) continue;
+    if (n <= 0) break;
+
+    size_t pos = 0;
+    if (!in_trailer) {
+      char* nul = memchr(buf, '\0', (size_t) n);
+      size_t text = nul ? (size_t) (nul - buf) : (size_t) n;
+      fwrite(buf, 1, text, stderr);
+      if (!nul) continue;
+      in_trailer = true;
+      pos = text + 1;
+    }
+    if (pos < (size_t) n) status = (unsigned char) buf[pos];
+  }
+  close(fd);
+
+  if (status < 0) {
+    error_report_general(
+        ERROR_SEVERITY_ERROR, "the compile server closed the connection");
+    return 1;
+  }
+  return status;
+}
@@ -0,0 +1,34 @@
+#ifndef BUILD_SERVER_H
+#define BUILD_SERVER_H
+
+#include <stdbool.h>
+
+// Unix socket of `cleaf serve`, relative to the project root: a client
+// only reaches the server of the tree it is run from
+#define SERVER_SOCKET_PATH "build/.cleaf.sock"
+
+// A `cleaf build` forwarded by a client. Diagnostics written to `fd` are
+// streamed back as they come.
+typedef struct {
+  int    fd;
+  int    argc;
+  char** argv; // owned, NULL terminated, argv[1] is "build"
+} server_request_t;
+
+// Binds the socket, refusing to take over one a live server answers on.
+// Returns the listening socket, -1 after reporting an error.
+int server_listen(const char* path);
+
+// Waits for the next client. Returns false when interrupted by a signal
+// or when the client sent a malformed request.
+bool server_accept(int listen_fd, server_request_t* req);
+
+// Sends the exit status of the build, then closes and frees `req`
+void server_finish(server_request_t* req, int status);
+
+// Client side: sends `argv` to the server listening on `path` and copies
+// its diagnostics to stderr. Returns the exit status of the remote build,
+// -1 when no server is listening.
+int server_forward(const char* path, int argc, char** argv);
+
+#endif // BUILD_SERVER_H
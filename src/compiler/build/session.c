@@ -0,0 +1,130 @@
+#include "compiler/build/session.h"
+
+#include <string.h>
+#include <sys/stat.h>
+
+#define FNV_OFFSET 0xcbf29ce484222325ULL
+#define FNV_PRIME  0x100000001b3ULL
+
+static uint64_t hash_source(const char* data, size_t len)
+{
+  uint64_t h = FNV_OFFSET;
+  for (size_t i = 0; i < len; ++i) {
+    h ^= (unsigned char) data[i];
+    h *= FNV_PRIME;
+  }
+  return h;
+}
+
+// hash of the file as it is now, false if it cannot be read
+static bool hash_file(const char* path, uint64_t* hash)
+{
+  module_unit_t* probe = calloc(1, sizeof(module_unit_t));
+  if (!probe) return false;
+
+  // read, not mapped: the file may be rewritten while it is hashed
+  bool ok = module_unit_load_source(probe, path, true);
+  if (ok) *hash = hash_source(probe->source, probe->source_len);
+  module_unit_free(probe);
+  return ok;
+}
+
+static bool same_stat(const session_entry_t* entry, const struct stat* st)
+{
+  return entry->size == st->st_size &&
+    entry->mtime.tv_sec == st->st_mtim.tv_sec &&
+    entry->mtime.tv_nsec == st->st_mtim.tv_nsec;
+}
+
+long build_session_refresh(
+    build_session_t* session,
+    const compiled_files_array* files,
+    session_load_fn load)
+{
+  hashmap_t previous = {0};
+  da_foreach(session_entry_t, it, session) {
+    hashmap_put(&previous, it->path, it);
+  }
+
+  build_session_t next = {0};
+  long changed = 0;
+  bool failed = false;
+
+  da_foreach(char*, fit, files) {
+    session_entry_t entry = {0};
+
+    // taking over an entry clears its path, what is left with one once
+    // every file was seen no longer exists
+    session_entry_t* prev = hashmap_get(&previous, *fit);
+    if (prev) {
+      entry = *prev;
+      entry.reloaded = false;
+      prev->path = NULL;
+      prev->unit = NULL;
+    } else {
+      entry.path = strdup(*fit);
+      if (!entry.path) {
+        error_report_general(ERROR_SEVERITY_ERROR, "out of memory");
+        failed = true;
+        continue;
+      }
+    }
+
+    struct stat st;
+    if (stat(entry.path, &st) == 0) {
+      bool untouched = entry.unit && same_stat(&entry, &st);
+      entry.mtime = st.st_mtim;
+      entry.size = st.st_size;
+      if (untouched) {
+        da_append(&next, entry);
+        continue;
+      }
+    }
+
+    // saved again without being modified, e.g. by a checkout
+    uint64_t hash = 0;
+    if (entry.unit && hash_file(entry.path, &hash) && hash == entry.hash) {
+      da_append(&next, entry);
+      continue;
+    }
+
+    module_unit_free(entry.unit);
+    entry.unit = load(entry.path);
+    entry.reloaded = true;
+    if (entry.unit)
+      entry.hash = hash_source(entry.unit->source, entry.unit->source_len);
+    else
+      failed = true;
+
+    changed++;
+    da_append(&next, entry);
+  }
+
+  da_foreach(session_entry_t, it, session) {
+    if (it->path) changed++;
+    module_unit_free(it->unit);
+    free(it->path);
+  }
+  da_free(session);
+  hashmap_free(&previous, 0);
+
+  *session = next;
+  return failed ? -1 : changed;
+}
+
+void build_session_units(
+    const build_session_t* session, module_unit_array* out)
+{
+  da_foreach(session_entry_t, it, session) {
+    if (it->unit) da_append(out, it->unit);
+  }
+}
+
+void build_session_free(build_session_t* session)
+{
+  da_foreach(session_entry_t, it, session) {
+    module_unit_free(it->unit);
+    free(it->path);
+  }
+  da_free(session);
+}
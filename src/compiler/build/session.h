@@ -0,0 +1,47 @@
+#ifndef BUILD_SESSION_H
+#define BUILD_SESSION_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <sys/types.h>
+#include <time.h>
+
+#include "compiler/definition/compiler_definition.h"
+
+// A parsed source file kept between the builds of `cleaf serve` and
+// `cleaf build --watch`
+typedef struct {
+  char*           path;  // owned, `unit->file_path` points here
+  module_unit_t*  unit;  // owned, with its AST and export table
+  struct timespec mtime;
+  off_t           size;
+  uint64_t        hash;  // of the source `unit` was parsed from
+  bool            reloaded; // by the last refresh
+} session_entry_t;
+
+typedef struct {
+  session_entry_t* items; // in the order of the last scan
+  size_t           count;
+  size_t           capacity;
+} build_session_t;
+
+// Lexes and parses `path` into a new unit, NULL after reporting an error
+typedef module_unit_t* (*session_load_fn)(char* path);
+
+// Brings the session in line with `files`: a unit is kept when its file
+// has the same mtime and size, or the same content, as when it was parsed.
+// Other files are loaded again with `load`, vanished ones are dropped.
+// Returns how many units were loaded or dropped, -1 if a load failed (the
+// failing file is loaded again by the next refresh).
+long build_session_refresh(
+    build_session_t* session,
+    const compiled_files_array* files,
+    session_load_fn load);
+
+// Appends the units of the session in scan order, they stay owned by it
+void build_session_units(
+    const build_session_t* session, module_unit_array* out);
+
+void build_session_free(build_session_t* session);
+
+#endif // BUILD_SESSION_H
@@ -0,0 +1,91 @@
+#include "compiler/build/watcher.h"
+#include "thirdparty/error.h"
+
+#include <errno.h>
+#include <poll.h>
+#include <string.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+#define WATCH_MASK \
+  (IN_CLOSE_WRITE | IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO)
+
+bool watcher_init(watcher_t* watcher)
+{
+  watcher->fd = inotify_init1(IN_CLOEXEC);
+  if (watcher->fd < 0) {
+    error_report_general(ERROR_SEVERITY_ERROR,
+        "cannot watch the source tree: %s", strerror(errno));
+    return false;
+  }
+  return true;
+}
+
+bool watcher_add_dirs(watcher_t* watcher, const compiled_files_array* dirs)
+{
+  da_foreach(char*, it, dirs) {
+    // watching a directory twice only returns its existing watch
+    if (inotify_add_watch(watcher->fd, *it, WATCH_MASK | IN_ONLYDIR) < 0) {
+      error_report_general(ERROR_SEVERITY_ERROR,
+          "cannot watch '%s': %s", *it, strerror(errno));
+      return false;
+    }
+  }
+  return true;
+}
+
+// the kinds are ordered, a burst is worth the strongest of its events;
+// WATCH_STOPPED here means the event is of no interest
+static watch_event_t event_kind(const struct inotify_event* ev)
+{
+  // events were dropped, the whole tree has to be looked at again
+  if (ev->mask & IN_Q_OVERFLOW) return WATCH_TREE_CHANGED;
+
+  if (ev->mask & IN_ISDIR)
+    return (ev->mask & (IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO))
+      ? WATCH_TREE_CHANGED : WATCH_STOPPED;
+
+  if (ev->len == 0) return WATCH_STOPPED;
+  const char* extension = strrchr(ev->name, '.');
+  if (!extension || strcmp(extension, ".clf") != 0) return WATCH_STOPPED;
+
+  return (ev->mask & IN_CLOSE_WRITE) ? WATCH_MODIFIED : WATCH_TREE_CHANGED;
+}
+
+watch_event_t watcher_wait(watcher_t* watcher, int debounce_ms)
+{
+  char buf[4096]
+    __attribute__((aligned(__alignof__(struct inotify_event))));
+  watch_event_t seen = WATCH_STOPPED;
+
+  for (;;) {
+    struct pollfd pfd = { .fd = watcher->fd, .events = POLLIN };
+    int ready = poll(&pfd, 1, seen == WATCH_STOPPED ? -1 : debounce_ms);
+    if (ready == 0) return seen;
+    if (ready < 0) {
+      if (errno != EINTR)
+        error_report_general(ERROR_SEVERITY_ERROR,
+            "cannot wait for changes: %s", strerror(errno));
+      return WATCH_STOPPED;
+    }
+
+    ssize_t len = read(watcher->fd, buf, sizeof(buf));
+    if (len < 0) {
+      if (errno == EINTR) return WATCH_STOPPED;
+      continue;
+    }
+
+    for (char* p = buf; p < buf + len;) {
+      const struct inotify_event* ev = (const struct inotify_event*) p;
+      watch_event_t kind = event_kind(ev);
+      if (kind > seen) seen = kind;
+      p += sizeof(struct inotify_event) + ev->len;
+    }
+  }
+}
+
+void watcher_free(watcher_t* watcher)
+{
+  if (watcher->fd >= 0) close(watcher->fd);
+  watcher->fd = -1;
+}
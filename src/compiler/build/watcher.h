@@ -0,0 +1,33 @@
+#ifndef BUILD_WATCHER_H
+#define BUILD_WATCHER_H
+
+#include <stdbool.h>
+#include "compiler/definition/compiler_definition.h"
+
+// Quiet period closing a burst of writes (an editor saving several
+// buffers, a checkout, ...) before the tree is rebuilt
+#define WATCH_DEBOUNCE_MS 100
+
+typedef enum {
+  WATCH_STOPPED,      // interrupted by a signal
+  WATCH_MODIFIED,     // only existing sources were written
+  WATCH_TREE_CHANGED, // sources or directories appeared or vanished
+} watch_event_t;
+
+// inotify watches on the source directories of `cleaf build --watch`
+typedef struct {
+  int fd;
+} watcher_t;
+
+bool watcher_init(watcher_t* watcher);
+
+// Watches every directory of `dirs`, already watched ones are kept
+bool watcher_add_dirs(watcher_t* watcher, const compiled_files_array* dirs);
+
+// Blocks until a .clf file or a directory changed, then until nothing
+// happened for `debounce_ms`
+watch_event_t watcher_wait(watcher_t* watcher, int debounce_ms);
+
+void watcher_free(watcher_t* watcher);
+
+#endif // BUILD_WATCHER_H
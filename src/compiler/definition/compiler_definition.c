@@ -1,42 +1,111 @@
 #include "compiler_definition.h"
 #include "frontend/symbols.h"
 
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Reads the `size` bytes fstat reported into a heap buffer, fewer if the
+// file shrank in between
+static bool read_source(module_unit_t* unit, int fd, size_t size)
+{
+  char* text = malloc(size + 1);
+  if (!text) return false;
+
+  size_t len = 0;
+  while (len < size) {
+    ssize_t n = read(fd, text + len, size - len);
+    if (n < 0 && errno == EINTR) continue;
+    if (n < 0) {
+      free(text);
+      return false;
+    }
+    if (n == 0) break;
+    len += (size_t) n;
+  }
+  text[len] = '\0';
+
+  unit->source = text;
+  unit->source_len = len;
+  unit->source_map_len = 0;
+  return true;
+}
+
+bool module_unit_load_source(module_unit_t* unit, const char* path, bool owned)
+{
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) return false;
+
+  struct stat st;
+  if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+    close(fd);
+    return false;
+  }
+
+  if (owned) {
+    bool ok = read_source(unit, fd, (size_t) st.st_size);
+    close(fd);
+    return ok;
+  }
+
+  // an anonymous reservation one byte longer than the file is mapped
+  // first, the file then replaces its beginning: the bytes left past the
+  // end of the file are zero even when its size is a multiple of a page
+  size_t size = (size_t) st.st_size;
+  size_t page = (size_t) sysconf(_SC_PAGESIZE);
+  size_t map_len = (size + 1 + page - 1) / page * page;
+
+  char* base = mmap(
+      NULL, map_len, PROT_READ, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (base == MAP_FAILED) {
+    close(fd);
+    return false;
+  }
+
+  if (size > 0 &&
+      mmap(base, size, PROT_READ, MAP_PRIVATE | MAP_FIXED, fd, 0) ==
+        MAP_FAILED) {
+    munmap(base, map_len);
+    close(fd);
+    return false;
+  }
+  close(fd);
+
+  unit->source = base;
+  unit->source_len = size;
+  unit->source_map_len = map_len;
+  return true;
+}
+
 void module_unit_free(module_unit_t* unit)
 {
   if (!unit) return;
 
   if (unit->parser.types) {
-    da_foreach(known_type_t, it, unit->parser.types) {
-      if (it->kind == TYPE_CUSTOM && it->name)
-        free(it->name);
-    }
-    da_free(unit->parser.types);
+    type_registry_free(unit->parser.types);
     free(unit->parser.types);
   }
 
-  for (size_t i = 0; i < unit->parser.count; i++) {
-    if (unit->parser.items[i].string_value)
-      free(unit->parser.items[i].string_value);
-  }
-  da_free(&unit->parser);
+  parser_free_tokens(&unit->parser);
 
-  da_foreach(declaration_t*, it, &unit->program) {
-    free_declaration(*it);
-  }
+  parser_free_ast(&unit->parser);
   da_free(&unit->program);
 
+  error_free(&unit->error_ctx);
   free(unit->module_name);
-  free(unit->source);
+  if (unit->source_map_len)
+    munmap((void*) unit->source, unit->source_map_len);
+  else
+    free((void*) unit->source);
+  da_free(&unit->deps);
 
   if (unit->export_funcs) {
-    for (size_t i = 0; i < 211; ++i) {
-      hashmap_entry_t* e = unit->export_funcs->buckets[i];
-      while (e) {
-        function_symbol_t* fs = (function_symbol_t*) e->value;
-        free(fs->params_name);
-        free(fs->params_type);
-        e = e->next;
-      }
+    hashmap_foreach(e, unit->export_funcs) {
+      function_symbol_t* fs = (function_symbol_t*) e->value;
+      free(fs->params_atom);
+      free(fs->params_type);
     }
     hashmap_free(unit->export_funcs, 1);
     free(unit->export_funcs);
@@ -79,18 +148,12 @@ void build_context_free(build_context_t* ctx)
   }
 
   if (ctx->registry) {
-    for (size_t i = 0; i < HASH_SIZE; i++) {
-      hashmap_entry_t* e = ctx->registry->buckets[i];
-      while (e) {
-        module_unit_array* arr = (module_unit_array*) e->value;
-        if (arr) {
-          da_free(arr);
-          free(arr);
-        }
-        e = e->next;
-      }
+    atom_map_foreach(e, ctx->registry) {
+      module_unit_array* arr = (module_unit_array*) e->value;
+      da_free(arr);
+      free(arr);
     }
-    hashmap_free(ctx->registry, 0);
+    atom_map_free(ctx->registry, 0);
     free(ctx->registry);
     ctx->registry = NULL;
   }
@@ -18,37 +18,58 @@ typedef struct {
   size_t capacity;
 } compiled_files_array;
 
+typedef struct module_unit_t module_unit_t;
+
 typedef struct {
+  module_unit_t** items;
+  size_t count;
+  size_t capacity;
+} module_unit_array;
+
+struct module_unit_t {
   char*             file_path;   // not owned (points into files array)
   char*             module_name; // owned, built from DECLARATION_MODULE path
-  char*             source;      // owned
-  int               source_len;
+  atom_t            module_atom; // of `module_name`, the registry key
+  const char*       source;      // owned read-only mapping, NUL terminated
+  size_t            source_len;
+  size_t            source_map_len; // 0 when `source` is not mapped
   error_context_t   error_ctx;
   parser_t          parser;
   declaration_array program;
   hashmap_t*        export_funcs;
-} module_unit_t;
-
-typedef struct {
-  module_unit_t** items;
-  size_t count;
-  size_t capacity;
-} module_unit_array;
+  module_unit_array deps;        // units this one imports from (not owned)
+};
 
 typedef struct {
   compiled_files_array files;
   module_unit_array    units;
   IR_function_array*   hir_program;
   const char*          output;
+  int                  jobs;
+  bool                 use_nasm;
+  bool                 stats;    // --stats, per phase time and memory report
+  const char*          trace_path; // --trace=<file>, NULL when not tracing
+  bool                 watch;    // --watch, rebuild on every change
 } compiler_resources_t;
 
 typedef struct {
-  hashmap_t*      registry;
+  atom_map_t*     registry; // module_unit_array* per module name atom
   module_unit_t** items; // act as topo_order
   size_t          count; // must compile the files in the order of this array
   size_t          capacity;
 } build_context_t;
 
+// Maps the file at `path` read-only as the source of `unit`, whatever its
+// size. A NUL byte always follows the last character, like the buffers the
+// lexer and the diagnostics were written for. Returns false if `path`
+// cannot be opened or mapped.
+//
+// `owned` reads it into a heap buffer instead, for a unit that outlives
+// the build (serve, watch): its tokens and deferred bodies point into the
+// source, which must not change or shrink under them when the file is
+// rewritten in place.
+bool module_unit_load_source(module_unit_t* unit, const char* path, bool owned);
+
 void build_context_free(build_context_t* ctx);
 void module_unit_free(module_unit_t* unit);
 void compiler_resources_free(compiler_resources_t* res);
@@ -1,14 +1,27 @@
 #include "compiler_setup.h"
 
+static bool parse_jobs_flag(const char* value, int* jobs);
+
 compiler_resources_t* single_file_setup(int argc, char** argv)
 {
   log_verbosity_t verbosity = LOG_VERBOSE;
   const char* output = NULL;
   char* filename = NULL;
+  int jobs = 1; // threads the module is parsed on
+
+  bool use_nasm = false;
+  bool stats = false;
+  const char* trace_path = NULL;
 
   for (int i = 1; i < argc; i++) {
     if (strcmp(argv[i], "-V") == 0)
       verbosity = LOG_DUMP;
+    else if (strcmp(argv[i], "--nasm") == 0)
+      use_nasm = true;
+    else if (strcmp(argv[i], "--stats") == 0)
+      stats = true;
+    else if (strncmp(argv[i], "--trace=", 8) == 0 && argv[i][8] != '\0')
+      trace_path = argv[i] + 8;
     else if (strcmp(argv[i], "-o") == 0) {
       if (++i >= argc) {
         error_report_general(
@@ -17,13 +30,27 @@ compiler_resources_t* single_file_setup(int argc, char** argv)
       }
       output = argv[i];
     }
+    else if (strcmp(argv[i], "-j") == 0) {
+      if (++i >= argc || !parse_jobs_flag(argv[i], &jobs)) {
+        error_report_general(
+            ERROR_SEVERITY_ERROR, "'-j' expects a number of jobs");
+        return NULL;
+      }
+    }
+    else if (strncmp(argv[i], "-j", 2) == 0) {
+      if (!parse_jobs_flag(argv[i] + 2, &jobs)) {
+        error_report_general(
+            ERROR_SEVERITY_ERROR, "'-j' expects a number of jobs");
+        return NULL;
+      }
+    }
     else if (argv[i][0] != '-')
       filename = argv[i];
     else {
       error_report_general(
           ERROR_SEVERITY_ERROR, "unknown flag '%s'", argv[i]);
       fprintf(
-          stderr, "usage: %s [-V] [-o <output>] <file.clf>\n", 
+          stderr, "usage: %s [-V] [-j <jobs>] [--nasm] [--stats] [--trace=<file>] [-o <output>] <file.clf>\n", 
           argv[0]);
       return NULL;
     }
@@ -35,7 +62,7 @@ compiler_resources_t* single_file_setup(int argc, char** argv)
     error_report_general(
         ERROR_SEVERITY_ERROR, "no input file provided");
     fprintf(
-        stderr, "usage: %s [-v|-V] [-o <output>] <file.clf>\n", 
+        stderr, "usage: %s [-v|-V] [-j <jobs>] [--nasm] [--stats] [--trace=<file>] [-o <output>] <file.clf>\n", 
         argv[0]);
     return NULL;
   }
@@ -44,19 +71,82 @@ compiler_resources_t* single_file_setup(int argc, char** argv)
     calloc(1, sizeof(compiler_resources_t));
 
   res->output = output;
+  res->jobs = jobs;
+  res->use_nasm = use_nasm;
+  res->stats = stats;
+  res->trace_path = trace_path;
   da_append(&(res->files), strdup(filename));
   return res;
 }
 
-compiler_resources_t* build_setup() 
+static bool parse_jobs_flag(const char* value, int* jobs)
+{
+  char* end = NULL;
+  long n = strtol(value, &end, 10);
+  if (!end || *end != '\0' || n < 1 || n > 1024)
+    return false;
+  *jobs = (int) n;
+  return true;
+}
+
+compiler_resources_t* build_setup(int argc, char** argv) 
 {
   log_verbosity_t verbosity = LOG_DUMP;
+  int jobs = 1;
+  bool use_nasm = false;
+  bool stats = false;
+  const char* trace_path = NULL;
+  bool watch = false;
+
+  // argv[1] is the `build` command itself
+  for (int i = 2; i < argc; i++) {
+    if (strcmp(argv[i], "-v") == 0)
+      verbosity = LOG_VERBOSE;
+    else if (strcmp(argv[i], "-V") == 0)
+      verbosity = LOG_DUMP;
+    else if (strcmp(argv[i], "--nasm") == 0)
+      use_nasm = true;
+    else if (strcmp(argv[i], "--stats") == 0)
+      stats = true;
+    else if (strncmp(argv[i], "--trace=", 8) == 0 && argv[i][8] != '\0')
+      trace_path = argv[i] + 8;
+    else if (strcmp(argv[i], "--server") == 0)
+      continue; // handled by main, only seen once no server answered
+    else if (strcmp(argv[i], "--watch") == 0)
+      watch = true;
+    else if (strcmp(argv[i], "-j") == 0) {
+      if (++i >= argc || !parse_jobs_flag(argv[i], &jobs)) {
+        error_report_general(
+            ERROR_SEVERITY_ERROR, "'-j' expects a number of jobs");
+        return NULL;
+      }
+    }
+    else if (strncmp(argv[i], "-j", 2) == 0) {
+      if (!parse_jobs_flag(argv[i] + 2, &jobs)) {
+        error_report_general(
+            ERROR_SEVERITY_ERROR, "'-j' expects a number of jobs");
+        return NULL;
+      }
+    }
+    else {
+      error_report_general(
+          ERROR_SEVERITY_ERROR, "unknown flag '%s'", argv[i]);
+      fprintf(stderr, "usage: %s build [-v|-V] [-j <jobs>] [--nasm] [--stats] [--trace=<file>] [--server] [--watch]\n", argv[0]);
+      return NULL;
+    }
+  }
+
   log_set_verbosity(verbosity);
 
   compiler_resources_t* res = 
     calloc(1, sizeof(compiler_resources_t));
 
-  res->files = find_source_files();  
+  res->jobs = jobs;
+  res->use_nasm = use_nasm;
+  res->stats = stats;
+  res->trace_path = trace_path;
+  res->watch = watch;
+  res->files = find_source_files(NULL);  
 
   return res;
 }
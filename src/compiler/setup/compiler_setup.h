@@ -6,6 +6,6 @@
 #include "compiler/build/file_scanner.h"
 
 compiler_resources_t* single_file_setup(int argc, char** argv);
-compiler_resources_t* build_setup();
+compiler_resources_t* build_setup(int argc, char** argv);
 
 #endif // COMPILER_SETUP_H
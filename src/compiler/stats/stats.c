@@ -0,0 +1,277 @@
+#include "compiler/stats/stats.h"
+#include "compiler/stats/trace.h"
+
+#define DA_LIB_IMPLEMENTATION
+#include "thirdparty/da.h"
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+typedef struct {
+  stats_module_t** items;
+  size_t count;
+  size_t capacity;
+} stats_module_array;
+
+static bool               _stats_on = false;
+static pthread_mutex_t    _stats_lock = PTHREAD_MUTEX_INITIALIZER;
+static stats_module_array _stats_modules = {0};
+static stats_cost_t       _stats_global[STATS_PHASE_COUNT] = {0};
+
+// filled by the allocator hook below, per thread so that concurrent
+// modules are charged for their own allocations only
+static __thread size_t _stats_allocs = 0;
+static __thread size_t _stats_alloc_bytes = 0;
+
+static const char* phase_names[STATS_PHASE_COUNT] = {
+  [STATS_LEX]       = "lex",
+  [STATS_PARSE]     = "parse",
+  [STATS_DEP_GRAPH] = "dep graph",
+  [STATS_EXPORTS]   = "exports",
+  [STATS_SEMANTIC]  = "semantic",
+  [STATS_HIR]       = "hir",
+  [STATS_CODEGEN]   = "codegen",
+  [STATS_ASSEMBLE]  = "assemble",
+  [STATS_LINK]      = "link",
+};
+
+// Counting allocator hook, only in a `make STATS_ALLOCS=1` build: the link
+// wraps malloc, calloc and realloc (ld --wrap) for the compiler's own
+// objects, allocations made inside libc (strdup, ...) are not seen. A
+// regular build leaves the allocator alone and reports no counts.
+#ifndef STATS_COUNT_ALLOCATIONS
+#define STATS_COUNT_ALLOCATIONS 0
+#endif
+
+#if STATS_COUNT_ALLOCATIONS
+void* __real_malloc(size_t size);
+void* __real_calloc(size_t count, size_t size);
+void* __real_realloc(void* ptr, size_t size);
+
+static inline void stats_count_alloc(size_t size)
+{
+  if (!__atomic_load_n(&_stats_on, __ATOMIC_RELAXED)) return;
+  _stats_allocs++;
+  _stats_alloc_bytes += size;
+}
+
+void* __wrap_malloc(size_t size)
+{
+  stats_count_alloc(size);
+  return __real_malloc(size);
+}
+
+void* __wrap_calloc(size_t count, size_t size)
+{
+  stats_count_alloc(count * size);
+  return __real_calloc(count, size);
+}
+
+void* __wrap_realloc(void* ptr, size_t size)
+{
+  stats_count_alloc(size);
+  return __real_realloc(ptr, size);
+}
+#endif
+
+static double clock_ms(clockid_t clock)
+{
+  struct timespec ts;
+  clock_gettime(clock, &ts);
+  return (double) ts.tv_sec * 1e3 + (double) ts.tv_nsec / 1e6;
+}
+
+void stats_enable(void)
+{
+  __atomic_store_n(&_stats_on, true, __ATOMIC_RELAXED);
+}
+
+bool stats_enabled(void)
+{
+  return __atomic_load_n(&_stats_on, __ATOMIC_RELAXED);
+}
+
+static bool stats_active(void)
+{
+  return stats_enabled() || trace_enabled();
+}
+
+static bool phase_is_global(stats_phase_t phase)
+{
+  return phase == STATS_DEP_GRAPH || phase == STATS_EXPORTS ||
+    phase == STATS_LINK;
+}
+
+stats_module_t* stats_module(const char* path)
+{
+  if (!stats_active()) return NULL;
+
+  pthread_mutex_lock(&_stats_lock);
+  stats_module_t* found = NULL;
+  da_foreach(stats_module_t*, it, &_stats_modules) {
+    if (strcmp((*it)->path, path) == 0) {
+      found = *it;
+      break;
+    }
+  }
+  if (!found) {
+    found = calloc(1, sizeof(stats_module_t));
+    if (found) {
+      found->path = strdup(path);
+      da_append(&_stats_modules, found);
+    }
+  }
+  pthread_mutex_unlock(&_stats_lock);
+
+  return found;
+}
+
+void stats_module_set_name(stats_module_t* module, const char* name)
+{
+  if (!module || module->name || !name) return;
+  module->name = strdup(name);
+}
+
+stats_span_t stats_begin(stats_module_t* module, stats_phase_t phase)
+{
+  stats_span_t span = {0};
+  if (!stats_active()) return span;
+
+  span.active = true;
+  span.module = module;
+  span.phase = phase;
+  span.wall_start = trace_now_ms();
+  span.cpu_start = clock_ms(CLOCK_THREAD_CPUTIME_ID);
+  span.allocs_start = _stats_allocs;
+  span.bytes_start = _stats_alloc_bytes;
+  return span;
+}
+
+static stats_cost_t* cost_slot(stats_module_t* module, stats_phase_t phase)
+{
+  return module ? &module->phases[phase] : &_stats_global[phase];
+}
+
+static void trace_phase(stats_module_t* module, stats_phase_t phase,
+    double start_ms, double wall_ms, long tid)
+{
+  trace_span(phase_names[phase],
+      module ? module->path : NULL, module ? module->name : NULL,
+      start_ms, wall_ms, tid);
+}
+
+void stats_end(stats_span_t* span)
+{
+  if (!span->active) return;
+  span->active = false;
+
+  double wall_ms = trace_now_ms() - span->wall_start;
+  trace_phase(span->module, span->phase,
+      span->wall_start, wall_ms, trace_thread_id());
+  if (!stats_enabled()) return;
+
+  // a module is only ever handled by one thread at a time, whole build
+  // phases run on the main thread while no module is being compiled
+  stats_cost_t* cost = cost_slot(span->module, span->phase);
+  cost->wall_ms += wall_ms;
+  cost->cpu_ms += clock_ms(CLOCK_THREAD_CPUTIME_ID) - span->cpu_start;
+  cost->allocs += _stats_allocs - span->allocs_start;
+  cost->alloc_bytes += _stats_alloc_bytes - span->bytes_start;
+}
+
+void stats_split(stats_span_t* span, stats_phase_t phase, double wall_ms)
+{
+  if (!span->active) return;
+
+  // the interleaved work is CPU bound, its CPU time is its wall time
+  double start_ms = span->wall_start;
+  span->wall_start += wall_ms;
+  span->cpu_start += wall_ms;
+  stats_add(span->module, phase, start_ms, wall_ms, wall_ms, trace_thread_id());
+}
+
+void stats_add(stats_module_t* module, stats_phase_t phase,
+    double start_ms, double wall_ms, double cpu_ms, long tid)
+{
+  if (!stats_active()) return;
+
+  trace_phase(module, phase, start_ms, wall_ms, tid);
+  if (!stats_enabled()) return;
+
+  stats_cost_t* cost = cost_slot(module, phase);
+  cost->wall_ms += wall_ms;
+  cost->cpu_ms += cpu_ms;
+}
+
+static void report_cost(FILE* out, const char* name, const stats_cost_t* c)
+{
+  fprintf(out, "  | %-10s %10.3f %10.3f", name, c->wall_ms, c->cpu_ms);
+  if (STATS_COUNT_ALLOCATIONS)
+    fprintf(out, " %10zu %12.1f\n", c->allocs, c->alloc_bytes / 1024.0);
+  else
+    fprintf(out, " %10s %12s\n", "-", "-");
+}
+
+static void report_header(FILE* out, const char* title)
+{
+  fprintf(out, "\n  ,-- stats: %s\n", title);
+  fprintf(out, "  | %-10s %10s %10s %10s %12s\n",
+      "phase", "wall ms", "cpu ms", "allocs", "alloc KiB");
+}
+
+static void report_counts(FILE* out, const stats_module_t* m)
+{
+  double lex_s = m->phases[STATS_LEX].wall_ms / 1e3;
+  fprintf(out, "  | tokens %zu (%.0f/s), ast nodes %zu, "
+      "hir instructions %zu, code bytes %zu\n",
+      m->tokens, lex_s > 0 ? (double) m->tokens / lex_s : 0.0,
+      m->ast_nodes, m->hir_instructions, m->code_bytes);
+  fprintf(out, "  `----------------------------------\n");
+}
+
+void stats_report(FILE* out)
+{
+  if (!stats_enabled()) return;
+
+  stats_module_t total = {0};
+  memcpy(total.phases, _stats_global, sizeof(total.phases));
+
+  da_foreach(stats_module_t*, it, &_stats_modules) {
+    stats_module_t* m = *it;
+    report_header(out, m->path);
+    for (stats_phase_t p = STATS_LEX; p < STATS_PHASE_COUNT; ++p) {
+      if (phase_is_global(p)) continue;
+      report_cost(out, phase_names[p], &m->phases[p]);
+
+      total.phases[p].wall_ms += m->phases[p].wall_ms;
+      total.phases[p].cpu_ms += m->phases[p].cpu_ms;
+      total.phases[p].allocs += m->phases[p].allocs;
+      total.phases[p].alloc_bytes += m->phases[p].alloc_bytes;
+    }
+    report_counts(out, m);
+
+    total.tokens += m->tokens;
+    total.ast_nodes += m->ast_nodes;
+    total.hir_instructions += m->hir_instructions;
+    total.code_bytes += m->code_bytes;
+  }
+
+  char title[64];
+  snprintf(title, sizeof(title), "total (%zu module(s))", _stats_modules.count);
+  report_header(out, title);
+  for (stats_phase_t p = STATS_LEX; p < STATS_PHASE_COUNT; ++p)
+    report_cost(out, phase_names[p], &total.phases[p]);
+  report_counts(out, &total);
+}
+
+void stats_free(void)
+{
+  da_foreach(stats_module_t*, it, &_stats_modules) {
+    free((*it)->path);
+    free((*it)->name);
+    free(*it);
+  }
+  da_free(&_stats_modules);
+}
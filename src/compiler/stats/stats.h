@@ -0,0 +1,79 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+
+typedef enum {
+  STATS_LEX,
+  STATS_PARSE,
+  STATS_DEP_GRAPH, // whole build, not per module
+  STATS_EXPORTS,   // whole build, not per module
+  STATS_SEMANTIC,
+  STATS_HIR,
+  STATS_CODEGEN,
+  STATS_ASSEMBLE,
+  STATS_LINK,      // whole build, not per module
+  STATS_PHASE_COUNT,
+} stats_phase_t;
+
+typedef struct {
+  double wall_ms;
+  double cpu_ms;
+  size_t allocs;
+  size_t alloc_bytes;
+} stats_cost_t;
+
+typedef struct {
+  char*        path; // owned
+  char*        name; // owned, module name once known
+  stats_cost_t phases[STATS_PHASE_COUNT];
+  size_t       tokens;
+  size_t       ast_nodes;
+  size_t       hir_instructions;
+  size_t       code_bytes; // assembly text, or machine code with the
+                           // built-in assembler
+} stats_module_t;
+
+// A phase being measured on the calling thread, reported by `--stats`
+// and recorded as a `--trace` span
+typedef struct {
+  bool            active;
+  stats_module_t* module; // NULL for whole build phases
+  stats_phase_t   phase;
+  double          wall_start;
+  double          cpu_start;
+  size_t          allocs_start;
+  size_t          bytes_start;
+} stats_span_t;
+
+// Turns collection on, every other function is a no-op until then or
+// until a trace is opened
+void stats_enable(void);
+bool stats_enabled(void);
+
+// Slot of the module compiled from `path`, created on first use. Safe to
+// call from several threads.
+stats_module_t* stats_module(const char* path);
+void stats_module_set_name(stats_module_t* module, const char* name);
+
+stats_span_t stats_begin(stats_module_t* module, stats_phase_t phase);
+void stats_end(stats_span_t* span);
+
+// Charges `wall_ms` of a still open span to `phase` instead, for work
+// interleaved with it (the lexer pulled by the parser). The moved part is
+// shown at the start of the span.
+void stats_split(stats_span_t* span, stats_phase_t phase, double wall_ms);
+
+// Adds a span measured outside of the calling thread (e.g. a child
+// process), `start_ms` is on the trace_now_ms clock
+void stats_add(stats_module_t* module, stats_phase_t phase,
+    double start_ms, double wall_ms, double cpu_ms, long tid);
+
+// Per module and aggregate table of everything collected so far
+void stats_report(FILE* out);
+
+void stats_free(void);
+
+#endif // STATS_H
@@ -0,0 +1,141 @@
+#include "compiler/stats/trace.h"
+
+#define DA_LIB_IMPLEMENTATION
+#include "thirdparty/da.h"
+#include "thirdparty/error.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+typedef struct {
+  const char* name; // static phase name
+  char*       file;
+  char*       module;
+  double      start_ms;
+  double      duration_ms;
+  long        tid;
+} trace_event_t;
+
+typedef struct {
+  trace_event_t* items;
+  size_t count;
+  size_t capacity;
+} trace_event_array;
+
+static bool              _trace_on = false;
+static char*             _trace_path = NULL;
+static double            _trace_origin_ms = 0;
+static pthread_mutex_t   _trace_lock = PTHREAD_MUTEX_INITIALIZER;
+static trace_event_array _trace_events = {0};
+
+double trace_now_ms(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double) ts.tv_sec * 1e3 + (double) ts.tv_nsec / 1e6;
+}
+
+long trace_thread_id(void)
+{
+  return (long) syscall(SYS_gettid);
+}
+
+bool trace_open(const char* path)
+{
+  _trace_path = strdup(path);
+  if (!_trace_path) return false;
+  _trace_origin_ms = trace_now_ms();
+  __atomic_store_n(&_trace_on, true, __ATOMIC_RELEASE);
+  return true;
+}
+
+bool trace_enabled(void)
+{
+  return __atomic_load_n(&_trace_on, __ATOMIC_ACQUIRE);
+}
+
+void trace_span(const char* name, const char* file, const char* module,
+    double start_ms, double duration_ms, long tid)
+{
+  if (!trace_enabled()) return;
+
+  trace_event_t ev = {
+    .name = name,
+    .file = file ? strdup(file) : NULL,
+    .module = module ? strdup(module) : NULL,
+    .start_ms = start_ms,
+    .duration_ms = duration_ms,
+    .tid = tid,
+  };
+
+  pthread_mutex_lock(&_trace_lock);
+  da_append(&_trace_events, ev);
+  pthread_mutex_unlock(&_trace_lock);
+}
+
+static void write_json_string(FILE* f, const char* s)
+{
+  fputc('"', f);
+  for (; *s; ++s) {
+    unsigned char c = (unsigned char) *s;
+    if (c == '"' || c == '\\') fprintf(f, "\\%c", c);
+    else if (c < 0x20) fprintf(f, "\\u%04x", c);
+    else fputc(c, f);
+  }
+  fputc('"', f);
+}
+
+bool trace_close(void)
+{
+  if (!trace_enabled()) return true;
+  __atomic_store_n(&_trace_on, false, __ATOMIC_RELEASE);
+
+  bool ok = false;
+  FILE* f = fopen(_trace_path, "wb");
+  if (f) {
+    long pid = (long) getpid();
+    fprintf(f, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    fprintf(f, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%ld,"
+        "\"args\":{\"name\":\"cleaf\"}}", pid);
+
+    da_foreach(trace_event_t, ev, &_trace_events) {
+      // timestamps are in microseconds since the trace was opened
+      fprintf(f, ",\n{\"name\":\"%s\",\"cat\":\"cleaf\",\"ph\":\"X\","
+          "\"ts\":%.3f,\"dur\":%.3f,\"pid\":%ld,\"tid\":%ld,\"args\":{",
+          ev->name, (ev->start_ms - _trace_origin_ms) * 1e3,
+          ev->duration_ms * 1e3, pid, ev->tid);
+      bool first = true;
+      if (ev->file) {
+        fprintf(f, "\"file\":");
+        write_json_string(f, ev->file);
+        first = false;
+      }
+      if (ev->module) {
+        fprintf(f, "%s\"module\":", first ? "" : ",");
+        write_json_string(f, ev->module);
+      }
+      fprintf(f, "}}");
+    }
+
+    fprintf(f, "\n]}\n");
+    ok = fclose(f) == 0;
+  }
+  if (!ok)
+    error_report_general(
+        ERROR_SEVERITY_ERROR, "cannot write trace file '%s'", _trace_path);
+
+  da_foreach(trace_event_t, ev, &_trace_events) {
+    free(ev->file);
+    free(ev->module);
+  }
+  da_free(&_trace_events);
+  free(_trace_path);
+  _trace_path = NULL;
+
+  return ok;
+}
@@ -0,0 +1,27 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdbool.h>
+
+// Chrome / Perfetto trace-event output (`--trace=<file>`), open it in
+// chrome://tracing or ui.perfetto.dev
+
+// Starts recording, the file is only written by trace_close
+bool trace_open(const char* path);
+bool trace_enabled(void);
+
+// Milliseconds on the clock every event is measured with
+double trace_now_ms(void);
+
+// Id of the calling thread as shown in the timeline
+long trace_thread_id(void);
+
+// Records a complete span. `file` and `module` are copied, both may be NULL.
+// Safe to call from several threads.
+void trace_span(const char* name, const char* file, const char* module,
+    double start_ms, double duration_ms, long tid);
+
+// Writes every recorded event and stops recording
+bool trace_close(void);
+
+#endif // TRACE_H
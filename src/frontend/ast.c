@@ -4,247 +4,233 @@
 #include "../thirdparty/da.h"
 #include "error.h"
 
-void free_expression(expression_t* e) 
+static size_t count_statement(statement_t* s);
+
+static size_t count_expression(expression_t* e)
 {
   if (!e)
-    return;
-
-  if (e->type == EXPRESSION_VAR) {
-    if (e->var.ident.ident_name)
-      free(e->var.ident.ident_name);
-    if (e->var.member)
-      free_expression(e->var.member);
-  }
-
-  if (e->type == EXPRESSION_ASSIGN) {
-    if (e->assign.lhs)
-      free_expression(e->assign.lhs);
-
-    if (e->assign.rhs)
-      free_expression(e->assign.rhs);
-  }
-
-  if (e->type == EXPRESSION_BINARY) {
-    if (e->binary.left)
-      free_expression(e->binary.left); 
-
-    if (e->binary.right)
-      free_expression(e->binary.right);
-  }
-
-  if (e->type == EXPRESSION_CALL) {
-    if (e->call.callee)
-      free(e->call.callee);
-  
-    if (e->call.args) {
-      for (size_t i = 0; i < e->call.arg_count; ++i) 
-        free_expression(e->call.args[i]);
-
-      free(e->call.args);
-    }
-
-    if (e->call.qualifier)
-      free(e->call.qualifier);
-
-    if (e->call.resolved_module)
-      free(e->call.resolved_module);
-  }
-
-  if (e->type == EXPRESSION_UNARY) 
-    if (e->unary.operand)
-      free_expression(e->unary.operand);
-
-  if (e->type == EXPRESSION_COMPOSITE_LITERAL) {
-    if (e->composite_literal.values) {
-      for (size_t i = 0; i < e->composite_literal.count; ++i)
-        free_expression(e->composite_literal.values[i]);
-      free(e->composite_literal.values);
-    }
-  }
-
-  if (e->type == EXPRESSION_INDEX) {
-    if (e->index.base)
-     free_expression(e->index.base);
+    return 0;
+
+  size_t n = 1;
+  switch (e->type) {
+  case EXPRESSION_VAR:
+    n += count_expression(e->var.member);
+    break;
+  case EXPRESSION_ASSIGN:
+    n += count_expression(e->assign.lhs) + count_expression(e->assign.rhs);
+    break;
+  case EXPRESSION_BINARY:
+    n += count_expression(e->binary.left) + count_expression(e->binary.right);
+    break;
+  case EXPRESSION_CALL:
+    for (size_t i = 0; e->call.args && i < e->call.arg_count; ++i)
+      n += count_expression(e->call.args[i]);
+    break;
+  case EXPRESSION_UNARY:
+    n += count_expression(e->unary.operand);
+    break;
+  case EXPRESSION_COMPOSITE_LITERAL:
+    for (size_t i = 0; e->composite_literal.values &&
+        i < e->composite_literal.count; ++i)
+      n += count_expression(e->composite_literal.values[i]);
+    break;
+  case EXPRESSION_INDEX:
+    n += count_expression(e->index.base) + count_expression(e->index.index);
+    break;
+  default:
+    break;
+  }
+  return n;
+}
 
-    if (e->index.index)
-     free_expression(e->index.index);
+static size_t count_block(statement_block_t* block)
+{
+  size_t n = 0;
+  if (block) {
+    da_foreach(statement_t*, it, block)
+      n += count_statement(*it);
   }
-
-  free(e);
+  return n;
 }
 
-void free_statement(statement_t* s) 
+static size_t count_statement(statement_t* s)
 {
   if (!s)
-    return;
-
-  if (s->type == STATEMENT_RETURN) 
-    free_expression(s->ret.value);
-
-  if (s->type == STATEMENT_DECL)
-      free_declaration(s->decl_stmt.decl);
-
-  if (s->type == STATEMENT_EXPR)
-    free_expression(s->expr_stmt.expr);
-
-  if (s->type == STATEMENT_IF) {
-    if (s->if_stmt.condition) 
-      free_expression(s->if_stmt.condition); 
-    if (s->if_stmt.then_branch) {
-      da_foreach(statement_t*, it, s->if_stmt.then_branch)
-        free_statement(*(it)); 
-      da_free(s->if_stmt.then_branch);
-      free(s->if_stmt.then_branch);
-    }
-    if (s->if_stmt.else_branch) {
-      da_foreach(statement_t*, it, s->if_stmt.else_branch)
-        free_statement(*(it));
-      da_free(s->if_stmt.else_branch);
-      free(s->if_stmt.else_branch);
-    }
-  }
-
-  if (s->type == STATEMENT_WHILE) {
-    if (s->while_stmt.condition)
-     free_expression(s->while_stmt.condition); 
-    if (s->while_stmt.body) {
-      da_foreach(statement_t*, it, s->while_stmt.body)
-        free_statement(*(it));
-      da_free(s->while_stmt.body); 
-      free(s->while_stmt.body);
-    }
-  }
-
-  if (s->type == STATEMENT_FOR) {
-    if (s->for_stmt.init_kind == FOR_INIT_DECL) {
-      if (s->for_stmt.decl_init)
-        free_declaration(s->for_stmt.decl_init);
-    } else {
-      if (s->for_stmt.expr_init)
-        free_expression(s->for_stmt.expr_init);
-    }
-    if (s->for_stmt.condition)
-      free_expression(s->for_stmt.condition);
-    if (s->for_stmt.loop)
-      free_expression(s->for_stmt.loop);
-    if (s->for_stmt.body) {
-      da_foreach(statement_t*, it, s->for_stmt.body)
-       free_statement(*(it)); 
-      da_free(s->for_stmt.body);
-      free(s->for_stmt.body);
-    }
-  }
-
-  if (s->type == STATEMENT_ASM) {
-    for (size_t i = 0; i < s->asm_stmt.instr_count; ++i) 
-      free(s->asm_stmt.instr[i]); 
-    free(s->asm_stmt.instr);
-
-    for (size_t i = 0; i < s->asm_stmt.arg_count; ++i) 
-      free_expression(s->asm_stmt.args[i]);
-    free(s->asm_stmt.args);
-  }
-
-  if (s->type == STATEMENT_FREE) {
-    free_expression(s->free_stmt.expr); 
-  }
-
-  free(s);
+    return 0;
+
+  size_t n = 1;
+  switch (s->type) {
+  case STATEMENT_RETURN:
+    n += count_expression(s->ret.value);
+    break;
+  case STATEMENT_DECL:
+    n += ast_count_nodes(s->decl_stmt.decl);
+    break;
+  case STATEMENT_EXPR:
+    n += count_expression(s->expr_stmt.expr);
+    break;
+  case STATEMENT_IF:
+    n += count_expression(s->if_stmt.condition);
+    n += count_block(s->if_stmt.then_branch);
+    n += count_block(s->if_stmt.else_branch);
+    break;
+  case STATEMENT_WHILE:
+    n += count_expression(s->while_stmt.condition);
+    n += count_block(s->while_stmt.body);
+    break;
+  case STATEMENT_FOR:
+    if (s->for_stmt.init_kind == FOR_INIT_DECL)
+      n += ast_count_nodes(s->for_stmt.decl_init);
+    else
+      n += count_expression(s->for_stmt.expr_init);
+    n += count_expression(s->for_stmt.condition);
+    n += count_expression(s->for_stmt.loop);
+    n += count_block(s->for_stmt.body);
+    break;
+  case STATEMENT_ASM:
+    for (size_t i = 0; i < s->asm_stmt.arg_count; ++i)
+      n += count_expression(s->asm_stmt.args[i]);
+    break;
+  case STATEMENT_FREE:
+    n += count_expression(s->free_stmt.expr);
+    break;
+  default:
+    break;
+  }
+  return n;
 }
 
-void free_declaration(declaration_t* d) 
+size_t ast_count_nodes(declaration_t* d)
 {
   if (!d)
-    return;
-
-  if (d->type == DECLARATION_FUNC) {
-    if (d->func.name)
-      free(d->func.name);
+    return 0;
+
+  size_t n = 1;
+  if (d->type == DECLARATION_FUNC)
+    n += count_block(d->func.body);
+  if (d->type == DECLARATION_VAR)
+    n += count_expression(d->var_decl.init);
+  return n;
+}
 
-    da_foreach(typed_identifier_t, it, &(d->func.params)) {
-      if (it->ident_name)
-        free(it->ident_name);
-    }
+void populate_parser_known_type(type_registry_t* types) 
+{
+  for (size_t i = 0; i < TYPE_COUNT; ++i) {
+    types_ident desc = types_description[i];
+    known_type_t t = { 
+      .name = desc.name, 
+      .element_size = desc.size, 
+      .kind = i
+    };
+    type_registry_add(types, t);
+  }
+}
 
-    da_free(&(d->func.params));
+void parser_init_stream(parser_t* p, token_source_fn next, void* user)
+{
+  memset(&p->window, 0, sizeof(p->window));
+  p->window.next = next;
+  p->window.user = user;
+}
 
-    if (d->func.body) {
-      da_foreach(statement_t*, it, d->func.body) {
-        free_statement(*it);
-      }
-      da_free(d->func.body);
-      free(d->func.body);
+// Lexes up to the end of the last block, adding a block when it is full
+static void window_fill(token_window_t* w)
+{
+  size_t held = w->lexed - w->first;
+  if (held == w->blocks.count * PARSER_BLOCK_TOKENS) {
+    token_t* block = malloc(PARSER_BLOCK_TOKENS * sizeof(token_t));
+    if (!block) {
+      error_report_general(ERROR_SEVERITY_ERROR, "out of memory");
+      w->done = true;
+      return;
     }
+    da_append(&w->blocks, block);
   }
 
-  if (d->type == DECLARATION_STRUCT) {
-    if (d->struc.name)
-      free(d->struc.name); 
-
-     da_foreach(typed_identifier_t, it, &(d->struc.members)) {
-      if (it->ident_name)
-        free(it->ident_name);
-    }
+  size_t offset = held % PARSER_BLOCK_TOKENS;
+  token_t* block = w->blocks.items[held / PARSER_BLOCK_TOKENS];
+  size_t room = PARSER_BLOCK_TOKENS - offset;
+  size_t produced = w->next(w->user, block + offset, room);
+  w->lexed += produced;
+  if (produced < room) w->done = true;
+}
 
-    da_free(&(d->struc.members));
-  }
+static token_t* token_at(parser_t* p, long index)
+{
+  if (index < 0) return NULL;
 
-  if (d->type == DECLARATION_VAR) {
-    if (d->var_decl.ident.ident_name)
-      free(d->var_decl.ident.ident_name);
+  token_window_t* w = &p->window;
+  if (!w->next)
+    return (size_t) index < p->count ? &p->items[index] : NULL;
 
-    if(d->var_decl.init)
-      free_expression(d->var_decl.init);
-  }
+  while ((size_t) index >= w->lexed && !w->done)
+    window_fill(w);
 
-  if (d->type == DECLARATION_MODULE) {
-    da_foreach(char*, it, &(d->module.path)) {
-      free(*it); 
-    }
-    da_free(&(d->module.path));
-  }
+  if ((size_t) index < w->first || (size_t) index >= w->lexed) return NULL;
+  size_t rel = (size_t) index - w->first;
+  return &w->blocks.items[rel / PARSER_BLOCK_TOKENS][rel % PARSER_BLOCK_TOKENS];
+}
 
-  if (d->type == DECLARATION_IMPORT) {
-    da_foreach(char*, it, &(d->import.path)) {
-      free(*it); 
-    }
+static void free_token_block(token_t* block, size_t count)
+{
+  for (size_t i = 0; i < count; ++i)
+    free(block[i].owned);
+  free(block);
+}
 
-    if (d->import.alias) {
-      free(d->import.alias); 
-    }
+void parser_release_consumed(parser_t* p)
+{
+  token_window_t* w = &p->window;
+  if (!w->next) return;
+
+  size_t consumed = ((size_t) p->pos - w->first) / PARSER_BLOCK_TOKENS;
+  if (consumed == 0) return;
+
+  for (size_t i = 0; i < consumed; ++i)
+    free_token_block(w->blocks.items[i], PARSER_BLOCK_TOKENS);
+  memmove(w->blocks.items, w->blocks.items + consumed,
+      (w->blocks.count - consumed) * sizeof(token_t*));
+  w->blocks.count -= consumed;
+  w->first += consumed * PARSER_BLOCK_TOKENS;
+}
 
-    da_free(&(d->import.path));
-  }
-  
-  free(d);
+size_t parser_token_count(parser_t* p)
+{
+  return p->window.next ? p->window.lexed : p->count;
 }
 
-void populate_parser_known_type(known_type_array* types) 
+void parser_free_tokens(parser_t* p)
 {
-  for (size_t i = 0; i < TYPE_COUNT; ++i) {
-    types_ident desc = types_description[i];
-    known_type_t t = { 
-      .name = desc.name, 
-      .element_size = desc.size, 
-      .kind = i
-    };
-    da_append(types, t);
-  }
+  for (size_t i = 0; i < p->count; i++)
+    free(p->items[i].owned);
+  da_free(p);
+
+  token_window_t* w = &p->window;
+  size_t held = w->lexed - w->first;
+  for (size_t i = 0; i < w->blocks.count; ++i) {
+    size_t in_block = held > PARSER_BLOCK_TOKENS ? PARSER_BLOCK_TOKENS : held;
+    free_token_block(w->blocks.items[i], in_block);
+    held -= in_block;
+  }
+  da_free(&w->blocks);
+  memset(w, 0, sizeof(*w));
 }
 
 token_t* peek(parser_t* p)
 {
-  return (size_t) p->pos < p->count ? &p->items[p->pos] : NULL;
+  return token_at(p, p->pos);
 }
 
 token_t* peek_next(parser_t* p, int range) 
 {
-  return (size_t) p->pos + range < p->count ? &p->items[p->pos + range] : NULL; 
+  return token_at(p, (long) p->pos + range);
 }
 
 token_t* advance(parser_t* p)
 {
-  return (size_t) p->pos < p->count ? &p->items[p->pos++] : NULL;
+  token_t* tok = token_at(p, p->pos);
+  if (tok) p->pos++;
+  return tok;
 }
 
 bool check(parser_t* p, long kind)
@@ -255,10 +241,60 @@ bool check(parser_t* p, long kind)
 
 bool check_next(parser_t* p, long kind, int range) 
 {
-  if ((size_t) (p->pos + range) >= p->count)
-    return false;
+  token_t* tok = peek_next(p, range);
+  return tok && tok->type == kind;
+}
+
+bool check_name(parser_t* p)
+{
+  // keywords are taken as names so the semantic pass reports them as
+  // reserved
+  token_t* tok = peek(p);
+  return tok && (tok->type == LEXER_token_id ||
+      (tok->type >= LEXER_token_kw_fn && tok->type <= LEXER_token_kw_as));
+}
+
+bool token_is(const token_t* tok, const char* text)
+{
+  if (!tok || !tok->string_value) return false;
+
+  size_t len = strlen(text);
+  return (size_t) tok->string_len == len &&
+    memcmp(tok->string_value, text, len) == 0;
+}
+
+const char* token_name(const token_t* tok)
+{
+  return atom_str(tok->atom);
+}
+
+char* token_strdup(const token_t* tok)
+{
+  char* copy = malloc((size_t) tok->string_len + 1);
+  if (!copy) return NULL;
+  memcpy(copy, tok->string_value, (size_t) tok->string_len);
+  copy[tok->string_len] = '\0';
+  return copy;
+}
 
-  return p->items[p->pos + range].type == kind;
+// Copy of the token text owned by the parser's arena
+static char* ast_strdup(parser_t* p, const token_t* tok)
+{
+  return arena_strndup(&p->arena, tok->string_value, (size_t) tok->string_len);
+}
+
+void parser_free_ast(parser_t* p)
+{
+  arena_free(&p->arena);
+}
+
+// Registry entry of `name` if the parser can see it yet
+static known_type_t* find_type(parser_t* p, atom_t name)
+{
+  known_type_t* t = type_registry_find(p->types, name);
+  if (t && p->types_visible && t->id >= p->types_visible)
+    return NULL;
+  return t;
 }
 
 bool check_is_type(parser_t* p) 
@@ -277,12 +313,11 @@ bool check_is_type(parser_t* p)
     return false;
   }
 
-  da_foreach(known_type_t, it, p->types) {
-    if (strcmp(peek(p)->string_value, it->name) == 0)
-      return true;  
-  }
+  if (tok->builtin_type >= 0)
+    return true;
 
-  return false;
+  return tok->type == LEXER_token_id &&
+    find_type(p, tok->atom) != NULL;
 }
 
 bool expect(parser_t* p, long kind, char* err) 
@@ -303,28 +338,25 @@ bool expect(parser_t* p, long kind, char* err)
   return false;
 }
 
-known_type_t* get_type_info_from_string(
+known_type_t* get_type_info_from_token(
     parser_t* p,
-    const char* type_string)
+    const token_t* type_tok)
 {
-  da_foreach(known_type_t, it, p->types) {
-    if (strcmp(type_string, it->name) == 0)
-     return it;
-  }
-  
-  return NULL;
+  if (type_tok->builtin_type >= 0)
+    return type_registry_get(p->types, (type_id_t) type_tok->builtin_type);
+
+  return find_type(p, type_tok->atom);
 }
 
 expression_t*  ast_parse_expr_int_lit(parser_t* p) 
 {
-  expression_t* e = (expression_t*) malloc(sizeof(expression_t));
+  expression_t* e = arena_alloc(&p->arena, sizeof(expression_t));
   
   if (!e) {
     error_report_general(ERROR_SEVERITY_ERROR, "out of memory");
     return NULL;
   }
 
-  memset(e, 0, sizeof(expression_t));
   e->type = EXPRESSION_INT_LIT;
   e->source_pos = peek(p)->source_pos;
 
@@ -336,12 +368,11 @@ expression_t*  ast_parse_expr_int_lit(parser_t* p)
 
 expression_t* ast_parse_expr_var(parser_t* p) 
 {
-  expression_t* e = (expression_t*) malloc(sizeof(expression_t));
+  expression_t* e = arena_alloc(&p->arena, sizeof(expression_t));
   if (!e) {
     error_report_general(ERROR_SEVERITY_ERROR, "out of memory");
     return NULL;
   }
-  memset(e, 0, sizeof(expression_t));
 
   e->type = EXPRESSION_VAR;
   e->source_pos = peek(p)->source_pos;
@@ -352,11 +383,11 @@ expression_t* ast_parse_expr_var(parser_t* p)
       error_report_at_token(p->error_ctx, var_tok, ERROR_SEVERITY_ERROR,
                            "identifier has no value");
     }
-    free_expression(e);
     return NULL;
   }
 
-  e->var.ident.ident_name = strdup(var_tok->string_value);
+  e->var.ident.ident_name = token_name(var_tok);
+  e->var.ident.atom = var_tok->atom;
 
   if (check(p, '.')) {
     // consume '.'
@@ -375,7 +406,7 @@ expression_t* ast_parse_expr_var(parser_t* p)
 
 expression_t* ast_parse_expr_array_composite_literal(parser_t* p)
 {
-  expression_t* e = calloc(1, sizeof(expression_t));
+  expression_t* e = arena_alloc(&p->arena, sizeof(expression_t));
   if (!e) {
     error_report_general(ERROR_SEVERITY_ERROR, "out of memory"); 
     return NULL;
@@ -405,9 +436,11 @@ expression_t* ast_parse_expr_array_composite_literal(parser_t* p)
 
     if (a) {
       e->composite_literal.values =
-        realloc(
+        arena_grow(&p->arena,
             e->composite_literal.values,
-            ++e->composite_literal.count * sizeof(expression_t*));
+            e->composite_literal.count * sizeof(expression_t*),
+            (e->composite_literal.count + 1) * sizeof(expression_t*));
+      ++e->composite_literal.count;
       e->composite_literal.values[e->composite_literal.count - 1] =
         a;
 
@@ -425,7 +458,7 @@ expression_t* ast_parse_expr_array_composite_literal(parser_t* p)
 
 expression_t* ast_parse_expr_composite_literal(parser_t* p)
 {
-  expression_t* e = calloc(1, sizeof(expression_t));
+  expression_t* e = arena_alloc(&p->arena, sizeof(expression_t));
   if (!e) {
     error_report_general(ERROR_SEVERITY_ERROR, "out of memory"); 
     return NULL;
@@ -452,8 +485,10 @@ expression_t* ast_parse_expr_composite_literal(parser_t* p)
       expression_t* a = ast_parse_expr_assign(p);
       if (a) {
         e->composite_literal.values = 
-          realloc(e->composite_literal.values,
-              ++e->composite_literal.count * sizeof(expression_t*));
+          arena_grow(&p->arena, e->composite_literal.values,
+              e->composite_literal.count * sizeof(expression_t*),
+              (e->composite_literal.count + 1) * sizeof(expression_t*));
+        ++e->composite_literal.count;
         e->composite_literal.values[
           e->composite_literal.count - 1] = a;
       }
@@ -472,24 +507,21 @@ expression_t* ast_parse_expr_composite_literal(parser_t* p)
 
 expression_t* ast_parse_expr_assign(parser_t* p)
 {
-  expression_t* e = (expression_t*) malloc(sizeof(expression_t));
+  expression_t* e = arena_alloc(&p->arena, sizeof(expression_t));
   if (!e) {
     error_report_general(ERROR_SEVERITY_ERROR, "out of memory");
     return NULL; 
   }
-  memset(e, 0, sizeof(expression_t));
 
   e->type = EXPRESSION_ASSIGN;
   e->source_pos = peek(p)->source_pos;
   
   // We compute lhs here otherwise we fallback in infinit loop 'id ='
-  expression_t* lhs = (expression_t*) malloc(sizeof(expression_t));
+  expression_t* lhs = arena_alloc(&p->arena, sizeof(expression_t));
   if (!lhs) {
     error_report_general(ERROR_SEVERITY_ERROR, "out of memory");
-    free_expression(e);
     return NULL;
   }
-  memset(lhs, 0, sizeof(expression_t));
 
   lhs->type = EXPRESSION_VAR;
 
@@ -499,16 +531,13 @@ expression_t* ast_parse_expr_assign(parser_t* p)
       error_report_at_token(p->error_ctx, var_tok, ERROR_SEVERITY_ERROR,
                            "expected identifier in assignment");
     }
-    free_expression(e);
-    free_expression(lhs);
     return NULL;
   }
 
-  lhs->var.ident.ident_name = strdup(var_tok->string_value);
+  lhs->var.ident.ident_name = token_name(var_tok);
+  lhs->var.ident.atom = var_tok->atom;
   if (!lhs->var.ident.ident_name) {
     error_report_general(ERROR_SEVERITY_ERROR, "out of memory");
-    free_expression(e);
-    free_expression(lhs);
     return NULL;
   }
 
@@ -565,10 +594,9 @@ expression_t* ast_parse_expr_binary(parser_t* p, int min_bp)
 
     if (lbp < min_bp) break;
 
-    expression_t* e = (expression_t*) calloc(1, sizeof(expression_t));
+    expression_t* e = arena_alloc(&p->arena, sizeof(expression_t));
     if (!e) {
       error_report_general(ERROR_SEVERITY_ERROR, "out of memory"); 
-      free_expression(expr);
       return NULL;
     }
 
@@ -623,8 +651,6 @@ expression_t* ast_parse_expr_binary(parser_t* p, int min_bp)
     if (!right) {
       error_report_at_token(p->error_ctx, peek(p), ERROR_SEVERITY_ERROR,
                             "expected expression after binary operator");
-      free_expression(e);
-      free_expression(expr);
       return NULL;
     }
 
@@ -639,7 +665,7 @@ binary_done:
 
 expression_t* ast_parse_expr_index(parser_t* p)
 {
-  expression_t* e = calloc(1, sizeof(expression_t));
+  expression_t* e = arena_alloc(&p->arena, sizeof(expression_t));
   if (!e) {
     error_report_general(ERROR_SEVERITY_ERROR, "out of memory"); 
     return NULL;
@@ -651,7 +677,6 @@ expression_t* ast_parse_expr_index(parser_t* p)
 
   // Do we have to propagate error here ?
   if (!e->index.base) {
-    free_expression(e); 
     return NULL;
   }
 
@@ -660,7 +685,6 @@ expression_t* ast_parse_expr_index(parser_t* p)
   e->index.index = parse_expression(p);
 
   if (!e->index.index) {
-    free_expression(e); 
     return NULL;
   }
 
@@ -670,7 +694,7 @@ expression_t* ast_parse_expr_index(parser_t* p)
 
 expression_t* ast_parse_expr_call(parser_t* p) 
 {
-  expression_t* e = calloc(1, sizeof(expression_t));
+  expression_t* e = arena_alloc(&p->arena, sizeof(expression_t));
   if (!e) {
     error_report_general(ERROR_SEVERITY_ERROR, "out of memory");
     return NULL;
@@ -684,14 +708,12 @@ expression_t* ast_parse_expr_call(parser_t* p)
       error_report_at_token(
           p->error_ctx, qualifier_tok, ERROR_SEVERITY_ERROR,
           "identifier has no value");
-      free_expression(e);
       return NULL;
     }
   
-    e->call.qualifier = strdup(qualifier_tok->string_value);
+    e->call.qualifier = token_name(qualifier_tok);
     if (!e->call.qualifier) {
       error_report_general(ERROR_SEVERITY_ERROR, "out of memory"); 
-      free_expression(e);
       return NULL;
     }
 
@@ -704,13 +726,12 @@ expression_t* ast_parse_expr_call(parser_t* p)
     error_report_at_token(
         p->error_ctx, name_tok, ERROR_SEVERITY_ERROR,
         "identifier has no value");
-    free_expression(e);
     return NULL;
   }
-  e->call.callee = strdup(name_tok->string_value);
+  e->call.callee = token_name(name_tok);
+  e->call.callee_atom = name_tok->atom;
   if (!e->call.callee) {
     error_report_general(ERROR_SEVERITY_ERROR, "out of memory");
-    free_expression(e);
     return NULL;
   }
 
@@ -719,24 +740,24 @@ expression_t* ast_parse_expr_call(parser_t* p)
 
   int l = 0;
   while (!check_next(p, ')', l)) {
-    if ((size_t) p->pos + l > p->count) {
+    if (!peek_next(p, l)) {
       error_report_at_token(
         p->error_ctx, peek_next(p, l - 1), ERROR_SEVERITY_ERROR, 
         "unexpected EOF, looking for ')' token");
+      return NULL;
     }
     ++l;
   }
 
   e->call.arg_count = (size_t) ceil((double) l / 2);
   if (e->call.arg_count > 0) {
-    e->call.args = (expression_t**) calloc(e->call.arg_count, sizeof(expression_t));
+    e->call.args = arena_alloc(&p->arena, e->call.arg_count * sizeof(expression_t*));
 
     for (size_t i = 0; i < e->call.arg_count; ++i) {
       expression_t* arg = parse_expression(p);  
       if (!arg) {
         error_report_at_token(p->error_ctx, peek(p), ERROR_SEVERITY_ERROR,
             "unexpected NULL argument");
-        free_expression(e);
         return NULL;
       }
       e->call.args[i] = arg;
@@ -744,7 +765,6 @@ expression_t* ast_parse_expr_call(parser_t* p)
       if (!check(p, ')') && i == e->call.arg_count - 1) {
         error_report_at_token(p->error_ctx, peek(p), ERROR_SEVERITY_ERROR,
             "expected ')' after argument declaration");
-        free_expression(e);
         return NULL;
       } 
 
@@ -752,7 +772,6 @@ expression_t* ast_parse_expr_call(parser_t* p)
       if (!check(p, ',') && i != e->call.arg_count - 1) {
         error_report_at_token(p->error_ctx, peek(p), ERROR_SEVERITY_ERROR, 
             "expected ',' after argument declaration");
-        free_expression(e);
         return NULL;
       }
 
@@ -771,12 +790,11 @@ expression_t* ast_parse_expr_call(parser_t* p)
 
 expression_t* ast_parse_expr_unary(parser_t* p) 
 {
-  expression_t* e = (expression_t*) malloc(sizeof(expression_t));
+  expression_t* e = arena_alloc(&p->arena, sizeof(expression_t));
   if (!e) {
     error_report_general(ERROR_SEVERITY_ERROR, "out of memory"); 
     return NULL;
   }
-  memset(e, 0, sizeof(expression_t));
   
   e->type = EXPRESSION_UNARY;
   e->source_pos = peek(p)->source_pos;
@@ -807,7 +825,6 @@ expression_t* ast_parse_expr_unary(parser_t* p)
     if (!operand) {
       error_report_at_token(p->error_ctx, peek(p), ERROR_SEVERITY_ERROR,
           "expected expression after unary operation");
-      free_expression(e);
       return NULL;
     }
     e->unary.operand = operand;
@@ -823,7 +840,6 @@ expression_t* ast_parse_expr_unary(parser_t* p)
       error_report_at_token(
         p->error_ctx, peek(p), ERROR_SEVERITY_ERROR,
         "expected identifier or literal before postfix operator");
-      free_expression(e);
       return NULL;
     }
    
@@ -872,7 +888,7 @@ expression_t* parse_primary(parser_t* p)
 
 expression_t* ast_parse_expr_char_lit(parser_t* p) 
 {
-  expression_t* expr = calloc(1, sizeof(expression_t));
+  expression_t* expr = arena_alloc(&p->arena, sizeof(expression_t));
   if (!expr) {
     error_report_general(ERROR_SEVERITY_ERROR, "out of memory"); 
     return NULL;
@@ -911,14 +927,11 @@ expression_t* parse_expression(parser_t* p)
     if (!rhs) {
       error_report_at_token(p->error_ctx, peek(p), ERROR_SEVERITY_ERROR,
                             "expected expression on right side of assignment");
-      free_expression(expr);
       return NULL;
     }
-    expression_t* assign = calloc(1, sizeof(expression_t));
+    expression_t* assign = arena_alloc(&p->arena, sizeof(expression_t));
     if (!assign) {
       error_report_general(ERROR_SEVERITY_ERROR, "out of memory");
-      free_expression(expr);
-      free_expression(rhs);
       return NULL;
     }
     assign->type = EXPRESSION_ASSIGN;
@@ -931,21 +944,68 @@ expression_t* parse_expression(parser_t* p)
   return expr;
 }
 
+
+// Statements of a function body up to and including its '}', the '{'
+// is already consumed
+static statement_block_t* parse_function_body(parser_t* p)
+{
+  statement_t* s;
+  statement_block_t* sb = arena_alloc(&p->arena, sizeof(statement_block_t));
+  if (!sb) {
+    error_report_general(ERROR_SEVERITY_ERROR, "out of memory"); 
+    return NULL;
+  }
+  while ((s = parse_statement(p)) != NULL)
+    arena_da_append(&p->arena, sb, s);
+
+  // consume '}'
+  if (!expect(p, '}', "expected '}' after function body")) {
+    return NULL; 
+  }
+
+  return sb;
+}
+
+// Advances past the '}' matching the '{' at `open` and records the body
+// source in `decl`, the types it can see are the ones declared so far
+static bool skip_function_body(parser_t* p, declaration_t* decl, const char* start)
+{
+  size_t depth = 1;
+  token_t* tok;
+  while ((tok = peek(p)) != NULL) {
+    if (tok->type == '{')
+      ++depth;
+    else if (tok->type == '}' && --depth == 0)
+      break;
+    advance(p);
+  }
+
+  const char* end = tok ? tok->source_pos : NULL;
+  // consume '}'
+  if (!expect(p, '}', "expected '}' after function body")) {
+    return false;
+  }
+
+  decl->func.body_start = start;
+  decl->func.body_end = end;
+  decl->func.body_types = p->types_visible ? p->types_visible : (type_id_t) p->types->count;
+  return true;
+}
+
 declaration_t* ast_parse_function(parser_t* p)
 {
-  declaration_t* decl = (declaration_t*) malloc(sizeof(declaration_t));
+  declaration_t* decl = arena_alloc(&p->arena, sizeof(declaration_t));
   if (!decl) { 
     error_report_general(ERROR_SEVERITY_ERROR, "out of memory");
     return NULL; 
   }
-  memset(decl, 0, sizeof(declaration_t));
 
   decl->type = DECLARATION_FUNC;
   decl->func.return_type = p->types->items[TYPE_UNTYPE];
   decl->source_pos = peek(p)->source_pos;
   decl->func.is_internal = false;
 
-  if (strcmp(peek(p)->string_value, "internal") == 0) {
+  if (check(p, LEXER_token_kw_internal)) {
     decl->func.is_internal = true;    
     // consume 'internal'
     advance(p);
@@ -954,13 +1014,13 @@ declaration_t* ast_parse_function(parser_t* p)
   // consume 'fn'
   advance(p);
 
-  if (check(p, LEXER_token_id)) {
+  if (check_name(p)) {
     token_t * name_tok = advance(p);
     if (name_tok->string_value) {
-      decl->func.name = strdup(name_tok->string_value);
+      decl->func.name = token_name(name_tok);
+      decl->func.atom = name_tok->atom;
       if (!decl->func.name) { 
         error_report_general(ERROR_SEVERITY_ERROR, "out of memory");
-        free_declaration(decl); 
         return NULL; 
       }
     }
@@ -970,12 +1030,10 @@ declaration_t* ast_parse_function(parser_t* p)
       error_report_at_token(p->error_ctx, tok, ERROR_SEVERITY_ERROR,
                            "expected function name");
     }
-    free_declaration(decl);
     return NULL;
   }
 
   if (!expect(p, '(', "expected '(' after function name")) {
-    free_declaration(decl);
     return NULL;
   }
 
@@ -988,7 +1046,6 @@ declaration_t* ast_parse_function(parser_t* p)
         error_report_at_token(p->error_ctx, tok, ERROR_SEVERITY_ERROR,
                              "expected parameter type");
       }
-      free_declaration(decl);
       return NULL;
     }
 
@@ -999,29 +1056,26 @@ declaration_t* ast_parse_function(parser_t* p)
         error_report_at_token(p->error_ctx, type_tok, ERROR_SEVERITY_ERROR,
                              "parameter type has no value");
       }
-      free_declaration(decl);
       return NULL;
     }
 
-    if (strcmp(type_tok->string_value, "var") == 0) {
+    if (type_tok->builtin_type == TYPE_VAR) {
       if (p->error_ctx) {
         error_report_at_token(
           p->error_ctx, type_tok, ERROR_SEVERITY_ERROR,
           "`var` cannot be use for functions parameters. Use an explicit type instead");
       }
-      free_declaration(decl);
       return NULL;
     }
 
-    known_type_t* type_info = get_type_info_from_string(
-        p, type_tok->string_value);
+    known_type_t* type_info = get_type_info_from_token(
+        p, type_tok);
     if (!type_info) {
       if (p->error_ctx) {
         error_report_at_token(p->error_ctx, type_tok,
-            ERROR_SEVERITY_ERROR, "unkown type: %s",
-            type_tok->string_value);
+            ERROR_SEVERITY_ERROR, "unkown type: %.*s",
+            type_tok->string_len, type_tok->string_value);
       } 
-      free_declaration(decl);
       return NULL;
     }
 
@@ -1033,13 +1087,12 @@ declaration_t* ast_parse_function(parser_t* p)
       param.is_constant = true;
     }
 
-    if (!check(p, LEXER_token_id)) {
+    if (!check_name(p)) {
       token_t* tok = peek(p);
       if (p->error_ctx && tok) {
         error_report_at_token(p->error_ctx, tok, ERROR_SEVERITY_ERROR,
                              "expected parameter name after type");
       }
-      free_declaration(decl);
       return NULL;
     }
     token_t* name_tok = advance(p);
@@ -1049,20 +1102,19 @@ declaration_t* ast_parse_function(parser_t* p)
         error_report_at_token(p->error_ctx, name_tok, ERROR_SEVERITY_ERROR,
                              "parameter name has no value");
       }
-      free_declaration(decl);
       return NULL;
     }
 
-    param.ident_name = strdup(name_tok->string_value);
+    param.ident_name = token_name(name_tok);
+    param.atom = name_tok->atom;
     if (!param.ident_name) {
       error_report_general(ERROR_SEVERITY_ERROR, "out of memory");
-      free_declaration(decl);
       return NULL;
     }
 
     param.source_pos = name_tok->source_pos;
 
-    da_append(&(decl->func.params), param);
+    arena_da_append(&p->arena, &(decl->func.params), param);
     if (check(p, ',')) {
       advance(p);
     }
@@ -1081,7 +1133,6 @@ declaration_t* ast_parse_function(parser_t* p)
         error_report_at_token(p->error_ctx, tok, ERROR_SEVERITY_ERROR,
                              "expected return type after ':'");
       }
-      free_declaration(decl);
       return NULL;
     }
 
@@ -1091,57 +1142,68 @@ declaration_t* ast_parse_function(parser_t* p)
         error_report_at_token(p->error_ctx, ret_tok, ERROR_SEVERITY_ERROR,
                              "return type has no value");
       }
-      free_declaration(decl);
       return NULL;
     }
 
     known_type_t* t = 
-      get_type_info_from_string(p, ret_tok->string_value);
+      get_type_info_from_token(p, ret_tok);
     if (!t) {
       error_report_at_token(
           p->error_ctx, ret_tok, ERROR_SEVERITY_ERROR,
           "unknown return type");
-      free_declaration(decl);
       return NULL;
     }
 
     decl->func.return_type = *t;
   }
 
+  // a token's source_pos is just past its last character
+  const char* open = peek(p) ? peek(p)->source_pos : NULL;
   if (!expect(p, '{', "expected '{' to start function body")) {
-    free_declaration(decl);
     return NULL;
   }
 
-  statement_t* s;
-  statement_block_t* sb = (statement_block_t*) malloc(sizeof(statement_block_t));
-  if (!sb) {
-    error_report_general(ERROR_SEVERITY_ERROR, "out of memory"); 
-    free_declaration(decl);
-    return NULL;
+  if (p->defer_bodies) {
+    if (!skip_function_body(p, decl, open))
+      return NULL;
+    return decl;
   }
-  memset(sb, 0, sizeof(statement_block_t));
-  while ((s = parse_statement(p)) != NULL)
-    da_append(sb, s);
 
-  decl->func.body = sb;
-  // consume '}'
-  if (!expect(p, '}', "expected '}' after function body")) {
-    free_declaration(decl);
-    return NULL; 
-  }
+  decl->func.body = parse_function_body(p);
+  if (!decl->func.body)
+    return NULL;
 
   return decl;
 }
 
+bool ast_parse_function_body(
+    parser_t* p, declaration_t* d, token_source_fn next, void* user)
+{
+  if (d->type != DECLARATION_FUNC || !d->func.body_start)
+    return true;
+
+  parser_t sub = {0};
+  sub.types = p->types;
+  sub.types_visible = d->func.body_types;
+  sub.error_ctx = p->error_ctx;
+  parser_init_stream(&sub, next, user);
+
+  d->func.body = parse_function_body(&sub);
+  d->func.body_start = NULL;
+  d->func.body_end = NULL;
+
+  arena_adopt(&p->arena, &sub.arena);
+  parser_free_tokens(&sub);
+  return d->func.body != NULL;
+}
+
 declaration_t* ast_parse_var_decl(parser_t* p)
 {
-  declaration_t* d = (declaration_t*) malloc(sizeof(declaration_t));
+  declaration_t* d = arena_alloc(&p->arena, sizeof(declaration_t));
   if (!d) {
     error_report_general(ERROR_SEVERITY_ERROR, "out of memory");
     return NULL;
   }
-  memset(d, 0, sizeof(declaration_t));
 
   d->type = DECLARATION_VAR;
   d->source_pos = peek(p)->source_pos;
@@ -1154,25 +1216,24 @@ declaration_t* ast_parse_var_decl(parser_t* p)
   if (!type_tok->string_value) {
     error_report_at_token(p->error_ctx, type_tok, ERROR_SEVERITY_ERROR,
        "expected type"); 
-    free_declaration(d);
     return NULL;
   }
 
   known_type_t* type_info = 
-    get_type_info_from_string(p, type_tok->string_value);
+    get_type_info_from_token(p, type_tok);
   if (!type_info) {
     if (p->error_ctx) {
       error_report_at_token(p->error_ctx, type_tok,
-         ERROR_SEVERITY_ERROR, "unknown type: %s",
-         type_tok->string_value); 
+         ERROR_SEVERITY_ERROR, "unknown type: %.*s",
+         type_tok->string_len, type_tok->string_value); 
     } 
-    free_declaration(d);
     return NULL;
   }
 
   d->var_decl.ident.is_constant = false;
-  type_info->array_len = 0;
+  // registry entries are shared, the copy is the one to adjust
   d->var_decl.ident.type = *type_info;
+  d->var_decl.ident.type.array_len = 0;
 
   if (check(p, '[')) {
     // consume '['
@@ -1182,7 +1243,6 @@ declaration_t* ast_parse_var_decl(parser_t* p)
       error_report_at_token(
          p->error_ctx, size_token, ERROR_SEVERITY_ERROR,
          "expected array length after array typed variable initilization"); 
-      free_declaration(d);
       return NULL;
     }
 
@@ -1200,14 +1260,13 @@ declaration_t* ast_parse_var_decl(parser_t* p)
     d->var_decl.ident.is_constant = true;
   }
 
-  if (!check(p, LEXER_token_id)) {
+  if (!check_name(p)) {
     token_t* tok = peek(p);
     if (p->error_ctx && tok) {
       error_report_at_token(
           p->error_ctx, tok, ERROR_SEVERITY_ERROR,
           "expected variable name");
     }
-    free_declaration(d);
     return NULL;
   }
 
@@ -1218,14 +1277,13 @@ declaration_t* ast_parse_var_decl(parser_t* p)
           p->error_ctx, name_tok, ERROR_SEVERITY_ERROR,
           "variable name has no value");
     }
-    free_declaration(d);
     return NULL;
   }
 
-  d->var_decl.ident.ident_name = strdup(name_tok->string_value);
+  d->var_decl.ident.ident_name = token_name(name_tok);
+  d->var_decl.ident.atom = name_tok->atom;
   if (!d->var_decl.ident.ident_name) {
     error_report_general(ERROR_SEVERITY_ERROR, "out of memory");
-    free_declaration(d);
     return NULL;
   }
 
@@ -1238,7 +1296,6 @@ declaration_t* ast_parse_var_decl(parser_t* p)
   }
 
   if (!expect(p, '=', "expected '=' in variable declaration")) {
-    free_declaration(d);
     return NULL;
   }
 
@@ -1249,13 +1306,11 @@ declaration_t* ast_parse_var_decl(parser_t* p)
       error_report_at_token(p->error_ctx, tok, ERROR_SEVERITY_ERROR,
                            "expected expression in variable initialization");
     }
-    free_declaration(d);
     return NULL;
   }
   d->var_decl.init = e;
 
   if (!expect(p, ';', "expected ';' after variable declaration")) {
-    free_declaration(d);
     return NULL;
   }
 
@@ -1264,12 +1319,11 @@ declaration_t* ast_parse_var_decl(parser_t* p)
 
 declaration_t* ast_parse_untype_var_decl(parser_t* p) 
 {
-  declaration_t* d = (declaration_t*) malloc(sizeof(declaration_t));
+  declaration_t* d = arena_alloc(&p->arena, sizeof(declaration_t));
   if (!d) {
     error_report_general(ERROR_SEVERITY_ERROR, "out of memory");
     return NULL;
   }
-  memset(d, 0, sizeof(declaration_t));
 
   d->type = DECLARATION_VAR;
   d->source_pos = peek(p)->source_pos;
@@ -1279,10 +1333,9 @@ declaration_t* ast_parse_untype_var_decl(parser_t* p)
 
   d->var_decl.ident.type.kind = TYPE_UNTYPE;
 
-  if (!check(p, LEXER_token_id)) {
+  if (!check_name(p)) {
     error_report_at_token(p->error_ctx, peek(p), ERROR_SEVERITY_ERROR,
                             "expected identifier variable name");
-    free_declaration(d);
     return NULL;
   }
 
@@ -1290,14 +1343,13 @@ declaration_t* ast_parse_untype_var_decl(parser_t* p)
   if (!name_tok->string_value) {
     error_report_at_token(p->error_ctx, name_tok, ERROR_SEVERITY_ERROR,
                             "identifier token has no value");
-    free_declaration(d);
     return NULL;
   }
 
-  d->var_decl.ident.type.name = strdup(name_tok->string_value);
+  d->var_decl.ident.type.name = token_name(name_tok);
+  d->var_decl.ident.type.atom = name_tok->atom;
   if (!d->var_decl.ident.type.name) {
     error_report_general(ERROR_SEVERITY_ERROR, "out of memory");
-    free_declaration(d);
     return NULL;
   }
 
@@ -1311,7 +1363,6 @@ declaration_t* ast_parse_untype_var_decl(parser_t* p)
   }
 
   if (!expect(p, '=', "expected '=' in variable declaration")) {
-    free_declaration(d);
     return NULL;
   }
 
@@ -1319,14 +1370,12 @@ declaration_t* ast_parse_untype_var_decl(parser_t* p)
   if (!e) {
     error_report_general(ERROR_SEVERITY_ERROR,
                           "error on expression parsing");
-    free_declaration(d);
     return NULL;
   }
 
   d->var_decl.init = e;
 
   if (!expect(p, ';', "expected ';' after variable declaration")) {
-    free_declaration(d);
     return NULL;
   }
 
@@ -1335,7 +1384,7 @@ declaration_t* ast_parse_untype_var_decl(parser_t* p)
 
 declaration_t* ast_parse_import_decl(parser_t* p)
 {
-  declaration_t* decl = calloc(1, sizeof(declaration_t));
+  declaration_t* decl = arena_alloc(&p->arena, sizeof(declaration_t));
   if (!decl) {
     error_report_general(ERROR_SEVERITY_ERROR, "out of memory"); 
     return NULL;
@@ -1351,7 +1400,6 @@ declaration_t* ast_parse_import_decl(parser_t* p)
       error_report_at_token(
           p->error_ctx, peek(p), ERROR_SEVERITY_ERROR,
           "expect identifier after `import`");
-      free_declaration(decl);
       return NULL;
     }
 
@@ -1360,17 +1408,15 @@ declaration_t* ast_parse_import_decl(parser_t* p)
       error_report_at_token(
           p->error_ctx, name_tok, ERROR_SEVERITY_ERROR,
           "expect module name");
-      free_declaration(decl);
       return NULL;
     }
 
-    char* n = strdup(name_tok->string_value);
+    char* n = ast_strdup(p, name_tok);
     if (!n) {
       error_report_general(ERROR_SEVERITY_ERROR, "out of memory"); 
-      free_declaration(decl);
       return NULL;
     }
-    da_append(&decl->import.path, n);
+    arena_da_append(&p->arena, &decl->import.path, n);
 
     if (!check(p, LEXER_token_coloncolon))
       break;
@@ -1379,8 +1425,7 @@ declaration_t* ast_parse_import_decl(parser_t* p)
     advance(p);
   } while (!check(p, LEXER_token_eof));
   
-  if (check(p, LEXER_token_id) &&
-      strcmp(peek(p)->string_value, "as") == 0) {
+  if (check(p, LEXER_token_kw_as)) {
     // consume 'as'
     advance(p); 
 
@@ -1389,14 +1434,12 @@ declaration_t* ast_parse_import_decl(parser_t* p)
       error_report_at_token(
           p->error_ctx, name_tok, ERROR_SEVERITY_ERROR,
           "expect module name");
-      free_declaration(decl);
       return NULL;
     }
 
-    char* alias = strdup(name_tok->string_value);
+    char* alias = ast_strdup(p, name_tok);
     if (!alias) {
       error_report_general(ERROR_SEVERITY_ERROR, "out of memory"); 
-      free_declaration(decl);
       return NULL;
     }
 
@@ -1408,7 +1451,7 @@ declaration_t* ast_parse_import_decl(parser_t* p)
 
 declaration_t* ast_parse_module_decl(parser_t* p)
 {
-  declaration_t* decl = calloc(1, sizeof(declaration_t));
+  declaration_t* decl = arena_alloc(&p->arena, sizeof(declaration_t));
   if (!decl) {
     error_report_general(ERROR_SEVERITY_ERROR, "out of memory"); 
     return NULL;
@@ -1424,7 +1467,6 @@ declaration_t* ast_parse_module_decl(parser_t* p)
       error_report_at_token(
           p->error_ctx, peek(p), ERROR_SEVERITY_ERROR,
           "expect module name after `module` keyword");
-      free_declaration(decl);
       return NULL;
     }
 
@@ -1433,17 +1475,15 @@ declaration_t* ast_parse_module_decl(parser_t* p)
       error_report_at_token(
           p->error_ctx, name_tok, ERROR_SEVERITY_ERROR,
           "expect module name");
-      free_declaration(decl);
       return NULL;
     }
 
-    char* m = strdup(name_tok->string_value);
+    char* m = ast_strdup(p, name_tok);
     if (!m) {
       error_report_general(ERROR_SEVERITY_ERROR, "out of memory");
-      free_declaration(decl);
       return NULL;
     }
-    da_append(&(decl->module.path), m);
+    arena_da_append(&p->arena, &(decl->module.path), m);
 
     if (!check(p, LEXER_token_coloncolon))
       break;
@@ -1458,7 +1498,7 @@ declaration_t* ast_parse_module_decl(parser_t* p)
 declaration_t* ast_parse_struct_decl(parser_t* p)
 {
   size_t total_struct_size = 0;
-  declaration_t* decl = calloc(1, sizeof(declaration_t));
+  declaration_t* decl = arena_alloc(&p->arena, sizeof(declaration_t));
   if (!decl) {
     error_report_general(ERROR_SEVERITY_ERROR, "out of memory");  
     return NULL;
@@ -1467,14 +1507,14 @@ declaration_t* ast_parse_struct_decl(parser_t* p)
   decl->type = DECLARATION_STRUCT;
   decl->source_pos = advance(p)->source_pos;
 
-  if (check(p, LEXER_token_id)) {
+  if (check_name(p)) {
     token_t* name_tok = advance(p);   
     if (name_tok->string_value) {
-      decl->struc.name = strdup(name_tok->string_value);   
+      decl->struc.name = token_name(name_tok);
+      decl->struc.atom = name_tok->atom;
       if (!decl->struc.name) {
         error_report_general(ERROR_SEVERITY_ERROR, 
             "out of memory");
-        free_declaration(decl);
         return NULL;
       }
     }
@@ -1484,12 +1524,10 @@ declaration_t* ast_parse_struct_decl(parser_t* p)
       error_report_at_token(p->error_ctx, tok, ERROR_SEVERITY_ERROR,
                            "expected struct name");
     }
-    free_declaration(decl);
     return NULL;
   }
 
   if (!expect(p, '{', "expected '{' after struct definition")) {
-    free_declaration(decl);
     return NULL;
   }
 
@@ -1502,7 +1540,6 @@ declaration_t* ast_parse_struct_decl(parser_t* p)
         error_report_at_token(p->error_ctx, tok, ERROR_SEVERITY_ERROR,
                              "expected member type");
       }
-      free_declaration(decl);
       return NULL;
     }
 
@@ -1513,29 +1550,26 @@ declaration_t* ast_parse_struct_decl(parser_t* p)
         error_report_at_token(p->error_ctx, type_tok, ERROR_SEVERITY_ERROR,
                              "parameter type has no value");
       }
-      free_declaration(decl);
       return NULL;
     }
 
-    if (strcmp(type_tok->string_value, "var") == 0) {
+    if (type_tok->builtin_type == TYPE_VAR) {
       if (p->error_ctx) {
         error_report_at_token(
           p->error_ctx, type_tok, ERROR_SEVERITY_ERROR,
           "`var` cannot be use for struct members. Use an explicit type instead");
       }
-      free_declaration(decl);
       return NULL;
     }
 
     known_type_t* type_info = 
-      get_type_info_from_string(p, type_tok->string_value);
+      get_type_info_from_token(p, type_tok);
     if (!type_info) {
       if (p->error_ctx) {
         error_report_at_token(p->error_ctx, type_tok,
-            ERROR_SEVERITY_ERROR, "unknown type: %s", 
-            type_tok->string_value);
+            ERROR_SEVERITY_ERROR, "unknown type: %.*s",
+            type_tok->string_len, type_tok->string_value);
       }
-      free_declaration(decl);
       return NULL;
     }
 
@@ -1547,14 +1581,13 @@ declaration_t* ast_parse_struct_decl(parser_t* p)
 
     member.type = *type_info;
   
-    if (!check(p, LEXER_token_id)) {
+    if (!check_name(p)) {
       token_t* tok = peek(p);
       if (p->error_ctx && tok) {
         error_report_at_token(p->error_ctx, tok, 
             ERROR_SEVERITY_ERROR,
             "expected member name after type");
       }
-      free_declaration(decl);
       return NULL;
     }
     token_t* name_tok = advance(p);
@@ -1565,21 +1598,20 @@ declaration_t* ast_parse_struct_decl(parser_t* p)
             p->error_ctx, name_tok, ERROR_SEVERITY_ERROR,
             "member name has no value");
       }
-      free_declaration(decl);
       return NULL;
     }
 
-    member.ident_name= strdup(name_tok->string_value);
+    member.ident_name = token_name(name_tok);
+    member.atom = name_tok->atom;
     if (!member.ident_name) {
       error_report_general(ERROR_SEVERITY_ERROR, "out of memory");
-      free_declaration(decl);
       return NULL;
     }
 
     member.source_pos = name_tok->source_pos;
     total_struct_size += type_info->size;
 
-    da_append(&(decl->struc.members), member);
+    arena_da_append(&p->arena, &(decl->struc.members), member);
     if (check(p, ';')) {
       advance(p);
     } else {
@@ -1592,11 +1624,15 @@ declaration_t* ast_parse_struct_decl(parser_t* p)
  }
 
   known_type_t t = {
-    .name = strdup(decl->struc.name),
+    .name = decl->struc.name,
+    .atom = decl->struc.atom,
     .size = total_struct_size,
     .kind = TYPE_CUSTOM
   };
-  da_append(p->types, t);
+  if (type_registry_add(p->types, t) == TYPE_ID_NONE) {
+    error_report_general(ERROR_SEVERITY_ERROR, "out of memory");
+    return NULL;
+  }
 
   // consume '}'
   advance(p);
@@ -1606,42 +1642,32 @@ declaration_t* ast_parse_struct_decl(parser_t* p)
 
 declaration_t* parse_declaration(parser_t* p)
 {
-  if (check(p, LEXER_token_id) && 
-      (strcmp(peek(p)->string_value, "fn") == 0 ||
-       strcmp(peek(p)->string_value, "internal") == 0)) {
-    return ast_parse_function(p);
-  }
-
-  if (check(p, LEXER_token_id) && 
-      strcmp(peek(p)->string_value, "struct") == 0) {
-    return ast_parse_struct_decl(p);
-  }
-
-  if (check(p, LEXER_token_id) &&
-      strcmp(peek(p)->string_value, "module") == 0) {
-    return ast_parse_module_decl(p); 
-  }
-
-  if (check(p, LEXER_token_id) &&
-      strcmp(peek(p)->string_value, "import") == 0) {
-    return ast_parse_import_decl(p); 
-  }
-
-  if (check(p, LEXER_token_id) && check_is_type(p)) {
-    return ast_parse_var_decl(p);
-  }
+  token_t* tok = peek(p);
 
-  if (check(p, LEXER_token_id) && strcmp(peek(p)->string_value, "var") == 0) {
-    return ast_parse_untype_var_decl(p);
+  switch (tok ? tok->type : LEXER_token_eof) {
+    case LEXER_token_kw_fn:
+    case LEXER_token_kw_internal:
+      return ast_parse_function(p);
+    case LEXER_token_kw_struct:
+      return ast_parse_struct_decl(p);
+    case LEXER_token_kw_module:
+      return ast_parse_module_decl(p);
+    case LEXER_token_kw_import:
+      return ast_parse_import_decl(p);
+    case LEXER_token_id:
+      if (check_is_type(p))
+        return ast_parse_var_decl(p);
+      if (tok->builtin_type == TYPE_VAR)
+        return ast_parse_untype_var_decl(p);
+      break;
   }
 
-  token_t* tok = peek(p);
   if (tok && p->error_ctx) {
     if (tok->string_value) {
       error_report_at_token(
           p->error_ctx, tok, ERROR_SEVERITY_ERROR,
-          "unexpected token '%s': expected declaration", 
-          tok->string_value);
+          "unexpected token '%.*s': expected declaration",
+          tok->string_len, tok->string_value);
     } else {
       error_report_at_token(
             p->error_ctx, tok, ERROR_SEVERITY_ERROR,
@@ -1654,12 +1680,11 @@ declaration_t* parse_declaration(parser_t* p)
 
 statement_t* ast_parse_return_stmt(parser_t* p) 
 {
-  statement_t* s = (statement_t*) malloc(sizeof(statement_t));
+  statement_t* s = arena_alloc(&p->arena, sizeof(statement_t));
   if (s == NULL) {
     error_report_general(ERROR_SEVERITY_ERROR, "out of memory");
     return NULL;
   }
-  memset(s, 0, sizeof(statement_t));
 
   s->type = STATEMENT_RETURN;
   s->source_pos = peek(p)->source_pos;
@@ -1670,7 +1695,6 @@ statement_t* ast_parse_return_stmt(parser_t* p)
   s->ret.value = parse_expression(p);
 
   if (!expect(p, ';', "expected ';' after return statement")) {
-    free_statement(s);
     return NULL;
   }
 
@@ -1679,12 +1703,11 @@ statement_t* ast_parse_return_stmt(parser_t* p)
 
 statement_t* ast_parse_decl_stmt(parser_t* p) 
 {
-  statement_t* s = (statement_t*) malloc(sizeof(statement_t));
+  statement_t* s = arena_alloc(&p->arena, sizeof(statement_t));
   if (s == NULL) {
     error_report_general(ERROR_SEVERITY_ERROR, "out of memory");
     return NULL;
   }
-  memset(s, 0, sizeof(statement_t));
   
   s->type = STATEMENT_DECL;
   s->source_pos = peek(p)->source_pos;
@@ -1692,7 +1715,6 @@ statement_t* ast_parse_decl_stmt(parser_t* p)
   s->decl_stmt.decl = parse_declaration(p);
   if (!s->decl_stmt.decl) {
     // Error already reported by ast_parse_var_decl
-    free_statement(s);
     return NULL;
   }
 
@@ -1701,12 +1723,11 @@ statement_t* ast_parse_decl_stmt(parser_t* p)
 
 statement_t* ast_parse_expr_stmt(parser_t* p) 
 {
-  statement_t* s = (statement_t*) malloc(sizeof(statement_t));
+  statement_t* s = arena_alloc(&p->arena, sizeof(statement_t));
   if (!s) {
     error_report_general(ERROR_SEVERITY_ERROR, "out of memory");
     return NULL;
   }
-  memset(s, 0, sizeof(statement_t));
 
   s->type = STATEMENT_EXPR;
   s->source_pos = peek(p)->source_pos;
@@ -1714,12 +1735,10 @@ statement_t* ast_parse_expr_stmt(parser_t* p)
   s->expr_stmt.expr = parse_expression(p);
   if (!s->expr_stmt.expr) {
     // Error already reported by parse_expression
-    free_statement(s);
     return NULL;
   }
 
   if(!expect(p, ';', "expected ';' after expression statement")) {
-    free_statement(s);
     return NULL; 
   }
 
@@ -1728,12 +1747,11 @@ statement_t* ast_parse_expr_stmt(parser_t* p)
 
 statement_t* ast_parse_if_stmt(parser_t* p) 
 {
-  statement_t* s = (statement_t*) malloc(sizeof(statement_t));
+  statement_t* s = arena_alloc(&p->arena, sizeof(statement_t));
   if (!s) {
     error_report_general(ERROR_SEVERITY_ERROR, "out of memory");
     return NULL; 
   }
-  memset(s, 0, sizeof(statement_t));
 
   s->type = STATEMENT_IF;
   s->source_pos = peek(p)->source_pos;
@@ -1742,34 +1760,28 @@ statement_t* ast_parse_if_stmt(parser_t* p)
   advance(p);
 
   if (!expect(p, '(', "expected '(' after if statement")) {
-    free_statement(s);  
     return NULL;
   }
   s->if_stmt.condition = parse_expression(p);
   if (!s->if_stmt.condition) {
     error_report_at_token(p->error_ctx, peek(p), ERROR_SEVERITY_ERROR,
              "expected condition"); 
-    free_statement(s);
     return NULL;
   }
 
   if (!expect(p, ')', "expected ')' after expression")) {
-    free_statement(s);
     return NULL; 
   }
 
   if (!expect(p, '{', "expected '{' after statement")) {
-    free_statement(s);
     return NULL;  
   }
 
-  statement_block_t* then_sb = (statement_block_t*) malloc(sizeof(statement_block_t));
+  statement_block_t* then_sb = arena_alloc(&p->arena, sizeof(statement_block_t));
   if (!then_sb) {
     error_report_general(ERROR_SEVERITY_ERROR, "out of memory");
-    free_statement(s);
     return NULL; 
   }
-  memset(then_sb, 0, sizeof(statement_block_t));
   s->if_stmt.then_branch = then_sb;
   
   while (!check(p, '}')) {
@@ -1777,46 +1789,39 @@ statement_t* ast_parse_if_stmt(parser_t* p)
     if (!stmt) {
       error_report_at_token(p->error_ctx, peek(p), ERROR_SEVERITY_ERROR, 
             "expected statement"); 
-      free_statement(s);
       return NULL;
     }
-    da_append(then_sb, stmt);
+    arena_da_append(&p->arena, then_sb, stmt);
   }
 
   if (!expect(p, '}', "expected '}' after if body")) {
-    free_statement(s); 
     return NULL;
   }
 
-  if (check(p, LEXER_token_id) && strcmp(peek(p)->string_value, "else") == 0) {
+  if (check(p, LEXER_token_kw_else)) {
     advance(p); 
 
     if (!expect(p, '{', "expected '{' after else stmt")) {
-      free_statement(s);
       return NULL; 
     }
 
-    statement_block_t* else_sb = (statement_block_t*) malloc(sizeof(statement_block_t));
+    statement_block_t* else_sb = arena_alloc(&p->arena, sizeof(statement_block_t));
     if (!else_sb) {
       error_report_general(ERROR_SEVERITY_ERROR, "out of memory");
-      free_statement(s);
       return NULL;
     }
-    memset(else_sb, 0, sizeof(statement_block_t));
     s->if_stmt.else_branch = else_sb;
     
     while (!check(p, '}')) {
       statement_t* stmt = parse_statement(p);
       if (!stmt) {
         error_report_general(ERROR_SEVERITY_ERROR, "out of memory"); 
-        free_statement(s);
         return NULL;
       } 
-      da_append(else_sb, stmt);
+      arena_da_append(&p->arena, else_sb, stmt);
     }
 
     if (!expect(p, '}', "expected '}' after else body")) {
-      free_statement(s);
       return NULL;
     }
   }
@@ -1826,12 +1831,11 @@ statement_t* ast_parse_if_stmt(parser_t* p)
 
 statement_t* ast_parse_while_stmt(parser_t* p)
 {
-  statement_t* s = (statement_t*) malloc(sizeof(statement_t));
+  statement_t* s = arena_alloc(&p->arena, sizeof(statement_t));
   if (!s) {
     error_report_general(ERROR_SEVERITY_ERROR, "out of memory"); 
     return NULL;
   }
-  memset(s, 0, sizeof(statement_t));
 
   s->type = STATEMENT_WHILE;
   s->source_pos = peek(p)->source_pos;
@@ -1840,7 +1844,6 @@ statement_t* ast_parse_while_stmt(parser_t* p)
   advance(p);
 
   if (!expect(p, '(', "expected '(' after while identifier")) {
-    free_statement(s);
     return NULL; 
   }
 
@@ -1848,29 +1851,24 @@ statement_t* ast_parse_while_stmt(parser_t* p)
   if (!cond) {
     error_report_at_token(p->error_ctx, peek(p), ERROR_SEVERITY_ERROR,
         "expected condition in while statement");
-    free_statement(s);
     return NULL;
   }
 
   s->while_stmt.condition = cond;
 
   if (!expect(p, ')', "expected ')' after condition")) {
-    free_statement(s); 
     return NULL;
   }
 
   if (!expect(p, '{', "expected '{' after while declaration")) {
-    free_statement(s);  
     return NULL;
   }
 
-  statement_block_t* block = (statement_block_t*) malloc(sizeof(statement_block_t));
+  statement_block_t* block = arena_alloc(&p->arena, sizeof(statement_block_t));
   if (!block) {
     error_report_general(ERROR_SEVERITY_ERROR, "out of memory"); 
-    free_statement(s);
     return NULL;
   }
-  memset(block, 0, sizeof(statement_block_t));
   s->while_stmt.body = block;
   
   while(!check(p, '}')) {
@@ -1878,14 +1876,12 @@ statement_t* ast_parse_while_stmt(parser_t* p)
     if (!stmt) {
       error_report_at_token(p->error_ctx, peek(p), ERROR_SEVERITY_ERROR,
          "expected statement in while body"); 
-      free_statement(s);
       return NULL;
     }
-    da_append(block, stmt);
+    arena_da_append(&p->arena, block, stmt);
   }
 
   if (!expect(p, '}', "expected '}' after while body")) {
-    free_statement(s); 
     return NULL;
   }
 
@@ -1894,12 +1890,11 @@ statement_t* ast_parse_while_stmt(parser_t* p)
 
 statement_t* ast_parse_for_stmt(parser_t* p)
 {
-  statement_t* s = (statement_t*) malloc(sizeof(statement_t));
+  statement_t* s = arena_alloc(&p->arena, sizeof(statement_t));
   if (!s) {
     error_report_general(ERROR_SEVERITY_ERROR, "out of memory"); 
     return NULL;
   }
-  memset(s, 0, sizeof(statement_t));
 
   s->type = STATEMENT_FOR;
   s->source_pos = peek(p)->source_pos;
@@ -1908,16 +1903,14 @@ statement_t* ast_parse_for_stmt(parser_t* p)
   advance(p);
 
   if (!expect(p, '(', "expected '(' after for statement")) {
-    free_statement(s);
     return NULL; 
   }
   
-  if (check_is_type(p) || strcmp(peek(p)->string_value, "var") == 0) {
+  if (check_is_type(p)) {
     declaration_t* init = parse_declaration(p);
     if (!init) {
       error_report_at_token(p->error_ctx, peek(p), ERROR_SEVERITY_ERROR,
          "expected init declaration"); 
-      free_statement(s);
       return NULL;
     }
     s->for_stmt.init_kind = FOR_INIT_DECL;
@@ -1927,14 +1920,12 @@ statement_t* ast_parse_for_stmt(parser_t* p)
     if (!init) {
       error_report_at_token(p->error_ctx, peek(p), ERROR_SEVERITY_ERROR,
           "expected init expression"); 
-      free_statement(s);
       return NULL;
     }
     s->for_stmt.init_kind = FOR_INIT_EXPR;
     s->for_stmt.expr_init = init;
 
     if (!expect(p, ';', "expected ';' between for expressions")) {
-      free_statement(s);
       return NULL; 
     }  
   }
@@ -1943,13 +1934,11 @@ statement_t* ast_parse_for_stmt(parser_t* p)
   if (!condition) {
     error_report_at_token(p->error_ctx, peek(p), ERROR_SEVERITY_ERROR,
        "expected condition expression"); 
-    free_statement(s);
     return NULL;
   }
   s->for_stmt.condition = condition;
 
   if (!expect(p, ';', "expected ';' between for expressions")) {
-    free_statement(s);
     return NULL; 
   }
 
@@ -1957,28 +1946,23 @@ statement_t* ast_parse_for_stmt(parser_t* p)
   if (!loop) {
     error_report_at_token(p->error_ctx, peek(p), ERROR_SEVERITY_ERROR,
        "expected loop expression"); 
-    free_statement(s);
     return NULL;
   }
   s->for_stmt.loop = loop;
 
   if (!expect(p, ')', "expected ')' after for statement")) {
-    free_statement(s);
     return NULL; 
   }
 
   if (!expect(p, '{', "expected '{' after for declaration")) {
-    free_statement(s); 
     return NULL;
   }
 
-  statement_block_t* body = (statement_block_t*) malloc(sizeof(statement_block_t));
+  statement_block_t* body = arena_alloc(&p->arena, sizeof(statement_block_t));
   if (!body) {
     error_report_general(ERROR_SEVERITY_ERROR, "out of memory");
-    free_statement(s);
     return NULL;
   }
-  memset(body, 0, sizeof(statement_block_t));
   s->for_stmt.body = body;
 
   while(!check(p, '}')) {
@@ -1986,14 +1970,12 @@ statement_t* ast_parse_for_stmt(parser_t* p)
     if (!stmt) {
       error_report_at_token(p->error_ctx, peek(p), ERROR_SEVERITY_ERROR,
          "expected statement"); 
-      free_statement(s);
       return NULL;
     }
-    da_append(body, stmt);
+    arena_da_append(&p->arena, body, stmt);
   }
 
   if (!expect(p, '}', "expected '}' after body")) {
-    free_statement(s);
     return NULL; 
   }
 
@@ -2002,7 +1984,7 @@ statement_t* ast_parse_for_stmt(parser_t* p)
 
 statement_t* ast_parse_asm_stmt(parser_t* p)
 {
-  statement_t* stmt = calloc(1, sizeof(statement_t));
+  statement_t* stmt = arena_alloc(&p->arena, sizeof(statement_t));
   if (!stmt) {
     error_report_general(ERROR_SEVERITY_ERROR, "out of memory"); 
     return NULL;
@@ -2034,17 +2016,17 @@ statement_t* ast_parse_asm_stmt(parser_t* p)
   }
 
   stmt->asm_stmt.instr = 
-    calloc(stmt->asm_stmt.instr_count, sizeof(char*));
+    arena_alloc(&p->arena, stmt->asm_stmt.instr_count * sizeof(char*));
   stmt->asm_stmt.instr_count = 0;
 
   stmt->asm_stmt.args =
-    calloc(stmt->asm_stmt.arg_count, sizeof(expression_t*));
+    arena_alloc(&p->arena, stmt->asm_stmt.arg_count * sizeof(expression_t*));
   stmt->asm_stmt.arg_count = 0;
 
   while (!check(p, ')')) {
     if (check(p, LEXER_token_dqstring)) {
       stmt->asm_stmt.instr[stmt->asm_stmt.instr_count++] =
-        strdup(peek(p)->string_value);
+        ast_strdup(p, peek(p));
       if (!stmt->asm_stmt.instr[stmt->asm_stmt.instr_count - 1]) {
         error_report_general(
             ERROR_SEVERITY_ERROR, "out of memory"); 
@@ -2071,7 +2053,7 @@ statement_t* ast_parse_asm_stmt(parser_t* p)
 
 statement_t* ast_parse_free_stmt(parser_t* p)
 {
-  statement_t* stmt = calloc(1, sizeof(statement_t));
+  statement_t* stmt = arena_alloc(&p->arena, sizeof(statement_t));
   if (!stmt) {
     error_report_general(ERROR_SEVERITY_ERROR, "out of memory"); 
     return NULL;
@@ -2086,7 +2068,6 @@ statement_t* ast_parse_free_stmt(parser_t* p)
   stmt->free_stmt.expr = parse_expression(p);
   if (!stmt->free_stmt.expr) {
     // TODO: maybe make error stack 
-    free_statement(stmt);
     return NULL;
   }
 
@@ -2098,45 +2079,28 @@ statement_t* ast_parse_free_stmt(parser_t* p)
 
 statement_t* parse_statement(parser_t* p) 
 {
-  if (check(p, LEXER_token_id) && 
-      strcmp(peek(p)->string_value, "return") == 0) {
-    return ast_parse_return_stmt(p);
-  } 
-
-  if (check(p, LEXER_token_id) && 
-      strcmp(peek(p)->string_value, "if") == 0) {
-    return ast_parse_if_stmt(p);
-  }
-
-  if (check(p, LEXER_token_id) && 
-      strcmp(peek(p)->string_value, "while") == 0) {
-    return ast_parse_while_stmt(p);
-  }
-
-  if (check(p, LEXER_token_id) && 
-      strcmp(peek(p)->string_value, "for") == 0) {
-    return ast_parse_for_stmt(p); 
-  }
-
-  if (check(p, LEXER_token_id) &&
-      strcmp(peek(p)->string_value, "asm") == 0) {
-    return ast_parse_asm_stmt(p); 
-  }
+  token_t* tok = peek(p);
+  if (!tok)
+    return NULL;
 
-  if (check(p, LEXER_token_id) &&
-      strcmp(peek(p)->string_value, "free") == 0) {
-    return ast_parse_free_stmt(p); 
+  switch (tok->type) {
+    case LEXER_token_kw_return:
+      return ast_parse_return_stmt(p);
+    case LEXER_token_kw_if:
+      return ast_parse_if_stmt(p);
+    case LEXER_token_kw_while:
+      return ast_parse_while_stmt(p);
+    case LEXER_token_kw_for:
+      return ast_parse_for_stmt(p);
+    case LEXER_token_kw_asm:
+      return ast_parse_asm_stmt(p);
+    case LEXER_token_kw_free:
+      return ast_parse_free_stmt(p);
+    case LEXER_token_id:
+      if (check_is_type(p))
+        return ast_parse_decl_stmt(p);
+      break;
   }
 
-  // WARNING: this can be unsafe if string_value is NULL
-  // TODO: keep an eye on this
-  if (check(p, LEXER_token_id) && ((check_is_type(p)) || 
-      strcmp(peek(p)->string_value, "var") == 0)) {
-    return ast_parse_decl_stmt(p);
-  } 
-
-  if ((size_t) p->pos < p->count) 
-    return ast_parse_expr_stmt(p);
-
-  return NULL;
+  return ast_parse_expr_stmt(p);
 }
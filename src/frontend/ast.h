@@ -8,8 +8,36 @@
 
 #include "lexer.h"
 #include "ast_definition.h"
+#include "../thirdparty/arena.h"
 #include "../thirdparty/error.h"
 #include "types.h"
+#include "type_registry.h"
+
+// Fills `out` with up to `max` tokens and returns how many were produced,
+// fewer than `max` once the input is exhausted (or the lexer failed)
+typedef size_t (*token_source_fn)(void* user, token_t* out, size_t max);
+
+#define PARSER_BLOCK_TOKENS 256
+
+typedef struct
+{
+  token_t** items; // blocks of PARSER_BLOCK_TOKENS tokens
+  size_t count;
+  size_t capacity;
+} token_block_array;
+
+// Tokens pulled on demand from a token source. Blocks are only dropped by
+// parser_release_consumed: the parse functions hold on to tokens they
+// advanced over until they return.
+typedef struct
+{
+  token_source_fn   next;  // NULL when the parser reads `items`
+  void*             user;
+  token_block_array blocks;
+  size_t            first; // index of the first token of blocks.items[0]
+  size_t            lexed; // tokens produced so far
+  bool              done;
+} token_window_t;
 
 typedef struct 
 {
@@ -19,11 +47,48 @@ typedef struct
 
   int pos;
 
-  known_type_array* types;
+  type_registry_t* types;
+  // types with a lower id are the ones declared so far, 0 when the
+  // parser sees the whole registry
+  type_id_t types_visible;
+
+  // function bodies are skipped and only their source range recorded
+  bool defer_bodies;
+
+  // AST nodes, their child arrays and copied strings
+  arena_t arena;
   
   error_context_t* error_ctx;
+
+  token_window_t window;
 } parser_t;
 
+// Makes the parser lex on demand through `next` instead of reading a
+// token array filled beforehand
+void parser_init_stream(parser_t* p, token_source_fn next, void* user);
+
+// Frees the tokens already consumed. Only call it between two top-level
+// declarations, when no parse function holds a token.
+void parser_release_consumed(parser_t* p);
+
+// Tokens read or produced so far
+size_t parser_token_count(parser_t* p);
+
+// Frees every token still owned by the parser, in either mode
+void parser_free_tokens(parser_t* p);
+
+// Frees every node parsed so far, the parsed declarations become invalid
+void parser_free_ast(parser_t* p);
+
+// Whether an identifier or string token spells `text`, false for NULL
+bool token_is(const token_t* tok, const char* text);
+
+// Interned text of an identifier token, NULL when out of memory
+const char* token_name(const token_t* tok);
+
+// NUL-terminated copy of the text of an identifier or string token
+char* token_strdup(const token_t* tok);
+
 // Get the actual token at pos
 token_t* peek(parser_t* p);
 token_t* peek_next(parser_t* p, int range);
@@ -35,14 +100,17 @@ token_t* advance(parser_t* p);
 bool check(parser_t* p, long kind);
 bool check_next(parser_t* p, long kind, int range);
 bool check_is_type(parser_t* p);
+// Check if the actual token can name a declaration: an identifier or a
+// keyword
+bool check_name(parser_t* p);
 
 // Check if the actual token is of kind
 // If yes, advance pos
 bool expect(parser_t* p, long kind, char* err);
 
-known_type_t* get_type_info_from_string(
+known_type_t* get_type_info_from_token(
     parser_t* p,
-    const char* type_string);
+    const token_t* type_tok);
 
 declaration_t* ast_parse_function(parser_t* p);
 declaration_t* ast_parse_var_decl(parser_t* p);
@@ -52,6 +120,12 @@ declaration_t* ast_parse_module_decl(parser_t* p);
 declaration_t* ast_parse_import_decl(parser_t* p);
 declaration_t* parse_declaration(parser_t* p);
 
+// Parses the body of `d` if it was deferred, from the tokens `next`
+// lexes out of its body_start..body_end range. Nodes go to `p->arena`.
+// Returns false after reporting an error.
+bool ast_parse_function_body(
+    parser_t* p, declaration_t* d, token_source_fn next, void* user);
+
 statement_t*   ast_parse_return_stmt(parser_t* p);
 statement_t*   ast_parse_decl_stmt(parser_t* p);
 statement_t*   ast_parse_expr_stmt(parser_t* p);
@@ -77,10 +151,9 @@ expression_t*  ast_parse_expr_char_lit(parser_t* p);
 expression_t*  ast_parse_expr_array_composite_literal(parser_t* p);
 expression_t*  ast_parse_expr_index(parser_t* p);
 
-void populate_parser_known_type(known_type_array* types);
+void populate_parser_known_type(type_registry_t* types);
 
-void free_declaration(declaration_t* d);
-void free_statement(statement_t* s);
-void free_expression(expression_t* e);
+// Number of declaration, statement and expression nodes under `d`
+size_t ast_count_nodes(declaration_t* d);
 
 #endif // AST_H
@@ -5,6 +5,7 @@
 #include <stdbool.h>
 
 #include "types.h"
+#include "../thirdparty/intern.h"
 
 // ----------------- Enums ------------------
 
@@ -80,8 +81,18 @@ typedef struct expression_t expression_t;
 
 // ----------------- Types and Identifiers ------------------
 
+// index of a type in its module's type_registry_t
+typedef uint32_t type_id_t;
+#define TYPE_ID_NONE ((type_id_t) -1)
+
+// index of a node in its pool of an ast_flat_t
+typedef uint32_t ast_ref_t;
+#define AST_REF_NONE UINT32_MAX
+
 typedef struct {
-  char* name;
+  const char* name;
+  atom_t atom; // of `name` for custom types
+  type_id_t id; // registration order, for types the parser resolved
   size_t size; // in bytes
   size_t element_size;
   size_t array_len;
@@ -91,19 +102,14 @@ typedef struct {
 typedef struct 
 {
   known_type_t type; 
-  char* ident_name;
+  const char* ident_name; // interned
+  atom_t atom;
   const char* source_pos;
   bool is_constant;
 } typed_identifier_t;
 
 // ----------------- Dynamic arrays ------------------
 
-typedef struct {
-  known_type_t* items;
-  size_t count;
-  size_t capacity; 
-} known_type_array;
-
 typedef struct 
 {
   typed_identifier_t* items;
@@ -146,15 +152,22 @@ struct declaration_t
     } var_decl;
 
     struct { 
-      char* name;  
+      const char* name; // interned
+      atom_t atom;
       known_type_t return_type; 
       typed_identifier_array params; 
       statement_block_t* body;
+      // source of a body the parser skipped, after its '{' up to and
+      // including its '}', NULL once parsed (see ast_parse_function_body)
+      const char* body_start;
+      const char* body_end;
+      type_id_t body_types; // types_visible for the body
       bool is_internal;
     } func;
 
     struct {
-      char* name;
+      const char* name; // interned
+      atom_t atom;
       typed_identifier_array members; 
     } struc;
 
@@ -215,6 +228,7 @@ struct expression_t
 {
   expression_kind type;
   const char* source_pos;
+  ast_ref_t flat; // in the module's ast_flat_t, set by ast_flat_build
 
   union {
     struct { int value; } int_lit;
@@ -230,11 +244,11 @@ struct expression_t
       binary_op_kind op;
     } binary;
     struct { 
-      char* qualifier;
-      char* callee; 
+      const char* qualifier; // interned
+      const char* callee; // interned
+      atom_t callee_atom;
       expression_t** args; 
       size_t arg_count; 
-      char* resolved_module;
     } call;
     struct {
       unary_op_kind op;
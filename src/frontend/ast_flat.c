@@ -0,0 +1,481 @@
+#include "ast_flat.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "../thirdparty/error.h"
+
+static bool pool_reserve(ast_pool_t* pool, void** cold, size_t cold_size)
+{
+  if (pool->count < pool->capacity)
+    return true;
+
+  size_t capacity = pool->capacity ? pool->capacity * 2 : 256;
+  uint8_t* kind = realloc(pool->kind, capacity);
+  if (kind) pool->kind = kind;
+  uint8_t* type = realloc(pool->type, capacity);
+  if (type) pool->type = type;
+  uint32_t* source = realloc(pool->source, capacity * sizeof(uint32_t));
+  if (source) pool->source = source;
+  ast_ref_t* a = realloc(pool->a, capacity * sizeof(ast_ref_t));
+  if (a) pool->a = a;
+  ast_ref_t* b = realloc(pool->b, capacity * sizeof(ast_ref_t));
+  if (b) pool->b = b;
+  void* c = realloc(*cold, capacity * cold_size);
+  if (c) *cold = c;
+
+  if (!kind || !type || !source || !a || !b || !c)
+    return false;
+  pool->capacity = capacity;
+  return true;
+}
+
+static uint32_t source_offset(const char* source, const char* pos)
+{
+  return source && pos && pos >= source ? (uint32_t) (pos - source) : AST_SOURCE_NONE;
+}
+
+// Slot for the type of a variable reference, -1 when out of memory
+static int32_t var_type_add(ast_flat_t* flat, known_type_t type)
+{
+  if (flat->var_types_count == flat->var_types_capacity) {
+    size_t capacity = flat->var_types_capacity ? flat->var_types_capacity * 2 : 64;
+    known_type_t* types = realloc(flat->var_types, capacity * sizeof(known_type_t));
+    if (!types) {
+      error_report_general(ERROR_SEVERITY_ERROR, "out of memory");
+      return -1;
+    }
+    flat->var_types = types;
+    flat->var_types_capacity = capacity;
+  }
+
+  flat->var_types[flat->var_types_count] = type;
+  return (int32_t) flat->var_types_count++;
+}
+
+// Adds a node with no children yet, AST_REF_NONE when out of memory
+static ast_ref_t pool_add(ast_pool_t* pool, void** cold, size_t cold_size,
+    uint8_t kind, uint8_t type, uint32_t source)
+{
+  if (!pool_reserve(pool, cold, cold_size)) {
+    error_report_general(ERROR_SEVERITY_ERROR, "out of memory");
+    return AST_REF_NONE;
+  }
+
+  ast_ref_t ref = (ast_ref_t) pool->count++;
+  pool->kind[ref] = kind;
+  pool->type[ref] = type;
+  pool->source[ref] = source;
+  pool->a[ref] = AST_REF_NONE;
+  pool->b[ref] = AST_REF_NONE;
+  memset((char*) *cold + ref * cold_size, 0, cold_size);
+  return ref;
+}
+
+// Reserves `count` consecutive list slots, filled in by the caller
+static bool list_reserve(ast_flat_t* flat, size_t count, ast_range_t* range)
+{
+  range->first = (uint32_t) flat->lists_count;
+  range->count = (uint32_t) count;
+
+  if (flat->lists_count + count > flat->lists_capacity) {
+    size_t capacity = flat->lists_capacity ? flat->lists_capacity * 2 : 256;
+    while (capacity < flat->lists_count + count)
+      capacity *= 2;
+    ast_ref_t* lists = realloc(flat->lists, capacity * sizeof(ast_ref_t));
+    if (!lists) {
+      error_report_general(ERROR_SEVERITY_ERROR, "out of memory");
+      return false;
+    }
+    flat->lists = lists;
+    flat->lists_capacity = capacity;
+  }
+
+  flat->lists_count += count;
+  return true;
+}
+
+typedef struct {
+  ast_flat_t* flat;
+  const char* source;
+  bool failed;
+} flat_builder_t;
+
+static ast_ref_t flatten_statement(flat_builder_t* b, const statement_t* s);
+static ast_ref_t flatten_declaration(flat_builder_t* b, const declaration_t* d);
+
+static ast_ref_t flatten_expression(flat_builder_t* b, expression_t* e)
+{
+  if (!e || b->failed)
+    return AST_REF_NONE;
+
+  ast_flat_t* flat = b->flat;
+  types_t type = TYPE_UNTYPE;
+  if (e->type == EXPRESSION_INT_LIT)
+    type = TYPE_INT;
+  else if (e->type == EXPRESSION_CHAR_LIT)
+    type = TYPE_CHAR;
+  else if (e->type == EXPRESSION_VAR)
+    type = e->var.ident.type.kind;
+
+  ast_ref_t ref = pool_add(&flat->exprs, (void**) &flat->expr_cold,
+      sizeof(ast_expr_cold_t), (uint8_t) e->type, (uint8_t) type,
+      source_offset(b->source, e->source_pos));
+  if (ref == AST_REF_NONE) {
+    b->failed = true;
+    return ref;
+  }
+  e->flat = ref;
+
+  ast_ref_t first = AST_REF_NONE, second = AST_REF_NONE;
+  expression_t* const* items = NULL;
+  size_t count = 0;
+
+  switch (e->type) {
+  case EXPRESSION_INT_LIT:
+    flat->expr_cold[ref].value = e->int_lit.value;
+    break;
+  case EXPRESSION_CHAR_LIT:
+    flat->expr_cold[ref].value = e->char_lit.value;
+    break;
+  case EXPRESSION_VAR: {
+    int32_t slot = var_type_add(flat, e->var.ident.type);
+    if (slot < 0) {
+      b->failed = true;
+      return AST_REF_NONE;
+    }
+    flat->expr_cold[ref].name = e->var.ident.atom;
+    flat->expr_cold[ref].value = slot;
+    first = flatten_expression(b, e->var.member);
+    break;
+  }
+  case EXPRESSION_ASSIGN:
+    first = flatten_expression(b, e->assign.lhs);
+    second = flatten_expression(b, e->assign.rhs);
+    break;
+  case EXPRESSION_BINARY:
+    flat->expr_cold[ref].op = e->binary.op;
+    first = flatten_expression(b, e->binary.left);
+    second = flatten_expression(b, e->binary.right);
+    break;
+  case EXPRESSION_UNARY:
+    flat->expr_cold[ref].op = e->unary.op;
+    first = flatten_expression(b, e->unary.operand);
+    break;
+  case EXPRESSION_INDEX:
+    first = flatten_expression(b, e->index.base);
+    second = flatten_expression(b, e->index.index);
+    break;
+  case EXPRESSION_CALL:
+    flat->expr_cold[ref].name = e->call.callee_atom;
+    flat->expr_cold[ref].qualifier =
+      e->call.qualifier ? intern_cstr(e->call.qualifier) : ATOM_NONE;
+    items = e->call.args;
+    count = items ? e->call.arg_count : 0;
+    break;
+  case EXPRESSION_COMPOSITE_LITERAL:
+    flat->expr_cold[ref].value = e->composite_literal.is_initializer;
+    items = e->composite_literal.values;
+    count = items ? e->composite_literal.count : 0;
+    break;
+  }
+
+  if (count) {
+    ast_range_t range;
+    if (!list_reserve(flat, count, &range)) {
+      b->failed = true;
+      return AST_REF_NONE;
+    }
+    for (size_t i = 0; i < count; ++i) {
+      ast_ref_t arg = flatten_expression(b, items[i]);
+      flat->lists[range.first + i] = arg;
+    }
+    flat->expr_cold[ref].list = range;
+  }
+
+  flat->exprs.a[ref] = first;
+  flat->exprs.b[ref] = second;
+  return ref;
+}
+
+static ast_range_t flatten_block(flat_builder_t* b, const statement_block_t* block)
+{
+  ast_range_t range = { 0, 0 };
+  if (!block || !block->count || b->failed)
+    return range;
+
+  if (!list_reserve(b->flat, block->count, &range)) {
+    b->failed = true;
+    return range;
+  }
+  for (size_t i = 0; i < block->count; ++i) {
+    ast_ref_t s = flatten_statement(b, block->items[i]);
+    b->flat->lists[range.first + i] = s;
+  }
+  return range;
+}
+
+static ast_ref_t flatten_statement(flat_builder_t* b, const statement_t* s)
+{
+  if (!s || b->failed)
+    return AST_REF_NONE;
+
+  ast_flat_t* flat = b->flat;
+  ast_ref_t ref = pool_add(&flat->stmts, (void**) &flat->stmt_cold,
+      sizeof(ast_stmt_cold_t), (uint8_t) s->type, TYPE_UNTYPE,
+      source_offset(b->source, s->source_pos));
+  if (ref == AST_REF_NONE) {
+    b->failed = true;
+    return ref;
+  }
+  flat->stmt_cold[ref].loop = AST_REF_NONE;
+
+  ast_ref_t first = AST_REF_NONE, second = AST_REF_NONE;
+  ast_range_t body = { 0, 0 }, other = { 0, 0 };
+
+  switch (s->type) {
+  case STATEMENT_RETURN:
+    first = flatten_expression(b, s->ret.value);
+    break;
+  case STATEMENT_EXPR:
+    first = flatten_expression(b, s->expr_stmt.expr);
+    break;
+  case STATEMENT_FREE:
+    first = flatten_expression(b, s->free_stmt.expr);
+    break;
+  case STATEMENT_DECL:
+    first = flatten_declaration(b, s->decl_stmt.decl);
+    break;
+  case STATEMENT_IF:
+    first = flatten_expression(b, s->if_stmt.condition);
+    body = flatten_block(b, s->if_stmt.then_branch);
+    other = flatten_block(b, s->if_stmt.else_branch);
+    break;
+  case STATEMENT_WHILE:
+    first = flatten_expression(b, s->while_stmt.condition);
+    body = flatten_block(b, s->while_stmt.body);
+    break;
+  case STATEMENT_FOR: {
+    bool init_decl = s->for_stmt.init_kind == FOR_INIT_DECL;
+    first = init_decl
+      ? flatten_declaration(b, s->for_stmt.decl_init)
+      : flatten_expression(b, s->for_stmt.expr_init);
+    second = flatten_expression(b, s->for_stmt.condition);
+    ast_ref_t loop = flatten_expression(b, s->for_stmt.loop);
+    body = flatten_block(b, s->for_stmt.body);
+    if (b->failed)
+      return AST_REF_NONE;
+    flat->stmt_cold[ref].init_decl = init_decl;
+    flat->stmt_cold[ref].loop = loop;
+    break;
+  }
+  case STATEMENT_ASM:
+    if (s->asm_stmt.arg_count && list_reserve(flat, s->asm_stmt.arg_count, &body)) {
+      for (size_t i = 0; i < s->asm_stmt.arg_count; ++i) {
+        ast_ref_t arg = flatten_expression(b, s->asm_stmt.args[i]);
+        flat->lists[body.first + i] = arg;
+      }
+    } else if (s->asm_stmt.arg_count) {
+      b->failed = true;
+    }
+    break;
+  }
+
+  if (b->failed)
+    return AST_REF_NONE;
+  flat->stmts.a[ref] = first;
+  flat->stmts.b[ref] = second;
+  flat->stmt_cold[ref].body = body;
+  flat->stmt_cold[ref].other = other;
+  return ref;
+}
+
+static ast_ref_t flatten_declaration(flat_builder_t* b, const declaration_t* d)
+{
+  if (!d || b->failed)
+    return AST_REF_NONE;
+
+  ast_flat_t* flat = b->flat;
+  types_t type = TYPE_UNTYPE;
+  if (d->type == DECLARATION_VAR)
+    type = d->var_decl.ident.type.kind;
+  else if (d->type == DECLARATION_FUNC)
+    type = d->func.return_type.kind;
+
+  ast_ref_t ref = pool_add(&flat->decls, (void**) &flat->decl_cold,
+      sizeof(ast_decl_cold_t), (uint8_t) d->type, (uint8_t) type,
+      source_offset(b->source, d->source_pos));
+  if (ref == AST_REF_NONE) {
+    b->failed = true;
+    return ref;
+  }
+
+  switch (d->type) {
+  case DECLARATION_VAR: {
+    flat->decl_cold[ref].name = d->var_decl.ident.atom;
+    ast_ref_t init = flatten_expression(b, d->var_decl.init);
+    flat->decls.a[ref] = init;
+    break;
+  }
+  case DECLARATION_FUNC: {
+    flat->decl_cold[ref].name = d->func.atom;
+    flat->decl_cold[ref].params = (uint32_t) d->func.params.count;
+    ast_range_t body = flatten_block(b, d->func.body);
+    flat->decl_cold[ref].body = body;
+    break;
+  }
+  case DECLARATION_STRUCT:
+    flat->decl_cold[ref].name = d->struc.atom;
+    flat->decl_cold[ref].params = (uint32_t) d->struc.members.count;
+    break;
+  default:
+    break;
+  }
+
+  return b->failed ? AST_REF_NONE : ref;
+}
+
+bool ast_flat_build(
+    ast_flat_t* flat, declaration_array* program, const char* source)
+{
+  memset(flat, 0, sizeof(*flat));
+  flat->source = source;
+  flat_builder_t b = { flat, source, false };
+
+  if (!program->count)
+    return true;
+  if (!list_reserve(flat, program->count, &flat->program))
+    return false;
+
+  for (size_t i = 0; i < program->count && !b.failed; ++i) {
+    ast_ref_t d = flatten_declaration(&b, program->items[i]);
+    flat->lists[flat->program.first + i] = d;
+  }
+  return !b.failed;
+}
+
+static void pool_free(ast_pool_t* pool)
+{
+  free(pool->kind);
+  free(pool->type);
+  free(pool->source);
+  free(pool->a);
+  free(pool->b);
+}
+
+void ast_flat_free(ast_flat_t* flat)
+{
+  pool_free(&flat->decls);
+  pool_free(&flat->stmts);
+  pool_free(&flat->exprs);
+  free(flat->decl_cold);
+  free(flat->stmt_cold);
+  free(flat->expr_cold);
+  free(flat->lists);
+  free(flat->var_types);
+  memset(flat, 0, sizeof(*flat));
+}
+
+static size_t pool_bytes(const ast_pool_t* pool, size_t cold_size)
+{
+  size_t hot = 2 * sizeof(uint8_t) + sizeof(uint32_t) + 2 * sizeof(ast_ref_t);
+  return pool->count * (hot + cold_size);
+}
+
+size_t ast_flat_bytes(const ast_flat_t* flat)
+{
+  return pool_bytes(&flat->decls, sizeof(ast_decl_cold_t)) +
+    pool_bytes(&flat->stmts, sizeof(ast_stmt_cold_t)) +
+    pool_bytes(&flat->exprs, sizeof(ast_expr_cold_t)) +
+    flat->lists_count * sizeof(ast_ref_t) +
+    flat->var_types_count * sizeof(known_type_t);
+}
+
+// ----------------- Traversal ------------------
+
+static size_t count_flat_statement(const ast_flat_t* flat, ast_ref_t s);
+static size_t count_flat_declaration(const ast_flat_t* flat, ast_ref_t d);
+
+static size_t count_flat_expression(const ast_flat_t* flat, ast_ref_t e)
+{
+  if (e == AST_REF_NONE)
+    return 0;
+
+  size_t n = 1 + count_flat_expression(flat, flat->exprs.a[e]) +
+    count_flat_expression(flat, flat->exprs.b[e]);
+
+  uint8_t kind = flat->exprs.kind[e];
+  if (kind == EXPRESSION_CALL || kind == EXPRESSION_COMPOSITE_LITERAL) {
+    ast_range_t list = flat->expr_cold[e].list;
+    for (uint32_t i = 0; i < list.count; ++i)
+      n += count_flat_expression(flat, flat->lists[list.first + i]);
+  }
+  return n;
+}
+
+static size_t count_flat_block(const ast_flat_t* flat, ast_range_t block)
+{
+  size_t n = 0;
+  for (uint32_t i = 0; i < block.count; ++i)
+    n += count_flat_statement(flat, flat->lists[block.first + i]);
+  return n;
+}
+
+static size_t count_flat_statement(const ast_flat_t* flat, ast_ref_t s)
+{
+  if (s == AST_REF_NONE)
+    return 0;
+
+  size_t n = 1;
+  const ast_stmt_cold_t* cold = &flat->stmt_cold[s];
+  switch (flat->stmts.kind[s]) {
+  case STATEMENT_DECL:
+    n += count_flat_declaration(flat, flat->stmts.a[s]);
+    break;
+  case STATEMENT_IF:
+    n += count_flat_expression(flat, flat->stmts.a[s]);
+    n += count_flat_block(flat, cold->body) + count_flat_block(flat, cold->other);
+    break;
+  case STATEMENT_WHILE:
+    n += count_flat_expression(flat, flat->stmts.a[s]);
+    n += count_flat_block(flat, cold->body);
+    break;
+  case STATEMENT_FOR:
+    n += cold->init_decl
+      ? count_flat_declaration(flat, flat->stmts.a[s])
+      : count_flat_expression(flat, flat->stmts.a[s]);
+    n += count_flat_expression(flat, flat->stmts.b[s]);
+    n += count_flat_expression(flat, cold->loop);
+    n += count_flat_block(flat, cold->body);
+    break;
+  case STATEMENT_ASM:
+    for (uint32_t i = 0; i < cold->body.count; ++i)
+      n += count_flat_expression(flat, flat->lists[cold->body.first + i]);
+    break;
+  default:
+    n += count_flat_expression(flat, flat->stmts.a[s]);
+    break;
+  }
+  return n;
+}
+
+static size_t count_flat_declaration(const ast_flat_t* flat, ast_ref_t d)
+{
+  if (d == AST_REF_NONE)
+    return 0;
+
+  size_t n = 1;
+  if (flat->decls.kind[d] == DECLARATION_FUNC)
+    n += count_flat_block(flat, flat->decl_cold[d].body);
+  if (flat->decls.kind[d] == DECLARATION_VAR)
+    n += count_flat_expression(flat, flat->decls.a[d]);
+  return n;
+}
+
+size_t ast_flat_count_nodes(const ast_flat_t* flat)
+{
+  size_t n = 0;
+  for (uint32_t i = 0; i < flat->program.count; ++i)
+    n += count_flat_declaration(flat, flat->lists[flat->program.first + i]);
+  return n;
+}
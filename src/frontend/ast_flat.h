@@ -0,0 +1,125 @@
+#ifndef AST_FLAT_H
+#define AST_FLAT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "ast_definition.h"
+
+// Compact copy of a module's AST: declarations, statements and expressions
+// live in their own pools and reference each other by 32-bit index. The
+// fields every walk reads (kind, type, source offset, two children) are
+// stored column by column, the rest of a node sits in a cold record only
+// the passes that need it look at.
+
+// source offset of a node the parser gave no position
+#define AST_SOURCE_NONE UINT32_MAX
+
+// `count` refs from `first` in ast_flat_t.lists
+typedef struct {
+  uint32_t first;
+  uint32_t count;
+} ast_range_t;
+
+typedef struct
+{
+  uint8_t*   kind;   // declaration_kind, statement_kind or expression_kind
+  uint8_t*   type;   // types_t of the node (expressions, variables)
+  uint32_t*  source; // offset of the node in the module source
+  ast_ref_t* a;      // first child, see the pool comments below
+  ast_ref_t* b;      // second child
+  size_t count;
+  size_t capacity;
+} ast_pool_t;
+
+// Cold expression fields
+//   VAR: name, a = member, value = slot in var_types
+//   CALL: name (callee), qualifier, module, list = args
+//   INT_LIT/CHAR_LIT: value  COMPOSITE_LITERAL: value = is_initializer,
+//                            list = values
+//   BINARY/UNARY: op, a/b = operands
+//   ASSIGN: a = lhs, b = rhs INDEX: a = base, b = index
+typedef struct {
+  atom_t      name;
+  atom_t      qualifier; // module named before '::', ATOM_NONE without
+  atom_t      module;    // of the callee, set by the semantic pass
+  int32_t     value;
+  uint32_t    op;
+  ast_range_t list;
+} ast_expr_cold_t;
+
+// Cold statement fields, children are expressions unless noted
+//   RETURN/EXPR/FREE: a      DECL: a (declaration)
+//   IF: a = condition, body = then, other = else
+//   WHILE: a = condition, body
+//   FOR: a = init (a declaration when `init_decl`), b = condition,
+//        loop, body          ASM: body = args
+typedef struct {
+  ast_range_t body;  // statements
+  ast_range_t other; // statements
+  ast_ref_t   loop;
+  bool        init_decl;
+} ast_stmt_cold_t;
+
+// Cold declaration fields
+//   VAR: name, a = init      FUNC: name, body, params
+//   STRUCT: name, params = member count
+typedef struct {
+  atom_t      name;
+  uint32_t    params;
+  ast_range_t body; // statements
+} ast_decl_cold_t;
+
+typedef struct
+{
+  ast_pool_t decls;
+  ast_pool_t stmts;
+  ast_pool_t exprs;
+
+  ast_decl_cold_t* decl_cold; // one per declaration
+  ast_stmt_cold_t* stmt_cold; // one per statement
+  ast_expr_cold_t* expr_cold; // one per expression
+
+  ast_ref_t* lists; // child lists of every range
+  size_t lists_count;
+  size_t lists_capacity;
+
+  // one per variable reference: the parser's type, replaced by the
+  // resolved one during the semantic pass, read back by the lowering
+  known_type_t* var_types;
+  size_t var_types_count;
+  size_t var_types_capacity;
+
+  const char* source; // `source` offsets are relative to it
+  ast_range_t program; // top-level declarations
+} ast_flat_t;
+
+// Builds `flat` from `program`, source offsets are taken relative to
+// `source`. Each expression of `program` records its index in `flat`.
+// Returns false when out of memory, `flat` must still be freed.
+bool ast_flat_build(
+    ast_flat_t* flat, declaration_array* program, const char* source);
+
+// Source position of expression `e`, NULL when the parser gave none
+static inline const char* ast_flat_expr_pos(const ast_flat_t* flat, ast_ref_t e)
+{
+  uint32_t offset = flat->exprs.source[e];
+  return offset == AST_SOURCE_NONE ? NULL : flat->source + offset;
+}
+
+// Type of the variable expression `e`
+static inline known_type_t* ast_flat_var_type(const ast_flat_t* flat, ast_ref_t e)
+{
+  return &flat->var_types[flat->expr_cold[e].value];
+}
+
+void ast_flat_free(ast_flat_t* flat);
+
+// Bytes held by the pools, cold records and lists
+size_t ast_flat_bytes(const ast_flat_t* flat);
+
+// Visits every node reachable from the top-level declarations, depth
+// first, and returns how many there are
+size_t ast_flat_count_nodes(const ast_flat_t* flat);
+
+#endif // AST_FLAT_H
@@ -0,0 +1,220 @@
+#include "ast_parallel.h"
+
+#include <pthread.h>
+#include <stdlib.h>
+
+#define DA_LIB_IMPLEMENTATION
+#include "../thirdparty/da.h"
+
+// Consecutive top-level declarations parsed by one sub-parser
+typedef struct {
+  size_t start;         // first token
+  size_t end;           // one past the last token
+  bool   serial;        // declares types, parsed before the workers start
+  type_id_t visible;    // registry size at `start`
+
+  declaration_array decls;
+  arena_t arena;
+  bool    ok;
+
+  // buffered diagnostics, replayed in source order
+  char*  output;
+  size_t output_len;
+} parse_task_t;
+
+typedef struct {
+  parse_task_t* items;
+  size_t count;
+  size_t capacity;
+} parse_task_array;
+
+typedef struct {
+  parser_t*     p;
+  parse_task_t* tasks;
+  size_t        count;
+  size_t        next; // next task to hand out, atomic
+} parse_pool_t;
+
+// Splits the tokens before every `fn`, `internal fn` and `struct` found
+// outside of braces. A part that declares a struct is a task of its own,
+// the others are merged up to AST_PARALLEL_TASK_TOKENS.
+static void split_tasks(parser_t* p, parse_task_array* tasks)
+{
+  size_t depth = 0;
+  size_t start = 0;
+  bool has_struct = false;
+
+  for (size_t i = 0; i <= p->count; ++i) {
+    long kind = i < p->count ? p->items[i].type : LEXER_token_eof;
+    bool cut = i == p->count;
+    if (!cut && depth == 0 && i > start) {
+      cut = kind == LEXER_token_kw_internal || kind == LEXER_token_kw_struct ||
+        (kind == LEXER_token_kw_fn && p->items[i - 1].type != LEXER_token_kw_internal);
+    }
+
+    if (cut && i > start) {
+      parse_task_t* last = tasks->count ? &tasks->items[tasks->count - 1] : NULL;
+      if (last && !last->serial && !has_struct &&
+          last->end - last->start < AST_PARALLEL_TASK_TOKENS) {
+        last->end = i;
+      } else {
+        parse_task_t task = { .start = start, .end = i, .serial = has_struct };
+        da_append(tasks, task);
+      }
+      start = i;
+      has_struct = false;
+    }
+
+    if (kind == '{')
+      ++depth;
+    else if (kind == '}' && depth > 0)
+      --depth;
+    else if (kind == LEXER_token_kw_struct)
+      has_struct = true;
+  }
+}
+
+// Parses the tokens of `task` with a parser of its own that stops at the
+// end of the task
+static void run_task(parser_t* p, parse_task_t* task)
+{
+  FILE* saved = error_get_output();
+  FILE* out = open_memstream(&task->output, &task->output_len);
+  if (out) error_set_output(out);
+
+  parser_t sub = {0};
+  sub.items = p->items;
+  sub.count = task->end;
+  sub.pos = (int) task->start;
+  sub.types = p->types;
+  sub.types_visible = task->visible;
+  sub.defer_bodies = p->defer_bodies;
+  sub.error_ctx = p->error_ctx;
+
+  task->ok = true;
+  while ((size_t) sub.pos < task->end) {
+    declaration_t* decl = parse_declaration(&sub);
+    if (!decl) {
+      task->ok = false;
+      break;
+    }
+    da_append(&task->decls, decl);
+  }
+  task->arena = sub.arena;
+
+  if (out) {
+    error_set_output(saved);
+    fclose(out);
+  }
+}
+
+static void* parse_worker(void* arg)
+{
+  parse_pool_t* pool = (parse_pool_t*) arg;
+  for (;;) {
+    size_t index = __atomic_fetch_add(&pool->next, 1, __ATOMIC_RELAXED);
+    if (index >= pool->count) break;
+    if (!pool->tasks[index].serial)
+      run_task(pool->p, &pool->tasks[index]);
+  }
+  return NULL;
+}
+
+static void run_pool(parse_pool_t* pool, int jobs)
+{
+  size_t worker_count = (size_t) jobs < pool->count ? (size_t) jobs : pool->count;
+  pthread_t* workers = calloc(worker_count, sizeof(pthread_t));
+  size_t started = 0;
+  if (workers) {
+    for (; started < worker_count; ++started) {
+      if (pthread_create(&workers[started], NULL, parse_worker, pool) != 0)
+        break;
+    }
+  }
+
+  // whatever the threads did not pick up runs here
+  parse_worker(pool);
+
+  for (size_t i = 0; i < started; ++i)
+    pthread_join(workers[i], NULL);
+  free(workers);
+}
+
+static void free_tasks(parse_task_array* tasks)
+{
+  da_foreach(parse_task_t, it, tasks) {
+    free(it->output);
+    da_free(&it->decls);
+    arena_free(&it->arena);
+  }
+  da_free(tasks);
+}
+
+// Parses the tasks and moves their declarations and nodes into `p`.
+// Nothing is reported and `p` is left as it was when a task fails.
+static bool parse_parallel(parser_t* p, declaration_array* program, int jobs)
+{
+  parse_task_array tasks = {0};
+  split_tasks(p, &tasks);
+  if (tasks.count < 2) {
+    free_tasks(&tasks);
+    return false;
+  }
+
+  // types are only added by the serial tasks, in source order, so every
+  // task sees the types a serial parse would have seen at its start
+  bool ok = true;
+  for (size_t i = 0; i < tasks.count && ok; ++i) {
+    if (tasks.items[i].serial) {
+      run_task(p, &tasks.items[i]);
+      ok = tasks.items[i].ok;
+    } else {
+      tasks.items[i].visible = (type_id_t) p->types->count;
+    }
+  }
+
+  if (ok) {
+    parse_pool_t pool = { p, tasks.items, tasks.count, 0 };
+    run_pool(&pool, jobs);
+    da_foreach(parse_task_t, it, &tasks) ok = ok && it->ok;
+  }
+
+  if (!ok) {
+    free_tasks(&tasks);
+    return false;
+  }
+
+  FILE* err = error_get_output();
+  da_foreach(parse_task_t, it, &tasks) {
+    if (it->output_len)
+      fwrite(it->output, 1, it->output_len, err);
+    for (size_t i = 0; i < it->decls.count; ++i)
+      da_append(program, it->decls.items[i]);
+    arena_adopt(&p->arena, &it->arena);
+  }
+  p->pos = (int) p->count;
+
+  free_tasks(&tasks);
+  return true;
+}
+
+bool ast_parse_program(parser_t* p, declaration_array* program, int jobs)
+{
+  if (jobs > 1 && p->count >= AST_PARALLEL_MIN_TOKENS) {
+    if (parse_parallel(p, program, jobs))
+      return true;
+
+    // start over with only the builtin types
+    type_registry_free(p->types);
+    populate_parser_known_type(p->types);
+    p->pos = 0;
+  }
+
+  while (peek(p)) {
+    declaration_t* decl = parse_declaration(p);
+    if (!decl)
+      return false;
+    da_append(program, decl);
+  }
+  return true;
+}
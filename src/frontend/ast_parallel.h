@@ -0,0 +1,24 @@
+#ifndef AST_PARALLEL_H
+#define AST_PARALLEL_H
+
+#include <stdbool.h>
+
+#include "ast.h"
+
+// Below this many tokens a module is parsed on the calling thread
+#define AST_PARALLEL_MIN_TOKENS  (32 * 1024)
+// Consecutive declarations are handed to a worker in tasks of about
+// this many tokens
+#define AST_PARALLEL_TASK_TOKENS (8 * 1024)
+
+// Parses every token of `p`, which reads a token array, into `program`.
+// With `jobs` > 1 the top-level declarations are cut at their boundaries
+// and parsed on a pool of threads, then appended in source order; the
+// nodes end up in `p->arena` either way.
+// Diagnostics are buffered and replayed in source order. When any part
+// fails the module is parsed again serially, so errors are reported
+// exactly as the serial parser does.
+// Returns false when a declaration could not be parsed.
+bool ast_parse_program(parser_t* p, declaration_array* program, int jobs);
+
+#endif // AST_PARALLEL_H
@@ -3,6 +3,7 @@
 #include <stdbool.h>
 
 #include "ast_printer.h"
+#include "../thirdparty/log.h"
 
 #define PREFIX_MAX 512
 
@@ -10,11 +11,11 @@ static void print_known_type(const known_type_t* t)
 {
   const char* name = t->name ? t->name : "?";
   if (t->array_len > 0)
-    printf(CLR_TYPE "%s[%zu]" CLR_RESET " " CLR_SIZE "(%zu)" CLR_RESET,
-           name, t->array_len, t->size);
+    fprintf(log_get_output(), CLR_TYPE "%s[%zu]" CLR_RESET " " CLR_SIZE "(%zu)" CLR_RESET,
+                              name, t->array_len, t->size);
   else
-    printf(CLR_TYPE "%s" CLR_RESET " " CLR_SIZE "(%zu)" CLR_RESET,
-           name, t->element_size);
+    fprintf(log_get_output(), CLR_TYPE "%s" CLR_RESET " " CLR_SIZE "(%zu)" CLR_RESET,
+                              name, t->element_size);
 }
 
 static const char* binary_op_str(binary_op_kind op)
@@ -54,7 +55,7 @@ static void child_prefix(const char* prefix, bool is_last, char* out)
 
 static void print_branch(const char* prefix, bool is_last)
 {
-  printf("%s" CLR_TREE "%s" CLR_RESET, prefix, is_last ? "`-" : "|-");
+  fprintf(log_get_output(), "%s" CLR_TREE "%s" CLR_RESET, prefix, is_last ? "`-" : "|-");
 }
 
 static void print_expression(expression_t* e, const char* prefix, bool is_last);
@@ -70,11 +71,11 @@ static void print_member(expression_t* e, const char* prefix, bool is_last)
   child_prefix(prefix, is_last, cp);
 
   print_branch(prefix, is_last);
-  printf(CLR_LIT "Member" CLR_RESET " '%s': ",
-         e->var.ident.ident_name ? 
-         e->var.ident.ident_name : "");
+  fprintf(log_get_output(), CLR_LIT "Member" CLR_RESET " '%s': ",
+                            e->var.ident.ident_name ? 
+                            e->var.ident.ident_name : "");
   print_known_type(&e->var.ident.type);
-  printf("\n");
+  fprintf(log_get_output(), "\n");
   if (e->var.member)
     print_member(e->var.member, cp, true);
 }
@@ -86,7 +87,7 @@ static void print_compound_stmt(statement_block_t* block,
   child_prefix(prefix, is_last, cp);
 
   print_branch(prefix, is_last);
-  printf(CLR_DECL "CompoundStmt\n" CLR_RESET);
+  fprintf(log_get_output(), CLR_DECL "CompoundStmt\n" CLR_RESET);
   print_block(block, cp);
 }
 
@@ -101,74 +102,74 @@ static void print_expression(expression_t* e, const char* prefix, bool is_last)
 
   switch (e->type) {
     case EXPRESSION_INT_LIT:
-      printf(CLR_LIT "IntegerLiteral" CLR_RESET " %d\n", e->int_lit.value);
+      fprintf(log_get_output(), CLR_LIT "IntegerLiteral" CLR_RESET " %d\n", e->int_lit.value);
       break;
 
     case EXPRESSION_CHAR_LIT:
-      printf(CLR_LIT "CharLiteral" CLR_RESET " %c\n", e->char_lit.value);
+      fprintf(log_get_output(), CLR_LIT "CharLiteral" CLR_RESET " %c\n", e->char_lit.value);
       break;
 
     case EXPRESSION_VAR:
-      printf(CLR_LIT "VarRef" CLR_RESET " '%s': ",
-             e->var.ident.ident_name ? 
-             e->var.ident.ident_name : "");
+      fprintf(log_get_output(), CLR_LIT "VarRef" CLR_RESET " '%s': ",
+                                e->var.ident.ident_name ? 
+                                e->var.ident.ident_name : "");
       print_known_type(&e->var.ident.type);
-      printf("\n");
+      fprintf(log_get_output(), "\n");
       if (e->var.member)
         print_member(e->var.member, cp, true);
       break;
 
     case EXPRESSION_BINARY:
-      printf(CLR_STMT "BinaryExpr" CLR_RESET " '%s'\n",
-             binary_op_str(e->binary.op));
+      fprintf(log_get_output(), CLR_STMT "BinaryExpr" CLR_RESET " '%s'\n",
+                                binary_op_str(e->binary.op));
       print_expression(e->binary.left,  cp, false);
       print_expression(e->binary.right, cp, true);
       break;
 
     case EXPRESSION_ASSIGN:
-      printf(CLR_STMT "AssignExpr\n" CLR_RESET);
+      fprintf(log_get_output(), CLR_STMT "AssignExpr\n" CLR_RESET);
       print_expression(e->assign.lhs, cp, false);
       print_expression(e->assign.rhs, cp, true);
       break;
 
     case EXPRESSION_CALL:
       if (e->call.qualifier)
-        printf(CLR_STMT "CallExpr" CLR_RESET " '%s::%s'\n",
-               e->call.qualifier, e->call.callee ? e->call.callee : "");
+        fprintf(log_get_output(), CLR_STMT "CallExpr" CLR_RESET " '%s::%s'\n",
+                                  e->call.qualifier, e->call.callee ? e->call.callee : "");
       else
-        printf(CLR_STMT "CallExpr" CLR_RESET " '%s'\n",
-               e->call.callee ? e->call.callee : "");
+        fprintf(log_get_output(), CLR_STMT "CallExpr" CLR_RESET " '%s'\n",
+                                  e->call.callee ? e->call.callee : "");
       for (size_t i = 0; i < e->call.arg_count; i++)
         print_expression(e->call.args[i], cp, i == e->call.arg_count - 1);
       break;
 
     case EXPRESSION_UNARY:
-      printf(CLR_STMT "UnaryExpr" CLR_RESET " '%s'\n",
-             unary_op_str(e->unary.op));
+      fprintf(log_get_output(), CLR_STMT "UnaryExpr" CLR_RESET " '%s'\n",
+                                unary_op_str(e->unary.op));
       print_expression(e->unary.operand, cp, true);
       break;
 
     case EXPRESSION_INDEX:
-      printf(CLR_STMT "IndexExpr\n" CLR_RESET);
+      fprintf(log_get_output(), CLR_STMT "IndexExpr\n" CLR_RESET);
       print_expression(e->index.base,  cp, false);
       print_expression(e->index.index, cp, true);
       break;
 
     case EXPRESSION_COMPOSITE_LITERAL:
       if (!e->composite_literal.is_initializer) {
-        printf(CLR_LIT "ZeroInit\n" CLR_RESET);
+        fprintf(log_get_output(), CLR_LIT "ZeroInit\n" CLR_RESET);
       } else if (e->composite_literal.count > 0 &&
                  e->composite_literal.values[0]->type == EXPRESSION_ASSIGN) {
-        printf(CLR_LIT "CompositeLiteral" CLR_RESET " (%zu field%s)\n",
-               e->composite_literal.count,
-               e->composite_literal.count != 1 ? "s" : "");
+        fprintf(log_get_output(), CLR_LIT "CompositeLiteral" CLR_RESET " (%zu field%s)\n",
+                                  e->composite_literal.count,
+                                  e->composite_literal.count != 1 ? "s" : "");
         for (size_t i = 0; i < e->composite_literal.count; i++)
           print_expression(e->composite_literal.values[i], cp,
                            i == e->composite_literal.count - 1);
       } else {
-        printf(CLR_LIT "ArrayLiteral" CLR_RESET " [%zu element%s]\n",
-               e->composite_literal.count,
-               e->composite_literal.count != 1 ? "s" : "");
+        fprintf(log_get_output(), CLR_LIT "ArrayLiteral" CLR_RESET " [%zu element%s]\n",
+                                  e->composite_literal.count,
+                                  e->composite_literal.count != 1 ? "s" : "");
         for (size_t i = 0; i < e->composite_literal.count; i++)
           print_expression(e->composite_literal.values[i], cp,
                            i == e->composite_literal.count - 1);
@@ -195,25 +196,25 @@ static void print_statement(statement_t* s, const char* prefix, bool is_last)
 
   switch (s->type) {
     case STATEMENT_RETURN:
-      printf(CLR_STMT "ReturnStmt\n" CLR_RESET);
+      fprintf(log_get_output(), CLR_STMT "ReturnStmt\n" CLR_RESET);
       if (s->ret.value)
         print_expression(s->ret.value, cp, true);
       break;
 
     case STATEMENT_DECL:
-      printf(CLR_STMT "DeclStmt\n" CLR_RESET);
+      fprintf(log_get_output(), CLR_STMT "DeclStmt\n" CLR_RESET);
       if (s->decl_stmt.decl)
         print_declaration(s->decl_stmt.decl, cp, true);
       break;
 
     case STATEMENT_EXPR:
-      printf(CLR_STMT "ExprStmt\n" CLR_RESET);
+      fprintf(log_get_output(), CLR_STMT "ExprStmt\n" CLR_RESET);
       if (s->expr_stmt.expr)
         print_expression(s->expr_stmt.expr, cp, true);
       break;
 
     case STATEMENT_IF: {
-      printf(CLR_STMT "IfStmt\n" CLR_RESET);
+      fprintf(log_get_output(), CLR_STMT "IfStmt\n" CLR_RESET);
       bool has_then = s->if_stmt.then_branch != NULL;
       bool has_else = s->if_stmt.else_branch != NULL;
 
@@ -229,7 +230,7 @@ static void print_statement(statement_t* s, const char* prefix, bool is_last)
     }
 
     case STATEMENT_WHILE: {
-      printf(CLR_STMT "WhileStmt\n" CLR_RESET);
+      fprintf(log_get_output(), CLR_STMT "WhileStmt\n" CLR_RESET);
       bool has_body = s->while_stmt.body != NULL;
 
       if (s->while_stmt.condition)
@@ -241,7 +242,7 @@ static void print_statement(statement_t* s, const char* prefix, bool is_last)
     }
 
     case STATEMENT_FOR: {
-      printf(CLR_STMT "ForStmt\n" CLR_RESET);
+      fprintf(log_get_output(), CLR_STMT "ForStmt\n" CLR_RESET);
       bool has_body = s->for_stmt.body != NULL;
 
       // init: either a declaration or an expression
@@ -265,22 +266,22 @@ static void print_statement(statement_t* s, const char* prefix, bool is_last)
     }
 
     case STATEMENT_FREE:
-      printf(CLR_STMT "FreeStmt\n" CLR_RESET);
+      fprintf(log_get_output(), CLR_STMT "FreeStmt\n" CLR_RESET);
       if (s->free_stmt.expr)
         print_expression(s->free_stmt.expr, cp, true);
       break;
 
     case STATEMENT_ASM: {
-      printf(CLR_STMT "AsmStmt" CLR_RESET " (%zu instr%s)\n",
-             s->asm_stmt.instr_count,
-             s->asm_stmt.instr_count != 1 ? "s" : "");
+      fprintf(log_get_output(), CLR_STMT "AsmStmt" CLR_RESET " (%zu instr%s)\n",
+                                s->asm_stmt.instr_count,
+                                s->asm_stmt.instr_count != 1 ? "s" : "");
       bool has_args = s->asm_stmt.arg_count > 0;
 
       for (size_t i = 0; i < s->asm_stmt.instr_count; i++) {
         bool last = (i == s->asm_stmt.instr_count - 1) && !has_args;
         print_branch(cp, last);
-        printf(CLR_LIT "Instr" CLR_RESET " \"%s\"\n",
-               s->asm_stmt.instr[i] ? s->asm_stmt.instr[i] : "");
+        fprintf(log_get_output(), CLR_LIT "Instr" CLR_RESET " \"%s\"\n",
+                                  s->asm_stmt.instr[i] ? s->asm_stmt.instr[i] : "");
       }
 
       for (size_t i = 0; i < s->asm_stmt.arg_count; i++)
@@ -301,86 +302,90 @@ static void print_declaration(declaration_t* d, const char* prefix, bool is_last
 
   switch (d->type) {
     case DECLARATION_FUNC: {
-      printf(CLR_DECL "%sFunctionDecl" CLR_RESET " '%s'(",
-             d->func.is_internal ? "internal " : "",
-             d->func.name ? d->func.name : "");
+      fprintf(log_get_output(), CLR_DECL "%sFunctionDecl" CLR_RESET " '%s'(",
+                                d->func.is_internal ? "internal " : "",
+                                d->func.name ? d->func.name : "");
 
       for (size_t i = 0; i < d->func.params.count; i++) {
         typed_identifier_t* p = &d->func.params.items[i];
         print_known_type(&p->type);
         if (p->is_constant) {
-          printf(" : " CLR_CONST "const" CLR_RESET); 
+          fprintf(log_get_output(), " : " CLR_CONST "const" CLR_RESET); 
         }
-        printf(" %s%s",
-               p->ident_name ? p->ident_name : "",
-               i < d->func.params.count - 1 ? ", " : "");
+        fprintf(log_get_output(), " %s%s",
+                                  p->ident_name ? p->ident_name : "",
+                                  i < d->func.params.count - 1 ? ", " : "");
       }
-      printf(")");
+      fprintf(log_get_output(), ")");
 
       if (d->func.return_type.kind != TYPE_UNTYPE) {
-        printf(" -> ");
+        fprintf(log_get_output(), " -> ");
         print_known_type(&d->func.return_type);
       }
 
-      printf("\n");
+      fprintf(log_get_output(), "\n");
 
       if (d->func.body)
         print_compound_stmt(d->func.body, cp, true);
+      else if (d->func.body_start) {
+        print_branch(cp, true);
+        fprintf(log_get_output(), CLR_DECL "CompoundStmt" CLR_RESET " (not parsed yet)\n");
+      }
       break;
     }
 
     case DECLARATION_VAR:
-      printf(CLR_DECL "VarDecl" CLR_RESET " '%s': ",
-             d->var_decl.ident.ident_name ? 
-              d->var_decl.ident.ident_name : "");
+      fprintf(log_get_output(), CLR_DECL "VarDecl" CLR_RESET " '%s': ",
+                                d->var_decl.ident.ident_name ? 
+                                 d->var_decl.ident.ident_name : "");
       print_known_type(&d->var_decl.ident.type);
       if (d->var_decl.ident.is_constant) {
-        printf(" : " CLR_CONST "const" CLR_RESET);
+        fprintf(log_get_output(), " : " CLR_CONST "const" CLR_RESET);
       }
-      printf("\n");
+      fprintf(log_get_output(), "\n");
       if (d->var_decl.init)
         print_expression(d->var_decl.init, cp, true);
       break;
 
     case DECLARATION_STRUCT: {
-      printf(CLR_DECL "StructDecl" CLR_RESET " '%s'\n",
-             d->struc.name ? d->struc.name : "");
+      fprintf(log_get_output(), CLR_DECL "StructDecl" CLR_RESET " '%s'\n",
+                                d->struc.name ? d->struc.name : "");
       for (size_t i = 0; i < d->struc.members.count; i++) {
         typed_identifier_t* m = &d->struc.members.items[i];
         bool last = (i == d->struc.members.count - 1);
         print_branch(cp, last);
-        printf(CLR_DECL "FieldDecl" CLR_RESET " '%s': ",
-               m->ident_name ? m->ident_name : "");
+        fprintf(log_get_output(), CLR_DECL "FieldDecl" CLR_RESET " '%s': ",
+                                  m->ident_name ? m->ident_name : "");
         print_known_type(&m->type);
         if (m->is_constant) {
-          printf(" : " CLR_CONST "const" CLR_RESET);
+          fprintf(log_get_output(), " : " CLR_CONST "const" CLR_RESET);
         }
-        printf("\n");
+        fprintf(log_get_output(), "\n");
       }
       break;
     }
 
     case DECLARATION_MODULE: {
-      printf(CLR_DECL "ModuleDecl" CLR_RESET " ");
+      fprintf(log_get_output(), CLR_DECL "ModuleDecl" CLR_RESET " ");
       for (size_t i = 0; i < d->module.path.count; i++) {
-        printf("%s%s",
-               d->module.path.items[i] ? d->module.path.items[i] : "?",
-               i < d->module.path.count - 1 ? "::" : "");
+        fprintf(log_get_output(), "%s%s",
+                                  d->module.path.items[i] ? d->module.path.items[i] : "?",
+                                  i < d->module.path.count - 1 ? "::" : "");
       }
-      printf("\n");
+      fprintf(log_get_output(), "\n");
       break;
     }
 
     case DECLARATION_IMPORT: {
-      printf(CLR_DECL "ImportDecl" CLR_RESET " ");
+      fprintf(log_get_output(), CLR_DECL "ImportDecl" CLR_RESET " ");
       for (size_t i = 0; i < d->import.path.count; i++) {
-        printf("%s%s",
-               d->import.path.items[i] ? d->import.path.items[i] : "?",
-               i < d->import.path.count - 1 ? "::" : "");
+        fprintf(log_get_output(), "%s%s",
+                                  d->import.path.items[i] ? d->import.path.items[i] : "?",
+                                  i < d->import.path.count - 1 ? "::" : "");
       }
       if (d->import.alias)
-        printf(CLR_CONST " as %s" CLR_RESET, d->import.alias);
-      printf("\n");
+        fprintf(log_get_output(), CLR_CONST " as %s" CLR_RESET, d->import.alias);
+      fprintf(log_get_output(), "\n");
       break;
     }
   }
@@ -390,7 +395,7 @@ void ast_print_program(declaration_array* program)
 {
   if (!program) return;
 
-  printf(CLR_DECL "TranslationUnit\n" CLR_RESET);
+  fprintf(log_get_output(), CLR_DECL "TranslationUnit\n" CLR_RESET);
   for (size_t i = 0; i < program->count; i++)
     print_declaration(program->items[i], "", i == program->count - 1);
 }
@@ -0,0 +1,75 @@
+#ifndef KEYWORDS_H
+#define KEYWORDS_H
+
+#include <stddef.h>
+#include <string.h>
+
+#include "types.h"
+
+// Keywords and builtin type names are classified by the lexer with a
+// perfect hash over the first, second and last character and the length.
+// Slots are computed by the compiler from the same macro the lookup uses,
+// two names landing in the same slot fail the build (-Woverride-init).
+
+#define KEYWORD_TABLE_SIZE 32
+
+#define KEYWORD_SLOT(first, second, last, len)                          \
+  (((unsigned) (first) * 5u + (unsigned) (second) * 20u +               \
+    (unsigned) (last) * 21u + (unsigned) (len)) & (KEYWORD_TABLE_SIZE - 1))
+
+typedef struct {
+  const char* name;
+  int         len;
+  long        token;        // LEXER_token_kw_*, LEXER_token_id for types
+  int         builtin_type; // types_t of a builtin type name, -1 otherwise
+} keyword_t;
+
+#define KEYWORD(a, b, z, text, tok, type) \
+  [KEYWORD_SLOT(a, b, z, sizeof(text) - 1)] = { text, sizeof(text) - 1, tok, type }
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic error "-Woverride-init"
+static const keyword_t keywords_table[KEYWORD_TABLE_SIZE] = {
+  KEYWORD('f', 'n', 'n', "fn",       LEXER_token_kw_fn,       -1),
+  KEYWORD('i', 'n', 'l', "internal", LEXER_token_kw_internal, -1),
+  KEYWORD('s', 't', 't', "struct",   LEXER_token_kw_struct,   -1),
+  KEYWORD('m', 'o', 'e', "module",   LEXER_token_kw_module,   -1),
+  KEYWORD('i', 'm', 't', "import",   LEXER_token_kw_import,   -1),
+  KEYWORD('i', 'f', 'f', "if",       LEXER_token_kw_if,       -1),
+  KEYWORD('w', 'h', 'e', "while",    LEXER_token_kw_while,    -1),
+  KEYWORD('f', 'o', 'r', "for",      LEXER_token_kw_for,      -1),
+  KEYWORD('a', 's', 'm', "asm",      LEXER_token_kw_asm,      -1),
+  KEYWORD('f', 'r', 'e', "free",     LEXER_token_kw_free,     -1),
+  KEYWORD('r', 'e', 'n', "return",   LEXER_token_kw_return,   -1),
+  KEYWORD('e', 'l', 'e', "else",     LEXER_token_kw_else,     -1),
+  KEYWORD('a', 's', 's', "as",       LEXER_token_kw_as,       -1),
+
+  // builtin types stay identifiers, a struct name can stand where they do
+  KEYWORD('u', '8', '8', "u8",       LEXER_token_id, TYPE_U8),
+  KEYWORD('c', 'h', 'r', "char",     LEXER_token_id, TYPE_CHAR),
+  KEYWORD('u', '1', '6', "u16",      LEXER_token_id, TYPE_U16),
+  KEYWORD('u', '3', '2', "u32",      LEXER_token_id, TYPE_U32),
+  KEYWORD('i', 'n', 't', "int",      LEXER_token_id, TYPE_INT),
+  KEYWORD('u', '6', '4', "u64",      LEXER_token_id, TYPE_U64),
+  KEYWORD('v', 'a', 'r', "var",      LEXER_token_id, TYPE_VAR),
+  KEYWORD('u', 'n', 'e', "untype",   LEXER_token_id, TYPE_UNTYPE),
+};
+#pragma GCC diagnostic pop
+
+#undef KEYWORD
+
+// The table entry `name` hashes to, NULL when it is a plain identifier
+static inline const keyword_t* keyword_lookup(const char* name, int len)
+{
+  if (len < 2) return NULL;
+
+  const keyword_t* k = &keywords_table[
+    KEYWORD_SLOT((unsigned char) name[0], (unsigned char) name[1],
+                 (unsigned char) name[len - 1], len)];
+
+  if (k->len != len || memcmp(k->name, name, (size_t) len) != 0)
+    return NULL;
+  return k;
+}
+
+#endif // KEYWORDS_H
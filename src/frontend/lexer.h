@@ -46,6 +46,7 @@ There is still no copy past from it at all. Otherwise it would make no sence to
 #define LEXER_LIB_DQ_STRINGS    Y  // doubles quotes delimited string LEXER_token_dqstring
 #define LEXER_LIB_LIT_CHARS     Y  // single quotes delimited char with escape LEXER_token_charlit
 #define LEXER_LIB_IDENTIFIERS   Y  // "[_a-zA-Z][_a-zA-Z0-9]*" LEXER_token_id
+#define LEXER_LIB_KEYWORDS      Y  // cleaf keywords       LEXER_token_kw_*, see keywords.h
 #define LEXER_LIB_SL_COMMENTS   Y  // single line comments starting with '//' 
 #define LEXER_LIB_ML_COMMENTS   Y  // multiple line comments like '/*' ... '*/' 
 
@@ -56,6 +57,8 @@ There is still no copy past from it at all. Otherwise it would make no sence to
 #endif // LEXER_LIB_IMPLEMENTATION
 #endif // LEXER_LIB_DEFINITION
 
+#include "../thirdparty/intern.h"
+
 typedef struct 
 {
   const char* input_stream;
@@ -79,6 +82,9 @@ typedef struct
 
   char* string_value;
   int string_len;
+
+  // first character of the last token
+  const char* token_start;
 } lexer_t;
 
 typedef struct 
@@ -87,8 +93,18 @@ typedef struct
 
   long int_value;
 
-  char* string_value;
+  // identifiers only, see thirdparty/intern.h
+  atom_t atom;
+
+  // types_t of a builtin type name, -1 for other identifiers
+  int builtin_type;
+
+  // Identifiers and string literals: a slice of the source buffer, which
+  // has to outlive the token, not NUL-terminated. Only string literals
+  // with escapes get their own copy, held by `owned`.
+  const char* string_value;
   int string_len;
+  char* owned;
   
   const char* source_pos;
 } token_t;
@@ -122,7 +138,22 @@ enum
   LEXER_token_sqstring,
   LEXER_token_dqstring,
   LEXER_token_charlit,
-  LEXER_token_coloncolon
+  LEXER_token_coloncolon,
+
+  // keywords, classified from identifiers
+  LEXER_token_kw_fn,
+  LEXER_token_kw_internal,
+  LEXER_token_kw_struct,
+  LEXER_token_kw_module,
+  LEXER_token_kw_import,
+  LEXER_token_kw_if,
+  LEXER_token_kw_while,
+  LEXER_token_kw_for,
+  LEXER_token_kw_asm,
+  LEXER_token_kw_free,
+  LEXER_token_kw_return,
+  LEXER_token_kw_else,
+  LEXER_token_kw_as,
 };
 
 // So we can #if on each token definition
@@ -136,6 +167,20 @@ extern "C" {
 extern int lexer_get_token(lexer_t* l);
 extern void lexer_init_lexer(lexer_t* l, const char* input_stream, const char* end_input_stream, char* string_storage, int string_storage_len);
 
+// Scanning paths for whitespace, comments, identifiers and string bodies.
+// The best one the CPU supports is picked by lexer_init_lexer, every path
+// produces the same tokens.
+enum
+{
+  LEXER_SIMD_SCALAR = 0,
+  LEXER_SIMD_SSE2,
+  LEXER_SIMD_AVX2,
+};
+
+// Forces a scanning path (benchmarks, tests). Returns the one in use,
+// which is lower than `level` when the CPU or the build lacks it.
+extern int lexer_set_simd(int level);
+
 #ifdef __cplusplus
   }
 #endif // __cplusplus
@@ -149,6 +194,8 @@ extern void lexer_init_lexer(lexer_t* l, const char* input_stream, const char* e
 #include <stdlib.h>
 #endif // LEXER_STDLIB
 
+#include "keywords.h"
+
 // Disable the 'config' usage of Y and N
 // Now, Y expand to its content and N to nothing
 // This avoid compiler error
@@ -161,23 +208,47 @@ static token_t lexer_copy_token(lexer_t* lex)
 {
   token_t token = {0};
   token.type = lex->token;
+  token.builtin_type = -1;
   token.source_pos = lex->parse_point;
   
   switch (lex->token) {
-    case LEXER_token_id: case LEXER_token_dqstring: 
-      if (lex->string_value) {
-        token.string_value = strdup(lex->string_value);
-        token.string_len = strlen(lex->string_value);
+    case LEXER_token_id:
+      token.string_value = lex->token_start;
+      token.string_len = (int) (lex->parse_point - lex->token_start);
+      token.atom = intern(token.string_value, (size_t) token.string_len);
+      token.builtin_type = (int) lex->int_value;
+      break;
+    case LEXER_token_dqstring: {
+      // the text between the quotes, unless escapes changed it
+      const char* raw = lex->token_start + 1;
+      int raw_len = (int) (lex->parse_point - raw) - 1;
+      token.string_len = lex->string_len;
+      if (raw_len == lex->string_len) {
+        token.string_value = raw;
+        break;
+      }
+      token.owned = malloc((size_t) lex->string_len + 1);
+      if (token.owned) {
+        memcpy(token.owned, lex->string_value, (size_t) lex->string_len + 1);
       } else {
-        token.string_value = NULL;
-        token.string_len = 0;  
+        token.string_len = 0;
       }
+      token.string_value = token.owned;
       break;
+    }
     case LEXER_token_intlit:
     case LEXER_token_charlit:
       token.int_value = lex->int_value;
       break;
     default:
+      // keywords keep their text and atom, for the reserved name checks
+      // and error messages
+      if (lex->token >= LEXER_token_kw_fn && lex->token <= LEXER_token_kw_as) {
+        token.string_value = lex->token_start;
+        token.string_len = (int) (lex->parse_point - lex->token_start);
+        token.atom = intern(token.string_value, (size_t) token.string_len);
+        break;
+      }
       token.string_value = NULL;
       token.string_len = 0;
       token.int_value = 0;
@@ -192,6 +263,199 @@ static int lexer_is_white(char c)
   return c == ' ' || c == '\n' || c == '\t' || c == '\r' || c == '\f'; 
 }
 
+// --- SIMD scanning ---
+// Each scanner returns the first byte of [p, eof) that stops the run it
+// skips. Vectors are only loaded when a whole one lies before `eof`, the
+// tail of the input always goes through the scalar loop.
+
+#if !defined(LEXER_NO_SIMD) && defined(__SSE2__) && \
+    (defined(__x86_64__) || defined(__i386__))
+#define LEXER_HAS_SIMD 1
+#include <immintrin.h>
+#else
+#define LEXER_HAS_SIMD 0
+#endif
+
+static int lexer_simd_level = -1;
+
+#if LEXER_HAS_SIMD
+
+static int lexer_is_ident_char(char c)
+{
+  return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') ||
+         (c >= '0' && c <= '9') || c == '_';
+}
+
+static inline __m128i lexer_sse2_white(__m128i v)
+{
+  __m128i m = _mm_cmpeq_epi8(v, _mm_set1_epi8(' '));
+  m = _mm_or_si128(m, _mm_cmpeq_epi8(v, _mm_set1_epi8('\n')));
+  m = _mm_or_si128(m, _mm_cmpeq_epi8(v, _mm_set1_epi8('\t')));
+  m = _mm_or_si128(m, _mm_cmpeq_epi8(v, _mm_set1_epi8('\r')));
+  return _mm_or_si128(m, _mm_cmpeq_epi8(v, _mm_set1_epi8('\f')));
+}
+
+// [_a-zA-Z0-9], bytes >= 0x80 are negative and never match
+static inline __m128i lexer_sse2_ident(__m128i v)
+{
+  __m128i lower = _mm_or_si128(v, _mm_set1_epi8(0x20));
+  __m128i alpha = _mm_and_si128(
+      _mm_cmpgt_epi8(lower, _mm_set1_epi8('a' - 1)),
+      _mm_cmplt_epi8(lower, _mm_set1_epi8('z' + 1)));
+  __m128i digit = _mm_and_si128(
+      _mm_cmpgt_epi8(v, _mm_set1_epi8('0' - 1)),
+      _mm_cmplt_epi8(v, _mm_set1_epi8('9' + 1)));
+  __m128i under = _mm_cmpeq_epi8(v, _mm_set1_epi8('_'));
+  return _mm_or_si128(_mm_or_si128(alpha, digit), under);
+}
+
+__attribute__((target("avx2")))
+static inline __m256i lexer_avx2_white(__m256i v)
+{
+  __m256i m = _mm256_cmpeq_epi8(v, _mm256_set1_epi8(' '));
+  m = _mm256_or_si256(m, _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\n')));
+  m = _mm256_or_si256(m, _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\t')));
+  m = _mm256_or_si256(m, _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\r')));
+  return _mm256_or_si256(m, _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\f')));
+}
+
+__attribute__((target("avx2")))
+static inline __m256i lexer_avx2_ident(__m256i v)
+{
+  __m256i lower = _mm256_or_si256(v, _mm256_set1_epi8(0x20));
+  __m256i alpha = _mm256_and_si256(
+      _mm256_cmpgt_epi8(lower, _mm256_set1_epi8('a' - 1)),
+      _mm256_cmpgt_epi8(_mm256_set1_epi8('z' + 1), lower));
+  __m256i digit = _mm256_and_si256(
+      _mm256_cmpgt_epi8(v, _mm256_set1_epi8('0' - 1)),
+      _mm256_cmpgt_epi8(_mm256_set1_epi8('9' + 1), v));
+  __m256i under = _mm256_cmpeq_epi8(v, _mm256_set1_epi8('_'));
+  return _mm256_or_si256(_mm256_or_si256(alpha, digit), under);
+}
+
+// `stop` builds the mask of the bytes ending the run: `a`, `b` are the
+// two bytes searched for by the find scanners
+#define LEXER_SSE2_SCAN(p, eof, stop)                                      \
+  while ((eof) - (p) >= 16) {                                              \
+    __m128i v = _mm_loadu_si128((const __m128i*) (p));                     \
+    unsigned mask = (unsigned) _mm_movemask_epi8(stop);                    \
+    if (mask) return (p) + __builtin_ctz(mask);                            \
+    (p) += 16;                                                             \
+  }
+
+#define LEXER_AVX2_SCAN(p, eof, stop)                                      \
+  while ((eof) - (p) >= 32) {                                              \
+    __m256i v = _mm256_loadu_si256((const __m256i*) (p));                  \
+    unsigned mask = (unsigned) _mm256_movemask_epi8(stop);                 \
+    if (mask) return (p) + __builtin_ctz(mask);                            \
+    (p) += 32;                                                             \
+  }
+
+static const char* lexer_sse2_skip_white(const char* p, const char* eof)
+{
+  LEXER_SSE2_SCAN(p, eof,
+      _mm_xor_si128(lexer_sse2_white(v), _mm_set1_epi8(-1)))
+  return p;
+}
+
+static const char* lexer_sse2_skip_ident(const char* p, const char* eof)
+{
+  LEXER_SSE2_SCAN(p, eof,
+      _mm_xor_si128(lexer_sse2_ident(v), _mm_set1_epi8(-1)))
+  return p;
+}
+
+static const char* lexer_sse2_find2(
+    const char* p, const char* eof, char a, char b)
+{
+  LEXER_SSE2_SCAN(p, eof,
+      _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(a)),
+                   _mm_cmpeq_epi8(v, _mm_set1_epi8(b))))
+  return p;
+}
+
+__attribute__((target("avx2")))
+static const char* lexer_avx2_skip_white(const char* p, const char* eof)
+{
+  LEXER_AVX2_SCAN(p, eof,
+      _mm256_xor_si256(lexer_avx2_white(v), _mm256_set1_epi8(-1)))
+  return lexer_sse2_skip_white(p, eof);
+}
+
+__attribute__((target("avx2")))
+static const char* lexer_avx2_skip_ident(const char* p, const char* eof)
+{
+  LEXER_AVX2_SCAN(p, eof,
+      _mm256_xor_si256(lexer_avx2_ident(v), _mm256_set1_epi8(-1)))
+  return lexer_sse2_skip_ident(p, eof);
+}
+
+__attribute__((target("avx2")))
+static const char* lexer_avx2_find2(
+    const char* p, const char* eof, char a, char b)
+{
+  LEXER_AVX2_SCAN(p, eof,
+      _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8(a)),
+                      _mm256_cmpeq_epi8(v, _mm256_set1_epi8(b))))
+  return lexer_sse2_find2(p, eof, a, b);
+}
+
+#endif // LEXER_HAS_SIMD
+
+int lexer_set_simd(int level)
+{
+  int supported = LEXER_SIMD_SCALAR;
+#if LEXER_HAS_SIMD
+  supported = __builtin_cpu_supports("avx2") ? LEXER_SIMD_AVX2 : LEXER_SIMD_SSE2;
+#endif
+  lexer_simd_level = level < supported ? level : supported;
+  return lexer_simd_level;
+}
+
+// Whitespace run starting at `p`
+static const char* lexer_skip_white(const char* p, const char* eof)
+{
+  // most tokens are apart by one blank or none, not worth a vector
+  if (p >= eof || !lexer_is_white(*p)) return p;
+  if (++p >= eof || !lexer_is_white(*p)) return p;
+#if LEXER_HAS_SIMD
+  if (lexer_simd_level == LEXER_SIMD_AVX2) p = lexer_avx2_skip_white(p, eof);
+  else if (lexer_simd_level == LEXER_SIMD_SSE2) p = lexer_sse2_skip_white(p, eof);
+#endif
+  while (p < eof && lexer_is_white(*p))
+    ++p;
+  return p;
+}
+
+// Identifier characters starting at `p`, only the vector part: the
+// identifier loop carries on byte by byte from there
+static const char* lexer_skip_ident(const char* p, const char* eof)
+{
+#if LEXER_HAS_SIMD
+  // short names end before a vector would pay off
+  for (int i = 0; i < 8; ++i, ++p)
+    if (p >= eof || !lexer_is_ident_char(*p)) return p;
+
+  if (lexer_simd_level == LEXER_SIMD_AVX2) return lexer_avx2_skip_ident(p, eof);
+  if (lexer_simd_level == LEXER_SIMD_SSE2) return lexer_sse2_skip_ident(p, eof);
+#endif
+  (void) eof;
+  return p;
+}
+
+// First `a` or `b` from `p`, or `eof`. The vector scans stop once fewer
+// than a vector is left, so no loop here reads past `eof`
+static const char* lexer_find2(const char* p, const char* eof, char a, char b)
+{
+#if LEXER_HAS_SIMD
+  if (lexer_simd_level == LEXER_SIMD_AVX2) p = lexer_avx2_find2(p, eof, a, b);
+  else if (lexer_simd_level == LEXER_SIMD_SSE2) p = lexer_sse2_find2(p, eof, a, b);
+#endif
+  while (p < eof && *p != a && *p != b)
+    ++p;
+  return p;
+}
+
 static int lexer_eof(lexer_t* l)
 {
   l->token = LEXER_token_eof;
@@ -238,9 +502,26 @@ static int lexer_parse_string(lexer_t* l, const char* p, int type)
   // To ensure we don't overflow
   char* outend = l->string_storage + l->string_storage_len;
 
-  while (*p != delim) {
+  for (;;) {
+    // never closed: the run reached the end of the input
+    if (p >= l->eof)
+      return lexer_create_token(l, LEXER_token_parse_error, l->eof - 1);
+    if (*p == delim)
+      break;
+
+    // plain run up to the closing quote or the next escape
+    const char* run_end = lexer_find2(p, l->eof, delim, '\\');
+    if (run_end > p && out + (run_end - p) <= outend) {
+      memcpy(out, p, (size_t) (run_end - p));
+      out += run_end - p;
+      p = run_end;
+      continue;
+    }
+
     int n;
     if (*p == '\\') {
+      if (p + 1 >= l->eof)
+        return lexer_create_token(l, LEXER_token_parse_error, l->eof - 1);
       const char* q;
       n = lexer_parse_char(p, &q);
       p = q;
@@ -265,6 +546,9 @@ static int lexer_parse_string(lexer_t* l, const char* p, int type)
 
 void lexer_init_lexer(lexer_t* l, const char* input_stream, const char* end_input_stream, char* string_storage, int string_storage_len) 
 {
+  if (lexer_simd_level < 0)
+    lexer_set_simd(LEXER_SIMD_AVX2);
+
   l->input_stream = input_stream;
   l->eof = end_input_stream;
   l->parse_point = input_stream;
@@ -278,24 +562,22 @@ int lexer_get_token(lexer_t* l)
   const char* p = l->parse_point;
 
   for (;;) {
-    while (p != l->eof && lexer_is_white(*p)) {
-      ++p;
-    }
+    p = lexer_skip_white(p, l->eof);
 
     LEXER_LIB_SL_COMMENTS(
-      if (p != l->eof && p[0] == '/' && p[1] == '/') {
-        while (p != l->eof && *p != '\n' && *p != '\r')
-          ++p;
+      if (p + 1 < l->eof && p[0] == '/' && p[1] == '/') {
+        p = lexer_find2(p, l->eof, '\n', '\r');
         continue;
       }
     )
 
     LEXER_LIB_ML_COMMENTS(
-      if (p != l->eof && p[0] == '/' && p[1] == '*') {
+      if (p + 1 < l->eof && p[0] == '/' && p[1] == '*') {
         p += 2;
-        while (p != l->eof && (p[0] != '*' || p[1] != '/'))
+        while ((p = lexer_find2(p, l->eof, '*', '*')) < l->eof
+            && (p + 1 == l->eof || p[1] != '/'))
           ++p;
-        if (p == l->eof) 
+        if (p >= l->eof) 
           return lexer_create_token(l, LEXER_token_parse_error, p-1); 
         p += 2;
         continue;
@@ -307,13 +589,21 @@ int lexer_get_token(lexer_t* l)
   if (p == l->eof)
     return lexer_eof(l);
 
+  l->token_start = p;
+
   switch (*p) {
     default:
       if (   (*p >= 'a' && *p <= 'z')
           || (*p >= 'A' && *p <= 'Z')
           || *p == '_') {
-        int n = 0;
+        // the vector scan copies most of the identifier at once, the loop
+        // takes over from its last character
+        int n = (int) (lexer_skip_ident(p, l->eof) - p);
+        if (n >= l->string_storage_len)
+          return lexer_create_token(l, LEXER_token_parse_error, p + l->string_storage_len - 1);
         l->string_value = l->string_storage;
+        memcpy(l->string_value, p, (size_t) n);
+        if (n > 0) --n;
         do {
           if (n + 1 >= l->string_storage_len)
             return lexer_create_token(l, LEXER_token_parse_error, p+n);
@@ -325,8 +615,17 @@ int lexer_get_token(lexer_t* l)
                  || p[n] == '_');
         l->string_value[n] = 0;
         l->string_len = n - 1;
+        l->int_value = -1;
+        long kind = LEXER_token_id;
+        LEXER_LIB_KEYWORDS(
+          const keyword_t* k = keyword_lookup(l->string_value, n);
+          if (k) {
+            kind = k->token;
+            l->int_value = k->builtin_type;
+          }
+        )
         // We use p+n-1 because we '\0' terminated the string and we don't count that in the parsing point
-        return lexer_create_token(l, LEXER_token_id, p+n-1);
+        return lexer_create_token(l, kind, p+n-1);
       }
 
     single_char:
@@ -458,6 +757,8 @@ static void lexer_print_token(lexer_t *l)
     default:
       if (l->token >= 0 && l->token < 256)
         printf("%c", (int) l->token);
+      else if (l->token >= LEXER_token_kw_fn && l->token <= LEXER_token_kw_as)
+        printf("%s", l->string_value);
       else {
         printf("<<<UNKNOWN TOKEN %ld >>>\n", l->token);
       }
@@ -1,59 +1,138 @@
 #ifndef SCOPE_H
 #define SCOPE_H
 
-#include "../thirdparty/hashmap.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "../thirdparty/intern.h"
+
+// Variables visible while a function is analyzed, kept as one stack: a
+// block pushes a mark, its variables go on top and leaving it pops back
+// to the mark. `innermost` maps a name to its visible binding and each
+// binding remembers the one it hides, so resolving a name is one lookup
+// and leaving a block undoes its bindings without allocating.
+
+typedef struct
+{
+  atom_t name;
+  void* sym;       // owned, NULL once removed
+  size_t shadowed; // index + 1 of the binding of `name` it hides, 0 if none
+} scope_binding_t;
 
 typedef struct scope_t
 {
-  hashmap_t* symbols;
-  struct scope_t* parent;
+  scope_binding_t* bindings;
+  size_t count;
+  size_t capacity;
+
+  size_t* marks;   // `count` when each open block was entered
+  size_t depth;
+  size_t marks_capacity;
+
+  atom_map_t innermost; // name -> index + 1 of its visible binding
 } scope_t;
 
-static inline scope_t* scope_enter(scope_t* parent) 
-{ 
-  scope_t* s = calloc(1, sizeof(scope_t));
-  if (!s)
-    return NULL;
-  s->symbols = calloc(1, sizeof(hashmap_t));
-  if (!s->symbols)
-    return NULL;
+// Enters a block. Returns false when out of memory.
+static inline bool scope_push(scope_t* scope)
+{
+  if (scope->depth == scope->marks_capacity) {
+    size_t capacity = scope->marks_capacity ? scope->marks_capacity * 2 : 16;
+    size_t* marks = realloc(scope->marks, capacity * sizeof(size_t));
+    if (!marks)
+      return false;
+    scope->marks = marks;
+    scope->marks_capacity = capacity;
+  }
 
-  if (parent)
-    s->parent = parent;
+  scope->marks[scope->depth++] = scope->count;
+  return true;
+}
+
+// Leaves the innermost block, freeing the symbols it declared
+static inline void scope_pop(scope_t* scope)
+{
+  if (scope->depth == 0)
+    return;
 
-  return s;
+  size_t mark = scope->marks[--scope->depth];
+  while (scope->count > mark) {
+    scope_binding_t* b = &scope->bindings[--scope->count];
+    if (b->shadowed)
+      atom_map_put(&scope->innermost, b->name, (void*) (uintptr_t) b->shadowed);
+    else
+      atom_map_remove(&scope->innermost, b->name);
+    free(b->sym);
+  }
 }
 
-static inline void scope_exit(scope_t* scope) 
+// Binds `name` in the innermost block to `sym`, which the scope now owns;
+// a symbol declared again in the same block is freed
+static inline void scope_declare(scope_t* scope, atom_t name, void* sym)
 {
-  if (scope) {
-    if (scope->symbols) {
-      hashmap_free(scope->symbols, 1);
-      free(scope->symbols);
+  size_t index = (uintptr_t) atom_map_get(&scope->innermost, name);
+  size_t mark = scope->depth ? scope->marks[scope->depth - 1] : 0;
+  if (index > mark) {
+    scope_binding_t* b = &scope->bindings[index - 1];
+    if (b->sym != sym)
+      free(b->sym);
+    b->sym = sym;
+    return;
+  }
+
+  if (scope->count == scope->capacity) {
+    size_t capacity = scope->capacity ? scope->capacity * 2 : 32;
+    scope_binding_t* bindings =
+      realloc(scope->bindings, capacity * sizeof(scope_binding_t));
+    if (!bindings) {
+      free(sym);
+      return;
     }
-    free(scope);
+    scope->bindings = bindings;
+    scope->capacity = capacity;
   }
+
+  if (!atom_map_put(&scope->innermost, name, (void*) (uintptr_t) (scope->count + 1))) {
+    free(sym);
+    return;
+  }
+  scope->bindings[scope->count++] = (scope_binding_t) { name, sym, index };
 }
 
-static inline void* scope_resolve(scope_t* scope, const char* name) 
+static inline void* scope_resolve(const scope_t* scope, atom_t name)
 {
-  for (scope_t* s = scope; s != NULL; s = s->parent) {
-    void* sym = hashmap_get(s->symbols, name);
-    if (sym)
-      return sym;
-  }
-  return NULL;
+  size_t index = (uintptr_t) atom_map_get(&scope->innermost, name);
+  return index ? scope->bindings[index - 1].sym : NULL;
 }
 
-static inline int scope_remove(scope_t* scope, const char* name)
+// Unbinds the visible `name`, returns its symbol which the caller now owns
+static inline void* scope_remove(scope_t* scope, atom_t name)
 {
-  for (scope_t* s = scope; s != NULL; s = s->parent) {
-    if (hashmap_remove(s->symbols, name)) {
-      return 1;     
-    }
-  }
+  size_t index = (uintptr_t) atom_map_get(&scope->innermost, name);
+  if (!index)
+    return NULL;
 
-  return 0;
+  scope_binding_t* b = &scope->bindings[index - 1];
+  void* sym = b->sym;
+  b->sym = NULL;
+  // the hidden binding shows again, as when the block declaring `name`
+  // is left
+  if (b->shadowed)
+    atom_map_put(&scope->innermost, name, (void*) (uintptr_t) b->shadowed);
+  else
+    atom_map_remove(&scope->innermost, name);
+  return sym;
+}
+
+// Frees every symbol still bound and releases the stack
+static inline void scope_free(scope_t* scope)
+{
+  for (size_t i = 0; i < scope->count; ++i)
+    free(scope->bindings[i].sym);
+  free(scope->bindings);
+  free(scope->marks);
+  atom_map_free(&scope->innermost, 0);
+  *scope = (scope_t) {0};
 }
 
 #endif // SCOPE_H
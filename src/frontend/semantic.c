@@ -10,19 +10,19 @@ static void semantic_resolve_type_size(
     t->size = 8;
     t->name = "int";
   } else if (t->kind == TYPE_CUSTOM && t->name) {
-    struct_symbol_t* sym =
-      (struct_symbol_t*) hashmap_get(
-          analyzer->struct_symbols, t->name);
-    if (sym)
-      t->element_size = sym->total_size;
+    // by name: a type inferred from an imported function comes from the
+    // registry of another module
+    known_type_t* def = type_registry_find(analyzer->types, t->atom);
+    if (def)
+      t->element_size = def->element_size;
   }
 }
 
-int string_array_contains(
-    char** source, size_t source_len, const char* name)
+int atom_array_contains(
+    const atom_t* source, size_t source_len, atom_t name)
 {
-  for (char** s = source; s < source + source_len; ++s)
-    if (*s && strcmp(*s, name) == 0)
+  for (const atom_t* s = source; s < source + source_len; ++s)
+    if (*s == name)
      return 1; 
 
   return 0;
@@ -31,16 +31,12 @@ int string_array_contains(
 void semantic_free_program_definition(semantic_analyzer_t* analyzer)
 {
   if (analyzer->function_symbols) {
-    for (size_t i = 0; i < 211; ++i) {
-      if (analyzer->function_symbols->buckets[i]) {
-        function_symbol_t* v = 
-          (function_symbol_t*) 
-          analyzer->function_symbols->buckets[i]->value;
-        free(v->params_name);
-        free(v->params_type);
-      } 
+    atom_map_foreach(e, analyzer->function_symbols) {
+      function_symbol_t* v = (function_symbol_t*) e->value;
+      free(v->params_atom);
+      free(v->params_type);
     }
-    hashmap_free(analyzer->function_symbols, 1);
+    atom_map_free(analyzer->function_symbols, 1);
     free(analyzer->function_symbols);
   }
 
@@ -58,19 +54,16 @@ void semantic_free_program_definition(semantic_analyzer_t* analyzer)
   da_free(&analyzer->imported_owned);
 
   if (analyzer->struct_symbols) {
-    for (size_t i = 0; i < 211; ++i) {
-      if (analyzer->struct_symbols->buckets[i]) {
-        struct_symbol_t* v = 
-          (struct_symbol_t*) 
-          analyzer->struct_symbols->buckets[i]->value;
-        free(v->members_type);
-        free(v->members_name);
-      } 
-    } 
-    hashmap_free(analyzer->struct_symbols, 1);
+    atom_map_foreach(e, analyzer->struct_symbols) {
+      struct_symbol_t* v = (struct_symbol_t*) e->value;
+      free(v->members_type);
+      free(v->members_atom);
+    }
+    atom_map_free(analyzer->struct_symbols, 1);
     free(analyzer->struct_symbols);
   }
 
+  ast_flat_free(&analyzer->flat);
   da_free(&analyzer->semantic_errors);
 }
 
@@ -78,34 +71,47 @@ void semantic_analyze(semantic_analyzer_t* analyzer)
 {
   if (analyzer->ast) {
     semantic_load_program_definition(analyzer);
+    // expressions are checked on the flat copy, which keeps their types
+    // for the lowering
+    const char* source =
+      analyzer->error_ctx ? analyzer->error_ctx->source_text : NULL;
+    if (!ast_flat_build(&analyzer->flat, analyzer->ast, source)) {
+      analyzer->error_count++;
+      return;
+    }
+    // one stack for every function, emptied when each one is done
+    scope_t scope = {0};
     da_foreach(declaration_t*, it, analyzer->ast) {
       if ((*it)->type == DECLARATION_FUNC) {
-        scope_t* function_scope = scope_enter(NULL);
-
-        function_symbol_t* fs = (function_symbol_t*) hashmap_get(
+        function_symbol_t* fs = (function_symbol_t*) atom_map_get(
             analyzer->function_symbols,
-            (*it)->func.name);
+            (*it)->func.atom);
 
         if (!fs) continue;
 
+        if (!scope_push(&scope)) {
+          error_report_general(ERROR_SEVERITY_ERROR, "out of memory");
+          break;
+        }
+
         for (size_t i = 0; i < fs->params_count; ++i) {
           variable_symbol_t* vs = 
             calloc(1, sizeof(variable_symbol_t));
           if (vs) {
             vs->type = fs->params_type[i].type;
             vs->is_constant = false;
-            hashmap_put(
-                function_scope->symbols, fs->params_name[i], vs);
+            scope_declare(&scope, fs->params_atom[i], vs);
           }
         }
 
-        analyzer->current_analyzed_function = (*it)->func.name; 
+        analyzer->current_analyzed_function = (*it)->func.atom;
         semantic_check_scope(
-            analyzer, (*it)->func.body, function_scope); 
+            analyzer, (*it)->func.body, &scope); 
 
-        scope_exit(function_scope);
+        scope_pop(&scope);
       }
     }
+    scope_free(&scope);
   }
 
   semantic_error_display(analyzer); 
@@ -131,7 +137,7 @@ int analyze_declaration(semantic_analyzer_t* analyzer,
                         declaration_t* decl,
                         scope_t* scope)
 {
-  if (scope_resolve(scope, decl->var_decl.ident.ident_name)) {
+  if (scope_resolve(scope, decl->var_decl.ident.atom)) {
     semantic_error_register(analyzer,
         decl->var_decl.ident.source_pos - 1,
         "already defined variable redifinition");
@@ -150,9 +156,9 @@ int analyze_declaration(semantic_analyzer_t* analyzer,
       return 1;
 
     struct_symbol_t* struc_sym = (struct_symbol_t*)
-      hashmap_get(
+      atom_map_get(
           analyzer->struct_symbols, 
-          decl->var_decl.ident.type.name);
+          decl->var_decl.ident.type.atom);
     if (struc_sym->members_count != 
         decl->var_decl.init->composite_literal.count) {
       semantic_error_register(
@@ -163,8 +169,8 @@ int analyze_declaration(semantic_analyzer_t* analyzer,
 
     expression_t* e = decl->var_decl.init;
     size_t total_found = 0;
-    char** founds = 
-      calloc(struc_sym->members_count, sizeof(char*));
+    atom_t* founds = 
+      calloc(struc_sym->members_count, sizeof(atom_t));
     if (!founds) {
       error_report_general(ERROR_SEVERITY_ERROR, "out of memory"); 
       return 0;
@@ -174,16 +180,14 @@ int analyze_declaration(semantic_analyzer_t* analyzer,
       expression_t* assign = e->composite_literal.values[j];  
       int found = 0;
       for (size_t i = 0; i < struc_sym->members_count; ++ i) {
-        if (strcmp(
-              assign->assign.lhs->var.ident.ident_name, 
-              struc_sym->members_name[i]) == 0) {
+        if (assign->assign.lhs->var.ident.atom ==
+              struc_sym->members_atom[i]) {
           for (size_t x = 0; x < struc_sym->members_count; ++x) {
 
             if (!founds[x])
               break;
 
-            if (strcmp(
-                  founds[x], struc_sym->members_name[i]) == 0) {
+            if (founds[x] == struc_sym->members_atom[i]) {
               semantic_error_register(
                  analyzer, assign->source_pos - 1,
                  "already declared struct member");
@@ -194,7 +198,7 @@ int analyze_declaration(semantic_analyzer_t* analyzer,
 
           known_type_t actual = 
             semantic_check_expression(
-                analyzer, assign->assign.rhs, scope);
+                analyzer, assign->assign.rhs->flat, scope);
           
           if (struc_sym->members_type[i].type.kind != actual.kind &&
               struc_sym->members_type[i].type.kind < actual.kind) {
@@ -203,7 +207,7 @@ int analyze_declaration(semantic_analyzer_t* analyzer,
                 "wrong type converstion");
           }
 
-          founds[total_found++] = struc_sym->members_name[i];
+          founds[total_found++] = struc_sym->members_atom[i];
           found = 1;
         }
       }
@@ -221,20 +225,30 @@ int analyze_declaration(semantic_analyzer_t* analyzer,
   return 1;
 }
 
+// Records the type the pass resolved for variable expression `e`, the
+// lowering reads it back
+static void semantic_type_var(
+    ast_flat_t* flat, ast_ref_t e, known_type_t type)
+{
+  *ast_flat_var_type(flat, e) = type;
+  flat->exprs.type[e] = (uint8_t) type.kind;
+}
+
 known_type_t semantic_check_expr_int_lit(
     semantic_analyzer_t* analyzer,
-    expression_t* expr,
+    ast_ref_t expr,
     scope_t* scope)
 {
   (void) scope;
-  int v = expr->int_lit.value;
+  const ast_flat_t* flat = &analyzer->flat;
+  int v = flat->expr_cold[expr].value;
   types_t kind;
   if (v <= 255)
     kind = TYPE_U8;
   else if (v <= 65535)
     kind = TYPE_U16;
   else {
-    semantic_error_register(analyzer, expr->source_pos - 1,
+    semantic_error_register(analyzer, ast_flat_expr_pos(flat, expr) - 1,
         "long intergers are not implemented yet");
     return (known_type_t){.kind = TYPE_ERROR};
   }
@@ -247,78 +261,80 @@ known_type_t semantic_check_expr_int_lit(
 
 known_type_t semantic_check_expr_char_lit(
     semantic_analyzer_t* analyzer,
-    expression_t* expr,
+    ast_ref_t expr,
     scope_t* scope)
 {
   (void) analyzer;
+  (void) expr;
   (void) scope;
-  return expr->var.ident.type;
+  // checks as the smallest integer type
+  return (known_type_t){.kind = TYPE_U8};
 }
 
 known_type_t semantic_check_expr_var(
     semantic_analyzer_t* analyzer,
-    expression_t* expr,
+    ast_ref_t expr,
     scope_t* scope)
 {
+  ast_flat_t* flat = &analyzer->flat;
   variable_symbol_t* vs = 
     (variable_symbol_t*) scope_resolve(
-        scope, expr->var.ident.ident_name);
+        scope, flat->expr_cold[expr].name);
 
   if (!vs) {
-    semantic_error_register(analyzer, expr->source_pos - 1,
+    semantic_error_register(analyzer, ast_flat_expr_pos(flat, expr) - 1,
         "use of undefined variable");
     return (known_type_t){.kind = TYPE_ERROR};
   }
 
   known_type_t* k = &vs->type;
+  ast_ref_t member = flat->exprs.a[expr];
 
-  if (expr->var.member) {
+  if (member != AST_REF_NONE) {
     struct_symbol_t* sym = 
-      hashmap_get(analyzer->struct_symbols, k->name);
+      atom_map_get(analyzer->struct_symbols, k->atom);
 
     // should never happened
     if (!sym) {
-      semantic_error_register(analyzer, expr->source_pos - 1, 
+      semantic_error_register(analyzer, ast_flat_expr_pos(flat, expr) - 1, 
           "use of undefined variable");
       return (known_type_t){.kind = TYPE_ERROR};
     }
 
     for (size_t i = 0; i < sym->members_count; ++i) {
-      if (strcmp(
-            expr->var.member->var.ident.ident_name,
-            sym->members_name[i]) == 0) {
+      if (flat->expr_cold[member].name == sym->members_atom[i]) {
         semantic_resolve_type_size(analyzer, k);
 
-        expr->var.ident.type = *k;
-        expr->var.member->var.ident.type = 
-          sym->members_type[i].type;
+        semantic_type_var(flat, expr, *k);
+        semantic_type_var(flat, member, sym->members_type[i].type);
 
         return sym->members_type[i].type;
       }
     }
     semantic_error_register(
-        analyzer, expr->var.member->source_pos - 1,
+        analyzer, ast_flat_expr_pos(flat, member) - 1,
         "undefined struct member");
     return (known_type_t){.kind = TYPE_ERROR};
   }
 
   semantic_resolve_type_size(analyzer, k);
-  expr->var.ident.type = *k;
+  semantic_type_var(flat, expr, *k);
   return *k; 
 }
 
 known_type_t semantic_check_expr_binary(
     semantic_analyzer_t* analyzer,
-    expression_t* expr,
+    ast_ref_t expr,
     scope_t* scope)
 {
+  const ast_flat_t* flat = &analyzer->flat;
+  ast_ref_t lhs = flat->exprs.a[expr];
+  ast_ref_t rhs = flat->exprs.b[expr];
+
   // some kind of guard, may need to handle it better even if should not happend
-  if (!expr->binary.left || !expr->binary.right)
+  if (lhs == AST_REF_NONE || rhs == AST_REF_NONE)
     return (known_type_t){.kind = TYPE_ERROR};
 
-  expression_t* lhs = expr->binary.left;
-  expression_t* rhs = expr->binary.right;
-
   known_type_t lhs_type = semantic_check_expression(analyzer, lhs, scope);
   known_type_t rhs_type = semantic_check_expression(analyzer, rhs, scope);
 
@@ -341,7 +357,7 @@ known_type_t semantic_check_expr_binary(
   }
   else {
     semantic_error_register(analyzer, 
-        rhs->source_pos - 1,
+        ast_flat_expr_pos(flat, rhs) - 1,
         "wrong type conversion");
     return (known_type_t){.kind = TYPE_ERROR};
   }
@@ -349,11 +365,12 @@ known_type_t semantic_check_expr_binary(
 
 known_type_t semantic_check_expr_assign(
     semantic_analyzer_t* analyzer,
-    expression_t* expr,
+    ast_ref_t expr,
     scope_t* scope)
 {
-  expression_t* lhs = expr->assign.lhs; 
-  expression_t* rhs = expr->assign.rhs;
+  const ast_flat_t* flat = &analyzer->flat;
+  ast_ref_t lhs = flat->exprs.a[expr]; 
+  ast_ref_t rhs = flat->exprs.b[expr];
 
   known_type_t lhs_type = 
     semantic_check_expression(analyzer, lhs, scope);
@@ -363,23 +380,23 @@ known_type_t semantic_check_expr_assign(
   variable_symbol_t* sym = 
     (variable_symbol_t*) scope_resolve(
         scope,
-        lhs->var.ident.ident_name);
+        flat->expr_cold[lhs].name);
 
   if (!sym) goto assign_type_check;
 
   struct_symbol_t* struct_sym = 
-    (struct_symbol_t*) hashmap_get(
+    (struct_symbol_t*) atom_map_get(
         analyzer->struct_symbols,
-        sym->type.name);
+        sym->type.atom);
 
   function_symbol_t* func_sym =
-    (function_symbol_t*) hashmap_get(
+    (function_symbol_t*) atom_map_get(
         analyzer->function_symbols,
         analyzer->current_analyzed_function);
 
   if (sym->is_constant) {
     semantic_error_register(
-        analyzer, lhs->source_pos - 1,
+        analyzer, ast_flat_expr_pos(flat, lhs) - 1,
         "you are trying to reassign constant variable, this is not authorized");
   } 
   else if (struct_sym) {
@@ -387,30 +404,26 @@ known_type_t semantic_check_expr_assign(
     // This is something I should work on later
     // For now, let's keep this simple
     // TODO: refactor this later
-    expression_t* member = lhs->var.member;
-    for (size_t i = 0; i < struct_sym->members_count; ++i) {
-      if (strcmp(
-            struct_sym->members_name[i], 
-            member->var.ident.ident_name) != 0) 
+    ast_ref_t member = flat->exprs.a[lhs];
+    for (size_t i = 0; member != AST_REF_NONE && i < struct_sym->members_count; ++i) {
+      if (struct_sym->members_atom[i] != flat->expr_cold[member].name)
         continue;
          
       if (struct_sym->members_type[i].is_constant) {
         semantic_error_register(
-            analyzer, member->source_pos - 1,
+            analyzer, ast_flat_expr_pos(flat, member) - 1,
             "you are trying to reassign constant variable, this is not authorized");
       }
     }       
   } 
   else if (func_sym) {
     for (size_t i = 0; i < func_sym->params_count; ++i) {
-      if (strcmp(
-           func_sym->params_name[i],
-           lhs->var.ident.ident_name) != 0)
+      if (func_sym->params_atom[i] != flat->expr_cold[lhs].name)
        continue;
 
       if (func_sym->params_type[i].is_constant) {
         semantic_error_register(
-            analyzer, lhs->source_pos - 1,
+            analyzer, ast_flat_expr_pos(flat, lhs) - 1,
             "you are trying to reassign constant variable, this is not authorized");
       } 
     }
@@ -433,7 +446,7 @@ assign_type_check:
   }
   else if (lhs_type.kind < rhs_type.kind) {
     semantic_error_register(
-        analyzer, rhs->source_pos - 1,
+        analyzer, ast_flat_expr_pos(flat, rhs) - 1,
         "value exceed lhs max accepting integer value");
     return (known_type_t){.kind = TYPE_ERROR};
   } else if (lhs_type.kind > rhs_type.kind) {
@@ -442,7 +455,7 @@ assign_type_check:
   
   else {
     semantic_error_register(analyzer, 
-        rhs->source_pos - 1,
+        ast_flat_expr_pos(flat, rhs) - 1,
         "wrong type conversion");
     return (known_type_t){.kind = TYPE_ERROR};
   }
@@ -450,12 +463,16 @@ assign_type_check:
 
 known_type_t semantic_check_expr_unary(
     semantic_analyzer_t* analyzer,
-    expression_t* expr,
+    ast_ref_t expr,
     scope_t* scope)
 {
-  if (expr->unary.operand) {
+  const ast_flat_t* flat = &analyzer->flat;
+  ast_ref_t operand = flat->exprs.a[expr];
+  unary_op_kind op = (unary_op_kind) flat->expr_cold[expr].op;
+
+  if (operand != AST_REF_NONE) {
     known_type_t t = semantic_check_expression(analyzer,
-        expr->unary.operand,
+        operand,
         scope);
     if (t.kind == TYPE_ERROR)
       return t;
@@ -465,18 +482,18 @@ known_type_t semantic_check_expr_unary(
         t.kind != TYPE_U32 &&
         t.kind != TYPE_U64) {
       semantic_error_register(analyzer,
-         expr->unary.operand->source_pos - 1,
+         ast_flat_expr_pos(flat, operand) - 1,
          "expression is not assignable"); 
-    } else if (expr->unary.operand->type == EXPRESSION_CALL && 
-               expr->unary.op != UNARY_POST_INC &&
-               expr->unary.op != UNARY_POST_DEC) {
+    } else if (flat->exprs.kind[operand] == EXPRESSION_CALL && 
+               op != UNARY_POST_INC &&
+               op != UNARY_POST_DEC) {
       semantic_error_register(analyzer,
-          expr->unary.operand->source_pos - 1,
+          ast_flat_expr_pos(flat, operand) - 1,
           "cannot modify rvalue");
-    } else if (expr->unary.operand->type != EXPRESSION_VAR &&
-               expr->unary.op != UNARY_NEGATE) {
+    } else if (flat->exprs.kind[operand] != EXPRESSION_VAR &&
+               op != UNARY_NEGATE) {
       semantic_error_register(analyzer,
-         expr->unary.operand->source_pos - 1,
+         ast_flat_expr_pos(flat, operand) - 1,
          "expression is not assignable"); 
     }
     
@@ -488,21 +505,25 @@ known_type_t semantic_check_expr_unary(
 
 known_type_t semantic_check_expr_call(
     semantic_analyzer_t* analyzer,
-    expression_t* expr,
+    ast_ref_t expr,
     scope_t* scope)
 {
+  ast_flat_t* flat = &analyzer->flat;
+  ast_expr_cold_t* call = &flat->expr_cold[expr];
+  const char* callee = atom_str(call->name);
   function_symbol_t* fs = NULL;
 
-  if (expr->call.qualifier) {
+  if (call->qualifier != ATOM_NONE) {
     imported_symbol_t* isym = NULL;
+    const char* qualifier = atom_str(call->qualifier);
 
     if (analyzer->imported_functions) {
       size_t key_len =
-        strlen(expr->call.qualifier) + 2 + strlen(expr->call.callee) + 1;
+        strlen(qualifier) + 2 + strlen(callee) + 1;
       char* key = malloc(key_len);
       if (key) {
         snprintf(key, key_len, "%s::%s",
-            expr->call.qualifier, expr->call.callee);
+            qualifier, callee);
         isym = (imported_symbol_t*) hashmap_get(
             analyzer->imported_functions, key);
         free(key);
@@ -511,52 +532,55 @@ known_type_t semantic_check_expr_call(
 
     if (!isym) {
       semantic_error_register(analyzer,
-          expr->source_pos - 1,
+          ast_flat_expr_pos(flat, expr) - 1,
           "unknown qualified function call (module not imported or "
           "qualifier does not match the source module)");
       return (known_type_t){.kind = TYPE_ERROR};
     }
 
     fs = isym->fs;
-    expr->call.resolved_module = strdup(isym->module_name);
+    call->module = intern_cstr(isym->module_name);
   } else {
-    fs = (function_symbol_t*) hashmap_get(
+    fs = (function_symbol_t*) atom_map_get(
         analyzer->function_symbols,
-        expr->call.callee);
+        call->name);
 
     if (!fs && analyzer->imported_functions) {
       imported_symbol_t* isym = (imported_symbol_t*) hashmap_get(
-          analyzer->imported_functions, expr->call.callee);
+          analyzer->imported_functions, callee);
       if (isym) {
         fs = isym->fs;
-        expr->call.resolved_module = strdup(isym->module_name);
+        call->module = intern_cstr(isym->module_name);
       }
     }
   }
 
   if (!fs) {
     semantic_error_register(analyzer,
-        expr->source_pos - 1,
+        ast_flat_expr_pos(flat, expr) - 1,
         "undefined function call");
     return (known_type_t){.kind = TYPE_ERROR};
   }
 
-  if (fs->params_count < expr->call.arg_count) {
+  size_t arg_count = call->list.count;
+  const ast_ref_t* args = &flat->lists[call->list.first];
+
+  if (fs->params_count < arg_count) {
     semantic_error_register(analyzer,
-        expr->call.args[expr->call.arg_count - 1]->source_pos - 1,
+        ast_flat_expr_pos(flat, args[arg_count - 1]) - 1,
         "too many arguments to function call");
       return (known_type_t){.kind = TYPE_ERROR};
   }
 
-  if (fs->params_count > expr->call.arg_count) {
-    if (expr->call.arg_count == 0) {
+  if (fs->params_count > arg_count) {
+    if (arg_count == 0) {
       semantic_error_register(analyzer,
-          expr->source_pos + 1,
+          ast_flat_expr_pos(flat, expr) + 1,
           "too few arguments to function call");
     
     } else {
       semantic_error_register(analyzer,
-        expr->call.args[expr->call.arg_count - 1]->source_pos - 1,
+        ast_flat_expr_pos(flat, args[arg_count - 1]) - 1,
         "too few arguments to function call");
     
     }
@@ -565,7 +589,7 @@ known_type_t semantic_check_expr_call(
 
   for (size_t i = 0; i < fs->params_count; ++i) {
     known_type_t arg_type = semantic_check_expression(analyzer,
-          expr->call.args[i],
+          args[i],
           scope);
     if (arg_type.kind == TYPE_UNTYPE)
       continue;
@@ -573,7 +597,7 @@ known_type_t semantic_check_expr_call(
     if (arg_type.kind != fs->params_type[i].type.kind &&
         fs->params_type[i].type.kind < arg_type.kind) {
       semantic_error_register(analyzer,
-          expr->call.args[i]->source_pos - 1,
+          ast_flat_expr_pos(flat, args[i]) - 1,
           "wrong type conversion");
       return (known_type_t){.kind = TYPE_ERROR};
     }
@@ -584,7 +608,7 @@ known_type_t semantic_check_expr_call(
 
 known_type_t semantic_check_expr_composite_literal(
     semantic_analyzer_t* analyzer,
-    expression_t* expr,
+    ast_ref_t expr,
     scope_t* scope)
 {
   (void) analyzer;
@@ -595,49 +619,44 @@ known_type_t semantic_check_expr_composite_literal(
 
 known_type_t semantic_check_expr_index(
     semantic_analyzer_t* analyzer,
-    expression_t* expr,
+    ast_ref_t expr,
     scope_t* scope)
 {
+  const ast_flat_t* flat = &analyzer->flat;
   known_type_t base = 
-    semantic_check_expression(analyzer, expr->index.base, scope);
+    semantic_check_expression(analyzer, flat->exprs.a[expr], scope);
 
-  semantic_check_expression(analyzer, expr->index.index, scope);
+  semantic_check_expression(analyzer, flat->exprs.b[expr], scope);
 
   return base;
 }
 
 known_type_t semantic_check_expression(
     semantic_analyzer_t* analyzer,
-    expression_t* expr,
+    ast_ref_t expr,
     scope_t* scope)
 {
-  if (expr->type == EXPRESSION_INT_LIT)
+  switch (analyzer->flat.exprs.kind[expr]) {
+  case EXPRESSION_INT_LIT:
     return semantic_check_expr_int_lit(analyzer, expr, scope);
-
-  if (expr->type == EXPRESSION_CHAR_LIT)
+  case EXPRESSION_CHAR_LIT:
     return semantic_check_expr_char_lit(analyzer, expr, scope);
-
-  if (expr->type == EXPRESSION_VAR)
+  case EXPRESSION_VAR:
     return semantic_check_expr_var(analyzer, expr, scope);
-
-  if (expr->type == EXPRESSION_BINARY)
+  case EXPRESSION_BINARY:
     return semantic_check_expr_binary(analyzer, expr, scope);
-
-  if (expr->type == EXPRESSION_ASSIGN)
+  case EXPRESSION_ASSIGN:
     return semantic_check_expr_assign(analyzer, expr, scope);
-
-  if (expr->type == EXPRESSION_UNARY)
+  case EXPRESSION_UNARY:
     return semantic_check_expr_unary(analyzer, expr, scope);
-
-  if (expr->type == EXPRESSION_CALL)
+  case EXPRESSION_CALL:
     return semantic_check_expr_call(analyzer, expr, scope);
-
-  if (expr->type == EXPRESSION_COMPOSITE_LITERAL)
+  case EXPRESSION_COMPOSITE_LITERAL:
     return semantic_check_expr_composite_literal(
         analyzer, expr, scope);
-
-  if (expr->type == EXPRESSION_INDEX)
+  case EXPRESSION_INDEX:
     return semantic_check_expr_index(analyzer, expr, scope);
+  }
 
   return (known_type_t){.kind = TYPE_ERROR};
 }
@@ -647,14 +666,14 @@ void semantic_check_return_statement(semantic_analyzer_t* analyzer,
                                      scope_t* scope)
 {
   expression_t* e = stmt->ret.value;
-  function_symbol_t* fs = (function_symbol_t*) hashmap_get(
+  function_symbol_t* fs = (function_symbol_t*) atom_map_get(
       analyzer->function_symbols, 
       analyzer->current_analyzed_function);
 
   // some kind of guard, should be always false as parser is working
   if (!e) return;
 
-  known_type_t rt = semantic_check_expression(analyzer, e, scope);
+  known_type_t rt = semantic_check_expression(analyzer, e->flat, scope);
 
   if (rt.kind == TYPE_ERROR) return;
 
@@ -680,17 +699,21 @@ void semantic_check_for_statement(semantic_analyzer_t* analyzer,
                                   statement_t* stmt,
                                   scope_t* scope)
 {
-  scope_t* for_scope = scope_enter(scope);
+  // the variable declared in the init is only visible in the loop
+  if (!scope_push(scope)) {
+    error_report_general(ERROR_SEVERITY_ERROR, "out of memory");
+    return;
+  }
 
   if (stmt->for_stmt.init_kind == FOR_INIT_DECL && 
       stmt->for_stmt.decl_init) {
 
     declaration_t* decl = stmt->for_stmt.decl_init;
 
-    if (analyze_declaration(analyzer, decl, for_scope)) {
+    if (analyze_declaration(analyzer, decl, scope)) {
       known_type_t inferred = 
         semantic_check_expression(
-            analyzer, decl->var_decl.init, for_scope);
+            analyzer, decl->var_decl.init->flat, scope);
 
       variable_symbol_t* vs = calloc(1, sizeof(variable_symbol_t));
 
@@ -706,30 +729,29 @@ void semantic_check_for_statement(semantic_analyzer_t* analyzer,
       }
       vs->is_constant = false;
       decl->var_decl.ident.type = vs->type;
-      hashmap_put(
-          for_scope->symbols, decl->var_decl.ident.ident_name, vs);
+      scope_declare(scope, decl->var_decl.ident.atom, vs);
     }
   } 
 
   else if (stmt->for_stmt.init_kind == FOR_INIT_EXPR && 
       stmt->for_stmt.expr_init) {
     semantic_check_expression(
-        analyzer, stmt->for_stmt.expr_init, for_scope);
+        analyzer, stmt->for_stmt.expr_init->flat, scope);
   }
 
   if (stmt->for_stmt.condition)
     semantic_check_expression(analyzer,
-        stmt->for_stmt.condition,
-        for_scope);
+        stmt->for_stmt.condition->flat,
+        scope);
 
   if (stmt->for_stmt.loop)
     semantic_check_expression(analyzer,
-        stmt->for_stmt.loop,
-        for_scope);
+        stmt->for_stmt.loop->flat,
+        scope);
 
-  semantic_check_scope(analyzer, stmt->for_stmt.body, for_scope);
+  semantic_check_scope(analyzer, stmt->for_stmt.body, scope);
 
-  scope_exit(for_scope);
+  scope_pop(scope);
 }
 
 void semantic_check_var_declaration(
@@ -754,7 +776,7 @@ void semantic_check_var_declaration(
       expression_t* e = 
         decl->var_decl.init->composite_literal.values[i];
 
-      actual_type = semantic_check_expression(analyzer, e, scope);
+      actual_type = semantic_check_expression(analyzer, e->flat, scope);
 
       if (expected_type.kind < actual_type.kind) {
         semantic_error_register(
@@ -778,7 +800,7 @@ void semantic_check_var_declaration(
   actual_type = 
     semantic_check_expression(
         analyzer, 
-        decl->var_decl.init,
+        decl->var_decl.init->flat,
         scope); 
   
   if (expected_type.kind != actual_type.kind && 
@@ -817,9 +839,7 @@ var_def_put:
   semantic_resolve_type_size(analyzer, &vs->type);
   vs->is_constant = decl->var_decl.ident.is_constant;
   decl->var_decl.ident.type = vs->type;
-  hashmap_put(
-      scope->symbols, 
-      decl->var_decl.ident.ident_name, vs);
+  scope_declare(scope, decl->var_decl.ident.atom, vs);
 }
 
 void semantic_check_if_statement(semantic_analyzer_t* analyzer,
@@ -827,7 +847,7 @@ void semantic_check_if_statement(semantic_analyzer_t* analyzer,
                                  scope_t* scope)
 {
   semantic_check_expression(
-      analyzer, stmt->if_stmt.condition, scope);
+      analyzer, stmt->if_stmt.condition->flat, scope);
   if (stmt->if_stmt.then_branch)
     semantic_check_scope(
         analyzer, stmt->if_stmt.then_branch, scope); 
@@ -841,7 +861,7 @@ void semantic_check_while_statement(semantic_analyzer_t* analyzer,
                                     scope_t* scope)
 {
   semantic_check_expression(
-      analyzer, stmt->while_stmt.condition, scope);
+      analyzer, stmt->while_stmt.condition->flat, scope);
   if (stmt->while_stmt.body) 
     semantic_check_scope(
         analyzer, stmt->while_stmt.body, scope); 
@@ -851,8 +871,7 @@ void semantic_check_scope(semantic_analyzer_t* analyzer,
                           statement_block_t* body, 
                           scope_t* scope)
 {
-  scope_t* local_scope = scope_enter(scope);
-  if (!local_scope) {
+  if (!scope_push(scope)) {
     error_report_general(ERROR_SEVERITY_ERROR, "out of memory"); 
     return;
   }
@@ -863,34 +882,34 @@ void semantic_check_scope(semantic_analyzer_t* analyzer,
     if (stmt->type == STATEMENT_DECL) {
       if (stmt->decl_stmt.decl->type == DECLARATION_VAR) {
         semantic_check_var_declaration(
-            analyzer, stmt->decl_stmt.decl, local_scope);
+            analyzer, stmt->decl_stmt.decl, scope);
       }
     }
 
     if (stmt->type == STATEMENT_IF)
-      semantic_check_if_statement(analyzer, stmt, local_scope); 
+      semantic_check_if_statement(analyzer, stmt, scope); 
 
     if (stmt->type == STATEMENT_WHILE)
-      semantic_check_while_statement(analyzer, stmt, local_scope); 
+      semantic_check_while_statement(analyzer, stmt, scope); 
 
     if (stmt->type == STATEMENT_FOR) 
-      semantic_check_for_statement(analyzer, stmt, local_scope); 
+      semantic_check_for_statement(analyzer, stmt, scope); 
 
     if (stmt->type == STATEMENT_RETURN) 
-      semantic_check_return_statement(analyzer, stmt, local_scope); 
+      semantic_check_return_statement(analyzer, stmt, scope); 
 
     if (stmt->type == STATEMENT_ASM)
-      semantic_check_asm_statement(analyzer, stmt, local_scope);
+      semantic_check_asm_statement(analyzer, stmt, scope);
 
     if (stmt->type == STATEMENT_EXPR)
       semantic_check_expression(
-          analyzer, stmt->expr_stmt.expr, local_scope);
+          analyzer, stmt->expr_stmt.expr->flat, scope);
 
     if (stmt->type == STATEMENT_FREE)
-      semantic_check_free_statement(analyzer, stmt, local_scope);
+      semantic_check_free_statement(analyzer, stmt, scope);
   }
 
-  scope_exit(local_scope);
+  scope_pop(scope);
 }
 
 void semantic_check_free_statement(
@@ -899,7 +918,7 @@ void semantic_check_free_statement(
     scope_t* scope)
 {
   known_type_t t = 
-    semantic_check_expression(analyzer, stmt->free_stmt.expr, scope);
+    semantic_check_expression(analyzer, stmt->free_stmt.expr->flat, scope);
 
   if (t.kind != TYPE_CUSTOM && t.array_len <= 0) {
     semantic_error_register(
@@ -908,10 +927,7 @@ void semantic_check_free_statement(
     return;
   }
 
-  variable_symbol_t* sym = (variable_symbol_t*)
-    scope_resolve(scope, stmt->free_stmt.expr->var.ident.ident_name);
-  free(sym);
-  scope_remove(scope, stmt->free_stmt.expr->var.ident.ident_name);
+  free(scope_remove(scope, stmt->free_stmt.expr->var.ident.atom));
 }
 
 void semantic_check_asm_statement(
@@ -936,20 +952,19 @@ void semantic_check_asm_statement(
 
   for (size_t i = 0; i < stmt->asm_stmt.arg_count; ++i) {
     semantic_check_expression(
-        analyzer, stmt->asm_stmt.args[i], scope);
+        analyzer, stmt->asm_stmt.args[i]->flat, scope);
   }
 }
 
 void semantic_load_program_definition(semantic_analyzer_t* analyzer) 
 {
   // TODO: return some sort of status code to make this stop the compiler
-  hashmap_t* func_sym = (hashmap_t*) malloc(sizeof(hashmap_t));
+  atom_map_t* func_sym = calloc(1, sizeof(atom_map_t));
   if (!func_sym) {
     error_report_general(ERROR_SEVERITY_ERROR, "out of memory");  
     return;
   }
-  memset(func_sym, 0, sizeof(hashmap_t));
-  hashmap_t* struct_sym = calloc(1, sizeof(hashmap_t));
+  atom_map_t* struct_sym = calloc(1, sizeof(atom_map_t));
   if (!struct_sym) {
     error_report_general(ERROR_SEVERITY_ERROR, "out of memory"); 
     return;
@@ -964,7 +979,7 @@ void semantic_load_program_definition(semantic_analyzer_t* analyzer)
         continue;
       }
 
-      if (hashmap_get(func_sym, (*it)->func.name)) {
+      if (atom_map_get(func_sym, (*it)->func.atom)) {
         const char* pos = (*it)->source_pos + 1;
         semantic_error_register(analyzer, pos, 
             "already defined function redefinition");
@@ -976,8 +991,8 @@ void semantic_load_program_definition(semantic_analyzer_t* analyzer)
       if (!value) {
         error_report_general(ERROR_SEVERITY_ERROR, 
             "out of memory"); 
-        hashmap_free(func_sym, 1);
-        hashmap_free(struct_sym, 1);
+        atom_map_free(func_sym, 1);
+        atom_map_free(struct_sym, 1);
         return; 
       }
       memset(value, 0, sizeof(function_symbol_t));
@@ -989,13 +1004,13 @@ void semantic_load_program_definition(semantic_analyzer_t* analyzer)
       }
 
       size_t actual_count = 0;
-      value->params_name = 
-        calloc((*it)->func.params.count, sizeof(char*));
-      if (!value->params_name) {
+      value->params_atom = 
+        calloc((*it)->func.params.count, sizeof(atom_t));
+      if (!value->params_atom) {
         error_report_general(ERROR_SEVERITY_ERROR, 
             "out of memory"); 
-        hashmap_free(func_sym, 1);
-        hashmap_free(struct_sym, 1);
+        atom_map_free(func_sym, 1);
+        atom_map_free(struct_sym, 1);
         return ;
       }
 
@@ -1004,23 +1019,23 @@ void semantic_load_program_definition(semantic_analyzer_t* analyzer)
       if (!value->params_type) {
         error_report_general(ERROR_SEVERITY_ERROR, 
             "out of memory"); 
-        hashmap_free(func_sym, 1);
-        hashmap_free(struct_sym, 1);
+        atom_map_free(func_sym, 1);
+        atom_map_free(struct_sym, 1);
         return;
       }
       value->params_count = (*it)->func.params.count;
 
       for (size_t i = 0; i < (*it)->func.params.count; ++i) {
-        if (string_array_contains(value->params_name, 
+        if (atom_array_contains(value->params_atom, 
               actual_count, 
-              (*it)->func.params.items[i].ident_name)) 
+              (*it)->func.params.items[i].atom)) 
           semantic_error_register(
               analyzer, 
               (*it)->func.params.items[i].source_pos - 1,
               "already defined function parameters redifinition");
 
-        value->params_name[i] = 
-          (*it)->func.params.items[i].ident_name;
+        value->params_atom[i] = 
+          (*it)->func.params.items[i].atom;
         value->params_type[i].type = 
           (*it)->func.params.items[i].type;
         value->params_type[i].is_constant =
@@ -1029,7 +1044,7 @@ void semantic_load_program_definition(semantic_analyzer_t* analyzer)
       }
 
 hash_func_put:
-      hashmap_put(func_sym, (*it)->func.name, value);
+      atom_map_put(func_sym, (*it)->func.atom, value);
     } else if ((*it)->type == DECLARATION_STRUCT) {
       if (semantic_check_name_not_reserved((*it)->struc.name)) {
         semantic_error_register(analyzer, (*it)->source_pos + 1,
@@ -1037,7 +1052,7 @@ hash_func_put:
         continue;
       } 
 
-      if (hashmap_get(struct_sym, (*it)->struc.name)) {
+      if (atom_map_get(struct_sym, (*it)->struc.atom)) {
         const char* pos = (*it)->source_pos + 1; 
         semantic_error_register(analyzer, pos,
             "already defined struct redifinition");
@@ -1048,8 +1063,8 @@ hash_func_put:
       if (!value) {
         error_report_general(ERROR_SEVERITY_ERROR,
            "out of memory"); 
-        hashmap_free(func_sym, 1);
-        hashmap_free(struct_sym, 1);
+        atom_map_free(func_sym, 1);
+        atom_map_free(struct_sym, 1);
         return;
       }
 
@@ -1061,13 +1076,13 @@ hash_func_put:
       }
 
       value->members_count = (*it)->struc.members.count;
-      value->members_name =
-        calloc(value->members_count, sizeof(char*));
-      if (!value->members_name) {
+      value->members_atom =
+        calloc(value->members_count, sizeof(atom_t));
+      if (!value->members_atom) {
         error_report_general(ERROR_SEVERITY_ERROR, 
             "out of memory"); 
-        hashmap_free(func_sym, 1);
-        hashmap_free(struct_sym, 1);
+        atom_map_free(func_sym, 1);
+        atom_map_free(struct_sym, 1);
         return ;
       }
 
@@ -1076,23 +1091,23 @@ hash_func_put:
       if (!value->members_type) {
         error_report_general(ERROR_SEVERITY_ERROR, 
             "out of memory"); 
-        hashmap_free(func_sym, 1);
-        hashmap_free(struct_sym, 1);
+        atom_map_free(func_sym, 1);
+        atom_map_free(struct_sym, 1);
         return;
       }
 
       size_t actual_count = 0;
       for (size_t i = 0; i < (*it)->struc.members.count; ++i) {
-        if (string_array_contains(value->members_name,
+        if (atom_array_contains(value->members_atom,
              actual_count,
-            (*it)->struc.members.items[i].ident_name))
+            (*it)->struc.members.items[i].atom))
           semantic_error_register(
             analyzer,
             (*it)->struc.members.items[i].source_pos - 1,
             "already defined struct members redifinition");
 
-        value->members_name[i] =
-          (*it)->struc.members.items[i].ident_name;
+        value->members_atom[i] =
+          (*it)->struc.members.items[i].atom;
         value->members_type[i].type =
           (*it)->struc.members.items[i].type;
         value->members_type[i].is_constant =
@@ -1103,7 +1118,12 @@ hash_func_put:
       }
 
 hash_struct_put:
-      hashmap_put(struct_sym, (*it)->struc.name, value);
+      atom_map_put(struct_sym, (*it)->struc.atom, value);
+
+      known_type_t* def =
+        type_registry_find(analyzer->types, (*it)->struc.atom);
+      if (def)
+        def->element_size = value->total_size;
     }
   }
 
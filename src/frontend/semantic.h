@@ -4,10 +4,12 @@
 #define DA_LIB_IMPLEMENTATION
 #include "../thirdparty/da.h"
 #include "ast_definition.h"
+#include "ast_flat.h"
 #include "../thirdparty/error.h"
 #include "../thirdparty/hashmap.h"
 #include "scope.h"    
 #include "symbols.h"
+#include "type_registry.h"
 
 #include <string.h>
 #include <stdlib.h>
@@ -61,18 +63,22 @@ typedef struct
   int error_count;
 
   declaration_array* ast;
+  type_registry_t* types; // of the parser that built `ast`
 
-  hashmap_t* function_symbols;
-  hashmap_t* struct_symbols;
+  atom_map_t* function_symbols;
+  atom_map_t* struct_symbols;
+
+  // expressions of `ast`, built and typed by semantic_analyze
+  ast_flat_t flat;
 
   hashmap_t* imported_functions;
   imported_symbol_array imported_owned;
 
-  const char* current_analyzed_function;
+  atom_t current_analyzed_function;
 } semantic_analyzer_t;
 
-int string_array_contains(
-    char** source, size_t source_len, const char* name);
+int atom_array_contains(
+    const atom_t* source, size_t source_len, atom_t name);
 
 int analyze_declaration(
     semantic_analyzer_t* analyzer, 
@@ -81,52 +87,52 @@ int analyze_declaration(
 
 known_type_t semantic_check_expression(
     semantic_analyzer_t* analyzer,
-    expression_t* expr, 
+    ast_ref_t expr, 
     scope_t* scope);
 
 known_type_t semantic_check_expr_int_lit(
     semantic_analyzer_t* analyzer,
-    expression_t* expr,
+    ast_ref_t expr,
     scope_t* scope);
 
 known_type_t semantic_check_expr_char_lit(
     semantic_analyzer_t* analyzer,
-    expression_t* expr,
+    ast_ref_t expr,
     scope_t* scope);
 
 known_type_t semantic_check_expr_var(
     semantic_analyzer_t* analyzer,
-    expression_t* expr,
+    ast_ref_t expr,
     scope_t* scope);
 
 known_type_t semantic_check_expr_binary(
     semantic_analyzer_t* analyzer,
-    expression_t* expr,
+    ast_ref_t expr,
     scope_t* scope);
 
 known_type_t semantic_check_expr_assign(
     semantic_analyzer_t* analyzer,
-    expression_t* expr,
+    ast_ref_t expr,
     scope_t* scope);
 
 known_type_t semantic_check_expr_unary(
     semantic_analyzer_t* analyzer,
-    expression_t* expr,
+    ast_ref_t expr,
     scope_t* scope);
 
 known_type_t semantic_check_expr_call(
     semantic_analyzer_t* analyzer,
-    expression_t* expr,
+    ast_ref_t expr,
     scope_t* scope);
 
 known_type_t semantic_check_expr_composite_literal(
     semantic_analyzer_t* analyzer,
-    expression_t* expr,
+    ast_ref_t expr,
     scope_t* scope);
 
 known_type_t semantic_check_expr_index(
     semantic_analyzer_t* analyzer,
-    expression_t* expr,
+    ast_ref_t expr,
     scope_t* scope);
 
 void semantic_analyze(semantic_analyzer_t* analyzer);
@@ -13,13 +13,13 @@ typedef struct
 {
   known_type_t return_type;
 
-  char** params_name;
+  atom_t* params_atom;
   variable_symbol_t* params_type;
   size_t params_count;
 } function_symbol_t;
 
 typedef struct {
-  char** members_name;
+  atom_t* members_atom;
   variable_symbol_t* members_type;
   size_t members_count;
   size_t total_size;
@@ -0,0 +1,74 @@
+#ifndef TYPE_REGISTRY_H
+#define TYPE_REGISTRY_H
+
+#include <stdint.h>
+
+#include "ast_definition.h"
+
+// Types known to a module, shared by the parser and the semantic pass,
+// both of which look them up by name. Builtins are registered first at
+// their types_t, struct types follow in declaration order. The AST and
+// the symbols hold copies of the entries, not ids: the id only tells the
+// parser which types a deferred body may see (parser_t.types_visible).
+typedef struct
+{
+  known_type_t* items;
+  size_t count;
+  size_t capacity;
+
+  atom_map_t by_name; // name atom -> id + 1
+} type_registry_t;
+
+static inline known_type_t* type_registry_get(type_registry_t* reg, type_id_t id)
+{
+  if (!reg || id >= reg->count)
+    return NULL;
+  return &reg->items[id];
+}
+
+static inline known_type_t* type_registry_find(type_registry_t* reg, atom_t name)
+{
+  if (!reg)
+    return NULL;
+
+  uintptr_t slot = (uintptr_t) atom_map_get(&reg->by_name, name);
+  return slot ? &reg->items[slot - 1] : NULL;
+}
+
+// Registers `t` under the next id and returns it, TYPE_ID_NONE when out
+// of memory. A name declared again keeps resolving to its first type.
+static inline type_id_t type_registry_add(type_registry_t* reg, known_type_t t)
+{
+  if (reg->count == reg->capacity) {
+    size_t capacity = reg->capacity ? reg->capacity * 2 : 16;
+    known_type_t* items = realloc(reg->items, capacity * sizeof(known_type_t));
+    if (!items)
+      return TYPE_ID_NONE;
+    reg->items = items;
+    reg->capacity = capacity;
+  }
+
+  t.id = (type_id_t) reg->count;
+  if (t.atom == ATOM_NONE)
+    t.atom = intern_cstr(t.name);
+
+  if (!atom_map_get(&reg->by_name, t.atom) &&
+      !atom_map_put(&reg->by_name, t.atom, (void*) (uintptr_t) (t.id + 1)))
+    return TYPE_ID_NONE;
+
+  reg->items[reg->count++] = t;
+  return t.id;
+}
+
+static inline void type_registry_free(type_registry_t* reg)
+{
+  if (!reg)
+    return;
+  free(reg->items);
+  atom_map_free(&reg->by_name, 0);
+  reg->items = NULL;
+  reg->count = 0;
+  reg->capacity = 0;
+}
+
+#endif // TYPE_REGISTRY_H
@@ -4,6 +4,22 @@ static size_t min(size_t a, size_t b) {
   return a < b ? a : b;
 }
 
+// Type of `e` when it is a variable, the zeroed type otherwise
+static known_type_t IR_var_type(const HIR_parser_t* hir, ast_ref_t e)
+{
+  if (hir->flat->exprs.kind[e] != EXPRESSION_VAR)
+    return (known_type_t){0};
+  return *ast_flat_var_type(hir->flat, e);
+}
+
+// Whether `init` is a `{ ... }` listing values, not a `{0}`
+static bool IR_is_initializer(const HIR_parser_t* hir, const expression_t* init)
+{
+  return init &&
+    hir->flat->exprs.kind[init->flat] == EXPRESSION_COMPOSITE_LITERAL &&
+    hir->flat->expr_cold[init->flat].value;
+}
+
 char* IR_mangle_function_name(const char* module_path, const char* func_name)
 {
   if (!module_path)
@@ -35,15 +51,8 @@ char* IR_mangle_function_name(const char* module_path, const char* func_name)
 }
   
 void IR_free_instruction(IR_instruction_t* instr) {
+  // variable names are interned, nothing to free for them
   switch (instr->kind) {
-    case IR_STORE_VAR:
-      if (instr->var.name)
-        free(instr->var.name);
-      break;
-    case IR_LOAD_VAR:
-      if (instr->var.name)
-        free(instr->var.name);
-      break;
     case IR_JMP_NOT_EQUAL:
     case IR_JMP:
     case IR_JMP_EQUAL:
@@ -82,7 +91,7 @@ void IR_free_function(IR_function_t* func)
   if (func->code) {
     da_foreach(IR_instruction_t*, it, func->code) 
       IR_free_instruction(*it); 
-    free(func->code->items);
+    da_small_free(func->code);
     free(func->code);
   }
 
@@ -94,7 +103,6 @@ int IR_lower_declaration(
     declaration_t* decl,
     IR_function_t* func)
 {
-  (void)hir;
   if (decl->type != DECLARATION_VAR) {
     error_report_general(ERROR_SEVERITY_ERROR, 
         "awaiting var declaration, getting something else");
@@ -108,7 +116,8 @@ int IR_lower_declaration(
   }
 
   instr->kind = IR_STORE_VAR;
-  instr->var.name = strdup(decl->var_decl.ident.ident_name);
+  instr->var.name = decl->var_decl.ident.ident_name;
+  instr->var.atom = decl->var_decl.ident.atom;
   instr->src.size = decl->var_decl.ident.type.element_size;
   if (!instr->var.name) {
     error_report_general(ERROR_SEVERITY_ERROR, "out of memory");
@@ -126,13 +135,12 @@ int IR_lower_declaration(
       alloc->kind = IR_ALLOC;
       alloc->alloc_size = decl->var_decl.ident.type.element_size;
 
-      da_append(func->code, alloc);
+      da_small_append(func->code, alloc);
       instr->var.is_init = 1;
       instr->src.id = -1;
 
-      da_append(func->code, instr);
-      if (decl->var_decl.init && 
-          decl->var_decl.init->composite_literal.is_initializer) {
+      da_small_append(func->code, instr);
+      if (IR_is_initializer(hir, decl->var_decl.init)) {
         int err = 
           IR_lower_composite_literal_expression(hir, decl, func);
         if (err)
@@ -149,14 +157,13 @@ int IR_lower_declaration(
     }
     alloc->kind = IR_ALLOC;
     alloc->alloc_size = decl->var_decl.ident.type.size;
-    da_append(func->code, alloc);
+    da_small_append(func->code, alloc);
 
     instr->var.is_init = 1;
     instr->src.id = -1;
 
-    da_append(func->code, instr);
-    if (decl->var_decl.init && 
-        decl->var_decl.init->composite_literal.is_initializer) {
+    da_small_append(func->code, instr);
+    if (IR_is_initializer(hir, decl->var_decl.init)) {
       int err = 
         IR_lower_composite_literal_expression(hir, decl, func);
       if (err)
@@ -167,14 +174,14 @@ int IR_lower_declaration(
   else {
     if (decl->var_decl.init) {
       instr->var.is_init = 1;
-      IR_lower_expression(hir, decl->var_decl.init, func);   
+      IR_lower_expression(hir, decl->var_decl.init->flat, func);   
       instr->src.id = func->next_temp_id;
     } else {
       if (decl->var_decl.ident.type.kind == TYPE_INT) {
         instr->var.is_init = 0; 
       }
     } 
-    da_append(func->code, instr);
+    da_small_append(func->code, instr);
     func->stack_reserve_size += decl->var_decl.ident.type.element_size;
   }
 
@@ -196,26 +203,26 @@ int IR_lower_composite_literal_expression(
   // we store a pointer (64bits) so we can hardcode the size here
   load->dest.size = 8;
   load->var.is_init = 1;
-  load->var.name = strdup(decl->var_decl.ident.ident_name);
+  load->var.name = decl->var_decl.ident.ident_name;
+  load->var.atom = decl->var_decl.ident.atom;
   if (!load->var.name) {
     error_report_general(ERROR_SEVERITY_ERROR, "out of memory");
     return 1;
   }
 
-  da_append(func->code, load);
+  da_small_append(func->code, load);
 
-  struct_symbol_t* sym = hashmap_get(hir->struct_symbols,
-      decl->var_decl.ident.type.name);
-  expression_t* e = decl->var_decl.init;
+  struct_symbol_t* sym = atom_map_get(hir->struct_symbols,
+      decl->var_decl.ident.type.atom);
+  const ast_flat_t* flat = hir->flat;
+  ast_range_t values = flat->expr_cold[decl->var_decl.init->flat].list;
 
   int save = func->next_temp_id;
 
-  for (size_t i = 0; i < e->composite_literal.count; ++i) {
-    expression_t* expr;
-    if (e->composite_literal.values[i]->type == EXPRESSION_ASSIGN) 
-      expr = e->composite_literal.values[i]->assign.rhs;
-    else 
-      expr = e->composite_literal.values[i];
+  for (size_t i = 0; i < values.count; ++i) {
+    ast_ref_t value = flat->lists[values.first + i];
+    bool named = flat->exprs.kind[value] == EXPRESSION_ASSIGN;
+    ast_ref_t expr = named ? flat->exprs.b[value] : value;
 
     IR_lower_expression(hir, expr, func);
     size_t computed_place = 0;
@@ -233,15 +240,11 @@ int IR_lower_composite_literal_expression(
     mov_offset->dest.size = 8;
     mov_offset->src.id = func->next_temp_id;
 
-    if (e->composite_literal.values[i]->type == 
-        EXPRESSION_ASSIGN) {
+    if (named) {
       size_t j = 0;
       for (; j < sym->members_count; ++j) {
-        expression_t* comparator = 
-          e->composite_literal.values[i]->assign.lhs;
-        if (strcmp(
-              comparator->var.ident.ident_name,
-              sym->members_name[j]) == 0) {
+        ast_ref_t comparator = flat->exprs.a[value];
+        if (flat->expr_cold[comparator].name == sym->members_atom[j]) {
           break ; 
         } else {
           computed_place += sym->members_type[j].type.element_size;
@@ -251,14 +254,14 @@ int IR_lower_composite_literal_expression(
         sym->members_type[j].type.element_size;
 
       mov_offset->offset.size = computed_place;
-      da_append(func->code, mov_offset);
+      da_small_append(func->code, mov_offset);
     }
     else {
       mov_offset->src.size = 
         decl->var_decl.ident.type.element_size; 
       mov_offset->offset.size = 
         decl->var_decl.ident.type.element_size * i;
-      da_append(func->code, mov_offset);
+      da_small_append(func->code, mov_offset);
     }
   }
 
@@ -266,15 +269,17 @@ int IR_lower_composite_literal_expression(
 }
 
 int IR_lower_unary_expression(HIR_parser_t* hir,
-    expression_t* expr,
+    ast_ref_t expr,
     IR_function_t* func)
 {
-  (void)hir;
-  size_t operand_size = 
-    expr->unary.operand->var.ident.type.element_size;
-
-  if (expr->unary.op == UNARY_POST_INC ||
-      expr->unary.op == UNARY_POST_DEC) {
+  ast_ref_t operand = hir->flat->exprs.a[expr];
+  unary_op_kind unary_op = (unary_op_kind) hir->flat->expr_cold[expr].op;
+  const char* operand_name = atom_str(hir->flat->expr_cold[operand].name);
+  atom_t operand_atom = hir->flat->expr_cold[operand].name;
+  size_t operand_size = IR_var_type(hir, operand).element_size;
+
+  if (unary_op == UNARY_POST_INC ||
+      unary_op == UNARY_POST_DEC) {
     IR_instruction_t* load = calloc(1, sizeof(IR_instruction_t)); 
     if (!load) {
       error_report_general(ERROR_SEVERITY_ERROR, "out of memory"); 
@@ -282,14 +287,15 @@ int IR_lower_unary_expression(HIR_parser_t* hir,
     }
 
     load->kind = IR_LOAD_VAR;
-    load->var.name = strdup(expr->unary.operand->var.ident.ident_name);
+    load->var.name = operand_name;
+    load->var.atom = operand_atom;
     load->dest.id = ++(func->next_temp_id);
     load->dest.size = operand_size;
     if (!load->var.name) {
       error_report_general(ERROR_SEVERITY_ERROR, "out of memory"); 
       return 1;
     }
-    da_append(func->code, load);  
+    da_small_append(func->code, load);  
 
     IR_instruction_t* mov = calloc(1, sizeof(IR_instruction_t));
     if (!mov) {
@@ -301,14 +307,14 @@ int IR_lower_unary_expression(HIR_parser_t* hir,
     mov->dest.size = operand_size;
     mov->src.id = func->next_temp_id;
     mov->src.size = operand_size;
-    da_append(func->code, mov);
+    da_small_append(func->code, mov);
 
     IR_instruction_t* op = calloc(1, sizeof(IR_instruction_t));
     if (!op) {
       error_report_general(ERROR_SEVERITY_ERROR, "out of memory");  
       return 1;
     }
-    switch (expr->unary.op) {
+    switch (unary_op) {
       case UNARY_POST_INC: op->kind = IR_INC; break;
       case UNARY_POST_DEC: op->kind = IR_DEC; break;
       default: break;
@@ -316,7 +322,7 @@ int IR_lower_unary_expression(HIR_parser_t* hir,
 
     op->dest.id = func->next_temp_id;
     op->dest.size = operand_size;
-    da_append(func->code, op);
+    da_small_append(func->code, op);
 
     IR_instruction_t* str = calloc(1, sizeof(IR_instruction_t));
     if (!str) {
@@ -326,18 +332,19 @@ int IR_lower_unary_expression(HIR_parser_t* hir,
     str->kind = IR_STORE_VAR;
     str->src.id = func->next_temp_id++;
     str->src.size = operand_size;
-    str->var.name = strdup(expr->unary.operand->var.ident.ident_name);
+    str->var.name = operand_name;
+    str->var.atom = operand_atom;
     str->var.is_init = 1;
     if (!str->var.name) {
       error_report_general(ERROR_SEVERITY_ERROR, "out of memory");  
       return 1;
     }
-    da_append(func->code, str);
+    da_small_append(func->code, str);
     return 0;
   }
 
-  if (expr->unary.op == UNARY_PRE_INC ||
-      expr->unary.op == UNARY_PRE_DEC) {
+  if (unary_op == UNARY_PRE_INC ||
+      unary_op == UNARY_PRE_DEC) {
     IR_instruction_t* load = calloc(1, sizeof(IR_instruction_t)); 
     if (!load) {
       error_report_general(ERROR_SEVERITY_ERROR, "out of memory");
@@ -346,26 +353,27 @@ int IR_lower_unary_expression(HIR_parser_t* hir,
     load->kind = IR_LOAD_VAR;
     load->dest.id = ++(func->next_temp_id);
     load->dest.size = operand_size;
-    load->var.name = strdup(expr->unary.operand->var.ident.ident_name);
+    load->var.name = operand_name;
+    load->var.atom = operand_atom;
     if (!load->var.name) {
       error_report_general(ERROR_SEVERITY_ERROR, "out of memory"); 
       return 1;
     }
-    da_append(func->code, load);
+    da_small_append(func->code, load);
 
     IR_instruction_t* op = calloc(1, sizeof(IR_instruction_t));
     if (!op) {
       error_report_general(ERROR_SEVERITY_ERROR, "out of memory"); 
       return 1;
     }
-    switch (expr->unary.op) {
+    switch (unary_op) {
       case UNARY_PRE_INC: op->kind = IR_INC; break;
       case UNARY_PRE_DEC: op->kind = IR_DEC; break;
       default: break;  
     }
     op->dest.id = func->next_temp_id;
     op->dest.size = operand_size;
-    da_append(func->code, op);
+    da_small_append(func->code, op);
 
     IR_instruction_t* str = calloc(1, sizeof(IR_instruction_t));
     if (!str) {
@@ -375,13 +383,14 @@ int IR_lower_unary_expression(HIR_parser_t* hir,
     str->kind = IR_STORE_VAR;
     str->src.id = func->next_temp_id;
     str->src.size = operand_size;
-    str->var.name = strdup(expr->unary.operand->var.ident.ident_name);
+    str->var.name = operand_name;
+    str->var.atom = operand_atom;
     if (!str->var.name) {
       error_report_general(ERROR_SEVERITY_ERROR, "out of memory");
       return 1; 
     }
     str->var.is_init = 1;
-    da_append(func->code, str);
+    da_small_append(func->code, str);
     return 0;
   }
 
@@ -392,25 +401,27 @@ int IR_lower_unary_expression(HIR_parser_t* hir,
 }
 
 int IR_lower_lvalue(HIR_parser_t* hir,
-    expression_t* expr,
+    ast_ref_t expr,
     IR_function_t* func,
     lvalue_t* lv)
 {
-  if (expr->type == EXPRESSION_VAR) {
+  const ast_flat_t* flat = hir->flat;
+  if (flat->exprs.kind[expr] == EXPRESSION_VAR) {
     lv->kind = LVALUE_VAR;
-    lv->var_name = expr->var.ident.ident_name;
-    lv->elem_size = expr->var.ident.type.element_size;
+    lv->var_name = atom_str(flat->expr_cold[expr].name);
+    lv->var_atom = flat->expr_cold[expr].name;
+    lv->elem_size = ast_flat_var_type(flat, expr)->element_size;
     return 0;
   }
 
-  if (expr->type == EXPRESSION_INDEX) {
-    size_t elem_size = expr->index.base->var.ident.type.element_size;
+  if (flat->exprs.kind[expr] == EXPRESSION_INDEX) {
+    size_t elem_size = IR_var_type(hir, flat->exprs.a[expr]).element_size;
 
-    if (IR_lower_expression(hir, expr->index.base, func) != 0)
+    if (IR_lower_expression(hir, flat->exprs.a[expr], func) != 0)
       return 1;
     int base_id = func->next_temp_id;
 
-    if (IR_lower_expression(hir, expr->index.index, func) != 0)
+    if (IR_lower_expression(hir, flat->exprs.b[expr], func) != 0)
       return 1;
     int idx_id = func->next_temp_id;
 
@@ -423,7 +434,7 @@ int IR_lower_lvalue(HIR_parser_t* hir,
     mul->dest.id = func->next_temp_id;
     mul->dest.size = elem_size;
     mul->int_value = elem_size;
-    da_append(func->code, mul);
+    da_small_append(func->code, mul);
 
     lv->kind = LVALUE_ELEM;
     lv->base_id = base_id;
@@ -438,7 +449,7 @@ int IR_lower_lvalue(HIR_parser_t* hir,
 }
 
 int IR_lower_index_expression(
-    HIR_parser_t* hir, expression_t* expr, IR_function_t* func)
+    HIR_parser_t* hir, ast_ref_t expr, IR_function_t* func)
 {
   lvalue_t lv = {0};
   if (IR_lower_lvalue(hir, expr, func, &lv) != 0)
@@ -456,15 +467,16 @@ int IR_lower_index_expression(
   load->index.size = 8;
   load->dest.id = ++(func->next_temp_id);
   load->dest.size = lv.elem_size;
-  da_append(func->code, load);
+  da_small_append(func->code, load);
 
   return 0;
 }
 
 int IR_lower_call_expression(
-    HIR_parser_t* hir, expression_t* expr, IR_function_t* func)
+    HIR_parser_t* hir, ast_ref_t expr, IR_function_t* func)
 {
-  for (int i = 0; i < (int) expr->call.arg_count; ++i) {
+  const ast_expr_cold_t* call_expr = &hir->flat->expr_cold[expr];
+  for (int i = 0; i < (int) call_expr->list.count; ++i) {
     IR_instruction_t* set_arg = calloc(1, sizeof(IR_instruction_t)); 
     if (!set_arg) {
       error_report_general(ERROR_SEVERITY_ERROR, "out of memory"); 
@@ -473,12 +485,13 @@ int IR_lower_call_expression(
     set_arg->kind = IR_MOV;
     set_arg->dest.id = -i - 1;
 
-    if (IR_lower_expression(hir, expr->call.args[i], func) != 0)
+    ast_ref_t arg = hir->flat->lists[call_expr->list.first + i];
+    if (IR_lower_expression(hir, arg, func) != 0)
       return 1;
 
     set_arg->src.id = func->next_temp_id;
     
-    da_append(func->code, set_arg);
+    da_small_append(func->code, set_arg);
   } 
 
   IR_instruction_t* call = calloc(1, sizeof(IR_instruction_t));
@@ -487,15 +500,16 @@ int IR_lower_call_expression(
     return 1;
   }
   call->kind = IR_CALL;
-  const char* call_module = expr->call.resolved_module
-    ? expr->call.resolved_module
+  const char* call_module = call_expr->module != ATOM_NONE
+    ? atom_str(call_expr->module)
     : hir->current_module;
-  call->func_name = IR_mangle_function_name(call_module, expr->call.callee);
+  call->func_name =
+    IR_mangle_function_name(call_module, atom_str(call_expr->name));
   if (!call->func_name) {
     error_report_general(ERROR_SEVERITY_ERROR, "out of memory"); 
     return 1;
   }
-  da_append(func->code, call);
+  da_small_append(func->code, call);
 
   IR_instruction_t* result = calloc(1, sizeof(IR_instruction_t));
   if (!result) {
@@ -505,17 +519,17 @@ int IR_lower_call_expression(
   result->kind = IR_MOV;
   result->dest.id = ++(func->next_temp_id);
   result->src.id = -1;
-  da_append(func->code, result);
+  da_small_append(func->code, result);
 
   return 0;
 }
 
-int IR_lower_binary_expression(expression_t* expr,
+int IR_lower_binary_expression(ast_ref_t expr,
     HIR_parser_t* hir,
     IR_instruction_t* instr,
     IR_function_t* func)
 {
-  switch(expr->binary.op) {
+  switch(hir->flat->expr_cold[expr].op) {
     case BINARY_ADD:
       instr->binary_op = IR_BINARY_ADD;
       break;
@@ -537,12 +551,12 @@ int IR_lower_binary_expression(expression_t* expr,
       return 1;
   }
 
-  if (IR_lower_expression(hir, expr->binary.left, func) != 0)
+  if (IR_lower_expression(hir, hir->flat->exprs.a[expr], func) != 0)
     return -1;
   instr->src.id = func->next_temp_id;
   instr->src.size = func->code->items[func->code->count - 1]->dest.size;
 
-  if (IR_lower_expression(hir, expr->binary.right, func) != 0)
+  if (IR_lower_expression(hir, hir->flat->exprs.b[expr], func) != 0)
     return -1;
   instr->dest.id = func->next_temp_id;
   instr->dest.size = func->code->items[func->code->count - 1]->dest.size;
@@ -558,10 +572,9 @@ int IR_lower_binary_expression(expression_t* expr,
 }
 
 int IR_lower_expr_int_lit(HIR_parser_t* hir,
-    expression_t* expr,
+    ast_ref_t expr,
     IR_function_t* func)
 {
-  (void)hir;
   IR_instruction_t* instr = calloc(1, sizeof(IR_instruction_t));
   if (!instr) {
     error_report_general(ERROR_SEVERITY_ERROR, "out of memory");
@@ -569,16 +582,15 @@ int IR_lower_expr_int_lit(HIR_parser_t* hir,
   }
   instr->kind = IR_INT_CONST;
   instr->dest.id = ++(func->next_temp_id);
-  instr->int_value = expr->int_lit.value;
-  da_append(func->code, instr);
+  instr->int_value = hir->flat->expr_cold[expr].value;
+  da_small_append(func->code, instr);
   return 0;
 }
 
 int IR_lower_expr_char_lit(HIR_parser_t* hir,
-    expression_t* expr,
+    ast_ref_t expr,
     IR_function_t* func)
 {
-  (void)hir;
   IR_instruction_t* instr = calloc(1, sizeof(IR_instruction_t));
   if (!instr) {
     error_report_general(ERROR_SEVERITY_ERROR, "out of memory");
@@ -586,15 +598,17 @@ int IR_lower_expr_char_lit(HIR_parser_t* hir,
   }
   instr->kind = IR_INT_CONST;
   instr->dest.id = ++(func->next_temp_id);
-  instr->int_value = expr->char_lit.value;
-  da_append(func->code, instr);
+  instr->int_value = hir->flat->expr_cold[expr].value;
+  da_small_append(func->code, instr);
   return 0;
 }
 
 int IR_lower_expr_var(HIR_parser_t* hir,
-    expression_t* expr,
+    ast_ref_t expr,
     IR_function_t* func)
 {
+  const ast_flat_t* flat = hir->flat;
+  const known_type_t* type = ast_flat_var_type(flat, expr);
   IR_instruction_t* instr = calloc(1, sizeof(IR_instruction_t));
   if (!instr) {
     error_report_general(ERROR_SEVERITY_ERROR, "out of memory");
@@ -603,21 +617,23 @@ int IR_lower_expr_var(HIR_parser_t* hir,
   instr->kind = IR_LOAD_VAR;
   instr->dest.id = ++(func->next_temp_id);
 
-  if (expr->var.ident.type.array_len > 0 ||
-      expr->var.ident.type.kind == TYPE_CUSTOM) {
+  if (type->array_len > 0 ||
+      type->kind == TYPE_CUSTOM) {
     instr->dest.size = 8; 
   } else {
-    instr->dest.size = expr->var.ident.type.element_size;
+    instr->dest.size = type->element_size;
   }
 
-  instr->var.name = strdup(expr->var.ident.ident_name);
+  instr->var.name = atom_str(flat->expr_cold[expr].name);
+  instr->var.atom = flat->expr_cold[expr].name;
   if (!instr->var.name) {
     error_report_general(ERROR_SEVERITY_ERROR, "out of memory");
     return -1;
   }
-  da_append(func->code, instr);
+  da_small_append(func->code, instr);
 
-  while (expr->var.member) {
+  while (flat->exprs.a[expr] != AST_REF_NONE) {
+    ast_ref_t member = flat->exprs.a[expr];
     IR_instruction_t* offset_instr = calloc(1, sizeof(IR_instruction_t));
     if (!offset_instr) {
       error_report_general(ERROR_SEVERITY_ERROR, "out of memory");
@@ -629,13 +645,11 @@ int IR_lower_expr_var(HIR_parser_t* hir,
     // sym should never be NULL after semantic
     // hence, we don't check and error report this but this is important to keep in mind in case it segfaults here
     struct_symbol_t* sym =
-      hashmap_get(hir->struct_symbols, expr->var.ident.type.name);
+      atom_map_get(hir->struct_symbols, ast_flat_var_type(flat, expr)->atom);
 
     size_t offset = 0;
     for (size_t i = 0; i < sym->members_count; ++i) {
-      if (strcmp(
-            expr->var.member->var.ident.ident_name,
-            sym->members_name[i]) == 0) {
+      if (flat->expr_cold[member].name == sym->members_atom[i]) {
           goto insert_member;
       }
       offset += sym->members_type[i].type.element_size;
@@ -644,12 +658,12 @@ int IR_lower_expr_var(HIR_parser_t* hir,
 insert_member:
     offset_instr->offset.size = offset;
     offset_instr->src.id = func->next_temp_id;
-    offset_instr->src.size = expr->var.ident.type.element_size;
+    offset_instr->src.size = ast_flat_var_type(flat, expr)->element_size;
     offset_instr->dest.id = ++func->next_temp_id;
-    offset_instr->dest.size = expr->var.member->var.ident.type.element_size;
-    da_append(func->code, offset_instr);
+    offset_instr->dest.size = ast_flat_var_type(flat, member)->element_size;
+    da_small_append(func->code, offset_instr);
 
-    expr = expr->var.member;
+    expr = member;
   }
 
   return 0;
@@ -657,15 +671,15 @@ insert_member:
 
 // TODO: make sure no error can still occurs here even after semantic analysis
 int IR_lower_expr_assign(HIR_parser_t* hir,
-    expression_t* expr,
+    ast_ref_t expr,
     IR_function_t* func)
 {
-  if (IR_lower_expression(hir, expr->assign.rhs, func) != 0)
+  if (IR_lower_expression(hir, hir->flat->exprs.b[expr], func) != 0)
     return 1;
   int rhs_temp = func->next_temp_id;
 
   lvalue_t lv = {0};
-  if (IR_lower_lvalue(hir, expr->assign.lhs, func, &lv) != 0)
+  if (IR_lower_lvalue(hir, hir->flat->exprs.a[expr], func, &lv) != 0)
     return 1;
 
   IR_instruction_t* store = calloc(1, sizeof(IR_instruction_t));
@@ -678,7 +692,8 @@ int IR_lower_expr_assign(HIR_parser_t* hir,
     store->kind = IR_STORE_VAR;
     store->src.id = rhs_temp;
     store->src.size = lv.elem_size;
-    store->var.name = strdup(lv.var_name);
+    store->var.name = lv.var_name;
+    store->var.atom = lv.var_atom;
     store->var.is_init = 1;
     if (!store->var.name) {
       error_report_general(ERROR_SEVERITY_ERROR, "out of memory");
@@ -695,24 +710,26 @@ int IR_lower_expr_assign(HIR_parser_t* hir,
     store->index.size = 8;
   }
 
-  da_append(func->code, store);
+  da_small_append(func->code, store);
   return 0;
 }
 
 int IR_lower_expression(HIR_parser_t* hir,
-    expression_t* expr,
+    ast_ref_t expr,
     IR_function_t* func)
 {
-  if (expr->type == EXPRESSION_INT_LIT)
+  expression_kind kind = (expression_kind) hir->flat->exprs.kind[expr];
+
+  if (kind == EXPRESSION_INT_LIT)
     return IR_lower_expr_int_lit(hir, expr, func);
 
-  if (expr->type == EXPRESSION_CHAR_LIT)
+  if (kind == EXPRESSION_CHAR_LIT)
     return IR_lower_expr_char_lit(hir, expr, func);
 
-  if (expr->type == EXPRESSION_VAR)
+  if (kind == EXPRESSION_VAR)
     return IR_lower_expr_var(hir, expr, func);
 
-  if (expr->type == EXPRESSION_BINARY) {
+  if (kind == EXPRESSION_BINARY) {
     IR_instruction_t* instr = calloc(1, sizeof(IR_instruction_t));
     if (!instr) {
       error_report_general(ERROR_SEVERITY_ERROR, "out of memory");
@@ -720,26 +737,26 @@ int IR_lower_expression(HIR_parser_t* hir,
     }
     if (IR_lower_binary_expression(expr, hir, instr, func) != 0) {
       error_report_at_position(hir->error_ctx,
-          expr->source_pos,
+          ast_flat_expr_pos(hir->flat, expr),
           ERROR_SEVERITY_ERROR,
           "error while lowering binary expression");
       return 1;
     }
     instr->kind = IR_BINARY;
-    da_append(func->code, instr);
+    da_small_append(func->code, instr);
     return 0;
   }
 
-  if (expr->type == EXPRESSION_ASSIGN)
+  if (kind == EXPRESSION_ASSIGN)
     return IR_lower_expr_assign(hir, expr, func);
 
-  if (expr->type == EXPRESSION_UNARY)
+  if (kind == EXPRESSION_UNARY)
     return IR_lower_unary_expression(hir, expr, func);
 
-  if (expr->type == EXPRESSION_CALL)
+  if (kind == EXPRESSION_CALL)
     return IR_lower_call_expression(hir, expr, func);
 
-  if (expr->type == EXPRESSION_INDEX)
+  if (kind == EXPRESSION_INDEX)
     return IR_lower_index_expression(hir, expr, func);
 
   return 1;
@@ -758,7 +775,7 @@ int IR_lower_free_statement(
 
   instr->kind = IR_DEALLOC;
   
-  IR_lower_expression(hir, stmt->free_stmt.expr, func); 
+  IR_lower_expression(hir, stmt->free_stmt.expr->flat, func); 
 
   instr->src.id = func->next_temp_id;
 
@@ -766,7 +783,7 @@ int IR_lower_free_statement(
   // TODO: fix this if we want it to compile on 32 bits architecture one day
   instr->src.size = 8;
 
-  da_append(func->code, instr);
+  da_small_append(func->code, instr);
   return 0;
 }
 
@@ -784,7 +801,7 @@ int IR_lower_asm_statement(
     }
     for (size_t i = 0; i < stmt->asm_stmt.arg_count; i++) {
       if (IR_lower_expression(
-            hir, stmt->asm_stmt.args[i], func) != 0) {
+            hir, stmt->asm_stmt.args[i]->flat, func) != 0) {
         free(temps);
         return 1;
       }
@@ -828,7 +845,7 @@ int IR_lower_asm_statement(
     }
   }
 
-  da_append(func->code, instr);
+  da_small_append(func->code, instr);
   return 0;
 }
 
@@ -841,7 +858,7 @@ int IR_lower_for_statement(
   if (stmt->for_stmt.init_kind == FOR_INIT_DECL) 
     err = IR_lower_declaration(hir, stmt->for_stmt.decl_init, func);
   else
-    err = IR_lower_expression(hir, stmt->for_stmt.expr_init, func);
+    err = IR_lower_expression(hir, stmt->for_stmt.expr_init->flat, func);
   if (err)
     return 1;
 
@@ -859,7 +876,7 @@ int IR_lower_for_statement(
   }
   main_label->kind = IR_CHUNK;
   main_label->chunk_name = strdup(main_chunk);
-  da_append(func->code, main_label);
+  da_small_append(func->code, main_label);
 
   da_foreach(statement_t*, it, stmt->for_stmt.body) {
     int err = IR_lower_statement(hir, *it, func);
@@ -867,10 +884,10 @@ int IR_lower_for_statement(
      return 1; 
   }
 
-  if (IR_lower_expression(hir, stmt->for_stmt.loop, func) != 0)
+  if (IR_lower_expression(hir, stmt->for_stmt.loop->flat, func) != 0)
    return 1; 
 
-  if (IR_lower_expression(hir, stmt->for_stmt.condition, func) != 0)
+  if (IR_lower_expression(hir, stmt->for_stmt.condition->flat, func) != 0)
     return 1;
 
   IR_instruction_t* jump = calloc(1, sizeof(IR_instruction_t));
@@ -902,7 +919,7 @@ int IR_lower_for_statement(
     free(jump);
     return 1;
   }
-  da_append(func->code, jump);
+  da_small_append(func->code, jump);
 
   free(main_chunk);
   return 0;
@@ -927,9 +944,9 @@ int IR_lower_while_statement(
   }
   condition_label->kind = IR_CHUNK;
   condition_label->chunk_name = strdup(condition_chunk);
-  da_append(func->code, condition_label);
+  da_small_append(func->code, condition_label);
 
-  if (IR_lower_expression(hir, stmt->while_stmt.condition, func) != 0)
+  if (IR_lower_expression(hir, stmt->while_stmt.condition->flat, func) != 0)
     return 1;
 
   char* next_chunk = calloc(2 + RAND_CHUNK_LEN, sizeof(char));
@@ -968,7 +985,7 @@ int IR_lower_while_statement(
     free(jump);
     return 1;
   }
-  da_append(func->code, jump);
+  da_small_append(func->code, jump);
 
   da_foreach(statement_t*, it, stmt->while_stmt.body) {
     int err = IR_lower_statement(hir, *it, func); 
@@ -983,7 +1000,7 @@ int IR_lower_while_statement(
   }
   jump_back->kind = IR_JMP;
   jump_back->chunk_name = strdup(condition_chunk);
-  da_append(func->code, jump_back);
+  da_small_append(func->code, jump_back);
 
   IR_instruction_t* next_label = calloc(1, sizeof(IR_instruction_t));
   if (!next_label) {
@@ -992,7 +1009,7 @@ int IR_lower_while_statement(
   }
   next_label->kind = IR_CHUNK;
   next_label->chunk_name = strdup(next_chunk);
-  da_append(func->code, next_label);
+  da_small_append(func->code, next_label);
 
   free(next_chunk);
   free(condition_chunk);
@@ -1004,7 +1021,7 @@ int IR_lower_if_statement(HIR_parser_t* hir,
     statement_t* stmt,
     IR_function_t* func)
 {
-  int err = IR_lower_expression(hir, stmt->if_stmt.condition, func);
+  int err = IR_lower_expression(hir, stmt->if_stmt.condition->flat, func);
   // TODO: do we have to propagate error ?
   if (err) 
     return 1;
@@ -1064,7 +1081,7 @@ int IR_lower_if_statement(HIR_parser_t* hir,
     return 1;
   }
 
-  da_append(func->code, jump);
+  da_small_append(func->code, jump);
 
   da_foreach(statement_t*, it, stmt->if_stmt.then_branch) {
     int err = IR_lower_statement(hir, *it, func); 
@@ -1081,7 +1098,7 @@ int IR_lower_if_statement(HIR_parser_t* hir,
 
     jump_else->kind = IR_JMP;
     jump_else->chunk_name = strdup(chunk);
-    da_append(func->code, jump_else);
+    da_small_append(func->code, jump_else);
 
     IR_instruction_t* chunk_else_label = calloc(1, sizeof(IR_instruction_t));
     if (!chunk_else_label) {
@@ -1091,7 +1108,7 @@ int IR_lower_if_statement(HIR_parser_t* hir,
 
     chunk_else_label->kind = IR_CHUNK;
     chunk_else_label->chunk_name = else_chunk;
-    da_append(func->code, chunk_else_label);
+    da_small_append(func->code, chunk_else_label);
 
     da_foreach(statement_t*, it, stmt->if_stmt.else_branch) {
       int err = IR_lower_statement(hir, *it, func);
@@ -1109,7 +1126,7 @@ int IR_lower_if_statement(HIR_parser_t* hir,
   chunk_label->kind = IR_CHUNK;
   chunk_label->chunk_name = strdup(chunk);
 
-  da_append(func->code, chunk_label);
+  da_small_append(func->code, chunk_label);
 
   free(chunk);
   return 0;
@@ -1119,7 +1136,7 @@ int IR_lower_return_statement(HIR_parser_t* hir,
     statement_t* stmt,
     IR_function_t* func)
 {
-  int res = IR_lower_expression(hir, stmt->ret.value, func);
+  int res = IR_lower_expression(hir, stmt->ret.value->flat, func);
   if (res != 0)
     return -1;
 
@@ -1152,11 +1169,11 @@ int IR_lower_return_statement(HIR_parser_t* hir,
       return_var->dest.size = s;
     }
 
-    da_append(func->code, return_var);
+    da_small_append(func->code, return_var);
     instr->kind = IR_RETURN;
   }
 
-  da_append(func->code, instr);
+  da_small_append(func->code, instr);
   return 0;
 }
 
@@ -1165,7 +1182,7 @@ int IR_lower_statement(HIR_parser_t* hir,
     IR_function_t* func)
 {
   if (stmt->type == STATEMENT_EXPR)
-    return IR_lower_expression(hir, stmt->expr_stmt.expr, func);
+    return IR_lower_expression(hir, stmt->expr_stmt.expr->flat, func);
 
   if (stmt->type == STATEMENT_RETURN)
     return IR_lower_return_statement(hir, stmt, func);
@@ -1218,7 +1235,7 @@ static int IR_lower_function_params(IR_function_t* func,
       mov->src.size  = s;
     }
 
-    da_append(func->code, mov);
+    da_small_append(func->code, mov);
 
     IR_instruction_t* str = calloc(1, sizeof(IR_instruction_t));
     if (!str) {
@@ -1226,7 +1243,8 @@ static int IR_lower_function_params(IR_function_t* func,
       return -1;
     }
     str->kind = IR_STORE_VAR;
-    str->var.name = strdup(function->func.params.items[i].ident_name);
+    str->var.name = function->func.params.items[i].ident_name;
+    str->var.atom = function->func.params.items[i].atom;
     if (!str->var.name) {
       error_report_general(ERROR_SEVERITY_ERROR, "out of memory");
       return -1;
@@ -1235,7 +1253,7 @@ static int IR_lower_function_params(IR_function_t* func,
     str->src.id = func->next_temp_id++;
     str->src.size = function->func.params.items[i].type.element_size;
 
-    da_append(func->code, str);
+    da_small_append(func->code, str);
   }
 
   return 0;
@@ -6,6 +6,7 @@
 #define DA_LIB_IMPLEMENTATION
 #include "../thirdparty/da.h"
 #include "../frontend/ast_definition.h"
+#include "../frontend/ast_flat.h"
 #include "../thirdparty/string_builder.h"
 #include "ir_definition.h"
 
@@ -13,7 +14,8 @@ typedef enum { LVALUE_VAR, LVALUE_ELEM } lvalue_kind;
 
 typedef struct {
   lvalue_kind kind;
-  char* var_name;
+  const char* var_name; // interned
+  atom_t var_atom;
   int base_id;
   int idx_id;
   size_t elem_size;
@@ -29,7 +31,9 @@ typedef struct
 
   const char* current_module;
 
-  hashmap_t* struct_symbols;
+  atom_map_t* struct_symbols;
+  // expressions of the program, typed by the semantic pass
+  const ast_flat_t* flat;
   IR_function_array* hir_program;
 } HIR_parser_t;
 
@@ -49,29 +53,29 @@ int IR_lower_return_statement(
     IR_function_t* func);
 int IR_lower_expression(
     HIR_parser_t* hir,
-    expression_t* expr,
+    ast_ref_t expr,
     IR_function_t* func);
 int IR_lower_expr_int_lit(
     HIR_parser_t* hir,
-    expression_t* expr,
+    ast_ref_t expr,
     IR_function_t* func);
 int IR_lower_expr_char_lit(
     HIR_parser_t* hir,
-    expression_t* expr,
+    ast_ref_t expr,
     IR_function_t* func);
 int IR_lower_expr_var(
     HIR_parser_t* hir,
-    expression_t* expr,
+    ast_ref_t expr,
     IR_function_t* func);
 int IR_lower_expr_assign(
     HIR_parser_t* hir,
-    expression_t* expr,
+    ast_ref_t expr,
     IR_function_t* func);
 void IR_display_function(IR_function_t* function);
 void IR_free_function(IR_function_t* func);
 void IR_free_instruction(IR_instruction_t* instr);
 char* IR_generate_string_program(IR_function_t* function);
-int IR_lower_binary_expression(expression_t* expr,
+int IR_lower_binary_expression(ast_ref_t expr,
     HIR_parser_t* hir,
     IR_instruction_t* instr,
     IR_function_t* func);
@@ -81,7 +85,7 @@ int IR_lower_declaration(
     IR_function_t* func);
 int IR_lower_unary_expression(
     HIR_parser_t* hir,
-    expression_t* expr,
+    ast_ref_t expr,
     IR_function_t* func);
 int IR_lower_if_statement(
     HIR_parser_t* hir,
@@ -109,12 +113,12 @@ int IR_lower_free_statement(
     IR_function_t* func);
 int IR_lower_lvalue(
     HIR_parser_t* hir,
-    expression_t* expr,
+    ast_ref_t expr,
     IR_function_t* func,
     lvalue_t* lv);
 int IR_lower_index_expression(
     HIR_parser_t* hir,
-    expression_t* expr,
+    ast_ref_t expr,
     IR_function_t* func);
 
 #endif // IR_H
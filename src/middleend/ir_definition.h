@@ -1,6 +1,8 @@
 #ifndef IR_DEFINITION_H
 #define IR_DEFINITION_H
 
+#define DA_LIB_IMPLEMENTATION
+#include "../thirdparty/da.h"
 #include "../frontend/ast_definition.h"
 #include "../thirdparty/rand.h"
 #include "../thirdparty/error.h"
@@ -89,7 +91,8 @@ typedef struct
     IR_temp_id index;
 
     struct {
-      char* name;
+      const char* name; // interned
+      atom_t atom;
       int is_init;
     } var;
 
@@ -112,11 +115,15 @@ typedef struct
   };
 } IR_instruction_t;
 
+// most functions lower to a few instructions, those stay in the block
+#define IR_BLOCK_INLINE 16
+
 typedef struct 
 {
   IR_instruction_t** items;
   size_t count;
   size_t capacity;
+  DA_INLINE(IR_instruction_t*, IR_BLOCK_INLINE);
 } IR_instruction_block;
 
 typedef struct 
@@ -0,0 +1,144 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <assert.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define DA_LIB_IMPLEMENTATION
+#include "da.h"
+
+// Bump allocator over a list of chunks. Allocations are zeroed and live
+// until arena_free releases every chunk at once, there is no per-object
+// free.
+
+#define ARENA_CHUNK_SIZE (64 * 1024)
+#define ARENA_ALIGN      (sizeof(max_align_t))
+
+typedef struct arena_chunk_t
+{
+  struct arena_chunk_t* next;
+  size_t used;
+  size_t size;
+  max_align_t data[];
+} arena_chunk_t;
+
+typedef struct
+{
+  arena_chunk_t* head; // chunk being filled, older ones follow
+  size_t allocated;    // bytes handed out, for statistics
+} arena_t;
+
+static inline size_t arena_align(size_t size)
+{
+  return (size + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1);
+}
+
+static inline void* arena_alloc(arena_t* a, size_t size)
+{
+  size = arena_align(size ? size : 1);
+
+  arena_chunk_t* c = a->head;
+  if (!c || c->size - c->used < size) {
+    size_t chunk_size = size > ARENA_CHUNK_SIZE ? size : ARENA_CHUNK_SIZE;
+    // calloc: memory is handed out once, so it is always zeroed
+    c = calloc(1, sizeof(arena_chunk_t) + chunk_size);
+    if (!c)
+      return NULL;
+    c->size = chunk_size;
+
+    // a dedicated chunk for a large block keeps filling the current one
+    if (a->head && size > ARENA_CHUNK_SIZE) {
+      c->next = a->head->next;
+      a->head->next = c;
+    } else {
+      c->next = a->head;
+      a->head = c;
+    }
+  }
+
+  void* ptr = (char*) c->data + c->used;
+  c->used += size;
+  a->allocated += size;
+  return ptr;
+}
+
+// Resizes the block `ptr` of `old_size` bytes, in place when it is the
+// last allocation of the current chunk
+static inline void* arena_grow(arena_t* a, void* ptr, size_t old_size, size_t new_size)
+{
+  if (!ptr)
+    return arena_alloc(a, new_size);
+
+  arena_chunk_t* c = a->head;
+  size_t old_aligned = arena_align(old_size);
+  size_t new_aligned = arena_align(new_size);
+  if (c && (char*) ptr + old_aligned == (char*) c->data + c->used &&
+      c->size - c->used >= new_aligned - old_aligned) {
+    c->used += new_aligned - old_aligned;
+    a->allocated += new_aligned - old_aligned;
+    return ptr;
+  }
+
+  void* grown = arena_alloc(a, new_size);
+  if (grown)
+    memcpy(grown, ptr, old_size);
+  return grown;
+}
+
+static inline char* arena_strndup(arena_t* a, const char* str, size_t len)
+{
+  char* copy = arena_alloc(a, len + 1);
+  if (copy)
+    memcpy(copy, str, len);
+  return copy;
+}
+
+static inline void arena_free(arena_t* a)
+{
+  arena_chunk_t* c = a->head;
+  while (c) {
+    arena_chunk_t* next = c->next;
+    free(c);
+    c = next;
+  }
+  a->head = NULL;
+  a->allocated = 0;
+}
+
+// Moves every chunk of `from` into `into`, blocks keep their address and
+// `from` is left empty
+static inline void arena_adopt(arena_t* into, arena_t* from)
+{
+  if (!from->head)
+    return;
+
+  arena_chunk_t* last = from->head;
+  while (last->next)
+    last = last->next;
+
+  // after the head, so `into` keeps filling its current chunk
+  if (into->head) {
+    last->next = into->head->next;
+    into->head->next = from->head;
+  } else {
+    into->head = from->head;
+  }
+  into->allocated += from->allocated;
+  from->head = NULL;
+  from->allocated = 0;
+}
+
+// da_grow_fn drawing from the arena `ctx`
+static inline void* arena_da_grow(void* ctx, void* ptr, size_t old_size, size_t new_size)
+{
+  return arena_grow((arena_t*) ctx, ptr, old_size, new_size);
+}
+
+// da_append for dynamic arrays whose items live in `arena`; they are
+// mostly short, the first block holds 4 items
+#define arena_da_append(arena, da, item) \
+  da_append_with(arena_da_grow, (arena), 4, da, item)
+
+#endif // ARENA_H
@@ -29,6 +29,8 @@ API:
     da_foreach(Type, Iterator, *da);
     da_append_amount(*da, Item, amount) -> append the same item 'amount' times
     da_remove(*da, Place);
+    da_append_with(Grow, Context, FirstCapacity, *da, Item) -> da_append through an allocator
+    da_small_append(*da, Item) / da_small_free(*da) -> arrays declared with DA_INLINE
 
 ERRORS: 
     
@@ -85,6 +87,8 @@ EXAMPLE:
 #define     DA_FREE free
 #endif // DA_FREE
 
+#include    <string.h>
+
 #ifndef DA_ASSERT
 #include    <assert.h>
 #define     DA_ASSERT assert
@@ -101,24 +105,81 @@ extern "C" {
 
 #ifdef DA_LIB_IMPLEMENTATION
 
-#ifndef DA_INIT_CAP 
-#define     DA_INIT_CAP 256
+// First capacity of an array: DA_INIT_CAP items when it is defined,
+// otherwise as many items as fit in DA_INIT_BYTES (at least 4), so an
+// array of pointers does not start as large as an array of chars
+#ifndef DA_INIT_BYTES
+#define     DA_INIT_BYTES 256
+#endif
+
+#ifdef DA_INIT_CAP
+#define da_init_cap(da) ((size_t) (DA_INIT_CAP))
+#else
+#define da_init_cap(da)                                                                     \
+    (sizeof(*(da)->items) * 4 > DA_INIT_BYTES ? (size_t) 4 : DA_INIT_BYTES / sizeof(*(da)->items))
 #endif
 
-#define da_append(da, item)                                                                 \
+// Allocator hook: resizes `ptr`, a block of `old_size` bytes obtained from
+// the same hook (NULL the first time), to `new_size` bytes. `ctx` is
+// passed through, an arena for instance (see arena_da_append).
+typedef void* (*da_grow_fn)(void* ctx, void* ptr, size_t old_size, size_t new_size);
+
+DA_LIB void* da_heap_grow(void* ctx, void* ptr, size_t old_size, size_t new_size)
+{
+    (void) ctx;
+    (void) old_size;
+    return DA_REALLOC(ptr, new_size);
+}
+
+#define da_append_with(grow, ctx, first_cap, da, item)                                      \
     do {                                                                                    \
         if((da)->count + 1 > (da)->capacity) {                                              \
-            if((da)->capacity == 0) {                                                       \
-                (da)->capacity = DA_INIT_CAP;                                               \
-            } else {                                                                        \
-                (da)->capacity *= 2;                                                        \
-            }                                                                               \
-            (da)->items = DA_REALLOC((da)->items, (da)->capacity * sizeof(*(da)->items));   \
+            size_t _da_old = (da)->capacity * sizeof(*(da)->items);                         \
+            (da)->capacity = (da)->capacity ? (da)->capacity * 2 : (first_cap);             \
+            (da)->items = grow((ctx), (da)->items, _da_old,                                 \
+                    (da)->capacity * sizeof(*(da)->items));                                 \
             DA_ASSERT((da)->items != NULL && "realloc failed");                             \
         }                                                                                   \
         (da)->items[(da)->count++] = item;                                                  \
     } while(0)
 
+#define da_append(da, item) da_append_with(da_heap_grow, NULL, da_init_cap(da), da, item)
+
+// Small vector: declared with DA_INLINE(Type, N) after its three fields,
+// the first N items live in the array itself and only the next ones are
+// allocated. `items` then points into the array, which must not be
+// copied by value while it holds items.
+#define DA_INLINE(Type, N) Type inline_items[N]
+
+#define da_small_append_with(grow, ctx, da, item)                                           \
+    do {                                                                                    \
+        if(!(da)->items) {                                                                  \
+            (da)->items = (da)->inline_items;                                               \
+            (da)->capacity = sizeof((da)->inline_items) / sizeof(*(da)->items);             \
+        }                                                                                   \
+        if((da)->count + 1 > (da)->capacity) {                                              \
+            int _da_inline = (da)->items == (da)->inline_items;                             \
+            size_t _da_old = (da)->capacity * sizeof(*(da)->items);                         \
+            void* _da_items = grow((ctx), _da_inline ? NULL : (void*) (da)->items,          \
+                    _da_inline ? 0 : _da_old, _da_old * 2);                                 \
+            DA_ASSERT(_da_items != NULL && "realloc failed");                               \
+            if(_da_inline) memcpy(_da_items, (da)->inline_items, _da_old);                  \
+            (da)->items = _da_items;                                                        \
+            (da)->capacity *= 2;                                                            \
+        }                                                                                   \
+        (da)->items[(da)->count++] = item;                                                  \
+    } while(0)
+
+#define da_small_append(da, item) da_small_append_with(da_heap_grow, NULL, da, item)
+
+#define da_small_free(da)                                                                   \
+    do {                                                                                    \
+        if((da)->items != (da)->inline_items) DA_FREE((da)->items);                         \
+        (da)->items = NULL;                                                                 \
+        (da)->count = 0;                                                                    \
+        (da)->capacity = 0;                                                                 \
+    } while(0)
+
 
 #define da_append_amount(da, item, amount)                \
     do {                                                  \
@@ -130,7 +191,7 @@ extern "C" {
 #define da_reserve(da, newcap) \
   do { \
     while ((da)->capacity < (newcap)) { \
-      (da)->capacity = (da)->capacity ? (da)->capacity * 2 : DA_INIT_CAP; \
+      (da)->capacity = (da)->capacity ? (da)->capacity * 2 : da_init_cap(da); \
     } \
     (da)->items = DA_REALLOC((da)->items, (da)->capacity * sizeof(*(da)->items)); \
     DA_ASSERT((da)->items != NULL); \
@@ -3,6 +3,10 @@
 #include <stdlib.h>
 #include <unistd.h>
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 // ANSI escape codes
 #define ANSI_RESET   "\033[0m"
 #define ANSI_BOLD    "\033[1m"
@@ -12,10 +16,28 @@
 #define ANSI_CYAN    "\033[36m"
 #define ANSI_MAGENTA "\033[35m"
 
+// Per-thread diagnostic sink. NULL means stderr. Worker threads of the
+// module scheduler point this at a private buffer so their output can be
+// replayed in a deterministic order.
+static __thread FILE* error_output = NULL;
+
+void error_set_output(FILE* out) {
+    error_output = out;
+}
+
+FILE* error_get_output(void) {
+    return error_output ? error_output : stderr;
+}
+
 static int use_color(void) {
+    // relaxed atomics: scheduler workers may race on the first call
     static int cached = -1;
-    if (cached == -1) cached = isatty(fileno(stderr));
-    return cached;
+    int c = __atomic_load_n(&cached, __ATOMIC_RELAXED);
+    if (c == -1) {
+        c = isatty(fileno(stderr));
+        __atomic_store_n(&cached, c, __ATOMIC_RELAXED);
+    }
+    return c;
 }
 
 static const char* severity_color(error_severity_t severity) {
@@ -39,10 +61,60 @@ static const char* severity_label(error_severity_t severity) {
     }
 }
 
+// Counts the '\n' of `source` and, when `starts` is not NULL, stores the
+// offset following each of them
+static size_t scan_newlines(const char* source, size_t len, size_t* starts) {
+    size_t n = 0;
+    size_t i = 0;
+
+#if defined(__SSE2__)
+    const __m128i newline = _mm_set1_epi8('\n');
+    for (; i + 16 <= len; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i*) (source + i));
+        unsigned mask = (unsigned) _mm_movemask_epi8(_mm_cmpeq_epi8(v, newline));
+        if (!starts) {
+            n += (size_t) __builtin_popcount(mask);
+            continue;
+        }
+        while (mask) {
+            starts[n++] = i + (size_t) __builtin_ctz(mask) + 1;
+            mask &= mask - 1;
+        }
+    }
+#endif
+
+    for (; i < len; i++) {
+        if (source[i] != '\n') continue;
+        if (starts) starts[n] = i + 1;
+        n++;
+    }
+    return n;
+}
+
 void error_init(error_context_t* ctx, const char* filename, const char* source, size_t source_len) {
     ctx->filename = filename;
     ctx->source_text = source;
     ctx->source_len = source_len;
+    ctx->line_starts = NULL;
+    ctx->line_count = 0;
+
+    // built up front: the parser reports from several threads at once
+    if (!source) return;
+    size_t lines = scan_newlines(source, source_len, NULL) + 1;
+    size_t* starts = malloc(lines * sizeof(size_t));
+    if (!starts) return; // locations fall back to scanning the source
+
+    starts[0] = 0;
+    scan_newlines(source, source_len, starts + 1);
+    ctx->line_starts = starts;
+    ctx->line_count = lines;
+}
+
+void error_free(error_context_t* ctx) {
+    if (!ctx) return;
+    free(ctx->line_starts);
+    ctx->line_starts = NULL;
+    ctx->line_count = 0;
 }
 
 void error_get_location(const char* source, const char* position, int* line, int* column) {
@@ -59,6 +131,36 @@ void error_get_location(const char* source, const char* position, int* line, int
     }
 }
 
+// Index of the line holding the byte at `offset`: the last line start
+// not after it
+static size_t find_line(const error_context_t* ctx, size_t offset) {
+    size_t lo = 0;
+    size_t hi = ctx->line_count;
+    while (hi - lo > 1) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (ctx->line_starts[mid] <= offset) lo = mid;
+        else hi = mid;
+    }
+    return lo;
+}
+
+static int has_line_table(const error_context_t* ctx, const char* position) {
+    return ctx->line_starts && position >= ctx->source_text &&
+           position <= ctx->source_text + ctx->source_len;
+}
+
+void error_context_location(const error_context_t* ctx, const char* position, int* line, int* column) {
+    if (!has_line_table(ctx, position)) {
+        error_get_location(ctx->source_text, position, line, column);
+        return;
+    }
+
+    size_t offset = (size_t) (position - ctx->source_text);
+    size_t index = find_line(ctx, offset);
+    *line = (int) index + 1;
+    *column = (int) (offset - ctx->line_starts[index]) + 1;
+}
+
 static const char* get_line_start(const char* source, const char* position) {
     const char* line_start = position;
     while (line_start > source && *(line_start - 1) != '\n') {
@@ -75,29 +177,44 @@ static const char* get_line_end(const char* position) {
     return line_end;
 }
 
+// Bounds of the line holding `position`, without its '\n'
+static void get_line_bounds(const error_context_t* ctx, const char* position, const char** start, const char** end) {
+    if (!has_line_table(ctx, position)) {
+        *start = get_line_start(ctx->source_text, position);
+        *end = get_line_end(position);
+        return;
+    }
+
+    size_t index = find_line(ctx, (size_t) (position - ctx->source_text));
+    *start = ctx->source_text + ctx->line_starts[index];
+    *end = index + 1 < ctx->line_count
+        ? ctx->source_text + ctx->line_starts[index + 1] - 1
+        : ctx->source_text + ctx->source_len;
+}
+
 static void print_source_line(const char* line_start, const char* line_end, int line_num) {
     if (use_color())
-        fprintf(stderr, ANSI_DIM " %4d |" ANSI_RESET " ", line_num);
+        fprintf(error_get_output(), ANSI_DIM " %4d |" ANSI_RESET " ", line_num);
     else
-        fprintf(stderr, " %4d | ", line_num);
+        fprintf(error_get_output(), " %4d | ", line_num);
 
-    fwrite(line_start, 1, line_end - line_start, stderr);
-    fprintf(stderr, "\n");
+    fwrite(line_start, 1, line_end - line_start, error_get_output());
+    fprintf(error_get_output(), "\n");
 }
 
 static void print_caret_line(int column, error_severity_t severity) {
     if (use_color())
-        fprintf(stderr, ANSI_DIM "      |" ANSI_RESET " ");
+        fprintf(error_get_output(), ANSI_DIM "      |" ANSI_RESET " ");
     else
-        fprintf(stderr, "      | ");
+        fprintf(error_get_output(), "      | ");
 
     for (int i = 1; i < column; i++)
-        fprintf(stderr, " ");
+        fprintf(error_get_output(), " ");
 
     if (use_color())
-        fprintf(stderr, "%s^" ANSI_RESET "\n", severity_color(severity));
+        fprintf(error_get_output(), "%s^" ANSI_RESET "\n", severity_color(severity));
     else
-        fprintf(stderr, "^\n");
+        fprintf(error_get_output(), "^\n");
 }
 
 static void print_error_header(const char* filename, int line, int column, error_severity_t severity) {
@@ -107,13 +224,13 @@ static void print_error_header(const char* filename, int line, int column, error
     const char* label = severity_label(severity);
 
     if (filename && line > 0)
-        fprintf(stderr, "%s%s:%d:%d:%s %s%s%s: ",
+        fprintf(error_get_output(), "%s%s:%d:%d:%s %s%s%s: ",
                 bold, filename, line, column, reset, color, label, reset);
     else if (filename)
-        fprintf(stderr, "%s%s:%s %s%s%s: ",
+        fprintf(error_get_output(), "%s%s:%s %s%s%s: ",
                 bold, filename, reset, color, label, reset);
     else
-        fprintf(stderr, "%s%s%s: ", color, label, reset);
+        fprintf(error_get_output(), "%s%s%s: ", color, label, reset);
 }
 
 void error_report_at_position(error_context_t* ctx, const char* position, error_severity_t severity, const char* fmt, ...) {
@@ -121,25 +238,26 @@ void error_report_at_position(error_context_t* ctx, const char* position, error_
         va_list args;
         va_start(args, fmt);
         print_error_header(NULL, 0, 0, severity);
-        vfprintf(stderr, fmt, args);
-        fprintf(stderr, "\n");
+        vfprintf(error_get_output(), fmt, args);
+        fprintf(error_get_output(), "\n");
         va_end(args);
         return;
     }
     
     int line, column;
-    error_get_location(ctx->source_text, position, &line, &column);
+    error_context_location(ctx, position, &line, &column);
     
     print_error_header(ctx->filename, line, column, severity);
     
     va_list args;
     va_start(args, fmt);
-    vfprintf(stderr, fmt, args);
+    vfprintf(error_get_output(), fmt, args);
     va_end(args);
-    fprintf(stderr, "\n");
+    fprintf(error_get_output(), "\n");
     
-    const char* line_start = get_line_start(ctx->source_text, position);
-    const char* line_end = get_line_end(position);
+    const char* line_start;
+    const char* line_end;
+    get_line_bounds(ctx, position, &line_start, &line_end);
     
     print_source_line(line_start, line_end, line);
     print_caret_line(column, severity);
@@ -150,25 +268,26 @@ void error_report_at_token(error_context_t* ctx, token_t* token, error_severity_
         va_list args;
         va_start(args, fmt);
         print_error_header(ctx ? ctx->filename : NULL, 0, 0, severity);
-        vfprintf(stderr, fmt, args);
-        fprintf(stderr, "\n");
+        vfprintf(error_get_output(), fmt, args);
+        fprintf(error_get_output(), "\n");
         va_end(args);
         return;
     }
     
     int line, column;
-    error_get_location(ctx->source_text, token->source_pos - 1, &line, &column);
+    error_context_location(ctx, token->source_pos - 1, &line, &column);
     
     print_error_header(ctx->filename, line, column, severity);
     
     va_list args;
     va_start(args, fmt);
-    vfprintf(stderr, fmt, args);
+    vfprintf(error_get_output(), fmt, args);
     va_end(args);
-    fprintf(stderr, "\n");
+    fprintf(error_get_output(), "\n");
     
-    const char* line_start = get_line_start(ctx->source_text, token->source_pos);
-    const char* line_end = get_line_end(token->source_pos);
+    const char* line_start;
+    const char* line_end;
+    get_line_bounds(ctx, token->source_pos, &line_start, &line_end);
     
     print_source_line(line_start, line_end, line);
     print_caret_line(column, severity);
@@ -180,11 +299,11 @@ void error_report_general(error_severity_t severity, const char* fmt, ...) {
     const char* bold  = use_color() ? ANSI_BOLD  : "";
     const char* label = severity_label(severity);
 
-    fprintf(stderr, "%scleaf%s: %s%s%s: ", bold, reset, color, label, reset);
+    fprintf(error_get_output(), "%scleaf%s: %s%s%s: ", bold, reset, color, label, reset);
 
     va_list args;
     va_start(args, fmt);
-    vfprintf(stderr, fmt, args);
+    vfprintf(error_get_output(), fmt, args);
     va_end(args);
-    fprintf(stderr, "\n");
+    fprintf(error_get_output(), "\n");
 }
@@ -16,12 +16,22 @@ typedef struct {
     const char* filename;
     const char* source_text;
     size_t source_len;
+    // offset of the first byte of each line, built by error_init and
+    // read-only afterwards; NULL when it could not be allocated
+    size_t* line_starts;
+    size_t line_count;
 } error_context_t;
 
 void error_init(error_context_t* ctx, const char* filename, const char* source, size_t source_len);
+void error_free(error_context_t* ctx);
 void error_report_at_token(error_context_t* ctx, token_t* token, error_severity_t severity, const char* fmt, ...);
 void error_report_at_position(error_context_t* ctx, const char* position, error_severity_t severity, const char* fmt, ...);
 void error_report_general(error_severity_t severity, const char* fmt, ...);
+void error_set_output(FILE* out);
+FILE* error_get_output(void);
 void error_get_location(const char* source, const char* position, int* line, int* column);
+// error_get_location for a position inside ctx->source_text, in
+// O(log lines) with the line table
+void error_context_location(const error_context_t* ctx, const char* position, int* line, int* column);
 
 #endif // ERROR_H
@@ -1,124 +1,232 @@
 #ifndef HASHMAP_H
 #define HASHMAP_H
 
+#include <stdint.h>
 #include <string.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <stddef.h>
 
-#define HASH_SIZE 211
+#include "arena.h"
 
-typedef struct hashmap_entry_t
+// String keyed map with open addressing and Robin Hood probing: an entry
+// never sits further from its home slot than the one it displaced, so
+// probe runs stay short at a high load. A zeroed hashmap_t is empty.
+//
+// Keys are copied into an arena owned by the map, freed with it: callers
+// may pass keys they release right after the call.
+
+typedef struct
 {
-  char* key;
+  const char* key;  // NULL for an empty slot
   void* value;
-  // in case of collision
-  struct hashmap_entry_t* next;
+  uint32_t hash;    // stored, probing and growing never hash a key again
+  uint32_t dist;    // distance from the home slot
 } hashmap_entry_t;
 
 typedef struct
 {
-  hashmap_entry_t* buckets[HASH_SIZE];
+  hashmap_entry_t* items; // `capacity` slots, a power of two
+  size_t count;
+  size_t capacity;
+  arena_t keys;
 } hashmap_t;
 
-inline static unsigned hashmap_hash(const char* s)
+#define hashmap_foreach(entry, map)                                    \
+  for (hashmap_entry_t* entry = (map)->items;                          \
+       entry && entry < (map)->items + (map)->capacity; ++entry)       \
+    if (entry->key)
+
+// 8 bytes at a time, then a murmur3 finalizer: names sharing a long
+// prefix still spread over the whole table
+inline static uint32_t hashmap_hash(const char* s, size_t len)
 {
-  unsigned h = 0;
-  while (*s)
-    h = (h << 4) + (unsigned char)*s++;
-  return h % HASH_SIZE;
+  uint64_t h = 0x9e3779b97f4a7c15ull ^ len;
+  size_t i = 0;
+  for (; i + 8 <= len; i += 8) {
+    uint64_t w;
+    memcpy(&w, s + i, sizeof(w));
+    h = (h ^ w) * 0xff51afd7ed558ccdull;
+    h ^= h >> 32;
+  }
+
+  uint64_t tail = 0;
+  memcpy(&tail, s + i, len - i);
+  h = (h ^ tail) * 0xc4ceb9fe1a85ec53ull;
+
+  h ^= h >> 33;
+  h *= 0xff51afd7ed558ccdull;
+  h ^= h >> 33;
+  h *= 0xc4ceb9fe1a85ec53ull;
+  h ^= h >> 33;
+  return (uint32_t) h;
 }
 
-inline static void hashmap_put(hashmap_t* map, const char* key, void* value)
+inline static hashmap_entry_t* hashmap_find_hashed(
+    const hashmap_t* map, const char* key, uint32_t hash)
 {
-  if (!map || !key) return;
-  unsigned idx = hashmap_hash(key);
-  hashmap_entry_t* e = malloc(sizeof(*e));
-  if (!e) return; 
-  e->key = strdup(key);
-  e->value = value;
-  e->next = map->buckets[idx];
-  map->buckets[idx] = e;
+  if (map->count == 0) return NULL;
+
+  size_t mask = map->capacity - 1;
+  for (size_t i = hash & mask, dist = 0;; i = (i + 1) & mask, ++dist) {
+    hashmap_entry_t* e = &map->items[i];
+    // past an entry closer to its home, `key` would have displaced it
+    if (!e->key || e->dist < dist) return NULL;
+    if (e->hash == hash && strcmp(e->key, key) == 0) return e;
+  }
 }
 
-inline static void* hashmap_get(hashmap_t* map, const char* key)
+// Slot holding `key`, NULL when it is not in the map
+inline static hashmap_entry_t* hashmap_find(const hashmap_t* map, const char* key)
 {
   if (!map || !key) return NULL;
+  return hashmap_find_hashed(map, key, hashmap_hash(key, strlen(key)));
+}
 
-  unsigned idx = hashmap_hash(key);
-  hashmap_entry_t* e = map->buckets[idx];
-  if (!e) return NULL;
+// Places an entry known to be absent, swapping it with the richer ones
+inline static void hashmap_place(hashmap_t* map, hashmap_entry_t entry)
+{
+  size_t mask = map->capacity - 1;
+  entry.dist = 0;
+  for (size_t i = entry.hash & mask;; i = (i + 1) & mask, ++entry.dist) {
+    hashmap_entry_t* e = &map->items[i];
+    if (!e->key) {
+      *e = entry;
+      return;
+    }
+    if (e->dist < entry.dist) {
+      hashmap_entry_t displaced = *e;
+      *e = entry;
+      entry = displaced;
+    }
+  }
+}
 
-  for (; e; e = e->next) {
-    if (strcmp(key, e->key) == 0)
-      return e->value; 
+inline static int hashmap_grow(hashmap_t* map)
+{
+  size_t capacity = map->capacity ? map->capacity * 2 : 16;
+  hashmap_entry_t* items = calloc(capacity, sizeof(hashmap_entry_t));
+  if (!items) return 0;
+
+  hashmap_entry_t* old = map->items;
+  size_t old_capacity = map->capacity;
+  map->items = items;
+  map->capacity = capacity;
+  for (size_t i = 0; i < old_capacity; ++i) {
+    if (old[i].key)
+      hashmap_place(map, old[i]);
   }
+  free(old);
+  return 1;
+}
+
+// Adds `key`, known to be absent, with its `hash`
+inline static int hashmap_insert(hashmap_t* map,
+    const char* key, size_t len, uint32_t hash, void* value)
+{
+  // Robin Hood keeps the probes short up to 7/8 full
+  if ((map->count + 1) * 8 > map->capacity * 7 && !hashmap_grow(map))
+    return 0;
 
-  return NULL;
+  char* copy = arena_strndup(&map->keys, key, len);
+  if (!copy) return 0;
+
+  hashmap_entry_t entry = { copy, value, hash, 0 };
+  hashmap_place(map, entry);
+  map->count++;
+  return 1;
 }
 
-inline static int hashmap_remove(hashmap_t* map, const char* key)
+// Maps `key` to `value`, replacing an existing mapping. Returns 0 when out
+// of memory.
+inline static int hashmap_put(hashmap_t* map, const char* key, void* value)
 {
   if (!map || !key) return 0;
 
-  unsigned idx = hashmap_hash(key);
-  hashmap_entry_t* e = map->buckets[idx];
-  hashmap_entry_t* prev = NULL;
-
-  for (; e; prev = e, e = e->next) {
-    if (strcmp(key, e->key) != 0) continue;
-    if (prev)
-      prev->next = e->next;
-    else
-      map->buckets[idx] = e->next;
-    free(e->key);
-    free(e);
+  size_t len = strlen(key);
+  uint32_t hash = hashmap_hash(key, len);
+  hashmap_entry_t* found = hashmap_find_hashed(map, key, hash);
+  if (found) {
+    found->value = value;
     return 1;
   }
 
-  return 0;
+  return hashmap_insert(map, key, len, hash, value);
 }
 
-inline static void hashmap_free(hashmap_t* map, int pointer_value)
+// Maps `key` to `value` unless `key` is already mapped, the map is then
+// left as is and 2 is returned so that the caller can release `value`.
+// Returns 0 when out of memory.
+inline static int hashmap_put_new(hashmap_t* map, const char* key, void* value)
 {
-  if (!map) return;
+  if (!map || !key) return 0;
 
-  for (size_t i = 0; i < HASH_SIZE; ++i) {
-    hashmap_entry_t* entry = map->buckets[i];
-    while (entry) {
-      free(entry->key);
-      if (pointer_value && entry->value) {
-        free(entry->value);
-      }
-      hashmap_entry_t* e = entry->next;
-      if (entry)
-        free(entry);
-      entry = e;
-    }
-    map->buckets[i] = NULL;
-  }
+  size_t len = strlen(key);
+  uint32_t hash = hashmap_hash(key, len);
+  if (hashmap_find_hashed(map, key, hash))
+    return 2;
+
+  return hashmap_insert(map, key, len, hash, value);
 }
 
-inline static hashmap_t* hashmap_merge(hashmap_t* map1, hashmap_t* map2) {
-  hashmap_t* map = calloc(1, sizeof(hashmap_t));
-  if (!map) {
-    free(map);
-    return NULL; 
-  }
+inline static void* hashmap_get(const hashmap_t* map, const char* key)
+{
+  hashmap_entry_t* e = hashmap_find(map, key);
+  return e ? e->value : NULL;
+}
 
-  for (size_t i = 0; i < HASH_SIZE; ++i) {
-    hashmap_entry_t* e = map1->buckets[i];
-    while (e) 
-      if (e->key)
-        hashmap_put(map, e->key, e->value);
-    e = map2->buckets[i];
-    while(e)
-      if (e->key)
-        hashmap_put(map, e->key, e->value);
+// Returns 1 when `key` was in the map. Its copy stays in the key arena
+// until the map is freed.
+inline static int hashmap_remove(hashmap_t* map, const char* key)
+{
+  hashmap_entry_t* e = hashmap_find(map, key);
+  if (!e) return 0;
+
+  // shift the rest of the run back by one slot, no tombstone is left
+  size_t mask = map->capacity - 1;
+  size_t i = (size_t) (e - map->items);
+  for (size_t j = (i + 1) & mask;
+       map->items[j].key && map->items[j].dist > 0; j = (j + 1) & mask) {
+    map->items[i] = map->items[j];
+    map->items[i].dist--;
+    i = j;
   }
+  memset(&map->items[i], 0, sizeof(hashmap_entry_t));
+  map->count--;
+  return 1;
+}
 
+inline static void hashmap_free(hashmap_t* map, int pointer_value)
+{
+  if (!map) return;
+  if (pointer_value)
+    hashmap_foreach(e, map) free(e->value);
+  free(map->items);
+  arena_free(&map->keys);
+  map->items = NULL;
+  map->count = 0;
+  map->capacity = 0;
+}
+
+// New map with the entries of both, those of `map2` win on a shared key.
+// NULL when out of memory.
+inline static hashmap_t* hashmap_merge(hashmap_t* map1, hashmap_t* map2)
+{
+  hashmap_t* map = calloc(1, sizeof(hashmap_t));
+  if (!map) return NULL;
+
+  hashmap_t* sources[] = { map1, map2 };
+  for (size_t s = 0; s < 2; ++s) {
+    if (!sources[s]) continue;
+    hashmap_foreach(e, sources[s]) {
+      if (!hashmap_put(map, e->key, e->value)) {
+        hashmap_free(map, 0);
+        free(map);
+        return NULL;
+      }
+    }
+  }
   return map;
 }
 
 #endif // HASHMAP_H
-
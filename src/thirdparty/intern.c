@@ -0,0 +1,145 @@
+#include "thirdparty/intern.h"
+
+#include <pthread.h>
+#include <string.h>
+
+// Atoms index pages that never move, so atom_str() reads without the
+// lock: a thread only holds atoms published by the interning thread.
+#define INTERN_PAGE_BITS  12
+#define INTERN_PAGE_SIZE  (1u << INTERN_PAGE_BITS)
+#define INTERN_MAX_PAGES  4096
+#define INTERN_CHUNK_SIZE (64 * 1024)
+
+typedef struct {
+  const char* str;
+  uint32_t    len;
+  uint32_t    hash;
+} intern_entry_t;
+
+// string storage, chained so a chunk never moves
+typedef struct intern_chunk_t {
+  struct intern_chunk_t* next;
+  size_t used;
+  size_t size;
+  char data[];
+} intern_chunk_t;
+
+static pthread_mutex_t _intern_lock = PTHREAD_MUTEX_INITIALIZER;
+static intern_entry_t* _intern_pages[INTERN_MAX_PAGES];
+static uint32_t        _intern_count = 1; // atom 0 is ATOM_NONE
+static atom_t*         _intern_table = NULL; // open addressing on the hash
+static size_t          _intern_capacity = 0;
+static intern_chunk_t* _intern_chunks = NULL;
+
+static uint32_t hash_name(const char* name, size_t len)
+{
+  uint32_t h = 2166136261u;
+  for (size_t i = 0; i < len; ++i) {
+    h ^= (unsigned char) name[i];
+    h *= 16777619u;
+  }
+  return h;
+}
+
+static intern_entry_t* entry_of(atom_t atom)
+{
+  return &_intern_pages[atom >> INTERN_PAGE_BITS][atom & (INTERN_PAGE_SIZE - 1)];
+}
+
+static char* store_string(const char* name, size_t len)
+{
+  intern_chunk_t* chunk = _intern_chunks;
+  if (!chunk || chunk->size - chunk->used < len + 1) {
+    size_t size = len + 1 > INTERN_CHUNK_SIZE ? len + 1 : INTERN_CHUNK_SIZE;
+    chunk = malloc(sizeof(intern_chunk_t) + size);
+    if (!chunk) return NULL;
+    chunk->next = _intern_chunks;
+    chunk->used = 0;
+    chunk->size = size;
+    _intern_chunks = chunk;
+  }
+
+  char* str = chunk->data + chunk->used;
+  memcpy(str, name, len);
+  str[len] = '\0';
+  chunk->used += len + 1;
+  return str;
+}
+
+static int grow_table(void)
+{
+  size_t capacity = _intern_capacity ? _intern_capacity * 2 : 1024;
+  atom_t* table = calloc(capacity, sizeof(atom_t));
+  if (!table) return 0;
+
+  for (size_t i = 0; i < _intern_capacity; ++i) {
+    atom_t atom = _intern_table[i];
+    if (atom == ATOM_NONE) continue;
+    size_t slot = entry_of(atom)->hash & (capacity - 1);
+    while (table[slot] != ATOM_NONE)
+      slot = (slot + 1) & (capacity - 1);
+    table[slot] = atom;
+  }
+  free(_intern_table);
+  _intern_table = table;
+  _intern_capacity = capacity;
+  return 1;
+}
+
+atom_t intern(const char* name, size_t len)
+{
+  if (!name) return ATOM_NONE;
+  uint32_t hash = hash_name(name, len);
+
+  pthread_mutex_lock(&_intern_lock);
+  atom_t atom = ATOM_NONE;
+
+  if (_intern_count * 2 >= _intern_capacity && !grow_table())
+    goto done;
+
+  size_t slot = hash & (_intern_capacity - 1);
+  for (; _intern_table[slot] != ATOM_NONE; slot = (slot + 1) & (_intern_capacity - 1)) {
+    intern_entry_t* e = entry_of(_intern_table[slot]);
+    if (e->hash == hash && e->len == len && memcmp(e->str, name, len) == 0) {
+      atom = _intern_table[slot];
+      goto done;
+    }
+  }
+
+  uint32_t page = _intern_count >> INTERN_PAGE_BITS;
+  if (page >= INTERN_MAX_PAGES) goto done;
+  if (!_intern_pages[page]) {
+    _intern_pages[page] = calloc(INTERN_PAGE_SIZE, sizeof(intern_entry_t));
+    if (!_intern_pages[page]) goto done;
+  }
+
+  const char* str = store_string(name, len);
+  if (!str) goto done;
+
+  atom = _intern_count++;
+  *entry_of(atom) = (intern_entry_t) { str, (uint32_t) len, hash };
+  _intern_table[slot] = atom;
+
+done:
+  pthread_mutex_unlock(&_intern_lock);
+  return atom;
+}
+
+atom_t intern_cstr(const char* name)
+{
+  return name ? intern(name, strlen(name)) : ATOM_NONE;
+}
+
+const char* atom_str(atom_t atom)
+{
+  if (atom == ATOM_NONE) return NULL;
+  return entry_of(atom)->str;
+}
+
+size_t intern_count(void)
+{
+  pthread_mutex_lock(&_intern_lock);
+  size_t count = _intern_count - 1;
+  pthread_mutex_unlock(&_intern_lock);
+  return count;
+}
@@ -0,0 +1,137 @@
+#ifndef INTERN_H
+#define INTERN_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+// Process-wide identifier interner: every distinct name is stored once and
+// known by a 32-bit atom, so two names are equal when their atoms are.
+// Atoms and their strings stay valid until the process exits, interning
+// is safe from several threads.
+typedef uint32_t atom_t;
+
+// never returned for a name, marks "no name"
+#define ATOM_NONE 0
+
+atom_t intern(const char* name, size_t len);
+atom_t intern_cstr(const char* name);
+
+// NUL-terminated text of `atom`, NULL for ATOM_NONE
+const char* atom_str(atom_t atom);
+
+// Distinct names interned so far
+size_t intern_count(void);
+
+// ----------------- Atom keyed map ------------------
+
+// Open addressing map from atoms to pointers, for symbol tables
+typedef struct
+{
+  atom_t key;
+  void* value;
+} atom_map_entry_t;
+
+typedef struct
+{
+  atom_map_entry_t* items; // `capacity` slots, a power of two
+  size_t count;
+  size_t capacity;
+} atom_map_t;
+
+#define atom_map_foreach(entry, map)                                   \
+  for (atom_map_entry_t* entry = (map)->items;                         \
+       entry && entry < (map)->items + (map)->capacity; ++entry)       \
+    if (entry->key != ATOM_NONE)
+
+static inline size_t atom_map_slot(const atom_map_t* map, atom_t key)
+{
+  return (size_t) (key * 2654435761u) & (map->capacity - 1);
+}
+
+static inline void* atom_map_get(const atom_map_t* map, atom_t key)
+{
+  if (!map || map->count == 0 || key == ATOM_NONE) return NULL;
+
+  for (size_t i = atom_map_slot(map, key);; i = (i + 1) & (map->capacity - 1)) {
+    if (map->items[i].key == key) return map->items[i].value;
+    if (map->items[i].key == ATOM_NONE) return NULL;
+  }
+}
+
+static inline int atom_map_grow(atom_map_t* map)
+{
+  size_t capacity = map->capacity ? map->capacity * 2 : 16;
+  atom_map_entry_t* items = calloc(capacity, sizeof(atom_map_entry_t));
+  if (!items) return 0;
+
+  atom_map_t grown = { items, map->count, capacity };
+  for (size_t i = 0; i < map->capacity; ++i) {
+    if (map->items[i].key == ATOM_NONE) continue;
+    size_t slot = atom_map_slot(&grown, map->items[i].key);
+    while (items[slot].key != ATOM_NONE)
+      slot = (slot + 1) & (capacity - 1);
+    items[slot] = map->items[i];
+  }
+  free(map->items);
+  *map = grown;
+  return 1;
+}
+
+// Maps `key` to `value`, replacing an existing mapping. Returns 0 when out
+// of memory.
+static inline int atom_map_put(atom_map_t* map, atom_t key, void* value)
+{
+  if (!map || key == ATOM_NONE) return 0;
+  if ((map->count + 1) * 4 > map->capacity * 3 && !atom_map_grow(map))
+    return 0;
+
+  size_t i = atom_map_slot(map, key);
+  while (map->items[i].key != ATOM_NONE && map->items[i].key != key)
+    i = (i + 1) & (map->capacity - 1);
+
+  if (map->items[i].key == ATOM_NONE) map->count++;
+  map->items[i].key = key;
+  map->items[i].value = value;
+  return 1;
+}
+
+// Returns the value `key` mapped to, NULL when it was not in the map
+static inline void* atom_map_remove(atom_map_t* map, atom_t key)
+{
+  if (!map || map->count == 0 || key == ATOM_NONE) return NULL;
+
+  size_t mask = map->capacity - 1;
+  size_t i = atom_map_slot(map, key);
+  while (map->items[i].key != key) {
+    if (map->items[i].key == ATOM_NONE) return NULL;
+    i = (i + 1) & mask;
+  }
+  void* value = map->items[i].value;
+
+  // pull back the entries of the run that probed past the freed slot
+  for (size_t j = (i + 1) & mask; map->items[j].key != ATOM_NONE; j = (j + 1) & mask) {
+    size_t home = atom_map_slot(map, map->items[j].key);
+    if (((j - home) & mask) >= ((j - i) & mask)) {
+      map->items[i] = map->items[j];
+      i = j;
+    }
+  }
+  map->items[i].key = ATOM_NONE;
+  map->items[i].value = NULL;
+  map->count--;
+  return value;
+}
+
+static inline void atom_map_free(atom_map_t* map, int pointer_value)
+{
+  if (!map) return;
+  if (pointer_value)
+    atom_map_foreach(e, map) free(e->value);
+  free(map->items);
+  map->items = NULL;
+  map->count = 0;
+  map->capacity = 0;
+}
+
+#endif // INTERN_H
@@ -16,6 +16,10 @@ log_verbosity_t log_get_verbosity(void);
 int log_is_verbose(void);
 int log_is_dump(void);
 
+// Redirects the calling thread's log output (NULL restores stderr)
+void log_set_output(FILE* out);
+FILE* log_get_output(void);
+
 void log_phase(const char* tag, const char* detail_fmt, ...);
 
 void log_section_begin(const char* title);
@@ -31,10 +35,15 @@ void log_section_end(void);
 
 static log_verbosity_t _log_verbosity  = LOG_SILENT;
 static int             _log_color_init = -1;
+static __thread FILE*  _log_output     = NULL;
 
 static int _log_use_color(void) {
-    if (_log_color_init == -1) _log_color_init = isatty(fileno(stderr));
-    return _log_color_init;
+    int c = __atomic_load_n(&_log_color_init, __ATOMIC_RELAXED);
+    if (c == -1) {
+        c = isatty(fileno(stderr));
+        __atomic_store_n(&_log_color_init, c, __ATOMIC_RELAXED);
+    }
+    return c;
 }
 
 void log_set_verbosity(log_verbosity_t level) { _log_verbosity = level; }
@@ -42,44 +51,47 @@ log_verbosity_t log_get_verbosity(void)       { return _log_verbosity; }
 int log_is_verbose(void) { return _log_verbosity >= LOG_VERBOSE; }
 int log_is_dump(void)    { return _log_verbosity >= LOG_DUMP; }
 
+void log_set_output(FILE* out) { _log_output = out; }
+FILE* log_get_output(void)     { return _log_output ? _log_output : stderr; }
+
 void log_phase(const char* tag, const char* detail_fmt, ...) {
     if (!log_is_verbose()) return;
 
     if (_log_use_color())
-        fprintf(stderr, _L_BOLD _L_CYAN "  --> " _L_RESET _L_BOLD "%-16s" _L_RESET, tag);
+        fprintf(log_get_output(), _L_BOLD _L_CYAN "  --> " _L_RESET _L_BOLD "%-16s" _L_RESET, tag);
     else
-        fprintf(stderr, "  --> %-16s", tag);
+        fprintf(log_get_output(), "  --> %-16s", tag);
 
     if (detail_fmt) {
-        if (_log_use_color()) fprintf(stderr, _L_DIM);
+        if (_log_use_color()) fprintf(log_get_output(), _L_DIM);
         va_list args;
         va_start(args, detail_fmt);
-        vfprintf(stderr, detail_fmt, args);
+        vfprintf(log_get_output(), detail_fmt, args);
         va_end(args);
-        if (_log_use_color()) fprintf(stderr, _L_RESET);
+        if (_log_use_color()) fprintf(log_get_output(), _L_RESET);
     }
-    fprintf(stderr, "\n");
+    fprintf(log_get_output(), "\n");
 }
 
 void log_section_begin(const char* title) {
     if (!log_is_dump()) return;
     if (_log_use_color())
-        fprintf(stderr,
+        fprintf(log_get_output(),
             "\n" _L_BOLD _L_YELLOW "  ,-- " _L_RESET _L_BOLD "%s\n" _L_RESET
             _L_DIM _L_YELLOW "  |\n" _L_RESET,
             title);
     else
-        fprintf(stderr, "\n  ,-- %s\n  |\n", title);
+        fprintf(log_get_output(), "\n  ,-- %s\n  |\n", title);
 }
 
 void log_section_end(void) {
     if (!log_is_dump()) return;
     if (_log_use_color())
-        fprintf(stderr,
+        fprintf(log_get_output(),
             _L_DIM _L_YELLOW "  |\n"
             "  `----------------------------------\n\n" _L_RESET);
     else
-        fprintf(stderr, "  |\n  `----------------------------------\n\n");
+        fprintf(log_get_output(), "  |\n  `----------------------------------\n\n");
 }
 
 #undef _L_RESET
@@ -6,34 +6,122 @@
 
 #include <stdarg.h>
 #include <stdio.h>
+#include <string.h>
 
-typedef struct 
+// With a sink the text is written out each time the buffer holds
+// SB_CHUNK_SIZE bytes, the buffer is then reused from its start
+#define SB_CHUNK_SIZE (64 * 1024)
+
+typedef struct
 {
   char* items;
   size_t count;
   size_t capacity;
+
+  FILE* sink;     // NULL: the whole text stays in `items`
+  size_t flushed; // bytes already written to `sink`
 } string_builder_t;
 
+inline static void sb_flush(string_builder_t* sb)
+{
+  if (sb->sink && sb->count) {
+    fwrite(sb->items, 1, sb->count, sb->sink);
+    sb->flushed += sb->count;
+    sb->count = 0;
+  }
+}
+
+// Streams the text to `sink` from now on, by chunks. sb_flush writes the
+// last one.
+inline static void sb_set_sink(string_builder_t* sb, FILE* sink)
+{
+  sb->sink = sink;
+  da_reserve(sb, SB_CHUNK_SIZE);
+}
+
+// Bytes appended so far, flushed ones included
+inline static size_t sb_length(const string_builder_t* sb)
+{
+  return sb->flushed + sb->count;
+}
+
+// Makes room for `size` more bytes and a NUL
+inline static void sb_reserve(string_builder_t* sb, size_t size)
+{
+  if (sb->sink && sb->count + size >= SB_CHUNK_SIZE)
+    sb_flush(sb);
+  if (sb->count + size + 1 > sb->capacity)
+    da_reserve(sb, sb->count + size + 1);
+}
+
+inline static void sb_append_strn(string_builder_t* sb, const char* s, size_t len)
+{
+  sb_reserve(sb, len);
+  memcpy(&sb->items[sb->count], s, len);
+  sb->count += len;
+  sb->items[sb->count] = '\0';
+}
+
+// strlen of a literal folds once inlined, appending one costs a memcpy
+inline static void sb_append_str(string_builder_t* sb, const char* s)
+{
+  sb_append_strn(sb, s, strlen(s));
+}
+
+inline static void sb_append_char(string_builder_t* sb, char c)
+{
+  sb_reserve(sb, 1);
+  sb->items[sb->count++] = c;
+  sb->items[sb->count] = '\0';
+}
+
+inline static void sb_append_uint(string_builder_t* sb, unsigned long long value)
+{
+  // digits are produced from the last one
+  char digits[20];
+  size_t n = sizeof(digits);
+  do {
+    digits[--n] = (char) ('0' + value % 10);
+    value /= 10;
+  } while (value);
+  sb_append_strn(sb, digits + n, sizeof(digits) - n);
+}
+
+inline static void sb_append_int(string_builder_t* sb, long long value)
+{
+  if (value < 0) {
+    sb_append_char(sb, '-');
+    // through unsigned, -LLONG_MIN does not fit a long long
+    sb_append_uint(sb, 0ull - (unsigned long long) value);
+  } else {
+    sb_append_uint(sb, (unsigned long long) value);
+  }
+}
+
 inline static void sb_append_fmt(string_builder_t* sb, const char* fmt, ...)
 {
   va_list args;
 
+  // formatted straight into the spare room, again only when it was short
+  size_t room = sb->capacity > sb->count ? sb->capacity - sb->count : 0;
   va_start(args, fmt);
-  int required = vsnprintf(NULL, 0, fmt, args);
+  int required = vsnprintf(room ? &sb->items[sb->count] : NULL, room, fmt, args);
   va_end(args);
 
   DA_ASSERT(required >= 0);
 
-  da_reserve(sb, sb->count + required + 1);
+  if ((size_t) required >= room) {
+    sb_reserve(sb, (size_t) required);
 
-  va_start(args, fmt);
-  vsnprintf(&sb->items[sb->count], 
-      required + 1,
-      fmt,
-      args);
-  va_end(args);
+    va_start(args, fmt);
+    vsnprintf(&sb->items[sb->count],
+        required + 1,
+        fmt,
+        args);
+    va_end(args);
+  }
 
   sb->count += required;
 }
 
-#endif // STRING_BUILDEr_H
+#endif // STRING_BUILDER_H
@@ -0,0 +1,168 @@
+// Memory and traversal time of the pointer AST against the flat AST.
+// Usage: ast_bench [file.clf] (a synthetic module when no file is given)
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define LEXER_LIB_IMPLEMENTATION
+#include "../src/frontend/lexer.h"
+#define DA_LIB_IMPLEMENTATION
+#include "../src/thirdparty/da.h"
+
+#include "../src/frontend/ast.h"
+#include "../src/frontend/ast_flat.h"
+
+#define BENCH_FUNCTIONS 40000
+#define BENCH_RUNS 10
+
+static char* generate_source(size_t* len)
+{
+  static const char* chunk =
+    "fn f%zu(int a, int b): int {\n"
+    "  var c = a + b * %zu;\n"
+    "  var d = 0;\n"
+    "  while (d < c) { d = d + 1; }\n"
+    "  for (var i = 0; i < 4; i++) { c = c - i; }\n"
+    "  if (c > 3) { return c; } else { d = -d; }\n"
+    "  return f%zu(a, d);\n"
+    "}\n\n";
+
+  size_t size = BENCH_FUNCTIONS * 256;
+  char* buf = malloc(size);
+  if (!buf) return NULL;
+
+  size_t used = 0;
+  for (size_t i = 0; i < BENCH_FUNCTIONS; ++i)
+    used += (size_t) sprintf(buf + used, chunk, i, i % 97, i ? i - 1 : 0);
+  *len = used;
+  return buf;
+}
+
+static char* read_source(const char* path, size_t* len)
+{
+  FILE* f = fopen(path, "rb");
+  if (!f) return NULL;
+  fseek(f, 0, SEEK_END);
+  long size = ftell(f);
+  fseek(f, 0, SEEK_SET);
+
+  char* buf = malloc((size_t) size + 1);
+  if (buf && fread(buf, 1, (size_t) size, f) != (size_t) size) {
+    free(buf);
+    buf = NULL;
+  }
+  fclose(f);
+  if (!buf) return NULL;
+  buf[size] = '\0';
+  *len = (size_t) size;
+  return buf;
+}
+
+static double now_seconds(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double) ts.tv_sec + (double) ts.tv_nsec / 1e9;
+}
+
+static size_t walk_tree(const declaration_array* program)
+{
+  size_t n = 0;
+  for (size_t i = 0; i < program->count; ++i)
+    n += ast_count_nodes(program->items[i]);
+  return n;
+}
+
+// Reads only the hot kind columns, the way a pass looking for one kind
+// of node would
+static size_t scan_kinds(const ast_flat_t* flat)
+{
+  size_t n = 0;
+  for (size_t i = 0; i < flat->exprs.count; ++i)
+    n += flat->exprs.kind[i] == EXPRESSION_BINARY;
+  for (size_t i = 0; i < flat->stmts.count; ++i)
+    n += flat->stmts.kind[i] == STATEMENT_RETURN;
+  return n;
+}
+
+int main(int argc, char** argv)
+{
+  size_t len = 0;
+  char* src = argc > 1 ? read_source(argv[1], &len) : generate_source(&len);
+  if (!src) {
+    fprintf(stderr, "cannot load the benchmark source\n");
+    return 1;
+  }
+
+  parser_t p = {0};
+  lexer_t lex;
+  char storage[4096];
+  lexer_init_lexer(&lex, src, src + len, storage, sizeof(storage));
+  while (lexer_get_token(&lex)) {
+    if (lex.token == LEXER_token_parse_error) break;
+    token_t t = lexer_copy_token(&lex);
+    da_append(&p, t);
+  }
+  p.types = calloc(1, sizeof(type_registry_t));
+  populate_parser_known_type(p.types);
+
+  declaration_array program = {0};
+  while (peek(&p)) {
+    declaration_t* decl = parse_declaration(&p);
+    if (!decl) {
+      fprintf(stderr, "the benchmark source does not parse\n");
+      return 1;
+    }
+    da_append(&program, decl);
+  }
+
+  ast_flat_t flat;
+  double start = now_seconds();
+  if (!ast_flat_build(&flat, &program, src)) {
+    fprintf(stderr, "cannot build the flat AST\n");
+    return 1;
+  }
+  double build = now_seconds() - start;
+
+  size_t nodes = walk_tree(&program);
+  printf("%zu bytes, %zu declarations, %zu nodes\n", len, program.count, nodes);
+  printf("pointer tree  %8.1f KiB (arena, names included)\n",
+      (double) p.arena.allocated / 1024);
+  printf("flat pools    %8.1f KiB, built in %.1f ms\n",
+      (double) ast_flat_bytes(&flat) / 1024, build * 1e3);
+
+  double best_tree = 0, best_flat = 0, best_scan = 0;
+  size_t tree_nodes = 0, flat_nodes = 0, scanned = 0;
+  for (int run = 0; run < BENCH_RUNS; ++run) {
+    double t0 = now_seconds();
+    tree_nodes = walk_tree(&program);
+    double t1 = now_seconds();
+    flat_nodes = ast_flat_count_nodes(&flat);
+    double t2 = now_seconds();
+    scanned = scan_kinds(&flat);
+    double t3 = now_seconds();
+
+    if (run == 0 || t1 - t0 < best_tree) best_tree = t1 - t0;
+    if (run == 0 || t2 - t1 < best_flat) best_flat = t2 - t1;
+    if (run == 0 || t3 - t2 < best_scan) best_scan = t3 - t2;
+  }
+
+  printf("pointer walk  %8.2f ms\n", best_tree * 1e3);
+  printf("index walk    %8.2f ms\n", best_flat * 1e3);
+  printf("kind scan     %8.2f ms  (%zu binaries and returns)\n", best_scan * 1e3, scanned);
+
+  int status = tree_nodes == flat_nodes ? 0 : 1;
+  if (status)
+    printf("index walk saw %zu nodes, pointer walk %zu\n", flat_nodes, tree_nodes);
+
+  ast_flat_free(&flat);
+  da_free(&program);
+  parser_free_ast(&p);
+  parser_free_tokens(&p);
+  free(src);
+  return status;
+}
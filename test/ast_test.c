@@ -1,6 +1,9 @@
 #define CTEST_BEFORE_EACH
 #define CTEST_LIB_IMPLEMENTATION
 #include "ctest.h"
+#include <stdint.h>
+#include <sys/mman.h>
+#include <unistd.h>
 
 #define LEXER_LIB_IMPLEMENTATION
 #include "../src/frontend/lexer.h"
@@ -9,6 +12,8 @@
 
 #include "../src/frontend/ast_definition.h"
 #include "../src/frontend/ast.h"
+#include "../src/frontend/ast_flat.h"
+#include "../src/frontend/ast_parallel.h"
 
 // before_each setup: build parser from given source code
 before_each(parser_t, parser, char* source_code)
@@ -28,7 +33,7 @@ before_each(parser_t, parser, char* source_code)
     da_append(&p, t);
   }
 
-  p.types = calloc(1, sizeof(known_type_array));
+  p.types = calloc(1, sizeof(type_registry_t));
   populate_parser_known_type(p.types);
 
   free(storage);
@@ -46,7 +51,7 @@ ct_test(ast, fn_def, "fn main() {}")
   ct_assert_not_null(decl->func.name, "Function name should not be NULL");
   ct_assert_eq(decl->func.name, "main", "Function name should match source code");
 
-  free_declaration(decl);
+  parser_free_ast(&parser);
   da_free(&parser);
 }
 
@@ -57,7 +62,7 @@ ct_test(ast, fn_ret_type, "fn main(): int {}")
   ct_assert_not_null(decl, "Declaration should not be NULL");
   ct_assert_eq(decl->func.return_type.kind, TYPE_INT, "Return type kind should be TYPE_INT");
 
-  free_declaration(decl);
+  parser_free_ast(&parser);
   da_free(&parser);
 }
 
@@ -76,7 +81,7 @@ ct_test(ast, fn_params, "fn main(int a, int b) {}")
   ct_assert_eq(p2.ident_name, "b", "Second parameter name should be 'b'");
   ct_assert_eq(p2.type.kind, TYPE_INT, "Second parameter type should be TYPE_INT");
 
-  free_declaration(decl);
+  parser_free_ast(&parser);
   da_free(&parser);
 }
 
@@ -92,7 +97,7 @@ ct_test(ast, typed_int_var, "int i = 3;")
   ct_assert_eq(decl->var_decl.init->type, EXPRESSION_INT_LIT, "Init expression should be INT literal");
   ct_assert_eq(decl->var_decl.init->int_lit.value, 3, "Init int value should be 3");
 
-  free_declaration(decl);
+  parser_free_ast(&parser);
   da_free(&parser);
 }
 
@@ -106,7 +111,7 @@ ct_test(ast, untyped_var_decl, "var i = 3;")
   ct_assert_eq(decl->var_decl.init->type, EXPRESSION_INT_LIT, "Init expression should be INT literal");
   ct_assert_eq(decl->var_decl.init->int_lit.value, 3, "Init int literal value should be 3");
 
-  free_declaration(decl);
+  parser_free_ast(&parser);
   da_free(&parser);
 }
 
@@ -119,7 +124,7 @@ ct_test(ast, uninitialized_var_decl, "var i;")
   ct_assert_eq(decl->var_decl.ident.type.kind, TYPE_VAR, "Variable type should be VAR");
   ct_assert(!decl->var_decl.init, "Init expression should be NULL for uninitialized var");
 
-  free_declaration(decl);
+  parser_free_ast(&parser);
   da_free(&parser);
 }
 
@@ -133,7 +138,7 @@ ct_test(ast, return_int, "return 1;")
   ct_assert_eq(s->ret.value->type, EXPRESSION_INT_LIT, "Return expression should be INT literal");
   ct_assert_eq(s->ret.value->int_lit.value, 1, "Return int value should be 1");
 
-  free_statement(s);
+  parser_free_ast(&parser);
   da_free(&parser);
 }
 
@@ -145,7 +150,7 @@ ct_test(ast, return_var, "return a;")
   ct_assert_eq(s->ret.value->type, EXPRESSION_VAR, "Return expression should be VAR");
   ct_assert_eq(s->ret.value->var.ident.ident_name, "a", "Returned var name should be 'a'");
 
-  free_statement(s);
+  parser_free_ast(&parser);
   da_free(&parser);
 }
 
@@ -160,7 +165,7 @@ ct_test(ast, expr_assign, "i = 4;")
   ct_assert_eq(e->assign.lhs->var.ident.ident_name, "i", "LHS var name should be 'i'");
   ct_assert_eq(e->assign.rhs->int_lit.value, 4, "RHS int literal value should be 4");
 
-  free_statement(s);
+  parser_free_ast(&parser);
   da_free(&parser);
 }
 
@@ -174,7 +179,7 @@ ct_test(ast, expr_binary, "i + 4;")
   ct_assert_eq(e->binary.left->var.ident.ident_name, "i", "Left operand var should be 'i'");
   ct_assert_eq(e->binary.right->int_lit.value, 4, "Right operand value should be 4");
 
-  free_statement(s);
+  parser_free_ast(&parser);
   da_free(&parser);
 }
 
@@ -188,7 +193,7 @@ ct_test(ast, expr_binary_gt, "i > 5;")
   ct_assert_eq(e->binary.left->var.ident.ident_name, "i", "Left operand var should be 'i'");
   ct_assert_eq(e->binary.right->int_lit.value, 5, "Right operand value should be 5");
 
-  free_statement(s);
+  parser_free_ast(&parser);
   da_free(&parser);
 }
 
@@ -205,7 +210,7 @@ ct_test(ast, function_call, "test(a, 5);")
   ct_assert_eq(e->call.args[0]->var.ident.ident_name, "a", "Arg1 should be var 'a'");
   ct_assert_eq(e->call.args[1]->int_lit.value, 5, "Arg2 should be int 5");
 
-  free_statement(s);
+  parser_free_ast(&parser);
   da_free(&parser);
 }
 
@@ -221,7 +226,7 @@ ct_test(ast, qualified_call_no_args, "io::print();")
   ct_assert_eq(e->call.callee, "print", "callee should be 'print'");
   ct_assert_eq((int)e->call.arg_count, 0, "should have 0 args");
 
-  free_statement(s);
+  parser_free_ast(&parser);
   da_free(&parser);
 }
 
@@ -237,7 +242,7 @@ ct_test(ast, qualified_call_with_args, "math::add(1, 2);")
   ct_assert_eq(e->call.args[0]->int_lit.value, 1, "first arg should be 1");
   ct_assert_eq(e->call.args[1]->int_lit.value, 2, "second arg should be 2");
 
-  free_statement(s);
+  parser_free_ast(&parser);
   da_free(&parser);
 }
 
@@ -250,7 +255,7 @@ ct_test(ast, unary_pre_inc, "++i;")
   ct_assert_eq(e->unary.op, UNARY_PRE_INC, "Unary op should be PRE_INC");
   ct_assert_eq(e->unary.operand->var.ident.ident_name, "i", "Unary operand name should be 'i'");
 
-  free_statement(s);
+  parser_free_ast(&parser);
   da_free(&parser);
 }
 
@@ -263,7 +268,7 @@ ct_test(ast, unary_post_dec, "i--;")
   ct_assert_eq(e->unary.op, UNARY_POST_DEC, "Unary op should be POST_DEC");
   ct_assert_eq(e->unary.operand->var.ident.ident_name, "i", "Unary operand name should be 'i'");
 
-  free_statement(s);
+  parser_free_ast(&parser);
   da_free(&parser);
 }
 
@@ -276,7 +281,7 @@ ct_test(ast, unary_single_char, "!i;")
   ct_assert_eq(e->unary.op, UNARY_NOT, "Unary op should be NOT");
   ct_assert_eq(e->unary.operand->var.ident.ident_name, "i", "Unary operand name should be 'i'");
 
-  free_statement(s);
+  parser_free_ast(&parser);
   da_free(&parser);
 }
 
@@ -299,7 +304,7 @@ ct_test(ast, if_statement, "if (a == 4) { a = 3; } else { a = 4; }")
   ct_assert_eq(then_stmt->expr_stmt.expr->assign.rhs->int_lit.value, 3, "Then branch assigns 3");
   ct_assert_eq(else_stmt->expr_stmt.expr->assign.rhs->int_lit.value, 4, "Else branch assigns 4");
 
-  free_statement(s);
+  parser_free_ast(&parser);
   da_free(&parser);
 }
 
@@ -319,7 +324,7 @@ ct_test(ast, while_statement, "while (i == 10) { i = 3; }")
   ct_assert_eq(body->expr_stmt.expr->assign.lhs->var.ident.ident_name, "i", "LHS var name should be 'i'");
   ct_assert_eq(body->expr_stmt.expr->assign.rhs->int_lit.value, 3, "RHS literal value should be 3");
 
-  free_statement(s);
+  parser_free_ast(&parser);
   da_free(&parser);
 }
 
@@ -337,7 +342,7 @@ ct_test(ast, for_statement, "for (var i = 0; i < 10; ++i) { b = 3; }")
   ct_assert_eq(loop->unary.op, UNARY_PRE_INC, "Unary expression type should be PRE_INC");
   ct_assert_eq(s->for_stmt.body->items[0]->expr_stmt.expr->type, EXPRESSION_ASSIGN, "Body expression type should be assign");
 
-  free_statement(s);
+  parser_free_ast(&parser);
   da_free(&parser);
 }
 
@@ -362,7 +367,7 @@ ct_test(ast, struct_declaration, "struct v2 { int a; int b; }")
   ct_assert_eq(decl->struc.members.items[1].ident_name, "b", "second struct member should have same name as defined in code");
   ct_assert_eq(decl->struc.members.items[1].type.kind, TYPE_INT, "second struct member should have same type as declared in code");
 
-  free_declaration(decl);
+  parser_free_ast(&parser);
   da_free(&parser);
 }
 
@@ -371,6 +376,7 @@ ct_test(ast, struct_declaration_var, "struct v1 { var a; int b }")
   declaration_t* decl = parse_declaration(&parser);
   ct_assert_null(decl, "decl should be NULL if defined with 'var' as one of its member");
 
+  parser_free_ast(&parser);
   da_free(&parser);
 }
 
@@ -379,6 +385,7 @@ ct_test(ast, struct_declaration_unknown_type, "struct v2 { dump a; int b; }")
   declaration_t* decl = parse_declaration(&parser);
   ct_assert_null(decl, "decl should be NULL if defined with unkown type as one of its member");
 
+  parser_free_ast(&parser);
   da_free(&parser);
 }
 
@@ -395,8 +402,29 @@ ct_test(ast, struct_var_zero_init, "struct v2 { int a; int b; } v2 a = { 0 };")
   ct_assert_eq(decl->var_decl.init->type, EXPRESSION_COMPOSITE_LITERAL, "init expression should be COMPOSITE_LITERAL");
   ct_assert_eq((int)decl->var_decl.init->composite_literal.is_initializer, 0, "is_initializer should be false for zero init");
 
-  free_declaration(struct_decl);
-  free_declaration(decl);
+  parser_free_ast(&parser);
+  da_free(&parser);
+}
+
+ct_test(ast, struct_types_get_stable_ids, "struct v2 { int a; } struct v3 { u8 b; } v3 c = { 0 };")
+{
+  declaration_t* v2_decl = parse_declaration(&parser);
+  declaration_t* v3_decl = parse_declaration(&parser);
+  ct_assert_not_null(v2_decl, "struct decl should not be NULL");
+  ct_assert_not_null(v3_decl, "struct decl should not be NULL");
+
+  known_type_t* v2 = type_registry_find(parser.types, intern_cstr("v2"));
+  known_type_t* v3 = type_registry_find(parser.types, intern_cstr("v3"));
+  ct_assert_not_null(v2, "struct type should be registered by name");
+  ct_assert_eq((int) v2->id, TYPE_COUNT, "first struct should follow the builtin types");
+  ct_assert_eq((int) v3->id, TYPE_COUNT + 1, "structs should be numbered in declaration order");
+  ct_assert((type_registry_get(parser.types, TYPE_INT)->kind == TYPE_INT), "builtin types should have their kind as id");
+
+  declaration_t* decl = parse_declaration(&parser);
+  ct_assert_not_null(decl, "var decl should not be NULL");
+  ct_assert_eq((int) decl->var_decl.ident.type.id, TYPE_COUNT + 1, "variable type should reference its registry entry");
+
+  parser_free_ast(&parser);
   da_free(&parser);
 }
 
@@ -417,8 +445,7 @@ ct_test(ast, struct_var_designated_init, "struct v2 { int a; int b; } v2 a = { .
   ct_assert_eq(decl->var_decl.init->composite_literal.values[1]->assign.lhs->var.ident.ident_name, "b", "second field name should be 'b'");
   ct_assert_eq(decl->var_decl.init->composite_literal.values[1]->assign.rhs->int_lit.value, 2, "second field value should be 2");
 
-  free_declaration(struct_decl);
-  free_declaration(decl);
+  parser_free_ast(&parser);
   da_free(&parser);
 }
 
@@ -437,8 +464,7 @@ ct_test(ast, struct_var_designated_init_single, "struct v1 { int x; } v1 a = { .
   ct_assert_eq(decl->var_decl.init->composite_literal.values[0]->assign.lhs->var.ident.ident_name, "x", "field name should be 'x'");
   ct_assert_eq(decl->var_decl.init->composite_literal.values[0]->assign.rhs->int_lit.value, 42, "field value should be 42");
 
-  free_declaration(struct_decl);
-  free_declaration(decl);
+  parser_free_ast(&parser);
   da_free(&parser);
 }
 
@@ -454,7 +480,7 @@ ct_test(ast, asm_single_instr, "asm(\"mov rax, 60\");")
   ct_assert_eq((int)s->asm_stmt.arg_count, 0, "asm statement should have 0 args");
   ct_assert_eq(s->asm_stmt.instr[0], "mov rax, 60", "instruction string should match");
 
-  free_statement(s);
+  parser_free_ast(&parser);
   da_free(&parser);
 }
 
@@ -470,7 +496,7 @@ ct_test(ast, asm_multiple_instr, "asm(\"mov rax, 60\", \"xor rdi, rdi\", \"sysca
   ct_assert_eq(s->asm_stmt.instr[1], "xor rdi, rdi", "second instruction should match");
   ct_assert_eq(s->asm_stmt.instr[2], "syscall", "third instruction should match");
 
-  free_statement(s);
+  parser_free_ast(&parser);
   da_free(&parser);
 }
 
@@ -487,7 +513,7 @@ ct_test(ast, asm_with_args, "asm(\"mov rdi,\", a);")
   ct_assert_eq(s->asm_stmt.args[0]->type, EXPRESSION_VAR, "arg expression should be a variable");
   ct_assert_eq(s->asm_stmt.args[0]->var.ident.ident_name, "a", "arg variable name should be 'a'");
 
-  free_statement(s);
+  parser_free_ast(&parser);
   da_free(&parser);
 }
 
@@ -504,7 +530,7 @@ ct_test(ast, asm_only_args, "asm(a, 42);")
   ct_assert_eq(s->asm_stmt.args[1]->type, EXPRESSION_INT_LIT, "second arg should be INT literal");
   ct_assert_eq(s->asm_stmt.args[1]->int_lit.value, 42, "second arg value should be 42");
 
-  free_statement(s);
+  parser_free_ast(&parser);
   da_free(&parser);
 }
 
@@ -520,7 +546,7 @@ ct_test(ast, typed_u8_var, "u8 i = 5;")
   ct_assert_not_null(decl->var_decl.init, "Variable init should not be NULL");
   ct_assert_eq(decl->var_decl.init->int_lit.value, 5, "Init value should be 5");
 
-  free_declaration(decl);
+  parser_free_ast(&parser);
   da_free(&parser);
 }
 
@@ -533,7 +559,7 @@ ct_test(ast, typed_u16_var, "u16 i = 300;")
   ct_assert_eq((int)decl->var_decl.ident.type.element_size, 2, "Variable size should be 2 bytes");
   ct_assert_eq(decl->var_decl.init->int_lit.value, 300, "Init value should be 300");
 
-  free_declaration(decl);
+  parser_free_ast(&parser);
   da_free(&parser);
 }
 
@@ -545,7 +571,7 @@ ct_test(ast, typed_u32_var, "u32 i = 5;")
   ct_assert_eq(decl->var_decl.ident.type.kind, TYPE_U32, "Variable type should be TYPE_U32");
   ct_assert_eq((int)decl->var_decl.ident.type.element_size, 4, "Variable size should be 4 bytes");
 
-  free_declaration(decl);
+  parser_free_ast(&parser);
   da_free(&parser);
 }
 
@@ -557,7 +583,7 @@ ct_test(ast, typed_u64_var, "u64 i = 5;")
   ct_assert_eq(decl->var_decl.ident.type.kind, TYPE_U64, "Variable type should be TYPE_U64");
   ct_assert_eq((int)decl->var_decl.ident.type.element_size, 8, "Variable size should be 8 bytes");
 
-  free_declaration(decl);
+  parser_free_ast(&parser);
   da_free(&parser);
 }
 
@@ -569,7 +595,7 @@ ct_test(ast, fn_ret_type_u8, "fn f(): u8 {}")
   ct_assert_eq(decl->func.return_type.kind, TYPE_U8, "Return type kind should be TYPE_U8");
   ct_assert_eq((int)decl->func.return_type.element_size, 1, "Return type size should be 1 byte");
 
-  free_declaration(decl);
+  parser_free_ast(&parser);
   da_free(&parser);
 }
 
@@ -591,7 +617,7 @@ ct_test(ast, fn_params_u8_u16, "fn f(u8 a, u16 b) {}")
   ct_assert_eq(p2.type.kind, TYPE_U16, "Second param type should be TYPE_U16");
   ct_assert_eq((int)p2.type.element_size, 2, "Second param size should be 2 bytes");
 
-  free_declaration(decl);
+  parser_free_ast(&parser);
   da_free(&parser);
 }
 
@@ -610,8 +636,7 @@ ct_test(ast, struct_var_designated_init_three_fields, "struct v3 { int a; int b;
   ct_assert_eq(decl->var_decl.init->composite_literal.values[2]->assign.lhs->var.ident.ident_name, "c", "third field name should be 'c'");
   ct_assert_eq(decl->var_decl.init->composite_literal.values[2]->assign.rhs->int_lit.value, 3, "third field value should be 3");
 
-  free_declaration(struct_decl);
-  free_declaration(decl);
+  parser_free_ast(&parser);
   da_free(&parser);
 }
 
@@ -621,7 +646,7 @@ ct_test(ast, const_in_func_parameter, "fn main(int! a) { }") {
   ct_assert_eq(decl->func.params.count, 1, "function should have one parameter");
   ct_assert_eq(decl->func.params.items[0].is_constant, true, "first function parameter should be marked as constant");
 
-  free_declaration(decl);
+  parser_free_ast(&parser);
   da_free(&parser);
 }
 
@@ -636,7 +661,7 @@ ct_test(ast, char_var_decl, "char a = 'a';") {
   ct_assert_eq(decl->var_decl.init->char_lit.value, 'a', "Init char value should be 'a'");
 
 
-  free_declaration(decl);
+  parser_free_ast(&parser);
   da_free(&parser);
 }
 
@@ -652,7 +677,7 @@ ct_test(ast, free_stmt_var, "free(a);")
   ct_assert_eq(s->free_stmt.expr->type, EXPRESSION_VAR, "free expression should be VAR");
   ct_assert_eq(s->free_stmt.expr->var.ident.ident_name, "a", "freed var name should be 'a'");
 
-  free_statement(s);
+  parser_free_ast(&parser);
   da_free(&parser);
 }
 
@@ -667,7 +692,7 @@ ct_test(ast, free_stmt_call, "free(get_ptr());")
   ct_assert_eq(s->free_stmt.expr->call.callee, "get_ptr", "callee should be 'get_ptr'");
   ct_assert_eq((int)s->free_stmt.expr->call.arg_count, 0, "call should have 0 args");
 
-  free_statement(s);
+  parser_free_ast(&parser);
   da_free(&parser);
 }
 
@@ -690,7 +715,7 @@ ct_test(ast, array_int_decl, "int[2] a = { 1, 2 };")
   ct_assert_eq((int)decl->var_decl.init->composite_literal.count, 2,
                "literal should have 2 elements");
 
-  free_declaration(decl);
+  parser_free_ast(&parser);
   da_free(&parser);
 }
 
@@ -706,7 +731,7 @@ ct_test(ast, array_literal_values, "int[2] a = { 1, 2 };")
   ct_assert_eq(vals[1]->type, EXPRESSION_INT_LIT, "second element should be INT_LIT");
   ct_assert_eq(vals[1]->int_lit.value, 2, "second element value should be 2");
 
-  free_declaration(decl);
+  parser_free_ast(&parser);
   da_free(&parser);
 }
 
@@ -723,7 +748,7 @@ ct_test(ast, array_zero_init, "int[4] b = { 0 };")
   ct_assert_eq(decl->var_decl.init->composite_literal.is_initializer, false,
                "is_initializer should be false for zero-init");
 
-  free_declaration(decl);
+  parser_free_ast(&parser);
   da_free(&parser);
 }
 
@@ -739,7 +764,7 @@ ct_test(ast, array_single_element, "int[1] x = { 99 };")
   ct_assert_eq(decl->var_decl.init->composite_literal.values[0]->int_lit.value, 99,
                "element value should be 99");
 
-  free_declaration(decl);
+  parser_free_ast(&parser);
   da_free(&parser);
 }
 
@@ -760,7 +785,7 @@ ct_test(ast, array_u8_decl, "u8[3] arr = { 10, 20, 30 };")
   ct_assert_eq(decl->var_decl.init->composite_literal.values[2]->int_lit.value, 30,
                "third element should be 30");
 
-  free_declaration(decl);
+  parser_free_ast(&parser);
   da_free(&parser);
 }
 
@@ -772,7 +797,7 @@ ct_test(ast, array_non_typed_has_no_array_len, "var a = 5;")
   ct_assert_eq((int)decl->var_decl.ident.type.array_len, 0,
                "non-array var should have array_len == 0");
 
-  free_declaration(decl);
+  parser_free_ast(&parser);
   da_free(&parser);
 }
 
@@ -791,7 +816,7 @@ ct_test(ast, array_index_int_literal, "a[0];")
   ct_assert_eq(e->index.index->type, EXPRESSION_INT_LIT, "index should be an int literal");
   ct_assert_eq(e->index.index->int_lit.value, 0, "index value should be 0");
 
-  free_statement(s);
+  parser_free_ast(&parser);
   da_free(&parser);
 }
 
@@ -806,7 +831,7 @@ ct_test(ast, array_index_var, "a[i];")
   ct_assert_eq(e->index.index->type, EXPRESSION_VAR, "index should be a var expression");
   ct_assert_eq(e->index.index->var.ident.ident_name, "i", "index var should be 'i'");
 
-  free_statement(s);
+  parser_free_ast(&parser);
   da_free(&parser);
 }
 
@@ -820,7 +845,7 @@ ct_test(ast, array_index_binary_expr, "a[i + 1];")
   ct_assert_eq(e->index.base->var.ident.ident_name, "a", "base should be var 'a'");
   ct_assert_eq(e->index.index->type, EXPRESSION_BINARY, "index should be a binary expression");
 
-  free_statement(s);
+  parser_free_ast(&parser);
   da_free(&parser);
 }
 
@@ -834,7 +859,7 @@ ct_test(ast, array_index_nonzero, "arr[3];")
   ct_assert_eq(e->index.base->var.ident.ident_name, "arr", "base should be var 'arr'");
   ct_assert_eq(e->index.index->int_lit.value, 3, "index value should be 3");
 
-  free_statement(s);
+  parser_free_ast(&parser);
   da_free(&parser);
 }
 
@@ -849,7 +874,7 @@ ct_test(ast, module_basic, "module mymod")
   ct_assert_eq(decl->module.path.count, 1, "path should have 1 segment");
   ct_assert_eq(decl->module.path.items[0], "mymod", "module name should match source");
 
-  free_declaration(decl);
+  parser_free_ast(&parser);
   da_free(&parser);
 }
 
@@ -863,7 +888,7 @@ ct_test(ast, module_nested, "module std::io")
   ct_assert_eq(decl->module.path.items[0], "std", "first segment should be 'std'");
   ct_assert_eq(decl->module.path.items[1], "io", "second segment should be 'io'");
 
-  free_declaration(decl);
+  parser_free_ast(&parser);
   da_free(&parser);
 }
 
@@ -877,7 +902,7 @@ ct_test(ast, module_deep_nested, "module std::io::fs")
   ct_assert_eq(decl->module.path.items[1], "io", "second segment should be 'io'");
   ct_assert_eq(decl->module.path.items[2], "fs", "third segment should be 'fs'");
 
-  free_declaration(decl);
+  parser_free_ast(&parser);
   da_free(&parser);
 }
 
@@ -893,7 +918,7 @@ ct_test(ast, import_simple, "import std::io")
   ct_assert_eq(decl->import.path.items[0], "std", "first segment should be 'std'");
   ct_assert_eq(decl->import.path.items[1], "io", "second segment should be 'io'");
 
-  free_declaration(decl);
+  parser_free_ast(&parser);
   da_free(&parser);
 }
 
@@ -908,7 +933,7 @@ ct_test(ast, import_nested, "import std::io::print")
   ct_assert_eq(decl->import.path.items[1], "io", "second segment should be 'io'");
   ct_assert_eq(decl->import.path.items[2], "print", "third segment should be 'print'");
 
-  free_declaration(decl);
+  parser_free_ast(&parser);
   da_free(&parser);
 }
 
@@ -922,7 +947,7 @@ ct_test(ast, import_single_segment, "import mymod")
   ct_assert_eq(decl->import.path.items[0], "mymod", "segment should be 'mymod'");
   ct_assert_null(decl->import.alias, "no alias should be NULL");
 
-  free_declaration(decl);
+  parser_free_ast(&parser);
   da_free(&parser);
 }
 
@@ -937,7 +962,7 @@ ct_test(ast, import_with_alias, "import std::io::print as p")
   ct_assert_not_null(decl->import.alias, "alias should not be NULL");
   ct_assert_eq(decl->import.alias, "p", "alias should be 'p'");
 
-  free_declaration(decl);
+  parser_free_ast(&parser);
   da_free(&parser);
 }
 
@@ -950,7 +975,7 @@ ct_test(ast, import_alias_no_conflict, "import math::add as math_add")
   ct_assert_eq(decl->import.path.items[1], "add", "symbol should be 'add'");
   ct_assert_eq(decl->import.alias, "math_add", "alias should be 'math_add'");
 
-  free_declaration(decl);
+  parser_free_ast(&parser);
   da_free(&parser);
 }
 
@@ -961,7 +986,7 @@ ct_test(ast, import_no_alias, "import std::io::print")
   ct_assert_not_null(decl, "import decl should not be NULL");
   ct_assert_null(decl->import.alias, "import without alias should have NULL alias");
 
-  free_declaration(decl);
+  parser_free_ast(&parser);
   da_free(&parser);
 }
 
@@ -976,7 +1001,7 @@ ct_test(ast, internal_fn_basic, "internal fn secret(): int { return 0; }")
   ct_assert(decl->func.is_internal, "function should be marked internal");
   ct_assert_eq(decl->func.name, "secret", "function name should be 'secret'");
 
-  free_declaration(decl);
+  parser_free_ast(&parser);
   da_free(&parser);
 }
 
@@ -988,7 +1013,7 @@ ct_test(ast, internal_fn_with_params, "internal fn add(int a, int b): int { retu
   ct_assert(decl->func.is_internal, "function should be marked internal");
   ct_assert_eq(decl->func.params.count, 2, "should have 2 params");
 
-  free_declaration(decl);
+  parser_free_ast(&parser);
   da_free(&parser);
 }
 
@@ -999,6 +1024,477 @@ ct_test(ast, non_internal_fn, "fn foo(): int { return 0; }")
   ct_assert_not_null(decl, "decl should not be NULL");
   ct_assert(!decl->func.is_internal, "regular function should not be internal");
 
-  free_declaration(decl);
+  parser_free_ast(&parser);
+  da_free(&parser);
+}
+
+ct_test(ast, count_nodes, "fn foo(): int { var a = 1 + 2; if (a == 3) { return a; } return 0; }")
+{
+  declaration_t* decl = parse_declaration(&parser);
+
+  ct_assert_not_null(decl, "decl should not be NULL");
+  // fn, decl stmt + var decl + binary + 2 literals, if + comparison + var +
+  // literal + return + var, return + literal
+  ct_assert_eq((int) ast_count_nodes(decl), 14, "every node should be counted");
+
+  parser_free_ast(&parser);
   da_free(&parser);
 }
+
+ct_test(ast, flat_ast_mirrors_tree, "fn foo(): int { var a = 1 + 2; if (a == 3) { return a; } return 0; }")
+{
+  declaration_t* decl = parse_declaration(&parser);
+  ct_assert_not_null(decl, "decl should not be NULL");
+
+  declaration_array program = { &decl, 1, 1 };
+  ast_flat_t flat;
+  ct_assert(ast_flat_build(&flat, &program, NULL), "flattening should succeed");
+
+  ct_assert_eq((int) flat.decls.count, 2, "fn and var should be declarations");
+  ct_assert_eq((int) flat.stmts.count, 4, "every statement should get a slot");
+  ct_assert_eq((int) flat.exprs.count, 8, "every expression should get a slot");
+  ct_assert_eq((int) ast_flat_count_nodes(&flat), 14, "index walk should see every node");
+
+  ast_ref_t fn = flat.lists[flat.program.first];
+  ct_assert_eq(flat.decls.kind[fn], DECLARATION_FUNC, "first declaration should be the function");
+  ct_assert((flat.decl_cold[fn].name == decl->func.atom), "function should keep its atom");
+
+  ast_range_t body = flat.decl_cold[fn].body;
+  ct_assert_eq((int) body.count, 3, "function body should have 3 statements");
+  ast_ref_t branch = flat.lists[body.first + 1];
+  ct_assert_eq(flat.stmts.kind[branch], STATEMENT_IF, "second statement should be the if");
+  ct_assert_eq((int) flat.stmt_cold[branch].body.count, 1, "then branch should have 1 statement");
+
+  ast_ref_t cond = flat.stmts.a[branch];
+  ct_assert_eq(flat.exprs.kind[cond], EXPRESSION_BINARY, "condition should be a binary expression");
+  ct_assert_eq((int) flat.expr_cold[cond].op, BINARY_EQ, "condition should compare for equality");
+  ct_assert_eq(flat.exprs.type[flat.exprs.b[cond]], TYPE_INT, "literal operand should be an int");
+
+  ast_flat_free(&flat);
+  parser_free_ast(&parser);
+  da_free(&parser);
+}
+
+// === STREAMED TOKENS TESTS ===
+
+static size_t test_lexer_source(void* user, token_t* out, size_t max)
+{
+  lexer_t* lex = (lexer_t*) user;
+  size_t produced = 0;
+  while (produced < max && lexer_get_token(lex)) {
+    if (lex->token == LEXER_token_parse_error) break;
+    out[produced++] = lexer_copy_token(lex);
+  }
+  return produced;
+}
+
+ct_test(ast, streamed_tokens_are_released, "")
+{
+  // 11 tokens per function, enough for several token blocks
+  char source[200 * 48] = {0};
+  size_t len = 0;
+  for (int i = 0; i < 200; ++i)
+    len += (size_t) snprintf(source + len, sizeof(source) - len,
+        "fn f%d(): int { return %d; }\n", i, i);
+
+  char* storage = malloc(255);
+  lexer_t lex;
+  lexer_init_lexer(&lex, source, source + len, storage, 255);
+  parser_init_stream(&parser, test_lexer_source, &lex);
+
+  int parsed = 0;
+  bool names_match = true;
+  size_t max_blocks = 0;
+  while (peek(&parser)) {
+    declaration_t* decl = parse_declaration(&parser);
+    if (!decl) break;
+
+    char expected[16];
+    snprintf(expected, sizeof(expected), "f%d", parsed);
+    if (strcmp(decl->func.name, expected) != 0) names_match = false;
+    parsed++;
+
+    parser_release_consumed(&parser);
+    if (parser.window.blocks.count > max_blocks)
+      max_blocks = parser.window.blocks.count;
+  }
+
+  ct_assert_eq(parsed, 200, "every declaration should be parsed");
+  ct_assert(names_match, "declarations should come in source order");
+  ct_assert_eq((int) parser_token_count(&parser), 2200, "every token should be lexed");
+  ct_assert((max_blocks <= 2), "consumed tokens should be released");
+
+  parser_free_tokens(&parser);
+  free(storage);
+}
+
+// token kinds, end offsets and texts of `source` lexed with `level`
+static uint64_t test_lex_signature(const char* source, size_t len, int level)
+{
+  lexer_set_simd(level);
+  char storage[255];
+  lexer_t lex;
+  lexer_init_lexer(&lex, source, source + len, storage, sizeof(storage));
+
+  uint64_t sum = 0;
+  while (lexer_get_token(&lex)) {
+    sum = sum * 31 + (uint64_t) lex.token;
+    sum = sum * 31 + (uint64_t) (lex.parse_point - source);
+    if (lex.token == LEXER_token_parse_error) break;
+    if (lex.token == LEXER_token_id || lex.token == LEXER_token_dqstring)
+      for (int i = 0; i < lex.string_len; ++i)
+        sum = sum * 31 + (unsigned char) lex.string_value[i];
+  }
+  return sum;
+}
+
+ct_test(ast, vector_scanning_matches_scalar, "")
+{
+  // runs shorter and longer than a vector, ending on and across its edges
+  const char* sources[] = {
+    "fn a_rather_long_function_name_crossing_vectors(x: int): int { return x; }",
+    "let s: string = \"plain text longer than thirty two bytes \\\"quoted\\\" \\n\";",
+    "//                                         comment\n"
+    "/* block ** comment *** spanning\n several vectors of input */ x\n",
+    "                                                  \t\t\r\n\f   y",
+    "abcdefghijklmnopqrstuvwxyz_ABCDEFGHIJKLMNOPQRSTUVWXYZ_0123456789",
+    "/* never closed, longer than a vector ......................",
+    "a_name_too_long_for_the_storage_"
+    "________________________________________________________________"
+    "________________________________________________________________"
+    "________________________________________________________________"
+    "________________________________________________________________",
+  };
+
+  int best = lexer_set_simd(LEXER_SIMD_AVX2);
+  bool same = true;
+  for (size_t i = 0; i < sizeof(sources) / sizeof(sources[0]); ++i) {
+    size_t len = strlen(sources[i]);
+    uint64_t scalar = test_lex_signature(sources[i], len, LEXER_SIMD_SCALAR);
+    for (int level = LEXER_SIMD_SSE2; level <= best; ++level)
+      if (test_lex_signature(sources[i], len, level) != scalar) same = false;
+  }
+  lexer_set_simd(best);
+
+  ct_assert(same, "every scanning path should produce the same tokens");
+}
+
+// Lexes `source` copied right before an unreadable page, so any read past
+// its end faults. True when lexing stops on a parse error at the end.
+static bool test_lex_ends_before_guard(const char* source, size_t len, int level)
+{
+  size_t page = (size_t) sysconf(_SC_PAGESIZE);
+  size_t span = (len + page - 1) / page * page;
+  char* base = mmap(NULL, span + page, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (base == MAP_FAILED) return false;
+  mprotect(base + span, page, PROT_NONE);
+  char* start = base + span - len;
+  memcpy(start, source, len);
+
+  lexer_set_simd(level);
+  char* storage = malloc(len + 1);
+  lexer_t lex;
+  lexer_init_lexer(&lex, start, start + len, storage, (int) len + 1);
+  while (lexer_get_token(&lex) && lex.token != LEXER_token_parse_error)
+    ;
+  bool ok = lex.token == LEXER_token_parse_error && lex.parse_point == start + len;
+
+  free(storage);
+  munmap(base, span + page);
+  return ok;
+}
+
+ct_test(ast, unterminated_string_stops_at_eof, "")
+{
+  size_t page = (size_t) sysconf(_SC_PAGESIZE);
+  const char* prefix = "fn main(): int { var s: char[4] = \"";
+  // a short one, one filling a page exactly and one ending on an escape
+  size_t lengths[] = { 40, page, 2 * page + 7 };
+
+  int best = lexer_set_simd(LEXER_SIMD_AVX2);
+  bool stopped = true;
+  for (size_t i = 0; i < sizeof(lengths) / sizeof(lengths[0]); ++i) {
+    char* source = malloc(lengths[i]);
+    size_t n = strlen(prefix);
+    memcpy(source, prefix, n);
+    memset(source + n, 'a', lengths[i] - n);
+    if (i == 2) source[lengths[i] - 1] = '\\';
+    for (int level = LEXER_SIMD_SCALAR; level <= best; ++level)
+      stopped = test_lex_ends_before_guard(source, lengths[i], level) && stopped;
+    free(source);
+  }
+  lexer_set_simd(best);
+
+  ct_assert(stopped, "an unterminated string should be a parse error at the end of the input");
+}
+
+ct_test(ast, tokens_reference_the_source, "")
+{
+  const char* source = "let name = \"plain\"; \"esc\\\"aped\"";
+  char storage[255];
+  lexer_t lex;
+  lexer_init_lexer(&lex, source, source + strlen(source), storage, sizeof(storage));
+
+  token_t tokens[8] = {0};
+  int count = 0;
+  while (count < 8 && lexer_get_token(&lex))
+    tokens[count++] = lexer_copy_token(&lex);
+
+  ct_assert_eq(count, 6, "every token should be lexed");
+  ct_assert((tokens[1].string_value == source + 4), "identifiers should point into the source");
+  ct_assert((token_is(&tokens[1], "name") && !token_is(&tokens[1], "nam")), "identifier slice should compare whole");
+  ct_assert((tokens[3].string_value == source + 12 && !tokens[3].owned), "plain strings should point into the source");
+  ct_assert((tokens[5].owned && token_is(&tokens[5], "esc\"aped")), "escaped strings should own their text");
+
+  char* copy = token_strdup(&tokens[1]);
+  ct_assert_eq(copy, "name", "copy should be NUL-terminated");
+  free(copy);
+  for (int i = 0; i < count; ++i) free(tokens[i].owned);
+}
+
+ct_test(ast, identifiers_share_atoms, "")
+{
+  const char* source = "value value values";
+  char storage[255];
+  lexer_t lex;
+  lexer_init_lexer(&lex, source, source + strlen(source), storage, sizeof(storage));
+
+  token_t tokens[3] = {0};
+  int count = 0;
+  while (count < 3 && lexer_get_token(&lex))
+    tokens[count++] = lexer_copy_token(&lex);
+
+  ct_assert_eq(count, 3, "every token should be lexed");
+  ct_assert((tokens[0].atom != ATOM_NONE && tokens[0].atom == tokens[1].atom), "same name should give the same atom");
+  ct_assert((tokens[0].atom != tokens[2].atom), "different names should give different atoms");
+  ct_assert((token_name(&tokens[0]) == token_name(&tokens[1])), "same name should share its interned text");
+  ct_assert_eq(atom_str(intern_cstr("values")), "values", "atom text should round trip");
+}
+
+ct_test(ast, keywords_get_their_token_kind, "")
+{
+  const char* source = "fn internal struct module import if while for asm free return else as fns u64 Vec";
+  char storage[255];
+  lexer_t lex;
+  lexer_init_lexer(&lex, source, source + strlen(source), storage, sizeof(storage));
+
+  token_t tokens[16] = {0};
+  int count = 0;
+  while (count < 16 && lexer_get_token(&lex))
+    tokens[count++] = lexer_copy_token(&lex);
+
+  ct_assert_eq(count, 16, "every token should be lexed");
+  for (int i = 0; i < 13; ++i)
+    ct_assert((tokens[i].type == LEXER_token_kw_fn + i), "keyword should get its own token kind");
+  ct_assert((tokens[13].type == LEXER_token_id && tokens[13].builtin_type == -1), "keyword prefix should stay an identifier");
+  ct_assert((tokens[14].type == LEXER_token_id && tokens[14].builtin_type == TYPE_U64), "builtin type should be classified");
+  ct_assert((tokens[15].type == LEXER_token_id && tokens[15].builtin_type == -1), "custom type should stay a plain identifier");
+
+  for (int i = 0; i < TYPE_COUNT; ++i) {
+    const char* name = types_description[i].name;
+    const keyword_t* k = keyword_lookup(name, (int) strlen(name));
+    ct_assert((k && k->builtin_type == i), "every builtin type should be in the keyword table");
+  }
+}
+
+// === PARALLEL PARSING TESTS ===
+
+typedef struct {
+  parser_t parser;
+  declaration_array program;
+  error_context_t error_ctx;
+  char* diagnostics;
+  size_t diagnostics_len;
+  bool ok;
+} parsed_module_t;
+
+// `functions` functions using a struct, with `middle` inserted halfway
+static char* generate_module(size_t functions, const char* middle)
+{
+  size_t size = functions * 96 + strlen(middle) + 64;
+  char* source = malloc(size);
+  size_t used = (size_t) sprintf(source, "struct v0 { int a; }\n");
+  for (size_t i = 0; i < functions; ++i) {
+    if (i == functions / 2)
+      used += (size_t) sprintf(source + used, "%s\n", middle);
+    used += (size_t) sprintf(source + used,
+        "fn f%zu(v0 a, int b): int { var c = b + %zu; if (c > 3) { return c; } return 0; }\n",
+        i, i);
+  }
+  return source;
+}
+
+static void parse_module(parsed_module_t* m, const char* source, int jobs)
+{
+  memset(m, 0, sizeof(*m));
+  error_init(&m->error_ctx, "generated.clf", source, strlen(source));
+
+  char storage[255];
+  lexer_t lex;
+  lexer_init_lexer(&lex, source, source + strlen(source), storage, sizeof(storage));
+  while (lexer_get_token(&lex) && lex.token != LEXER_token_parse_error) {
+    token_t t = lexer_copy_token(&lex);
+    da_append(&m->parser, t);
+  }
+  m->parser.types = calloc(1, sizeof(type_registry_t));
+  populate_parser_known_type(m->parser.types);
+  m->parser.error_ctx = &m->error_ctx;
+
+  FILE* out = open_memstream(&m->diagnostics, &m->diagnostics_len);
+  error_set_output(out);
+  m->ok = ast_parse_program(&m->parser, &m->program, jobs);
+  error_set_output(NULL);
+  fclose(out);
+}
+
+static void free_parsed_module(parsed_module_t* m)
+{
+  parser_free_ast(&m->parser);
+  parser_free_tokens(&m->parser);
+  type_registry_free(m->parser.types);
+  free(m->parser.types);
+  da_free(&m->program);
+  free(m->diagnostics);
+  error_free(&m->error_ctx);
+}
+
+ct_test(ast, parallel_parse_matches_serial, "")
+{
+  char* source = generate_module(3000, "struct v1 { int a; } fn g(v1 a): int { return 0; }");
+  parsed_module_t serial, parallel;
+  parse_module(&serial, source, 1);
+  parse_module(&parallel, source, 4);
+
+  ct_assert((parallel.parser.count >= AST_PARALLEL_MIN_TOKENS), "module should be large enough to be split");
+  ct_assert((serial.ok && parallel.ok), "both parses should succeed");
+  ct_assert_eq((int) parallel.program.count, (int) serial.program.count, "both parses should give every declaration");
+  bool same = true;
+  for (size_t i = 0; same && i < serial.program.count; ++i) {
+    declaration_t* a = serial.program.items[i];
+    declaration_t* b = parallel.program.items[i];
+    same = a->type == b->type && a->source_pos == b->source_pos &&
+      ast_count_nodes(a) == ast_count_nodes(b);
+  }
+  ct_assert(same, "declarations should come out in source order");
+  ct_assert_eq((int) parallel.diagnostics_len, 0, "nothing should be reported");
+
+  free_parsed_module(&serial);
+  free_parsed_module(&parallel);
+  free(source);
+}
+
+ct_test(ast, parallel_parse_replays_diagnostics, "")
+{
+  char* source = generate_module(3000, "struct v9 { int a int b; }");
+  parsed_module_t serial, parallel;
+  parse_module(&serial, source, 1);
+  parse_module(&parallel, source, 4);
+
+  ct_assert((serial.ok && parallel.ok), "a missing ';' between members should not stop the parse");
+  ct_assert((serial.diagnostics_len > 0), "the missing ';' should be reported");
+  ct_assert((parallel.diagnostics_len == serial.diagnostics_len &&
+      memcmp(parallel.diagnostics, serial.diagnostics, serial.diagnostics_len) == 0),
+      "diagnostics should match the serial parse");
+
+  free_parsed_module(&serial);
+  free_parsed_module(&parallel);
+  free(source);
+}
+
+ct_test(ast, parallel_parse_error_matches_serial, "")
+{
+  // v5 is only a type after its declaration
+  char* source = generate_module(3000, "fn early(v5 a): int { return 0; } struct v5 { int a; }");
+  parsed_module_t serial, parallel;
+  parse_module(&serial, source, 1);
+  parse_module(&parallel, source, 4);
+
+  ct_assert((!serial.ok && !parallel.ok), "using a type before its declaration should fail");
+  ct_assert((serial.diagnostics_len > 0), "the error should be reported");
+  ct_assert((parallel.diagnostics_len == serial.diagnostics_len &&
+      memcmp(parallel.diagnostics, serial.diagnostics, serial.diagnostics_len) == 0),
+      "errors should match the serial parse");
+
+  free_parsed_module(&serial);
+  free_parsed_module(&parallel);
+  free(source);
+}
+
+// === DEFERRED BODIES TESTS ===
+
+static bool parse_body_from_source(parser_t* p, declaration_t* d)
+{
+  char storage[255];
+  lexer_t lex;
+  if (d->func.body_start)
+    lexer_init_lexer(&lex, d->func.body_start, d->func.body_end, storage, sizeof(storage));
+  return ast_parse_function_body(p, d, test_lexer_source, &lex);
+}
+
+ct_test(ast, deferred_body_is_parsed_on_demand, "fn main(): int { var a = 1; if (a == 1) { return a; } return 0; } fn g() {}")
+{
+  parser.defer_bodies = true;
+  declaration_t* main_decl = parse_declaration(&parser);
+  declaration_t* g_decl = parse_declaration(&parser);
+
+  ct_assert_not_null(g_decl, "declaration after a skipped body should parse");
+  ct_assert_null(main_decl->func.body, "body should not be parsed yet");
+  ct_assert_not_null(main_decl->func.body_start, "body source should be recorded");
+  ct_assert_eq((int) ast_count_nodes(main_decl), 1, "only the declaration should exist");
+
+  ct_assert(parse_body_from_source(&parser, main_decl), "deferred body should parse");
+  ct_assert_not_null(main_decl->func.body, "body should be parsed");
+  ct_assert_null(main_decl->func.body_start, "body should no longer be deferred");
+  ct_assert_eq((int) main_decl->func.body->count, 3, "body should have 3 statements");
+  ct_assert_eq(main_decl->func.body->items[1]->type, STATEMENT_IF, "second statement should be the if");
+  ct_assert(parse_body_from_source(&parser, main_decl), "parsing a body twice should do nothing");
+
+  ct_assert(parse_body_from_source(&parser, g_decl), "empty body should parse");
+  ct_assert_not_null(g_decl->func.body, "empty body should be parsed");
+  ct_assert_eq((int) g_decl->func.body->count, 0, "empty body should have no statement");
+
+  parser_free_ast(&parser);
+  da_free(&parser);
+}
+
+ct_test(ast, deferred_body_sees_earlier_types_only, "struct v1 { int a; } fn f(): int { v1 a = { 0 }; v2 b = { 0 }; return 0; } struct v2 { int b; }")
+{
+  parser.defer_bodies = true;
+  parse_declaration(&parser);
+  declaration_t* f = parse_declaration(&parser);
+  declaration_t* v2 = parse_declaration(&parser);
+
+  ct_assert_not_null(f, "function with a skipped body should parse");
+  ct_assert_not_null(v2, "struct after the function should parse");
+  ct_assert(!parse_body_from_source(&parser, f), "type declared after the function should stay unknown in its body");
+
+  parser_free_ast(&parser);
+  da_free(&parser);
+}
+
+// === DIAGNOSTIC LOCATION TESTS ===
+
+ct_test(ast, line_table_matches_scan, "")
+{
+  // lines both shorter and longer than a 16 byte block, and an empty one
+  const char* source =
+    "fn main(): int {\n"
+    "\n"
+    "  var a_rather_long_name_spanning_blocks = 1;\n"
+    "  return a;\n"
+    "}";
+  error_context_t ctx;
+  error_init(&ctx, "lines.clf", source, strlen(source));
+
+  ct_assert_eq((int) ctx.line_count, 5, "every line should be indexed");
+  bool same = true;
+  for (const char* p = source; p <= source + strlen(source); ++p) {
+    int line, column, scan_line, scan_column;
+    error_context_location(&ctx, p, &line, &column);
+    error_get_location(source, p, &scan_line, &scan_column);
+    if (line != scan_line || column != scan_column) same = false;
+  }
+  ct_assert(same, "table lookup should match a scan from the start");
+
+  error_free(&ctx);
+}
@@ -15,25 +15,28 @@
 #include "../src/compiler/build/registry.h"
 #include "../src/compiler/build/export_table.h"
 #include "../src/compiler/build/import_resolver.h"
+#include "../src/compiler/build/build_cache.h"
+#include "../src/compiler/build/process_pool.h"
+#include "../src/compiler/build/session.h"
+#include "../src/compiler/build/dep_graph.h"
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 // Loads and parses a single .clf file into a fresh module_unit_t. `path`
 // must outlive the returned unit (it is not duplicated, mirroring how
 // module_unit_t.file_path is a borrowed pointer in the real compiler).
 static module_unit_t* load_module_unit(const char* path)
 {
-  FILE* f = fopen(path, "rb");
-  if (!f) {
-    fprintf(stderr, "error opening test file '%s'\n", path);
-    abort();
-  }
-
   module_unit_t* unit = calloc(1, sizeof(module_unit_t));
   if (!unit) abort();
 
+  if (!module_unit_load_source(unit, path, false)) {
+    fprintf(stderr, "error opening test file '%s'\n", path);
+    abort();
+  }
   unit->file_path = (char*) path;
-  unit->source = malloc(1 << 20);
-  unit->source_len = (int) fread(unit->source, 1, 1 << 20, f);
-  fclose(f);
 
   error_init(&unit->error_ctx, path, unit->source, unit->source_len);
   unit->parser.error_ctx = &unit->error_ctx;
@@ -50,7 +53,7 @@ static module_unit_t* load_module_unit(const char* path)
   }
   free(lex.string_storage);
 
-  unit->parser.types = calloc(1, sizeof(known_type_array));
+  unit->parser.types = calloc(1, sizeof(type_registry_t));
   populate_parser_known_type(unit->parser.types);
 
   while ((size_t) unit->parser.pos < unit->parser.count) {
@@ -69,11 +72,18 @@ typedef struct {
   semantic_analyzer_t  analyzer;
 } build_test_ctx_t;
 
+// Loads `dep_path` and `main_path` and analyzes the main module against
+// the other. Tests of the build machinery that need no analyzed module
+// pass NULL paths and get an empty context.
 before_each(build_test_ctx_t, tctx, char* dep_path, char* main_path)
 {
   build_test_ctx_t t = {0};
+  if (!dep_path || !main_path) {
+    tctx = t;
+    return;
+  }
 
-  t.ctx.registry = calloc(1, sizeof(hashmap_t));
+  t.ctx.registry = calloc(1, sizeof(atom_map_t));
   if (!t.ctx.registry) abort();
 
   t.dep_unit  = load_module_unit(dep_path);
@@ -87,6 +97,7 @@ before_each(build_test_ctx_t, tctx, char* dep_path, char* main_path)
 
   t.analyzer.error_ctx = &t.main_unit->error_ctx;
   t.analyzer.ast = &t.main_unit->program;
+  t.analyzer.types = t.main_unit->parser.types;
 
   semantic_resolve_imports(&t.ctx, t.main_unit, &t.analyzer);
   semantic_analyze(&t.analyzer);
@@ -130,6 +141,15 @@ ct_test(build_import, alias_call_resolves,
   free_build_test_ctx(&tctx);
 }
 
+ct_test(build_import, duplicate_import_errors,
+    "test/build_case/math_ok.clf",
+    "test/build_case/main_duplicate_import.clf")
+{
+  ct_assert((tctx.analyzer.error_count > 0),
+      "importing the same name twice should error");
+  free_build_test_ctx(&tctx);
+}
+
 ct_test(build_import, unknown_module_errors,
     "test/build_case/math_ok.clf",
     "test/build_case/main_unknown_module.clf")
@@ -166,3 +186,225 @@ ct_test(build_import, qualifier_mismatch_errors,
       "module should error");
   free_build_test_ctx(&tctx);
 }
+
+// Key of `main_unit` once its only dependency is swapped for the module
+// parsed from `dep_path`
+static uint64_t cache_key_with_dep(build_test_ctx_t* t, const char* dep_path)
+{
+  module_unit_t* dep = load_module_unit(dep_path);
+  if (!semantic_build_export_table(dep)) abort();
+
+  t->main_unit->deps.count = 0;
+  da_append(&t->main_unit->deps, dep);
+  uint64_t key =
+    build_cache_key(t->main_unit, "built-in", build_cache_compiler_id());
+
+  t->main_unit->deps.count = 0;
+  module_unit_free(dep);
+  return key;
+}
+
+ct_test(build_cache, key_ignores_dep_bodies,
+    "test/build_case/math_ok.clf",
+    "test/build_case/main_bare_call_ok.clf")
+{
+  uint64_t before = cache_key_with_dep(&tctx, "test/build_case/math_ok.clf");
+  uint64_t after =
+    cache_key_with_dep(&tctx, "test/build_case/math_body_changed.clf");
+
+  ct_assert((before == after),
+      "changing the body of an imported function should not invalidate "
+      "the importer");
+  free_build_test_ctx(&tctx);
+}
+
+ct_test(build_cache, key_tracks_dep_signatures,
+    "test/build_case/math_ok.clf",
+    "test/build_case/main_bare_call_ok.clf")
+{
+  uint64_t before = cache_key_with_dep(&tctx, "test/build_case/math_ok.clf");
+  uint64_t after =
+    cache_key_with_dep(&tctx, "test/build_case/math_signature_changed.clf");
+
+  ct_assert((before != after),
+      "changing the signature of an imported function should invalidate "
+      "the importer");
+  free_build_test_ctx(&tctx);
+}
+
+ct_test(build_cache, other_compiler_misses,
+    "test/build_case/math_ok.clf",
+    "test/build_case/main_bare_call_ok.clf")
+{
+  const char* base = "build_test_compiler_id";
+  FILE* obj = fopen("build/build_test_compiler_id.o", "wb");
+  if (!obj) abort();
+  fclose(obj);
+
+  uint64_t id = build_cache_compiler_id();
+  ct_assert((build_cache_compiler_id() == id),
+      "the compiler identity is stable within a run");
+
+  uint64_t key = build_cache_key(tctx.main_unit, "built-in", id);
+  ct_assert((build_cache_store(base, key)), "the key is stored");
+  ct_assert((build_cache_lookup(base,
+          build_cache_key(tctx.main_unit, "built-in", id))),
+      "the same compiler hits the cache");
+  ct_assert((!build_cache_lookup(base,
+          build_cache_key(tctx.main_unit, "built-in", id + 1))),
+      "another compiler misses the objects of this one");
+
+  build_cache_invalidate(base);
+  remove("build/build_test_compiler_id.o");
+  free_build_test_ctx(&tctx);
+}
+
+ct_test(process_pool, jobs_reported_in_index_order, NULL, NULL)
+{
+  process_pool_t pool;
+  process_pool_init(&pool, 2);
+
+  const char* slow[] = { "sh", "-c", "sleep 0.1; echo slow >&2; exit 3", NULL };
+  const char* fast[] = { "sh", "-c", "echo fast >&2", NULL };
+  process_pool_submit(&pool, slow, 1);
+  process_pool_submit(&pool, fast, 0);
+  process_pool_wait(&pool);
+
+  ct_assert_eq((int) pool.count, 2, "both jobs are recorded");
+  ct_assert_eq((int) pool.items[0]->index, 0, "jobs are sorted by index");
+  ct_assert_eq(pool.items[0]->exit_status, 0, "exit status is collected");
+  ct_assert_eq(pool.items[1]->exit_status, 3, "failures keep their status");
+  ct_assert((pool.items[1]->err_len == 5 &&
+        memcmp(pool.items[1]->err, "slow\n", 5) == 0),
+      "stderr is captured per job");
+
+  process_pool_free(&pool);
+}
+
+static int session_loads = 0;
+
+static module_unit_t* count_session_load(char* path)
+{
+  session_loads++;
+  return load_module_unit(path);
+}
+
+static void write_test_source(const char* path, const char* text)
+{
+  FILE* f = fopen(path, "wb");
+  if (!f) abort();
+  fputs(text, f);
+  fclose(f);
+}
+
+ct_test(build_session, reparses_changed_files_only, NULL, NULL)
+{
+  char path[] = "/tmp/cleaf_session_XXXXXX.clf";
+  int fd = mkstemps(path, 4);
+  if (fd < 0) abort();
+  close(fd);
+  write_test_source(path, "module main\n\ninternal fn main(): int { return 0; }\n");
+
+  compiled_files_array files = {0};
+  da_append(&files, path);
+  build_session_t session = {0};
+
+  ct_assert_eq((int) build_session_refresh(&session, &files, count_session_load),
+      1, "a new file is loaded");
+  module_unit_t* first = session.items[0].unit;
+  ct_assert_eq((int) build_session_refresh(&session, &files, count_session_load),
+      0, "an untouched file is kept");
+
+  // same bytes, newer mtime
+  struct timespec times[2] = {
+    { .tv_nsec = UTIME_OMIT },
+    { .tv_sec = session.items[0].mtime.tv_sec + 10 },
+  };
+  utimensat(AT_FDCWD, path, times, 0);
+  ct_assert_eq((int) build_session_refresh(&session, &files, count_session_load),
+      0, "a file saved without changes is kept");
+  ct_assert((session.items[0].unit == first), "the kept unit is the same");
+
+  write_test_source(path, "module main\n\ninternal fn main(): int { return 1; }\n");
+  times[1].tv_sec += 10;
+  utimensat(AT_FDCWD, path, times, 0);
+  ct_assert_eq((int) build_session_refresh(&session, &files, count_session_load),
+      1, "a modified file is reparsed");
+  ct_assert_eq(session_loads, 2, "only new and modified files are loaded");
+  ct_assert((session.items[0].unit->file_path == session.items[0].path),
+      "the unit borrows the session path");
+
+  files.count = 0;
+  ct_assert_eq((int) build_session_refresh(&session, &files, count_session_load),
+      1, "a vanished file is dropped");
+  ct_assert_eq((int) session.count, 0, "nothing is left in the session");
+
+  build_session_free(&session);
+  da_free(&files);
+  unlink(path);
+}
+
+ct_test(build_session, owned_source_survives_rewrite, NULL, NULL)
+{
+  char path[] = "/tmp/cleaf_source_XXXXXX.clf";
+  int fd = mkstemps(path, 4);
+  if (fd < 0) abort();
+  close(fd);
+  const char* text = "module main\n\ninternal fn main(): int { return 0; }\n";
+  write_test_source(path, text);
+
+  module_unit_t* mapped = calloc(1, sizeof(module_unit_t));
+  module_unit_t* owned = calloc(1, sizeof(module_unit_t));
+  module_unit_t* reread = calloc(1, sizeof(module_unit_t));
+  if (!mapped || !owned || !reread) abort();
+
+  ct_assert((module_unit_load_source(mapped, path, false)), "the source is mapped");
+  ct_assert((module_unit_load_source(owned, path, true)), "the source is read");
+  ct_assert((owned->source_map_len == 0), "an owned source is not a mapping");
+  ct_assert((owned->source_len == mapped->source_len &&
+        memcmp(owned->source, mapped->source, mapped->source_len) == 0),
+      "both hold the bytes of the file");
+  ct_assert((owned->source[owned->source_len] == '\0'), "a NUL follows the owned source");
+
+  // rewritten in place, shorter: the copy is left as it was
+  write_test_source(path, "x");
+  ct_assert((owned->source_len == strlen(text) &&
+        memcmp(owned->source, text, owned->source_len) == 0),
+      "the owned source does not follow the file");
+
+  ct_assert((module_unit_load_source(reread, path, true)), "the new file is read");
+  ct_assert_eq((int) reread->source_len, 1, "the new size is read");
+
+  module_unit_free(mapped);
+  module_unit_free(owned);
+  module_unit_free(reread);
+  unlink(path);
+}
+
+ct_test(dep_graph, marks_dependents_of_changed_modules, NULL, NULL)
+{
+  // the graph only needs the parsed modules in the registry
+  build_context_t ctx = {0};
+  ctx.registry = calloc(1, sizeof(atom_map_t));
+  if (!ctx.registry) abort();
+  module_unit_t* dep = load_module_unit("test/build_case/math_ok.clf");
+  module_unit_t* importer = load_module_unit("test/build_case/main_bare_call_ok.clf");
+  if (!populate_module_registry(&ctx, dep)) abort();
+  if (!populate_module_registry(&ctx, importer)) abort();
+
+  ct_assert(build_dep_graph(&ctx), "the graph should build");
+  ct_assert_eq((int) ctx.count, 2, "both modules are ordered");
+  ct_assert((ctx.items[0] == dep), "the imported module comes first");
+
+  bool dep_changed[2] = { true, false };
+  dep_graph_mark_dependents(&ctx, dep_changed);
+  ct_assert((dep_changed[1]), "the importer of a changed module is marked");
+
+  bool main_changed[2] = { false, true };
+  dep_graph_mark_dependents(&ctx, main_changed);
+  ct_assert((!main_changed[0]), "imported modules are left alone");
+
+  module_unit_free(dep);
+  module_unit_free(importer);
+  build_context_free(&ctx);
+}
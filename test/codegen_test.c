@@ -13,11 +13,38 @@
 #include "../src/middleend/hir.h"
 #include "../src/backend/codegen.h"
 #include "../src/backend/x86_64_definition.h"
+#include "../src/backend/x86_64_encoder.h"
 #include "../src/thirdparty/error.h"
 #include "../src/thirdparty/string_builder.h"
 
 typedef struct { int n; } chunk_counter_t;
 
+// 0 when the object target encodes exactly what the built-in assembler
+// makes of the expected asm, i.e. what `--nasm` would have assembled
+static int object_result;
+
+// Assembles the expected NASM text one line at a time
+static void assemble_expected(object_file_t* obj, char* text)
+{
+  char* line = text;
+  while (line && *line) {
+    char* next = strchr(line, '\n');
+    if (next) *next = '\0';
+    x86_assemble_line(obj, line);
+    if (next) *next = '\n';
+    line = next ? next + 1 : NULL;
+  }
+  object_finalize(obj);
+}
+
+static int compare_objects(object_file_t* a, object_file_t* b)
+{
+  if (a->failed || b->failed) return 1;
+  if (a->text.count != b->text.count) return 1;
+  if (a->relocs.count != b->relocs.count) return 1;
+  return memcmp(a->text.items, b->text.items, a->text.count);
+}
+
 static void counter_chunk_gen(void* ctx, char* out)
 {
   chunk_counter_t* c = (chunk_counter_t*)ctx;
@@ -62,7 +89,7 @@ before_each(int, result, char* file_path, char* expected_path)
   free(storage);
 
   // --- Parse ---
-  p.types = calloc(1, sizeof(known_type_array));
+  p.types = calloc(1, sizeof(type_registry_t));
   populate_parser_known_type(p.types);
 
   declaration_array* program = calloc(1, sizeof(declaration_array));
@@ -78,8 +105,8 @@ before_each(int, result, char* file_path, char* expected_path)
 
   free(text);
   for (size_t i = 0; i < p.count; i++) {
-    if (p.items[i].string_value)
-      free(p.items[i].string_value);
+    if (p.items[i].owned)
+      free(p.items[i].owned);
   }
   da_free(&p);
 
@@ -87,6 +114,7 @@ before_each(int, result, char* file_path, char* expected_path)
   semantic_analyzer_t analyzer = {0};
   analyzer.error_ctx = error_ctx;
   analyzer.ast = program;
+  analyzer.types = p.types;
   semantic_analyze(&analyzer);
   if (analyzer.error_count > 0) {
     fprintf(stderr, "semantic error(s) in: %s\n", file_path);
@@ -101,6 +129,7 @@ before_each(int, result, char* file_path, char* expected_path)
   hir_parser.error_ctx = error_ctx;
   hir_parser.hir_program = hir_program;
   hir_parser.struct_symbols = analyzer.struct_symbols;
+  hir_parser.flat = &analyzer.flat;
   chunk_counter_t chunk_counter = {0};
   hir_parser.gen_chunk = counter_chunk_gen;
   hir_parser.chunk_ctx = &chunk_counter;
@@ -121,6 +150,15 @@ before_each(int, result, char* file_path, char* expected_path)
     }
   }
 
+  object_file_t encoded = {0};
+  da_foreach(IR_function_t*, it, hir_parser.hir_program) {
+    if (CODEGEN_write_function(&encoded.text, *it, &x86_64_object_target) != 0) {
+      fprintf(stderr, "object codegen error in: %s\n", file_path);
+      abort();
+    }
+  }
+  object_finalize(&encoded);
+
   // --- Cleanup IR & AST ---
   da_foreach(IR_function_t*, it, hir_program) {
     IR_free_function(*it);
@@ -130,11 +168,10 @@ before_each(int, result, char* file_path, char* expected_path)
 
   semantic_free_program_definition(&analyzer);
 
-  da_foreach(declaration_t*, it, program) {
-    free_declaration(*it);
-  }
+  parser_free_ast(&p);
   da_free(program);
   free(program);
+  error_free(error_ctx);
   free(error_ctx);
 
   // --- Read expected asm file ---
@@ -158,142 +195,182 @@ before_each(int, result, char* file_path, char* expected_path)
   // --- Compare ---
   result = strcmp(expected, sb.items);
 
+  object_file_t assembled = {0};
+  assemble_expected(&assembled, expected);
+  object_result = compare_objects(&encoded, &assembled);
+  object_file_free(&encoded);
+  object_file_free(&assembled);
+
   free(expected);
   da_free(&sb);
 }
 
 ct_test(codegen_test, return_stmt, "test/codegen_case/return_stmt.clf", "test/codegen_case/return_stmt.asm") {
   ct_assert_eq(result, 0, "codegen gives right output");
+  ct_assert_eq(object_result, 0, "object target matches the expected asm");
 }
 
 ct_test(codegen_test, simple_binary, "test/codegen_case/simple_binary.clf", "test/codegen_case/simple_binary.asm") {
   ct_assert_eq(result, 0, "codegen gives right output");
+  ct_assert_eq(object_result, 0, "object target matches the expected asm");
 }
 
 ct_test(codegen_test, nested_binary, "test/codegen_case/nested_binary.clf", "test/codegen_case/nested_binary.asm") {
   ct_assert_eq(result, 0, "codegen gives right output");
+  ct_assert_eq(object_result, 0, "object target matches the expected asm");
 }
 
 ct_test(codegen_test, basic_var_decl, "test/codegen_case/basic_var_decl.clf", "test/codegen_case/basic_var_decl.asm") {
   ct_assert_eq(result, 0, "codegen gives right output");
+  ct_assert_eq(object_result, 0, "object target matches the expected asm");
 }
 
 ct_test(codegen_test, initialized_var_decl, "test/codegen_case/initialized_var_decl.clf", "test/codegen_case/initialized_var_decl.asm") {
   ct_assert_eq(result, 0, "codegen gives right output");
+  ct_assert_eq(object_result, 0, "object target matches the expected asm");
 }
 
 ct_test(codegen_test, expression_init_var_decl, "test/codegen_case/expression_init_var_decl.clf", "test/codegen_case/expression_init_var_decl.asm") {
   ct_assert_eq(result, 0, "codegen gives right output");
+  ct_assert_eq(object_result, 0, "object target matches the expected asm");
 }
 
 ct_test(codegen_test, var_loading, "test/codegen_case/var_loading.clf", "test/codegen_case/var_loading.asm") {
   ct_assert_eq(result, 0, "codegen gives right output");
+  ct_assert_eq(object_result, 0, "object target matches the expected asm");
 }
 
 ct_test(codegen_test, unary_op, "test/codegen_case/unary_op.clf", "test/codegen_case/unary_op.asm") {
   ct_assert_eq(result, 0, "codegen gives right output");
+  ct_assert_eq(object_result, 0, "object target matches the expected asm");
 }
 
 ct_test(codegen_test, basic_if, "test/codegen_case/basic_if.clf", "test/codegen_case/basic_if.asm") {
   ct_assert_eq(result, 0, "codegen gives right output");
+  ct_assert_eq(object_result, 0, "object target matches the expected asm");
 }
 
 ct_test(codegen_test, if_else, "test/codegen_case/if_else.clf", "test/codegen_case/if_else.asm") {
   ct_assert_eq(result, 0, "codegen gives right output");
+  ct_assert_eq(object_result, 0, "object target matches the expected asm");
 }
 
 ct_test(codegen_test, all_comparison_if, "test/codegen_case/all_comparison_if.clf", "test/codegen_case/all_comparison_if.asm") {
   ct_assert_eq(result, 0, "codegen gives right output");
+  ct_assert_eq(object_result, 0, "object target matches the expected asm");
 }
 
 ct_test(codegen_test, while_stmt, "test/codegen_case/while_stmt.clf", "test/codegen_case/while_stmt.asm") {
   ct_assert_eq(result, 0, "codegen gives right output");
+  ct_assert_eq(object_result, 0, "object target matches the expected asm");
 }
 
 ct_test(codegen_test, for_stmt, "test/codegen_case/for_stmt.clf", "test/codegen_case/for_stmt.asm") {
   ct_assert_eq(result, 0, "codegen gives right output");
+  ct_assert_eq(object_result, 0, "object target matches the expected asm");
 }
 
 ct_test(codegen_test, call, "test/codegen_case/call.clf", "test/codegen_case/call.asm") {
   ct_assert_eq(result, 0, "codegen gives right output");
+  ct_assert_eq(object_result, 0, "object target matches the expected asm");
 }
 
 ct_test(codegen_test, struct_var_allocation, "test/codegen_case/struct_var_allocation.clf", "test/codegen_case/struct_var_allocation.res") {
   ct_assert_eq(result, 0, "hit parsing give right output");
+  ct_assert_eq(object_result, 0, "object target matches the expected asm");
 }
 
 ct_test(codegen_test, struct_var_designated_init, "test/codegen_case/struct_var_designated_init.clf", "test/codegen_case/struct_var_designated_init.res") {
   ct_assert_eq(result, 0, "codegen gives right output for designated struct initializer");
+  ct_assert_eq(object_result, 0, "object target matches the expected asm");
 }
 
 ct_test(codegen_test, struct_var_designated_init_reordered, "test/codegen_case/struct_var_designated_init_reordered.clf", "test/codegen_case/struct_var_designated_init_reordered.asm") {
   ct_assert_eq(result, 0, "codegen gives right output for reordered designated struct initializer");
+  ct_assert_eq(object_result, 0, "object target matches the expected asm");
 }
 
 ct_test(codegen_test, struct_member_access_first, "test/codegen_case/struct_member_access_first.clf", "test/codegen_case/struct_member_access_first.asm") {
   ct_assert_eq(result, 0, "codegen gives right output for struct member access return (first member, offset 0)");
+  ct_assert_eq(object_result, 0, "object target matches the expected asm");
 }
 
 ct_test(codegen_test, struct_member_access_second, "test/codegen_case/struct_member_access_second.clf", "test/codegen_case/struct_member_access_second.asm") {
   ct_assert_eq(result, 0, "codegen gives right output for struct member access return (second member, offset 8)");
+  ct_assert_eq(object_result, 0, "object target matches the expected asm");
 }
 
 ct_test(codegen_test, int_binary_typed, "test/codegen_case/int_binary_typed.clf", "test/codegen_case/int_binary_typed.asm") {
   ct_assert_eq(result, 0, "codegen uses 32-bit registers (r11d) for int binary ops");
+  ct_assert_eq(object_result, 0, "object target matches the expected asm");
 }
 
 ct_test(codegen_test, u8_u16_u64_vars, "test/codegen_case/u8_u16_u64_vars.clf", "test/codegen_case/u8_u16_u64_vars.asm") {
   ct_assert_eq(result, 0, "codegen falls back to 64-bit registers for u8/u16/u64");
+  ct_assert_eq(object_result, 0, "object target matches the expected asm");
 }
 
 ct_test(codegen_test, asm_no_args, "test/codegen_case/asm_no_args.clf", "test/codegen_case/asm_no_args.asm") {
   ct_assert_eq(result, 0, "codegen gives right output for asm with no args");
+  ct_assert_eq(object_result, 0, "object target matches the expected asm");
 }
 
 ct_test(codegen_test, asm_with_arg, "test/codegen_case/asm_with_arg.clf", "test/codegen_case/asm_with_arg.asm") {
   ct_assert_eq(result, 0, "codegen gives right output for asm with variable interpolation");
+  ct_assert_eq(object_result, 0, "object target matches the expected asm");
 }
 
 ct_test(codegen_test, char_var_declaration, "test/codegen_case/char_var_declaration.clf", "test/codegen_case/char_var_declaration.asm") {
   ct_assert_eq(result, 0, "codegen gives right output for char var declaration");
+  ct_assert_eq(object_result, 0, "object target matches the expected asm");
 }
 
 ct_test(codegen_test, free_stmt, "test/codegen_case/free_stmt.clf", "test/codegen_case/free_stmt.asm") {
   ct_assert_eq(result, 0, "codegen gives right output for free statement");
+  ct_assert_eq(object_result, 0, "object target matches the expected asm");
 }
 
 ct_test(codegen_test, array_u8_init, "test/codegen_case/array_u8_init.clf", "test/codegen_case/array_u8_init.asm") {
   ct_assert_eq(result, 0, "codegen gives right output for u8 array with initializer");
+  ct_assert_eq(object_result, 0, "object target matches the expected asm");
 }
 
 ct_test(codegen_test, array_int_init, "test/codegen_case/array_int_init.clf", "test/codegen_case/array_int_init.asm") {
   ct_assert_eq(result, 0, "codegen gives right output for int array with initializer");
+  ct_assert_eq(object_result, 0, "object target matches the expected asm");
 }
 
 ct_test(codegen_test, array_no_init, "test/codegen_case/array_no_init.clf", "test/codegen_case/array_no_init.asm") {
   ct_assert_eq(result, 0, "codegen gives right output for array declaration without initializer");
+  ct_assert_eq(object_result, 0, "object target matches the expected asm");
 }
 
 ct_test(codegen_test, array_int_index_literal, "test/codegen_case/array_int_index_literal.clf", "test/codegen_case/array_int_index_literal.asm") {
   ct_assert_eq(result, 0, "codegen gives right output for int array access with literal index 0");
+  ct_assert_eq(object_result, 0, "object target matches the expected asm");
 }
 
 ct_test(codegen_test, array_int_index_nonzero, "test/codegen_case/array_int_index_nonzero.clf", "test/codegen_case/array_int_index_nonzero.asm") {
   ct_assert_eq(result, 0, "codegen gives right output for int array access with non-zero literal index");
+  ct_assert_eq(object_result, 0, "object target matches the expected asm");
 }
 
 ct_test(codegen_test, array_u8_index_literal, "test/codegen_case/array_u8_index_literal.clf", "test/codegen_case/array_u8_index_literal.asm") {
   ct_assert_eq(result, 0, "codegen gives right output for u8 array access (element_size=1, imul by 1)");
+  ct_assert_eq(object_result, 0, "object target matches the expected asm");
 }
 
 ct_test(codegen_test, array_index_var_index, "test/codegen_case/array_index_var_index.clf", "test/codegen_case/array_index_var_index.asm") {
   ct_assert_eq(result, 0, "codegen gives right output for array access with variable index");
+  ct_assert_eq(object_result, 0, "object target matches the expected asm");
 }
 
 ct_test(codegen_test, array_index_as_var, "test/codegen_case/array_index_as_var.clf", "test/codegen_case/array_index_as_var.asm") {
   ct_assert_eq(result, 0, "codegen gives right output for array index result stored in a variable");
+  ct_assert_eq(object_result, 0, "object target matches the expected asm");
 }
 
 ct_test(codegen_test, array_elem_assign, "test/codegen_case/array_elem_assign.clf", "test/codegen_case/array_elem_assign.asm") {
   ct_assert_eq(result, 0, "codegen gives right output for array element assignment");
+  ct_assert_eq(object_result, 0, "object target matches the expected asm");
 }
@@ -0,0 +1,230 @@
+// Insert and lookup time of hashmap_t against the chained 211 bucket map
+// it replaced, on identifiers sharing a long prefix.
+// Usage: hashmap_bench [key count]
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "../src/thirdparty/hashmap.h"
+
+#define BENCH_KEYS 100000
+#define BENCH_RUNS 5
+
+// --- previous implementation, kept for comparison ---
+
+#define LEGACY_HASH_SIZE 211
+
+typedef struct legacy_entry_t
+{
+  char* key;
+  void* value;
+  struct legacy_entry_t* next;
+} legacy_entry_t;
+
+typedef struct
+{
+  legacy_entry_t* buckets[LEGACY_HASH_SIZE];
+} legacy_map_t;
+
+static unsigned legacy_hash(const char* s)
+{
+  unsigned h = 0;
+  while (*s)
+    h = (h << 4) + (unsigned char) *s++;
+  return h % LEGACY_HASH_SIZE;
+}
+
+static void legacy_put(legacy_map_t* map, const char* key, void* value)
+{
+  unsigned idx = legacy_hash(key);
+  legacy_entry_t* e = malloc(sizeof(*e));
+  if (!e) return;
+  e->key = strdup(key);
+  e->value = value;
+  e->next = map->buckets[idx];
+  map->buckets[idx] = e;
+}
+
+static void* legacy_get(legacy_map_t* map, const char* key)
+{
+  for (legacy_entry_t* e = map->buckets[legacy_hash(key)]; e; e = e->next) {
+    if (strcmp(key, e->key) == 0)
+      return e->value;
+  }
+  return NULL;
+}
+
+static void legacy_free(legacy_map_t* map)
+{
+  for (size_t i = 0; i < LEGACY_HASH_SIZE; ++i) {
+    legacy_entry_t* e = map->buckets[i];
+    while (e) {
+      legacy_entry_t* next = e->next;
+      free(e->key);
+      free(e);
+      e = next;
+    }
+    map->buckets[i] = NULL;
+  }
+}
+
+// --- benchmark ---
+
+static double now_seconds(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double) ts.tv_sec + (double) ts.tv_nsec / 1e9;
+}
+
+static char** make_keys(size_t count, const char* prefix)
+{
+  char** keys = malloc(count * sizeof(char*));
+  if (!keys) return NULL;
+  for (size_t i = 0; i < count; ++i) {
+    char buf[64];
+    snprintf(buf, sizeof(buf), "%s%zu", prefix, i);
+    keys[i] = strdup(buf);
+  }
+  return keys;
+}
+
+static void free_keys(char** keys, size_t count)
+{
+  for (size_t i = 0; i < count; ++i)
+    free(keys[i]);
+  free(keys);
+}
+
+typedef struct {
+  double insert;
+  double hit;
+  double miss;
+} bench_times_t;
+
+static void keep_best(bench_times_t* best, bench_times_t t, int run)
+{
+  if (run == 0 || t.insert < best->insert) best->insert = t.insert;
+  if (run == 0 || t.hit < best->hit) best->hit = t.hit;
+  if (run == 0 || t.miss < best->miss) best->miss = t.miss;
+}
+
+static bool bench_hashmap(char** keys, char** absent, size_t count, bench_times_t* out)
+{
+  hashmap_t map = {0};
+  bool ok = true;
+
+  double t0 = now_seconds();
+  for (size_t i = 0; i < count; ++i)
+    hashmap_put(&map, keys[i], (void*) (uintptr_t) (i + 1));
+  double t1 = now_seconds();
+  for (size_t i = 0; i < count; ++i)
+    ok = ok && (uintptr_t) hashmap_get(&map, keys[i]) == i + 1;
+  double t2 = now_seconds();
+  for (size_t i = 0; i < count; ++i)
+    ok = ok && hashmap_get(&map, absent[i]) == NULL;
+  double t3 = now_seconds();
+
+  // every other key removed, the rest must still be found
+  for (size_t i = 0; i < count; i += 2)
+    ok = ok && hashmap_remove(&map, keys[i]);
+  for (size_t i = 0; i < count; ++i) {
+    uintptr_t v = (uintptr_t) hashmap_get(&map, keys[i]);
+    ok = ok && v == (i % 2 ? i + 1 : 0);
+  }
+  ok = ok && map.count == count / 2;
+
+  hashmap_free(&map, 0);
+  *out = (bench_times_t) { t1 - t0, t2 - t1, t3 - t2 };
+  return ok;
+}
+
+static bool bench_legacy(char** keys, char** absent, size_t count, bench_times_t* out)
+{
+  legacy_map_t* map = calloc(1, sizeof(legacy_map_t));
+  if (!map) return false;
+  bool ok = true;
+
+  double t0 = now_seconds();
+  for (size_t i = 0; i < count; ++i)
+    legacy_put(map, keys[i], (void*) (uintptr_t) (i + 1));
+  double t1 = now_seconds();
+  for (size_t i = 0; i < count; ++i)
+    ok = ok && (uintptr_t) legacy_get(map, keys[i]) == i + 1;
+  double t2 = now_seconds();
+  for (size_t i = 0; i < count; ++i)
+    ok = ok && legacy_get(map, absent[i]) == NULL;
+  double t3 = now_seconds();
+
+  legacy_free(map);
+  free(map);
+  *out = (bench_times_t) { t1 - t0, t2 - t1, t3 - t2 };
+  return ok;
+}
+
+static bool check_merge(void)
+{
+  hashmap_t a = {0}, b = {0};
+  hashmap_put(&a, "shared", (void*) 1);
+  hashmap_put(&a, "only_a", (void*) 2);
+  hashmap_put(&b, "shared", (void*) 3);
+  hashmap_put(&b, "only_b", (void*) 4);
+
+  hashmap_t* m = hashmap_merge(&a, &b);
+  bool ok = m && m->count == 3 &&
+    (uintptr_t) hashmap_get(m, "shared") == 3 &&
+    (uintptr_t) hashmap_get(m, "only_a") == 2 &&
+    (uintptr_t) hashmap_get(m, "only_b") == 4;
+
+  hashmap_free(m, 0);
+  free(m);
+  hashmap_free(&a, 0);
+  hashmap_free(&b, 0);
+  return ok;
+}
+
+static void print_row(const char* name, bench_times_t t, size_t count)
+{
+  printf("%-10s %9.1f %9.1f %9.1f\n", name,
+      t.insert * 1e9 / (double) count,
+      t.hit * 1e9 / (double) count,
+      t.miss * 1e9 / (double) count);
+}
+
+int main(int argc, char** argv)
+{
+  size_t count = argc > 1 ? (size_t) strtoul(argv[1], NULL, 10) : BENCH_KEYS;
+  if (count == 0) count = BENCH_KEYS;
+
+  char** keys = make_keys(count, "semantic_analyzer_function_");
+  char** absent = make_keys(count, "semantic_analyzer_missing_");
+  if (!keys || !absent) {
+    fprintf(stderr, "cannot allocate the benchmark keys\n");
+    return 1;
+  }
+
+  bench_times_t best_map = {0}, best_legacy = {0};
+  bool ok = check_merge();
+  for (int run = 0; run < BENCH_RUNS; ++run) {
+    bench_times_t t;
+    ok = bench_hashmap(keys, absent, count, &t) && ok;
+    keep_best(&best_map, t, run);
+    ok = bench_legacy(keys, absent, count, &t) && ok;
+    keep_best(&best_legacy, t, run);
+  }
+
+  printf("%zu keys, ns per operation\n", count);
+  printf("%-10s %9s %9s %9s\n", "", "insert", "hit", "miss");
+  print_row("hashmap", best_map, count);
+  print_row("chained", best_legacy, count);
+  if (!ok)
+    printf("a lookup returned a wrong value\n");
+
+  free_keys(keys, count);
+  free_keys(absent, count);
+  return ok ? 0 : 1;
+}
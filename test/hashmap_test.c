@@ -0,0 +1,176 @@
+#define CTEST_LIB_IMPLEMENTATION
+#include "ctest.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "../src/thirdparty/hashmap.h"
+
+// Fills `keys` with `count` names whose home slot in a `capacity` table is
+// `home`, so they end up in one probe run
+static void colliding_keys(char keys[][16], size_t count, size_t capacity, size_t home)
+{
+  size_t found = 0;
+  for (size_t i = 0; found < count; ++i) {
+    char name[16];
+    snprintf(name, sizeof(name), "k%zu", i);
+    if ((hashmap_hash(name, strlen(name)) & (capacity - 1)) == home)
+      memcpy(keys[found++], name, sizeof(name));
+  }
+}
+
+ct_test(hashmap, grows_past_load_limit)
+{
+  hashmap_t map = {0};
+  size_t count = 1000;
+  bool put_ok = true;
+  for (size_t i = 0; i < count; ++i) {
+    char key[16];
+    snprintf(key, sizeof(key), "key%zu", i);
+    put_ok = hashmap_put(&map, key, (void*) (uintptr_t) (i + 1)) && put_ok;
+  }
+  ct_assert(put_ok, "every put should succeed");
+  ct_assert_eq((int) map.count, (int) count, "every key should be counted once");
+  ct_assert((map.count * 8 <= map.capacity * 7), "the table should stay under 7/8 full");
+  ct_assert(((map.capacity & (map.capacity - 1)) == 0), "the capacity should stay a power of two");
+
+  bool found = true;
+  for (size_t i = 0; i < count; ++i) {
+    char key[16];
+    snprintf(key, sizeof(key), "key%zu", i);
+    found = found && (uintptr_t) hashmap_get(&map, key) == i + 1;
+  }
+  ct_assert(found, "every key should be found after growing");
+  ct_assert_null(hashmap_get(&map, "key1000"), "an absent key should not be found");
+
+  hashmap_free(&map, 0);
+}
+
+ct_test(hashmap, remove_inside_collision_run)
+{
+  // 16 slots hold up to 14 entries, the table does not grow under the test
+  char keys[6][16];
+  colliding_keys(keys, 6, 16, 3);
+
+  hashmap_t map = {0};
+  for (size_t i = 0; i < 6; ++i)
+    hashmap_put(&map, keys[i], (void*) (uintptr_t) (i + 1));
+  ct_assert_eq((int) map.capacity, 16, "the table should not have grown");
+
+  ct_assert_eq(hashmap_remove(&map, keys[2]), 1, "removing a key in the run should succeed");
+  ct_assert_eq(hashmap_remove(&map, keys[2]), 0, "a removed key should not be removed twice");
+  ct_assert_null(hashmap_get(&map, keys[2]), "a removed key should not be found");
+
+  bool found = true;
+  for (size_t i = 0; i < 6; ++i) {
+    if (i != 2)
+      found = found && (uintptr_t) hashmap_get(&map, keys[i]) == i + 1;
+  }
+  ct_assert(found, "the rest of the run should still be found");
+  ct_assert_eq((int) map.count, 5, "the count should drop by one");
+
+  // backward shift leaves each entry at its probe distance, no gap inside
+  // the run
+  bool consistent = true;
+  hashmap_foreach(e, &map) {
+    size_t slot = (size_t) (e - map.items);
+    consistent = consistent && ((e->hash + e->dist) & (map.capacity - 1)) == slot;
+  }
+  ct_assert(consistent, "every entry should sit `dist` slots past its home");
+
+  hashmap_free(&map, 0);
+}
+
+ct_test(hashmap, put_replaces_existing_value)
+{
+  hashmap_t map = {0};
+  char key[] = "name";
+  hashmap_put(&map, key, (void*) 1);
+  // the map keeps its own copy of the key
+  key[0] = 'g';
+  hashmap_put(&map, "name", (void*) 2);
+
+  ct_assert_eq((int) map.count, 1, "a key put twice should be stored once");
+  ct_assert_eq((int) (uintptr_t) hashmap_get(&map, "name"), 2, "the later value should win");
+  ct_assert_null(hashmap_get(&map, "game"), "changing the caller's buffer should not change the key");
+
+  hashmap_free(&map, 0);
+}
+
+ct_test(hashmap, put_new_keeps_existing_value)
+{
+  hashmap_t map = {0};
+  ct_assert_eq(hashmap_put_new(&map, "name", (void*) 1), 1,
+      "a new key should be added");
+  ct_assert_eq(hashmap_put_new(&map, "name", (void*) 2), 2,
+      "a mapped key should be reported");
+
+  ct_assert_eq((int) map.count, 1, "a key put twice should be stored once");
+  ct_assert_eq((int) (uintptr_t) hashmap_get(&map, "name"), 1, "the first value should stay");
+
+  hashmap_free(&map, 0);
+}
+
+ct_test(hashmap, foreach_visits_each_entry_once)
+{
+  hashmap_t map = {0};
+  size_t visits[100] = {0};
+  for (size_t i = 0; i < 100; ++i) {
+    char key[16];
+    snprintf(key, sizeof(key), "entry%zu", i);
+    hashmap_put(&map, key, (void*) (uintptr_t) i);
+  }
+  for (size_t i = 0; i < 100; i += 3) {
+    char key[16];
+    snprintf(key, sizeof(key), "entry%zu", i);
+    hashmap_remove(&map, key);
+  }
+
+  size_t seen = 0;
+  hashmap_foreach(e, &map) {
+    visits[(uintptr_t) e->value]++;
+    seen++;
+  }
+
+  bool once = true;
+  for (size_t i = 0; i < 100; ++i)
+    once = once && visits[i] == (i % 3 ? 1u : 0u);
+  ct_assert(once, "each remaining entry should be visited once, removed ones never");
+  ct_assert_eq((int) seen, (int) map.count, "foreach should visit `count` entries");
+
+  hashmap_t empty = {0};
+  size_t empty_seen = 0;
+  hashmap_foreach(e, &empty) empty_seen++;
+  ct_assert_eq((int) empty_seen, 0, "a zeroed map should have nothing to visit");
+
+  hashmap_free(&map, 0);
+}
+
+ct_test(hashmap, merge_prefers_second_map)
+{
+  hashmap_t a = {0}, b = {0};
+  hashmap_put(&a, "shared", (void*) 1);
+  hashmap_put(&a, "only_a", (void*) 2);
+  hashmap_put(&b, "shared", (void*) 3);
+  hashmap_put(&b, "only_b", (void*) 4);
+
+  hashmap_t* m = hashmap_merge(&a, &b);
+  ct_assert_not_null(m, "merge should succeed");
+  ct_assert_eq((int) m->count, 3, "a shared key should be stored once");
+  ct_assert_eq((int) (uintptr_t) hashmap_get(m, "shared"), 3, "the second map should win");
+  ct_assert_eq((int) (uintptr_t) hashmap_get(m, "only_a"), 2, "keys of the first map should be kept");
+  ct_assert_eq((int) (uintptr_t) hashmap_get(m, "only_b"), 4, "keys of the second map should be kept");
+  ct_assert_eq((int) (uintptr_t) hashmap_get(&a, "shared"), 1, "the sources should be left as is");
+
+  hashmap_t* only = hashmap_merge(NULL, &b);
+  ct_assert_not_null(only, "merging with NULL should succeed");
+  ct_assert_eq((int) only->count, 2, "merging with NULL should copy the other map");
+
+  hashmap_free(only, 0);
+  free(only);
+  hashmap_free(m, 0);
+  free(m);
+  hashmap_free(&a, 0);
+  hashmap_free(&b, 0);
+}
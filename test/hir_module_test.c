@@ -64,7 +64,7 @@ before_each(int, result, char* file_path, char* expected_path, char* module_name
 
   free(storage);
 
-  p.types = calloc(1, sizeof(known_type_array));
+  p.types = calloc(1, sizeof(type_registry_t));
   populate_parser_known_type(p.types);
 
   while ((size_t)p.pos < p.count) {
@@ -75,8 +75,8 @@ before_each(int, result, char* file_path, char* expected_path, char* module_name
   free(text);
 
   for (size_t i = 0; i < p.count; i++) {
-    if (p.items[i].string_value) {
-      free(p.items[i].string_value);
+    if (p.items[i].owned) {
+      free(p.items[i].owned);
     }
   }
   da_free(&p);
@@ -90,6 +90,7 @@ before_each(int, result, char* file_path, char* expected_path, char* module_name
   semantic_analyzer_t analyzer = {0};
   analyzer.error_ctx  = error_ctx;
   analyzer.ast        = program;
+  analyzer.types      = p.types;
   analyzer.error_count = 0;
   semantic_analyze(&analyzer);
 
@@ -98,6 +99,7 @@ before_each(int, result, char* file_path, char* expected_path, char* module_name
   hir_parser.error_count = 0;
   hir_parser.hir_program = hir_program;
   hir_parser.struct_symbols = analyzer.struct_symbols;
+  hir_parser.flat = &analyzer.flat;
   hir_parser.current_module = module_name;
   da_foreach(declaration_t*, it, program) {
     int lowering_result = IR_lower_function(&hir_parser, *it);
@@ -117,10 +119,10 @@ before_each(int, result, char* file_path, char* expected_path, char* module_name
 
   semantic_free_program_definition(&analyzer);
 
-  da_foreach(declaration_t*, it, program) {
-    free_declaration(*it);
-  }
+  parser_free_ast(&p);
   da_free(program);
+  error_free(error_ctx);
+  free(error_ctx);
 
   FILE *fr = fopen(expected_path, "rb");
   if (fr == NULL) {
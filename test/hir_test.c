@@ -68,7 +68,7 @@ before_each(int, result, char* file_path, char* expected_path)
 
   free(storage);
 
-  p.types = calloc(1, sizeof(known_type_array));
+  p.types = calloc(1, sizeof(type_registry_t));
   populate_parser_known_type(p.types);
 
   while ((size_t)p.pos < p.count) {
@@ -79,8 +79,8 @@ before_each(int, result, char* file_path, char* expected_path)
   free(text);
 
   for (size_t i = 0; i < p.count; i++) {
-    if (p.items[i].string_value) {
-      free(p.items[i].string_value);
+    if (p.items[i].owned) {
+      free(p.items[i].owned);
     }
   }
   da_free(&p);
@@ -94,6 +94,7 @@ before_each(int, result, char* file_path, char* expected_path)
   semantic_analyzer_t analyzer = {0};
   analyzer.error_ctx  = error_ctx;
   analyzer.ast        = program;
+  analyzer.types      = p.types;
   analyzer.error_count = 0;
   semantic_analyze(&analyzer);
 
@@ -102,6 +103,7 @@ before_each(int, result, char* file_path, char* expected_path)
   hir_parser.error_count = 0;
   hir_parser.hir_program = hir_program;
   hir_parser.struct_symbols = analyzer.struct_symbols;
+  hir_parser.flat = &analyzer.flat;
   chunk_counter_t chunk_counter = {0};
   hir_parser.gen_chunk = counter_chunk_gen;
   hir_parser.chunk_ctx = &chunk_counter;
@@ -123,10 +125,10 @@ before_each(int, result, char* file_path, char* expected_path)
 
   semantic_free_program_definition(&analyzer);
 
-  da_foreach(declaration_t*, it, program) {
-    free_declaration(*it);
-  }
+  parser_free_ast(&p);
   da_free(program);
+  error_free(error_ctx);
+  free(error_ctx);
 
   FILE *fr = fopen(expected_path, "rb");
   if (fr == NULL) {
@@ -7,6 +7,10 @@
 #   build_exit=<n>   required — expected exit code of `cleaf build`
 #   run_exit=<n>      optional — if set, the produced build/a.out is
 #                      executed afterwards and its exit code checked
+#   jobs=<n>          optional — if set, the project is built twice more
+#                      with `-j <n>`: the output (diagnostics included)
+#                      and build/a.out (link order included) must be
+#                      those of the `-j 1` build
 #
 # Usage: test/integration_test.sh <path-to-cleaf-binary>
 
@@ -32,6 +36,7 @@ for dir in "$CASE_DIR"/*/; do
 
   expected_build_exit=$(grep '^build_exit=' "$expect_file" | cut -d= -f2)
   expected_run_exit=$(grep '^run_exit=' "$expect_file" | cut -d= -f2)
+  jobs=$(grep '^jobs=' "$expect_file" | cut -d= -f2)
 
   (
     cd "$dir" || exit 1
@@ -57,6 +62,40 @@ for dir in "$CASE_DIR"/*/; do
     fi
   fi
 
+  if [ -n "$jobs" ]; then
+    ref_log=/tmp/cleaf_integration_${name}.log
+    ref_out=/tmp/cleaf_integration_${name}.a.out
+    jobs_log=/tmp/cleaf_integration_${name}_j${jobs}.log
+    rm -f "$ref_out"
+    [ -f "$dir/build/a.out" ] && cp "$dir/build/a.out" "$ref_out"
+
+    differs=""
+    for run in 1 2; do
+      (
+        cd "$dir" || exit 1
+        rm -rf build a.out
+        "$CLEAF_BIN" build -j "$jobs" > "$jobs_log" 2>&1
+      )
+      # only the worker count line may tell the two builds apart
+      if ! diff <(grep -v -- '--> jobs ' "$ref_log") \
+                <(grep -v -- '--> jobs ' "$jobs_log") > /dev/null; then
+        differs="output"
+        break
+      fi
+      if [ -f "$ref_out" ] && ! cmp -s "$ref_out" "$dir/build/a.out"; then
+        differs="build/a.out"
+        break
+      fi
+    done
+
+    if [ -n "$differs" ]; then
+      echo "[FAIL] $name: $differs of -j $jobs differs from -j 1 (run $run)"
+      echo "       see $ref_log and $jobs_log"
+      fail=$((fail + 1))
+      continue
+    fi
+  fi
+
   echo "[ OK ] $name"
 done
 
@@ -0,0 +1,132 @@
+// Lexer throughput on a generated source, once per scanning path.
+// Usage: lexer_bench [file.clf] (a synthetic module when no file is given)
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define LEXER_LIB_IMPLEMENTATION
+#include "../src/frontend/lexer.h"
+
+#define BENCH_SOURCE_BYTES (16 * 1024 * 1024)
+#define BENCH_RUNS 10
+
+static const char* path_names[] = { "scalar", "sse2", "avx2" };
+
+static char* generate_source(size_t* len)
+{
+  static const char* chunk =
+    "// running total of the values accumulated by the long loop below\n"
+    "/* block comment describing the function in a couple of lines,\n"
+    "   as documentation in real modules tends to do */\n"
+    "export fn accumulate_running_total_%zu(first_value: int, second_value: int): int {\n"
+    "        let message: string = \"accumulating values, this is a longer string literal\";\n"
+    "        let running_total_value: int = first_value + second_value * 42;\n"
+    "        return running_total_value;\n"
+    "}\n\n";
+
+  char* buf = malloc(BENCH_SOURCE_BYTES + 512);
+  if (!buf) return NULL;
+
+  size_t used = 0;
+  for (size_t i = 0; used < BENCH_SOURCE_BYTES; ++i)
+    used += (size_t) sprintf(buf + used, chunk, i);
+  *len = used;
+  return buf;
+}
+
+static char* read_source(const char* path, size_t* len)
+{
+  FILE* f = fopen(path, "rb");
+  if (!f) return NULL;
+  fseek(f, 0, SEEK_END);
+  long size = ftell(f);
+  fseek(f, 0, SEEK_SET);
+
+  char* buf = malloc((size_t) size + 1);
+  if (buf && fread(buf, 1, (size_t) size, f) != (size_t) size) {
+    free(buf);
+    buf = NULL;
+  }
+  fclose(f);
+  if (!buf) return NULL;
+  buf[size] = '\0';
+  *len = (size_t) size;
+  return buf;
+}
+
+static double now_seconds(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double) ts.tv_sec + (double) ts.tv_nsec / 1e9;
+}
+
+// Lexes the whole input, the checksum covers every token and identifier so
+// the paths can be compared
+static uint64_t lex_all(const char* src, size_t len, char* storage, long* tokens)
+{
+  lexer_t lex;
+  lexer_init_lexer(&lex, src, src + len, storage, 1024);
+
+  uint64_t sum = 0;
+  *tokens = 0;
+  while (lexer_get_token(&lex)) {
+    if (lex.token == LEXER_token_parse_error) break;
+    sum = sum * 31 + (uint64_t) lex.token;
+    if (lex.token == LEXER_token_id || lex.token == LEXER_token_dqstring)
+      for (int i = 0; i < lex.string_len; ++i)
+        sum = sum * 31 + (unsigned char) lex.string_value[i];
+    ++*tokens;
+  }
+  return sum;
+}
+
+int main(int argc, char** argv)
+{
+  size_t len = 0;
+  char* src = argc > 1 ? read_source(argv[1], &len) : generate_source(&len);
+  if (!src) {
+    fprintf(stderr, "cannot load the benchmark source\n");
+    return 1;
+  }
+
+  // tokens are not copied out, only the scanning is measured
+  (void) lexer_copy_token;
+
+  char storage[1024];
+  uint64_t expected = 0;
+  int status = 0;
+
+  printf("%zu bytes\n", len);
+  for (int level = LEXER_SIMD_SCALAR; level <= LEXER_SIMD_AVX2; ++level) {
+    if (lexer_set_simd(level) != level) {
+      printf("%-7s unsupported\n", path_names[level]);
+      continue;
+    }
+
+    long tokens = 0;
+    uint64_t sum = 0;
+    double best = 0;
+    for (int run = 0; run < BENCH_RUNS; ++run) {
+      double start = now_seconds();
+      sum = lex_all(src, len, storage, &tokens);
+      double elapsed = now_seconds() - start;
+      if (run == 0 || elapsed < best) best = elapsed;
+    }
+
+    if (level == LEXER_SIMD_SCALAR) expected = sum;
+    bool same = sum == expected;
+    if (!same) status = 1;
+
+    printf("%-7s %8.1f MB/s  %ld tokens%s\n",
+        path_names[level], (double) len / best / 1e6, tokens,
+        same ? "" : "  (token stream differs from scalar)");
+  }
+
+  free(src);
+  return status;
+}
@@ -0,0 +1,270 @@
+#define CTEST_BEFORE_EACH
+#define CTEST_LIB_IMPLEMENTATION
+#include "ctest.h"
+
+#define DA_LIB_IMPLEMENTATION
+#include "../src/thirdparty/da.h"
+
+#include <elf.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "../src/backend/object.h"
+#include "../src/backend/elf64.h"
+#include "../src/backend/linker.h"
+#include "../src/backend/x86_64_encoder.h"
+#include "../src/thirdparty/error.h"
+
+typedef struct {
+  int           result; // 0 when .text matches the expected bytes
+  object_file_t obj;
+} object_test_ctx_t;
+
+static int hex_digit(char c)
+{
+  if (c >= '0' && c <= '9') return c - '0';
+  if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+  return -1;
+}
+
+// Assembles `source` (one NASM line per `\n`) with the built-in assembler
+// and compares the encoded .text with `expected_hex`. Expected bytes were
+// checked against GNU as / objdump.
+before_each(object_test_ctx_t, tctx, char* source, char* expected_hex)
+{
+  object_test_ctx_t t = {0};
+
+  char* copy = strdup(source);
+  for (char* line = strtok(copy, "\n"); line; line = strtok(NULL, "\n"))
+    x86_assemble_line(&t.obj, line);
+  free(copy);
+  object_finalize(&t.obj);
+
+  size_t len = strlen(expected_hex);
+  t.result = t.obj.failed || len / 2 != t.obj.text.count;
+  for (size_t i = 0; !t.result && i < len / 2; ++i) {
+    int byte = hex_digit(expected_hex[2 * i]) * 16 +
+      hex_digit(expected_hex[2 * i + 1]);
+    if ((unsigned char) t.obj.text.items[i] != byte) t.result = 1;
+  }
+
+  tctx = t;
+}
+
+ct_test(object_encode, mov_reg_reg, "mov rbx, r11", "4c89db") {
+  ct_assert_eq(tctx.result, 0, "mov between 64 bit registers sets REX.W/R");
+  object_file_free(&tctx.obj);
+}
+
+ct_test(object_encode, mov_reg_reg_32, "mov r15d, eax", "4189c7") {
+  ct_assert_eq(tctx.result, 0, "mov between 32 bit registers has no REX.W");
+  object_file_free(&tctx.obj);
+}
+
+ct_test(object_encode, mov_imm_zero_extend, "mov rax, 60", "b83c000000") {
+  ct_assert_eq(tctx.result, 0,
+      "positive 32 bit immediate uses the zero extending form like NASM");
+  object_file_free(&tctx.obj);
+}
+
+ct_test(object_encode, mov_imm_negative, "mov r8, -1", "49c7c0ffffffff") {
+  ct_assert_eq(tctx.result, 0, "negative immediate is sign extended");
+  object_file_free(&tctx.obj);
+}
+
+ct_test(object_encode, mov_imm_64, "mov rax, 0x123456789",
+    "48b88967452301000000") {
+  ct_assert_eq(tctx.result, 0, "large immediate uses movabs");
+  object_file_free(&tctx.obj);
+}
+
+ct_test(object_encode, mov_imm_expression, "mov rdx, 0x01 | 0x02",
+    "ba03000000") {
+  ct_assert_eq(tctx.result, 0, "immediate expressions are folded");
+  object_file_free(&tctx.obj);
+}
+
+ct_test(object_encode, store_rbp_disp8, "mov [rbp - 16], r11d", "44895df0") {
+  ct_assert_eq(tctx.result, 0, "stack store uses a disp8");
+  object_file_free(&tctx.obj);
+}
+
+ct_test(object_encode, load_rbp_disp32, "mov r13, [rbp - 200]",
+    "4c8bad38ffffff") {
+  ct_assert_eq(tctx.result, 0, "stack load beyond 127 uses a disp32");
+  object_file_free(&tctx.obj);
+}
+
+ct_test(object_encode, base_r13_no_disp, "mov rbx, [r13]", "498b5d00") {
+  ct_assert_eq(tctx.result, 0, "r13 base always needs a displacement");
+  object_file_free(&tctx.obj);
+}
+
+ct_test(object_encode, base_rsp_sib, "mov rbx, [rsp]", "488b1c24") {
+  ct_assert_eq(tctx.result, 0, "rsp base always needs a SIB byte");
+  object_file_free(&tctx.obj);
+}
+
+ct_test(object_encode, base_index, "mov [rbx + r11], r12", "4e89241b") {
+  ct_assert_eq(tctx.result, 0, "base + index sets REX.X from the index");
+  object_file_free(&tctx.obj);
+}
+
+ct_test(object_encode, lea_scaled, "lea rdi, [rax + rbx*8 + 16]",
+    "488d7cd810") {
+  ct_assert_eq(tctx.result, 0, "scaled index with displacement");
+  object_file_free(&tctx.obj);
+}
+
+ct_test(object_encode, alu_imm8, "sub rsp, 32", "4883ec20") {
+  ct_assert_eq(tctx.result, 0, "small immediate uses the imm8 form");
+  object_file_free(&tctx.obj);
+}
+
+ct_test(object_encode, alu_imm32, "add rsp, 1024", "4881c400040000") {
+  ct_assert_eq(tctx.result, 0, "large immediate uses the imm32 form");
+  object_file_free(&tctx.obj);
+}
+
+ct_test(object_encode, imul_forms, "imul rbx, r11\nimul rbx, 8\nimul r13, r14, 1000",
+    "490fafdb486bdb084d69ee" "e8030000") {
+  ct_assert_eq(tctx.result, 0, "two and three operand imul");
+  object_file_free(&tctx.obj);
+}
+
+ct_test(object_encode, push_pop_extended, "push r12\npop rbp\npop r15",
+    "41545d415f") {
+  ct_assert_eq(tctx.result, 0, "push/pop of r8-r15 need REX.B");
+  object_file_free(&tctx.obj);
+}
+
+ct_test(object_encode, unsupported_fails, "movsb", "") {
+  ct_assert((tctx.obj.failed), "unknown mnemonics are reported");
+  object_file_free(&tctx.obj);
+}
+
+ct_test(object_label, local_jump_resolved,
+    "_f:\n.l0:\nnop\njmp .l0\n_g:\n.l0:\njmp .l0",
+    "90e9faffffffe9fbffffff") {
+  ct_assert_eq(tctx.result, 0,
+      "`.x` labels are scoped to the previous label and resolved in place");
+  ct_assert_eq((int) tctx.obj.relocs.count, 0, "no relocation for local jumps");
+  object_file_free(&tctx.obj);
+}
+
+ct_test(object_label, extern_call_relocated,
+    "extern _math__add\n_start:\ncall _math__add\ncall _start",
+    "e800000000e8f6ffffff") {
+  ct_assert_eq(tctx.result, 0, "calls to defined labels are resolved");
+  ct_assert_eq((int) tctx.obj.relocs.count, 1, "extern call is relocated");
+  ct_assert_eq((int) tctx.obj.relocs.items[0].offset, 1,
+      "relocation points at the rel32 field");
+  object_file_free(&tctx.obj);
+}
+
+ct_test(object_label, undefined_local_fails, "_f:\njmp .nowhere", "") {
+  ct_assert((tctx.obj.failed), "jump to an undefined local label errors");
+  object_file_free(&tctx.obj);
+}
+
+ct_test(object_elf, relocatable_layout,
+    "global _start\nextern _math__add\n_start:\ncall _math__add\nret",
+    "e800000000c3") {
+  string_builder_t image = {0};
+  ct_assert((elf64_serialize_object(&tctx.obj, &image)),
+      "object serializes");
+
+  Elf64_Ehdr* eh = (Elf64_Ehdr*) image.items;
+  Elf64_Shdr* sh = (Elf64_Shdr*) (image.items + eh->e_shoff);
+  ct_assert((memcmp(eh->e_ident, ELFMAG, SELFMAG) == 0), "ELF magic");
+  ct_assert_eq((int) eh->e_type, ET_REL, "relocatable object");
+  ct_assert_eq((int) eh->e_machine, EM_X86_64, "x86-64 machine");
+
+  Elf64_Shdr* rela = NULL;
+  Elf64_Shdr* symtab = NULL;
+  for (int i = 0; i < eh->e_shnum; ++i) {
+    if (sh[i].sh_type == SHT_RELA) rela = &sh[i];
+    if (sh[i].sh_type == SHT_SYMTAB) symtab = &sh[i];
+  }
+  ct_assert_not_null(rela, "has a .rela.text section");
+  ct_assert_not_null(symtab, "has a .symtab section");
+
+  Elf64_Rela* r = (Elf64_Rela*) (image.items + rela->sh_offset);
+  Elf64_Sym* syms = (Elf64_Sym*) (image.items + symtab->sh_offset);
+  const char* strtab = image.items + sh[symtab->sh_link].sh_offset;
+  Elf64_Sym* target = &syms[ELF64_R_SYM(r->r_info)];
+
+  ct_assert_eq((int) ELF64_R_TYPE(r->r_info), R_X86_64_PLT32,
+      "calls use PLT32 relocations");
+  ct_assert_eq(strtab + target->st_name, "_math__add",
+      "relocation targets the extern symbol");
+  ct_assert_eq((int) target->st_shndx, SHN_UNDEF, "extern is undefined");
+  ct_assert_eq((int) ELF64_ST_BIND(syms[symtab->sh_info].st_info),
+      STB_GLOBAL, "globals start at sh_info");
+
+  da_free(&image);
+  object_file_free(&tctx.obj);
+}
+
+static void serialize_input(
+    link_input_array* inputs, string_builder_t* image, const char* source)
+{
+  object_file_t obj = {0};
+  char* copy = strdup(source);
+  for (char* line = strtok(copy, "\n"); line; line = strtok(NULL, "\n"))
+    x86_assemble_line(&obj, line);
+  free(copy);
+  object_finalize(&obj);
+  elf64_serialize_object(&obj, image);
+  object_file_free(&obj);
+
+  link_input_t input = { "<test>", image->items, image->count };
+  da_append(inputs, input);
+}
+
+ct_test(object_link, two_objects_run,
+    "global _start\nextern _math__add\n_start:\nmov rdi, 40\n"
+    "call _math__add\nmov rdi, rax\nmov rax, 60\nsyscall", "") {
+  string_builder_t main_image = {0};
+  string_builder_t math_image = {0};
+  link_input_array inputs = {0};
+
+  ct_assert((elf64_serialize_object(&tctx.obj, &main_image)),
+      "main object serializes");
+  link_input_t main_input = { "<main>", main_image.items, main_image.count };
+  da_append(&inputs, main_input);
+  serialize_input(&inputs, &math_image,
+      "global _math__add\n_math__add:\nlea rax, [rdi + 2]\nret");
+
+  ct_assert_eq((int) link_executable(&inputs, "_start", "build/object_link"),
+      LINK_OK, "objects link without ld");
+
+  int status = system("./build/object_link");
+  ct_assert_eq(WIFEXITED(status) ? WEXITSTATUS(status) : -1, 42,
+      "cross-object call is relocated");
+
+  remove("build/object_link");
+  da_free(&inputs);
+  da_free(&math_image);
+  da_free(&main_image);
+  object_file_free(&tctx.obj);
+}
+
+ct_test(object_link, undefined_reference_fails,
+    "global _start\nextern _math__sub\n_start:\ncall _math__sub", "") {
+  string_builder_t image = {0};
+  link_input_array inputs = {0};
+
+  ct_assert((elf64_serialize_object(&tctx.obj, &image)), "object serializes");
+  link_input_t input = { "<main>", image.items, image.count };
+  da_append(&inputs, input);
+
+  ct_assert_eq((int) link_executable(&inputs, "_start", "build/object_link"),
+      LINK_ERROR, "undefined symbol is reported");
+  ct_assert((access("build/object_link", F_OK) != 0),
+      "nothing is written on error");
+
+  da_free(&inputs);
+  da_free(&image);
+  object_file_free(&tctx.obj);
+}
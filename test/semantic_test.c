@@ -12,6 +12,9 @@
 #include "../src/frontend/semantic.h"
 #include "../src/thirdparty/error.h"
 
+// nodes of the program `analyzer` checks, freed by free_analyzer
+static arena_t ast_arena;
+
 before_each(semantic_analyzer_t, analyzer, char* file_path)
 {
   FILE *f = fopen(file_path, "rb");
@@ -60,7 +63,7 @@ before_each(semantic_analyzer_t, analyzer, char* file_path)
 
   free(storage);
 
-  p.types = calloc(1, sizeof(known_type_array));
+  p.types = calloc(1, sizeof(type_registry_t));
   populate_parser_known_type(p.types);
 
   while ((size_t)p.pos < p.count) {
@@ -72,28 +75,28 @@ before_each(semantic_analyzer_t, analyzer, char* file_path)
 
   a.error_ctx    = error_ctx;
   a.ast          = program;
+  a.types        = p.types;
   a.error_count  = 0;
 
   semantic_analyze(&a);
 
   for (size_t i = 0; i < p.count; i++) {
-    if (p.items[i].string_value) {
-      free(p.items[i].string_value);
+    if (p.items[i].owned) {
+      free(p.items[i].owned);
     }
   }
   da_free(&p);
 
+  ast_arena = p.arena;
   analyzer = a;
 }
 
 void free_analyzer(semantic_analyzer_t* analyzer)
 {
-  da_foreach(declaration_t*, it, analyzer->ast) {
-    free_declaration(*it);
-  }
-
+  arena_free(&ast_arena);
   da_free(analyzer->ast);
   free(analyzer->ast);
+  error_free(analyzer->error_ctx);
   free(analyzer->error_ctx);
 
   semantic_free_program_definition(analyzer);
@@ -108,12 +111,12 @@ ct_test(semantic_analyze, fn_def_simple, "test/semantic_case/fn_def_simple.clf")
 ct_test(semantic_analyze, fn_def_with_params, "test/semantic_case/fn_def_with_params.clf") {
   ct_assert_eq(analyzer.error_count, 0, "Should have no errors for function with params");
 
-  function_symbol_t* fs = (function_symbol_t*) hashmap_get(analyzer.function_symbols, "main");
+  function_symbol_t* fs = (function_symbol_t*) atom_map_get(analyzer.function_symbols, intern_cstr("main"));
   ct_assert_not_null(fs, "Function symbol should be in symbol table");
   ct_assert_eq((int)fs->params_count, 2, "Function should have 2 parameters");
-  ct_assert_eq(fs->params_name[0], "a", "First param name should be 'a'");
+  ct_assert_eq(atom_str(fs->params_atom[0]), "a", "First param name should be 'a'");
   ct_assert_eq(fs->params_type[0].type.kind, TYPE_INT, "First param type should be TYPE_INT");
-  ct_assert_eq(fs->params_name[1], "b", "Second param name should be 'b'");
+  ct_assert_eq(atom_str(fs->params_atom[1]), "b", "Second param name should be 'b'");
   ct_assert_eq(fs->params_type[1].type.kind, TYPE_INT, "Second param type should be TYPE_STRING");
 
   free_analyzer(&analyzer);
@@ -122,7 +125,7 @@ ct_test(semantic_analyze, fn_def_with_params, "test/semantic_case/fn_def_with_pa
 ct_test(semantic_analyze, fn_def_with_return_type, "test/semantic_case/fn_def_with_return_type.clf") {
   ct_assert_eq(analyzer.error_count, 0, "Should have no errors for function with return type");
 
-  function_symbol_t* fs = (function_symbol_t*) hashmap_get(analyzer.function_symbols, "main");
+  function_symbol_t* fs = (function_symbol_t*) atom_map_get(analyzer.function_symbols, intern_cstr("main"));
   ct_assert_not_null(fs, "Function symbol should be in symbol table");
   ct_assert_eq(fs->return_type.kind, TYPE_INT, "Return type should be TYPE_INT");
 
@@ -449,13 +452,17 @@ ct_test(semantic_case, member_access_type_annotation, "test/semantic_case/struct
   ct_assert_not_null(expr, "Return expression should not be null");
   ct_assert_not_null(expr->var.member, "Member expression should not be null");
 
-  ct_assert_eq(expr->var.ident.type.kind, TYPE_CUSTOM,
+  known_type_t* base = ast_flat_var_type(&analyzer.flat, expr->flat);
+  known_type_t* member =
+    ast_flat_var_type(&analyzer.flat, expr->var.member->flat);
+
+  ct_assert_eq(base->kind, TYPE_CUSTOM,
       "Member access base 'a' should be annotated as TYPE_CUSTOM (struct)");
-  ct_assert_eq((int)expr->var.ident.type.element_size, 8,
+  ct_assert_eq((int)base->element_size, 8,
       "Member access base 'a' should have size 8 bytes");
-  ct_assert_eq(expr->var.member->var.ident.type.kind, TYPE_INT,
+  ct_assert_eq(member->kind, TYPE_INT,
       "Member access '.x' should be annotated as TYPE_INT");
-  ct_assert_eq((int)expr->var.member->var.ident.type.element_size, 4,
+  ct_assert_eq((int)member->element_size, 4,
       "Member access '.x' should have size 4 bytes");
 
   free_analyzer(&analyzer);
@@ -465,7 +472,7 @@ ct_test(semantic_case, struct_symbol_total_size, "test/semantic_case/struct_defi
   ct_assert_eq(analyzer.error_count, 0, "Should have no errors");
 
   struct_symbol_t* sym =
-      (struct_symbol_t*) hashmap_get(analyzer.struct_symbols, "v2");
+      (struct_symbol_t*) atom_map_get(analyzer.struct_symbols, intern_cstr("v2"));
   ct_assert_not_null(sym, "Struct symbol 'v2' should be in symbol table");
   ct_assert_eq((int)sym->total_size, 8,
       "Struct v2 total_size should be 8 (2 int fields x 4 bytes each)");
@@ -533,7 +540,7 @@ ct_test(semantic_case, binary_promotion_return_ok, "test/semantic_case/binary_pr
 ct_test(semantic_case, fn_ret_type_u8, "test/semantic_case/fn_ret_type_u8.clf") {
   ct_assert_eq(analyzer.error_count, 0, "Should have no errors for u8 return type function");
 
-  function_symbol_t* fs = (function_symbol_t*) hashmap_get(analyzer.function_symbols, "main");
+  function_symbol_t* fs = (function_symbol_t*) atom_map_get(analyzer.function_symbols, intern_cstr("main"));
   ct_assert_not_null(fs, "Function symbol should be in symbol table");
   ct_assert_eq(fs->return_type.kind, TYPE_U8, "Return type should be TYPE_U8");
 
@@ -543,7 +550,7 @@ ct_test(semantic_case, fn_ret_type_u8, "test/semantic_case/fn_ret_type_u8.clf")
 ct_test(semantic_case, fn_params_u8_u16, "test/semantic_case/fn_params_u8_u16.clf") {
   ct_assert_eq(analyzer.error_count, 0, "Should have no errors for u8/u16 parameters");
 
-  function_symbol_t* fs = (function_symbol_t*) hashmap_get(analyzer.function_symbols, "main");
+  function_symbol_t* fs = (function_symbol_t*) atom_map_get(analyzer.function_symbols, intern_cstr("main"));
   ct_assert_not_null(fs, "Function symbol should be in symbol table");
   ct_assert_eq((int)fs->params_count, 2, "Function should have 2 parameters");
   ct_assert_eq(fs->params_type[0].type.kind, TYPE_U8, "First param type should be TYPE_U8");
@@ -557,7 +564,7 @@ ct_test(semantic_case, fn_params_u8_u16, "test/semantic_case/fn_params_u8_u16.cl
 ct_test(semantic_case, fn_def_return_type_u16, "test/semantic_case/fn_def_with_return_type.clf") {
   ct_assert_eq(analyzer.error_count, 0, "Should have no errors");
 
-  function_symbol_t* fs = (function_symbol_t*) hashmap_get(analyzer.function_symbols, "foo");
+  function_symbol_t* fs = (function_symbol_t*) atom_map_get(analyzer.function_symbols, intern_cstr("foo"));
   ct_assert_not_null(fs, "Function symbol 'foo' should be in symbol table");
   ct_assert_eq(fs->return_type.kind, TYPE_U16, "Return type of foo should be TYPE_U16");
 
@@ -618,14 +625,20 @@ ct_test(semantic_case, struct_inference_if_while_condition, "test/semantic_case/
   statement_t* while_stmt = func_decl->func.body->items[3];
   expression_t* expr = while_stmt->while_stmt.condition;
 
-  ct_assert_eq(expr->binary.left->var.ident.type.name, "v2", "type infence should have been applied");
-  ct_assert_eq(expr->binary.left->var.member->var.ident.type.name, "int", "type inference should have been applied to function member");
+  expression_t* lhs = expr->binary.left;
+  ct_assert_eq(ast_flat_var_type(&analyzer.flat, lhs->flat)->name, "v2",
+      "type infence should have been applied");
+  ct_assert_eq(ast_flat_var_type(&analyzer.flat, lhs->var.member->flat)->name,
+      "int", "type inference should have been applied to function member");
 
   statement_t* if_stmt = func_decl->func.body->items[2];
   expr = if_stmt->if_stmt.condition;
 
-  ct_assert_eq(expr->binary.right->var.ident.type.name, "v2", "type infence should have been applied");
-  ct_assert_eq(expr->binary.right->var.member->var.ident.type.name, "int", "type inference should have been applied to function member");
+  expression_t* rhs = expr->binary.right;
+  ct_assert_eq(ast_flat_var_type(&analyzer.flat, rhs->flat)->name, "v2",
+      "type infence should have been applied");
+  ct_assert_eq(ast_flat_var_type(&analyzer.flat, rhs->var.member->flat)->name,
+      "int", "type inference should have been applied to function member");
 
   free_analyzer(&analyzer);
 }
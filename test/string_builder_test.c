@@ -0,0 +1,145 @@
+#define CTEST_LIB_IMPLEMENTATION
+#include "ctest.h"
+
+#include <limits.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+#include "../src/thirdparty/string_builder.h"
+
+// Appends the same mix of pieces, `rounds` times: literals, register like
+// names, integers, formatted lines and a piece longer than a chunk
+static void append_sample(string_builder_t* sb, size_t rounds)
+{
+  static char long_piece[SB_CHUNK_SIZE + 123];
+  memset(long_piece, 'x', sizeof(long_piece));
+
+  for (size_t i = 0; i < rounds; ++i) {
+    sb_append_str(sb, "    mov ");
+    sb_append_str(sb, i % 2 ? "rax" : "r11d");
+    sb_append_str(sb, ", ");
+    sb_append_int(sb, (long long) i * -7919);
+    sb_append_char(sb, '\n');
+    sb_append_fmt(sb, "    mov [rbp - %zu], %s\n", i * 8, "rbx");
+    if (i % 5000 == 0)
+      sb_append_strn(sb, long_piece, sizeof(long_piece));
+  }
+}
+
+// Text written through `sink` since it was rewound
+static char* read_sink(FILE* sink, size_t* len)
+{
+  *len = (size_t) ftell(sink);
+  rewind(sink);
+  char* text = malloc(*len + 1);
+  if (!text) abort();
+  if (fread(text, 1, *len, sink) != *len) abort();
+  text[*len] = '\0';
+  return text;
+}
+
+ct_test(string_builder, sink_matches_plain_builder)
+{
+  string_builder_t plain = {0};
+  append_sample(&plain, 20000);
+
+  FILE* sink = tmpfile();
+  ct_assert_not_null(sink, "a temporary file should open");
+  string_builder_t streamed = {0};
+  sb_set_sink(&streamed, sink);
+  append_sample(&streamed, 20000);
+
+  ct_assert((streamed.flushed > 3 * SB_CHUNK_SIZE), "several chunks should be flushed before the end");
+  ct_assert((streamed.capacity < 3 * SB_CHUNK_SIZE), "the buffer should not grow with the text");
+  ct_assert((sb_length(&streamed) == plain.count), "the length should count the flushed bytes");
+
+  sb_flush(&streamed);
+  ct_assert_eq((int) streamed.count, 0, "a flush should empty the buffer");
+  ct_assert((sb_length(&streamed) == plain.count), "a flush should not change the length");
+
+  size_t len = 0;
+  char* text = read_sink(sink, &len);
+  ct_assert((len == plain.count), "the file should hold every byte");
+  ct_assert((memcmp(text, plain.items, plain.count) == 0), "the file should match the plain builder");
+
+  free(text);
+  fclose(sink);
+  da_free(&streamed);
+  da_free(&plain);
+}
+
+ct_test(string_builder, fmt_after_flush)
+{
+  FILE* sink = tmpfile();
+  ct_assert_not_null(sink, "a temporary file should open");
+  string_builder_t sb = {0};
+  sb_set_sink(&sb, sink);
+
+  // fill the chunk to a few bytes short, the next line does not fit
+  static char filler[SB_CHUNK_SIZE - 4];
+  memset(filler, '.', sizeof(filler));
+  sb_append_strn(&sb, filler, sizeof(filler));
+  sb_append_fmt(&sb, "%s %d\n", "after flush", 42);
+
+  ct_assert((sb.flushed == sizeof(filler)), "the full chunk should be flushed first");
+  ct_assert_eq(sb.items, "after flush 42\n", "the line should start the next chunk");
+
+  sb_flush(&sb);
+  size_t len = 0;
+  char* text = read_sink(sink, &len);
+  ct_assert((len == sizeof(filler) + strlen("after flush 42\n")), "the file should hold both parts");
+  ct_assert((strcmp(text + sizeof(filler), "after flush 42\n") == 0), "the line should follow the filler");
+
+  free(text);
+  fclose(sink);
+  da_free(&sb);
+}
+
+ct_test(string_builder, fmt_longer_than_spare_room)
+{
+  string_builder_t sb = {0};
+  sb_append_str(&sb, "ab");
+  char wide[300];
+  memset(wide, 'w', sizeof(wide) - 1);
+  wide[sizeof(wide) - 1] = '\0';
+  sb_append_fmt(&sb, "[%s]", wide);
+
+  ct_assert((sb.count == 2 + 2 + strlen(wide)), "the whole line should be appended");
+  ct_assert((sb.items[sb.count] == '\0'), "the text should stay terminated");
+  ct_assert((sb.items[2] == '[' && sb.items[sb.count - 1] == ']'), "the line should follow the earlier text");
+
+  da_free(&sb);
+}
+
+ct_test(string_builder, integer_edge_cases)
+{
+  const long long signed_values[] = { 0, 7, -1, 10, -10, 1234567890123LL, LLONG_MAX, LLONG_MIN };
+  const unsigned long long unsigned_values[] = { 0, 9, 10, ULLONG_MAX };
+
+  bool same = true;
+  for (size_t i = 0; i < sizeof(signed_values) / sizeof(signed_values[0]); ++i) {
+    char expected[32];
+    snprintf(expected, sizeof(expected), "%lld", signed_values[i]);
+    string_builder_t sb = {0};
+    sb_append_int(&sb, signed_values[i]);
+    same = same && strcmp(sb.items, expected) == 0;
+    da_free(&sb);
+  }
+  ct_assert(same, "signed integers should print as %lld does");
+
+  same = true;
+  for (size_t i = 0; i < sizeof(unsigned_values) / sizeof(unsigned_values[0]); ++i) {
+    char expected[32];
+    snprintf(expected, sizeof(expected), "%llu", unsigned_values[i]);
+    string_builder_t sb = {0};
+    sb_append_uint(&sb, unsigned_values[i]);
+    same = same && strcmp(sb.items, expected) == 0;
+    da_free(&sb);
+  }
+  ct_assert(same, "unsigned integers should print as %llu does");
+
+  string_builder_t sb = {0};
+  sb_append_int(&sb, LLONG_MIN);
+  ct_assert_eq(sb.items, "-9223372036854775808", "LLONG_MIN should not overflow");
+  da_free(&sb);
+}